@@ -0,0 +1,301 @@
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+// Cold-cache random segment reads: the blocking path the server used before
+// (mmap + copy on the request thread, as SegmentCache::load did) against the async
+// file backends of libwavy/utils/io/async.
+//
+// A set of segment-sized files is written once. Every run drops them from the page
+// cache (posix_fadvise(DONTNEED)) and then reads each file exactly once, whole, in a
+// random order, so every read goes to the device. Per concurrency level:
+//
+//   blocking      N threads, each reading with mmap + copy
+//   <backend>     N threads, each submitting one read and waiting for it
+//   <backend>+b   one thread submitting N reads as a batch and waiting for the batch
+//
+// <backend> is `threads` (pread pool) and, when built with liburing, `io_uring`.
+//
+// The files have to live on a block device: on tmpfs there is no cold cache and the
+// numbers only measure memcpy.
+//
+// Usage: example_io_bench [dir=./io-bench-data] [files=512] [file-kib=512]
+//                         [pool-threads=4] [concurrency=1,4,16,64]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <libwavy/utils/io/async/entry.hpp>
+#include <libwavy/utils/io/mmap/entry.hpp>
+#include <linux/magic.h>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/vfs.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace fs  = std::filesystem;
+namespace aio = libwavy::utils::aio;
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+
+struct Result
+{
+  double              seconds = 0;
+  std::size_t         bytes   = 0;
+  std::size_t         errors  = 0;
+  std::vector<double> latencies_ms;
+};
+
+void make_files(const std::vector<std::string>& paths, std::size_t size)
+{
+  std::mt19937_64   rng(42);
+  std::vector<char> data(size);
+
+  for (const auto& path : paths)
+  {
+    std::error_code ec;
+    if (fs::exists(path, ec) && fs::file_size(path, ec) == size)
+      continue;
+
+    for (auto& c : data)
+      c = static_cast<char>(rng());
+
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ::write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size()))
+    {
+      std::cerr << "cannot write " << path << "\n";
+      std::exit(1);
+    }
+    ::fsync(fd);
+    ::close(fd);
+  }
+}
+
+void drop_cache(const std::vector<std::string>& paths)
+{
+  for (const auto& path : paths)
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      continue;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+}
+
+// The read every request did before: map the file, copy it into a body
+auto blocking_read(const std::string& path) -> std::optional<std::string>
+{
+  libwavy::utils::MappedFile file(path);
+  if (!file.is_open())
+    return std::nullopt;
+  auto view = file.view();
+  return std::string(view.data(), view.size());
+}
+
+// `clients` threads pull file indices off a shared cursor, one read at a time
+auto run_clients(const std::vector<std::string>& paths, const std::vector<std::size_t>& order,
+                 std::size_t clients,
+                 const std::function<std::optional<std::string>(const std::string&)>& read)
+  -> Result
+{
+  Result                           result;
+  std::atomic<std::size_t>         cursor{0};
+  std::atomic<std::size_t>         bytes{0}, errors{0};
+  std::vector<std::vector<double>> latencies(clients);
+
+  const auto start = Clock::now();
+
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < clients; ++t)
+    threads.emplace_back(
+      [&, t]
+      {
+        for (std::size_t i = cursor++; i < order.size(); i = cursor++)
+        {
+          const auto t0   = Clock::now();
+          const auto body = read(paths[order[i]]);
+          latencies[t].push_back(
+            std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+          if (body)
+            bytes += body->size();
+          else
+            errors++;
+        }
+      });
+  for (auto& thread : threads)
+    thread.join();
+
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  result.bytes   = bytes;
+  result.errors  = errors;
+  for (auto& l : latencies)
+    result.latencies_ms.insert(result.latencies_ms.end(), l.begin(), l.end());
+  return result;
+}
+
+// One thread, `batch` reads per submission; every read of a batch reports the batch time
+auto run_batches(aio::FileIO& io, const std::vector<std::string>& paths,
+                 const std::vector<std::size_t>& order, std::size_t batch) -> Result
+{
+  Result     result;
+  const auto start = Clock::now();
+
+  for (std::size_t first = 0; first < order.size(); first += batch)
+  {
+    std::vector<std::string> names;
+    for (std::size_t i = first; i < std::min(order.size(), first + batch); ++i)
+      names.push_back(paths[order[i]]);
+
+    const auto t0       = Clock::now();
+    const auto contents = aio::read_files(io, names);
+    const auto ms       = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    for (const auto& body : contents)
+    {
+      result.latencies_ms.push_back(ms);
+      if (body)
+        result.bytes += body->size();
+      else
+        result.errors++;
+    }
+  }
+
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
+
+auto percentile(std::vector<double>& values, double p) -> double
+{
+  if (values.empty())
+    return 0;
+  const auto k = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(k), values.end());
+  return values[k];
+}
+
+void report(const std::string& mode, std::size_t concurrency, Result r)
+{
+  const double ops = static_cast<double>(r.latencies_ms.size()) / r.seconds;
+  const double mib = static_cast<double>(r.bytes) / (1024.0 * 1024.0) / r.seconds;
+  std::printf("%-12s %6zu %10.0f %10.1f %9.2f %9.2f %7zu\n", mode.c_str(), concurrency, ops, mib,
+              percentile(r.latencies_ms, 0.50), percentile(r.latencies_ms, 0.99), r.errors);
+}
+
+auto parse_levels(const std::string& arg) -> std::vector<std::size_t>
+{
+  std::vector<std::size_t> levels;
+  std::stringstream        ss(arg);
+  std::string              item;
+  while (std::getline(ss, item, ','))
+    if (const int n = std::atoi(item.c_str()); n > 0)
+      levels.push_back(static_cast<std::size_t>(n));
+  return levels;
+}
+
+} // namespace
+
+auto main(int argc, char* argv[]) -> int
+{
+  const fs::path    dir          = argc > 1 ? argv[1] : "./io-bench-data";
+  const std::size_t files        = argc > 2 ? std::atoi(argv[2]) : 512;
+  const std::size_t file_kib     = argc > 3 ? std::atoi(argv[3]) : 512;
+  const std::size_t pool_threads = argc > 4 ? std::atoi(argv[4]) : 4;
+  const auto        levels       = parse_levels(argc > 5 ? argv[5] : "1,4,16,64");
+
+  if (files == 0 || file_kib == 0 || levels.empty())
+  {
+    std::cerr << "nothing to do\n";
+    return 1;
+  }
+
+  fs::create_directories(dir);
+
+  struct statfs sfs{};
+  if (::statfs(dir.c_str(), &sfs) == 0 && sfs.f_type == TMPFS_MAGIC)
+    std::cerr << "warning: " << dir << " is on tmpfs, reads will never be cold\n";
+
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < files; ++i)
+    paths.push_back((dir / ("hls_seg_" + std::to_string(i) + ".ts")).string());
+  make_files(paths, file_kib * 1024);
+
+  std::vector<std::size_t> order(files);
+  for (std::size_t i = 0; i < files; ++i)
+    order[i] = i;
+  std::mt19937 rng(7);
+
+  const std::size_t deepest = *std::max_element(levels.begin(), levels.end());
+
+  std::vector<std::unique_ptr<aio::FileIO>> backends;
+  backends.push_back(std::make_unique<aio::ThreadPoolFileIO>(pool_threads, 0, 128 * 1024));
+#ifdef WAVY_HAVE_LIBURING
+  if (auto ring = aio::IoUringFileIO::create(static_cast<unsigned>(deepest), 0, 128 * 1024))
+    backends.push_back(std::move(ring));
+  else
+    std::cerr << "io_uring unavailable on this kernel, skipping it\n";
+#endif
+
+  std::printf("%zu files x %zu KiB in %s, pool threads: %zu\n\n", files, file_kib,
+              dir.string().c_str(), pool_threads);
+  std::printf("%-12s %6s %10s %10s %9s %9s %7s\n", "mode", "conc", "ops/s", "MiB/s", "p50 ms",
+              "p99 ms", "errors");
+
+  auto cold_order = [&]
+  {
+    std::shuffle(order.begin(), order.end(), rng);
+    drop_cache(paths);
+    return order;
+  };
+
+  for (const std::size_t concurrency : levels)
+  {
+    report("blocking", concurrency, run_clients(paths, cold_order(), concurrency, blocking_read));
+
+    for (auto& io : backends)
+    {
+      const std::string name(io->name());
+      report(name, concurrency,
+             run_clients(paths, cold_order(), concurrency,
+                         [&io](const std::string& path) { return aio::read_file(*io, path); }));
+      report(name + "+b", concurrency, run_batches(*io, paths, cold_order(), concurrency));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+
+// Mixed reader/writer stress run for the sharded MiniDB (libwavy/db/entry.hpp).
+//
+// Built with -fsanitize=thread (see CMakeLists.txt): ThreadSanitizer aborts the
+// run on any data race. On top of that the program checks a few invariants that
+// only hold if every shard is updated atomically:
+//
+//   - a visitor never sees an owner with an empty audio set
+//   - every writer owns its audio IDs, so the final relation count must equal the
+//     sum of what the writers believe they left behind
+//
+// Usage: example_minidb_stress [readers=8] [writers=4] [ops-per-writer=5000]
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <libwavy/db/entry.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using StressDB = libwavy::MiniDB<std::string, std::string>;
+
+namespace
+{
+
+constexpr int OWNER_POOL = 24; // small on purpose: writers and readers keep colliding
+
+auto owner_name(int i) -> std::string { return "owner-" + std::to_string(i); }
+
+} // namespace
+
+auto main(int argc, char* argv[]) -> int
+{
+  const int readers = argc > 1 ? std::atoi(argv[1]) : 8;
+  const int writers = argc > 2 ? std::atoi(argv[2]) : 4;
+  const int ops     = argc > 3 ? std::atoi(argv[3]) : 5000;
+
+  StressDB db;
+  db.update_db(
+    [](StressDB& d)
+    {
+      for (int i = 0; i < OWNER_POOL; ++i)
+        d.insert(owner_name(i), "seed-" + std::to_string(i));
+    });
+
+  std::atomic<bool>   done{false};
+  std::atomic<size_t> violations{0};
+  std::atomic<size_t> reads{0};
+  std::vector<size_t> left_behind(writers, 0);
+
+  std::vector<std::thread> threads;
+
+  for (int w = 0; w < writers; ++w)
+  {
+    threads.emplace_back(
+      [&, w]
+      {
+        std::mt19937                                     rng(w + 1);
+        std::uniform_int_distribution<int>               pick_owner(0, OWNER_POOL - 1);
+        std::vector<std::pair<std::string, std::string>> live;
+
+        for (int i = 0; i < ops; ++i)
+        {
+          if (!live.empty() && rng() % 3 == 0)
+          {
+            const auto idx = rng() % live.size();
+            if (!db.erase(live[idx].first, live[idx].second))
+              violations.fetch_add(1);
+            live[idx] = live.back();
+            live.pop_back();
+            continue;
+          }
+
+          auto owner = owner_name(pick_owner(rng));
+          auto audio = "w" + std::to_string(w) + "-" + std::to_string(i);
+          if (!db.insert(owner, audio))
+            violations.fetch_add(1);
+          live.emplace_back(std::move(owner), std::move(audio));
+        }
+        left_behind[w] = live.size();
+      });
+  }
+
+  for (int r = 0; r < readers; ++r)
+  {
+    threads.emplace_back(
+      [&, r]
+      {
+        std::mt19937 rng(1000 + r);
+        while (!done.load(std::memory_order_relaxed))
+        {
+          const auto owner = owner_name(static_cast<int>(rng() % OWNER_POOL));
+
+          switch (rng() % 5)
+          {
+            case 0:
+              db.for_each_owner(
+                [&](const std::string&, const StressDB::audio_set& audios)
+                {
+                  if (audios.empty())
+                    violations.fetch_add(1);
+                });
+              break;
+            case 1:
+              (void)db.has(owner, "seed-0");
+              (void)db.has_owner(owner);
+              break;
+            case 2:
+              db.with_audio_ids(owner,
+                                [&](const StressDB::audio_set& audios)
+                                {
+                                  if (audios.empty())
+                                    violations.fetch_add(1);
+                                });
+              break;
+            case 3:
+              (void)db.audio_ids(owner).size();
+              break;
+            default:
+              (void)db.relation_count();
+              (void)db.owners();
+              break;
+          }
+          reads.fetch_add(1, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  for (int w = 0; w < writers; ++w)
+    threads[w].join();
+  done = true;
+  for (size_t t = writers; t < threads.size(); ++t)
+    threads[t].join();
+
+  size_t expected = OWNER_POOL; // seeds are never erased
+  for (auto n : left_behind)
+    expected += n;
+
+  const auto relations = db.relation_count();
+  if (relations != expected)
+    violations.fetch_add(1);
+
+  std::cout << "readers=" << readers << " writers=" << writers << " ops/writer=" << ops
+            << " reads=" << reads.load() << " owners=" << db.owner_count()
+            << " relations=" << relations << " expected=" << expected
+            << " violations=" << violations.load() << "\n";
+
+  return violations.load() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
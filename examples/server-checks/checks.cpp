@@ -0,0 +1,350 @@
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+
+// Self-checking run over the server pieces whose failure modes are hard to hit from a
+// client: Range parsing and the 206 / 416 bodies (libwavy/server/http-range.hpp), and
+// the recovery paths of the catalog log (libwavy/db/catalog-log.hpp).
+//
+//   - ranges: suffix, open-ended, overlapping / adjacent (coalesced), clamped,
+//     unsatisfiable and malformed headers, and the multipart/byteranges body
+//   - catalog: replay of a log cut mid-record, an append that fails half way (the
+//     partial record is cut back off, the change survives in a snapshot) and a
+//     compaction interrupted between the snapshot rename and the log truncation
+//
+// Every failed check is printed; the exit status is non-zero if any failed.
+//
+// Usage: example_server_checks [scratch-dir=/tmp/wavy-server-checks]
+
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <libwavy/db/catalog-log.hpp>
+#include <libwavy/server/http-range.hpp>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using libwavy::CatalogLog;
+using libwavy::server::ByteRange;
+using libwavy::server::RangeStatus;
+
+namespace
+{
+
+constexpr ui64 FILE_SIZE = 1000;
+
+std::size_t g_checks   = 0;
+std::size_t g_failures = 0;
+
+void check(bool ok, std::string_view what)
+{
+  g_checks++;
+  if (ok)
+    return;
+  g_failures++;
+  std::cerr << "FAILED: " << what << "\n";
+}
+
+auto same_ranges(const libwavy::server::RangeRequest& got, RangeStatus status,
+                 const std::vector<ByteRange>& want) -> bool
+{
+  if (got.status != status || got.ranges.size() != want.size())
+    return false;
+  for (std::size_t i = 0; i < want.size(); ++i)
+    if (got.ranges[i].first != want[i].first || got.ranges[i].last != want[i].last)
+      return false;
+  return true;
+}
+
+void check_range(std::string_view header, ui64 size, RangeStatus status,
+                 const std::vector<ByteRange>& want)
+{
+  check(same_ranges(libwavy::server::parse_range_header(header, size), status, want),
+        "Range '" + std::string(header) + "' against " + std::to_string(size) + " bytes");
+}
+
+void check_range_parsing()
+{
+  using enum RangeStatus;
+
+  // Suffix ranges: the last N bytes, all of them if N is larger than the file
+  check_range("bytes=-100", FILE_SIZE, Satisfiable, {{900, 999}});
+  check_range("bytes=-5000", FILE_SIZE, Satisfiable, {{0, 999}});
+  check_range("bytes=-0", FILE_SIZE, Unsatisfiable, {});
+
+  // Open-ended and over-long ranges run to the end of the file
+  check_range("bytes=900-", FILE_SIZE, Satisfiable, {{900, 999}});
+  check_range("bytes=0-", FILE_SIZE, Satisfiable, {{0, 999}});
+  check_range("bytes=990-5000", FILE_SIZE, Satisfiable, {{990, 999}});
+  check_range("  BYTES=10-19  ", FILE_SIZE, Satisfiable, {{10, 19}});
+
+  // Overlapping and adjacent ranges are sorted and coalesced, disjoint ones kept apart
+  check_range("bytes=500-599,0-99,50-149,150-199", FILE_SIZE, Satisfiable,
+              {{0, 199}, {500, 599}});
+  check_range("bytes=0-9,,20-29", FILE_SIZE, Satisfiable, {{0, 9}, {20, 29}});
+  check_range("bytes=-10,0-9", FILE_SIZE, Satisfiable, {{0, 9}, {990, 999}});
+
+  // Nothing satisfiable: 416
+  check_range("bytes=1000-", FILE_SIZE, Unsatisfiable, {});
+  check_range("bytes=2000-3000,1500-", FILE_SIZE, Unsatisfiable, {});
+  check_range("bytes=0-", 0, Unsatisfiable, {});
+  check_range("bytes=-5", 0, Unsatisfiable, {});
+
+  // A satisfiable spec next to an unsatisfiable one still gets 206
+  check_range("bytes=2000-,0-0", FILE_SIZE, Satisfiable, {{0, 0}});
+
+  // Malformed, other units, or too many ranges: ignored, the whole file is served
+  check_range("bytes=5-1", FILE_SIZE, None, {});
+  check_range("bytes=abc", FILE_SIZE, None, {});
+  check_range("bytes=1-x", FILE_SIZE, None, {});
+  check_range("items=0-1", FILE_SIZE, None, {});
+  check_range("bytes=", FILE_SIZE, None, {});
+  check_range("bytes=,", FILE_SIZE, None, {});
+
+  std::string many = "bytes=";
+  for (std::size_t i = 0; i <= libwavy::server::WAVY_MAX_RANGES; ++i)
+    many += std::to_string(i * 10) + "-" + std::to_string(i * 10 + 1) + ",";
+  check_range(many, FILE_SIZE, None, {});
+}
+
+void check_range_bodies()
+{
+  using namespace libwavy::server;
+
+  std::string source(FILE_SIZE, '\0');
+  for (std::size_t i = 0; i < source.size(); ++i)
+    source[i] = static_cast<char>('a' + i % 26);
+  const auto reader = memory_range_reader(source);
+
+  // Single range: the bytes themselves with a Content-Range
+  auto single = build_range_body(parse_range_header("bytes=-100", FILE_SIZE), FILE_SIZE,
+                                 "video/mp2t", reader);
+  check(single && single->code == 206 && single->content_type == "video/mp2t" &&
+          single->content_range == "bytes 900-999/1000" && single->body == source.substr(900),
+        "single range body");
+
+  // Unsatisfiable: 416 with the size, no body
+  auto unsatisfiable = build_range_body(parse_range_header("bytes=5000-", FILE_SIZE),
+                                        FILE_SIZE, "video/mp2t", reader);
+  check(unsatisfiable && unsatisfiable->code == 416 &&
+          unsatisfiable->content_range == "bytes */1000" && unsatisfiable->body.empty(),
+        "416 body");
+
+  // Multipart: one part per coalesced range, in order, each with its own headers
+  auto multi = build_range_body(parse_range_header("bytes=950-,0-9,5-19", FILE_SIZE), FILE_SIZE,
+                                "video/mp2t", reader);
+  check(multi && multi->code == 206 && multi->content_range.empty(), "multipart status");
+  if (!multi)
+    return;
+
+  constexpr std::string_view prefix = "multipart/byteranges; boundary=";
+  check(multi->content_type.starts_with(prefix), "multipart content type");
+  const std::string boundary = multi->content_type.substr(prefix.size());
+
+  std::string expected;
+  for (const auto& [first, last] : std::vector<std::pair<ui64, ui64>>{{0, 19}, {950, 999}})
+  {
+    expected += "--" + boundary + CRLF;
+    expected += "Content-Type: video/mp2t" CRLF;
+    expected += "Content-Range: " + content_range({first, last}, FILE_SIZE) + CRLF2;
+    expected += source.substr(first, last - first + 1) + CRLF;
+  }
+  expected += "--" + boundary + "--" + CRLF;
+  check(!boundary.empty() && multi->body == expected, "multipart body");
+
+  // A read that fails mid-body fails the whole response
+  std::size_t reads   = 0;
+  auto        failing = [&](ui64 offset, ui64 len, std::string& out)
+  {
+    if (++reads > 1)
+      return false;
+    out.append(std::string_view(source).substr(offset, len));
+    return true;
+  };
+  check(!build_range_body(parse_range_header("bytes=0-9,100-109", FILE_SIZE), FILE_SIZE,
+                          "video/mp2t", failing),
+        "failed read yields no body");
+}
+
+auto relations(const OwnerAudioIDMap& db) -> std::size_t
+{
+  std::size_t n = 0;
+  db.for_each([&](const StorageOwnerID&, const StorageAudioID&) { n++; });
+  return n;
+}
+
+// Fresh directory with a snapshot of `tracks` relations and an empty log
+void seed_catalog(const fs::path& dir, std::size_t tracks)
+{
+  fs::remove_all(dir);
+  OwnerAudioIDMap db;
+  CatalogLog      log(db, dir, 1'000'000);
+  log.load();
+  for (std::size_t i = 0; i < tracks; ++i)
+    log.record_insert("owner-" + std::to_string(i % 4), "seed-" + std::to_string(i));
+  check(log.compact() && fs::file_size(log.wal_path()) == 0, "seed snapshot");
+}
+
+void check_torn_tail(const fs::path& dir)
+{
+  seed_catalog(dir, 8);
+
+  fs::path wal;
+  {
+    OwnerAudioIDMap db;
+    CatalogLog      log(db, dir, 1'000'000);
+    log.load();
+    log.record_insert("owner-0", "a");
+    log.record_insert("owner-0", "b");
+    log.record_erase("owner-1", "seed-1");
+    log.flush();
+    wal = log.wal_path();
+  }
+
+  // Crash in the middle of the last record
+  const auto full = fs::file_size(wal);
+  fs::resize_file(wal, full - 3);
+
+  {
+    OwnerAudioIDMap db;
+    CatalogLog      log(db, dir, 1'000'000);
+    const auto      loaded = log.load();
+    check(loaded.snapshot_loaded && loaded.relations == 8, "torn tail: snapshot read");
+    check(loaded.wal_applied == 2 && loaded.wal_discarded > 0, "torn tail: good records kept");
+    check(db.has("owner-0", "b") && db.has("owner-1", "seed-1"), "torn tail: torn record lost");
+    check(fs::file_size(wal) == full - 3 - loaded.wal_discarded, "torn tail: cut off the log");
+
+    // The next append lands after the good records, not behind the torn bytes
+    log.record_insert("owner-2", "c");
+  }
+
+  OwnerAudioIDMap db;
+  CatalogLog      log(db, dir, 1'000'000);
+  const auto      loaded = log.load();
+  check(loaded.wal_applied == 3 && loaded.wal_discarded == 0 && db.has("owner-2", "c") &&
+          relations(db) == 11,
+        "torn tail: appends after recovery replay");
+}
+
+void check_failed_append(const fs::path& dir)
+{
+  seed_catalog(dir, 64);
+
+  // Files may grow to a few bytes: the next record is written in part, and the snapshot
+  // that would record it instead cannot be written at all
+  rlimit old{};
+  ::getrlimit(RLIMIT_FSIZE, &old);
+  std::signal(SIGXFSZ, SIG_IGN);
+
+  OwnerAudioIDMap db;
+  CatalogLog      log(db, dir, 1'000'000);
+  log.load();
+
+  rlimit tight = old;
+  tight.rlim_cur = 8;
+  ::setrlimit(RLIMIT_FSIZE, &tight);
+  log.record_insert("owner-0", "lost-until-retry");
+  log.flush();
+  ::setrlimit(RLIMIT_FSIZE, &old);
+
+  check(fs::file_size(log.wal_path()) == 0, "failed append: partial record cut back off");
+  check(db.has("owner-0", "lost-until-retry"), "failed append: index keeps the change");
+  {
+    OwnerAudioIDMap reread;
+    CatalogLog      other(reread, dir, 1'000'000);
+    const auto      loaded = other.load();
+    check(loaded.snapshot_loaded && loaded.wal_discarded == 0 && relations(reread) == 64,
+          "failed append: files still load cleanly");
+  }
+
+  // The next batch finds the log broken and rewrites the snapshot with everything
+  log.record_insert("owner-1", "after-retry");
+  log.flush();
+
+  OwnerAudioIDMap reread;
+  CatalogLog      other(reread, dir, 1'000'000);
+  const auto      loaded = other.load();
+  check(loaded.snapshot_loaded && relations(reread) == 66 &&
+          reread.has("owner-0", "lost-until-retry") && reread.has("owner-1", "after-retry"),
+        "failed append: retried snapshot holds both changes");
+}
+
+void check_interrupted_compaction(const fs::path& dir)
+{
+  seed_catalog(dir, 8);
+
+  const fs::path saved = dir / "wal.before-compaction";
+  {
+    OwnerAudioIDMap db;
+    CatalogLog      log(db, dir, 1'000'000);
+    log.load();
+    log.record_insert("owner-0", "x");
+    log.record_erase("owner-0", "x");
+    log.record_insert("owner-0", "x");
+    log.record_erase("owner-2", "seed-2");
+    log.record_insert("owner-3", "y");
+    log.flush();
+    fs::copy_file(log.wal_path(), saved);
+
+    // A stale temporary from a crash before the rename must not matter either
+    check(log.compact(), "compaction");
+    fs::copy_file(log.wal_path(), log.snapshot_path().string() + ".tmp");
+  }
+
+  // Crash after the snapshot rename, before the log was truncated: the new snapshot
+  // already holds every record the old log replays on top of it
+  OwnerAudioIDMap db;
+  CatalogLog      probe(db, dir, 1'000'000);
+  fs::copy_file(saved, probe.wal_path(), fs::copy_options::overwrite_existing);
+
+  const auto loaded = probe.load();
+  check(loaded.snapshot_loaded && loaded.relations == 9 && loaded.wal_applied == 5,
+        "interrupted compaction: snapshot and old log both read");
+  check(relations(db) == 9 && db.has("owner-0", "x") && db.has("owner-3", "y") &&
+          !db.has("owner-2", "seed-2"),
+        "interrupted compaction: replay is idempotent");
+}
+
+} // namespace
+
+auto main(int argc, char* argv[]) -> int
+{
+  const fs::path scratch = argc > 1 ? argv[1] : "/tmp/wavy-server-checks";
+
+  check_range_parsing();
+  check_range_bodies();
+  check_torn_tail(scratch / "torn-tail");
+  check_failed_append(scratch / "failed-append");
+  check_interrupted_compaction(scratch / "interrupted-compaction");
+
+  fs::remove_all(scratch);
+
+  std::cout << "checks=" << g_checks << " failures=" << g_failures << "\n";
+  return g_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,135 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <cstddef>
+#include <libwavy/common/types.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Segment bundle framing (GET /bundle/<owner>/<audio-id>/<playlist>).
+//
+//   "WAVYBND1"                     8 bytes magic
+//   u32 frame count
+//   per frame:
+//     u16 name length, name        file name inside the track directory
+//     u64 payload length, payload  the file, byte for byte
+//
+// All integers are big-endian. Frames appear in playlist order (the playlist itself
+// first when it was asked for), so a client can hand them to the decoder as they
+// are parsed.
+
+namespace libwavy::bundle
+{
+
+inline constexpr std::string_view MAGIC        = "WAVYBND1";
+inline constexpr std::string_view CONTENT_TYPE = "application/vnd.wavy.bundle";
+
+inline constexpr std::size_t HEADER_SIZE       = MAGIC.size() + sizeof(ui32);
+inline constexpr std::size_t FRAME_HEADER_SIZE = sizeof(ui16) + sizeof(ui64);
+
+struct Frame
+{
+  std::string_view name;
+  std::string_view payload;
+};
+
+namespace detail
+{
+
+template <typename T> void put_be(std::string& out, T value)
+{
+  for (int shift = static_cast<int>(sizeof(T) - 1) * 8; shift >= 0; shift -= 8)
+    out.push_back(static_cast<char>((value >> shift) & 0xFF));
+}
+
+template <typename T> auto get_be(std::string_view& in, T& value) -> bool
+{
+  if (in.size() < sizeof(T))
+    return false;
+  value = 0;
+  for (std::size_t i = 0; i < sizeof(T); ++i)
+    value = static_cast<T>((value << 8) | static_cast<ui8>(in[i]));
+  in.remove_prefix(sizeof(T));
+  return true;
+}
+
+} // namespace detail
+
+// Bytes one frame takes on the wire
+inline auto frame_size(std::size_t name_len, std::size_t payload_len) -> std::size_t
+{
+  return FRAME_HEADER_SIZE + name_len + payload_len;
+}
+
+inline void append_header(std::string& out, ui32 frame_count)
+{
+  out.append(MAGIC);
+  detail::put_be(out, frame_count);
+}
+
+inline void append_frame(std::string& out, std::string_view name, std::string_view payload)
+{
+  detail::put_be(out, static_cast<ui16>(name.size()));
+  out.append(name);
+  detail::put_be(out, static_cast<ui64>(payload.size()));
+  out.append(payload);
+}
+
+// Frames of a complete bundle (views into `body`), nullopt if it is truncated or malformed
+inline auto parse(std::string_view body) -> std::optional<std::vector<Frame>>
+{
+  if (!body.starts_with(MAGIC))
+    return std::nullopt;
+  body.remove_prefix(MAGIC.size());
+
+  ui32 count = 0;
+  if (!detail::get_be(body, count))
+    return std::nullopt;
+
+  std::vector<Frame> frames;
+  frames.reserve(count);
+  for (ui32 i = 0; i < count; ++i)
+  {
+    ui16 name_len = 0;
+    ui64 len      = 0;
+    if (!detail::get_be(body, name_len) || body.size() < name_len)
+      return std::nullopt;
+    const auto name = body.substr(0, name_len);
+    body.remove_prefix(name_len);
+
+    if (!detail::get_be(body, len) || body.size() < len)
+      return std::nullopt;
+    frames.push_back({name, body.substr(0, len)});
+    body.remove_prefix(len);
+  }
+
+  if (!body.empty())
+    return std::nullopt;
+  return frames;
+}
+
+} // namespace libwavy::bundle
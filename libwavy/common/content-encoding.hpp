@@ -0,0 +1,343 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cstddef>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/zstd/stream.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <zlib.h>
+#include <zstd.h>
+
+// HTTP content codings shared by the server and HttpsClient.
+//
+// The server never compresses per request. Text files of a track (playlists,
+// metadata.toml) get `<name>.zst` and `<name>.gz` siblings at ingest, and a request
+// picks one of them with negotiate(). Segments are already compressed audio and are
+// always sent as they are.
+
+namespace libwavy::encoding
+{
+
+enum class Coding : ui8
+{
+  Identity,
+  Zstd,
+  Gzip
+};
+
+/// What HttpsClient puts in Accept-Encoding
+inline constexpr std::string_view ACCEPT_ENCODING = "zstd, gzip";
+
+inline constexpr auto token(Coding coding) -> std::string_view
+{
+  switch (coding)
+  {
+    case Coding::Zstd:
+      return "zstd";
+    case Coding::Gzip:
+      return "gzip";
+    default:
+      return "identity";
+  }
+}
+
+/// Suffix of the stored variant, appended to the file name
+inline constexpr auto file_suffix(Coding coding) -> std::string_view
+{
+  switch (coding)
+  {
+    case Coding::Zstd:
+      return ".zst";
+    case Coding::Gzip:
+      return ".gz";
+    default:
+      return "";
+  }
+}
+
+inline auto variant_name(std::string_view filename, Coding coding) -> std::string
+{
+  std::string name(filename);
+  name += file_suffix(coding);
+  return name;
+}
+
+/// Files worth storing precompressed variants of
+inline auto is_precompressible(std::string_view filename) -> bool
+{
+  return filename.ends_with(macros::PLAYLIST_EXT) || filename.ends_with(macros::TOML_FILE_EXT) ||
+         filename.ends_with(macros::SEEK_INDEX_EXT);
+}
+
+namespace detail
+{
+
+inline auto iequals(std::string_view a, std::string_view b) -> bool
+{
+  if (a.size() != b.size())
+    return false;
+  for (std::size_t i = 0; i < a.size(); ++i)
+    if (std::tolower(static_cast<unsigned char>(a[i])) !=
+        std::tolower(static_cast<unsigned char>(b[i])))
+      return false;
+  return true;
+}
+
+inline auto trim(std::string_view s) -> std::string_view
+{
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    s.remove_suffix(1);
+  return s;
+}
+
+// q-value of one Accept-Encoding element ("gzip;q=0.5"), 1 when absent
+inline auto qvalue(std::string_view params) -> double
+{
+  const auto pos = params.find("q=");
+  if (pos == std::string_view::npos)
+    return 1.0;
+
+  const auto value = trim(params.substr(pos + 2));
+  double     q     = 1.0;
+  std::from_chars(value.data(), value.data() + value.size(), q);
+  return q;
+}
+
+inline auto zstd_compress(std::string_view in, int level) -> std::optional<std::string>
+{
+  std::string out(ZSTD_compressBound(in.size()), '\0');
+
+  const std::size_t n = ZSTD_compress(out.data(), out.size(), in.data(), in.size(), level);
+  if (ZSTD_isError(n))
+    return std::nullopt;
+  out.resize(n);
+  return out;
+}
+
+inline auto gzip_compress(std::string_view in, int level) -> std::optional<std::string>
+{
+  if (in.size() > UINT_MAX)
+    return std::nullopt;
+
+  z_stream zs{};
+  // windowBits 15 + 16: gzip wrapper instead of zlib
+  if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return std::nullopt;
+
+  std::string out(deflateBound(&zs, static_cast<uLong>(in.size())), '\0');
+  zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  zs.avail_in  = static_cast<uInt>(in.size());
+  zs.next_out  = reinterpret_cast<Bytef*>(out.data());
+  zs.avail_out = static_cast<uInt>(out.size());
+
+  const bool ok = deflate(&zs, Z_FINISH) == Z_STREAM_END;
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+
+  if (!ok)
+    return std::nullopt;
+  return out;
+}
+
+inline auto zstd_decode(std::string_view in) -> std::optional<std::string>
+{
+  zstd::StreamDecoder decoder;
+  if (!decoder.reset())
+    return std::nullopt;
+
+  std::string out;
+  auto        sink = [&out](const char* data, std::size_t len)
+  {
+    out.append(data, len);
+    return true;
+  };
+
+  const bool ok = decoder.feed(in.data(), in.size(), sink);
+  if (!ok || !decoder.finished())
+    return std::nullopt;
+  return out;
+}
+
+inline auto gzip_decode(std::string_view in) -> std::optional<std::string>
+{
+  if (in.size() > UINT_MAX)
+    return std::nullopt;
+
+  z_stream zs{};
+  // windowBits 15 + 32: accept both gzip and zlib headers
+  if (inflateInit2(&zs, 15 + 32) != Z_OK)
+    return std::nullopt;
+
+  zs.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  zs.avail_in = static_cast<uInt>(in.size());
+
+  std::string out;
+  char        buf[64 * 1024];
+  int         rc = Z_OK;
+  while (rc == Z_OK)
+  {
+    zs.next_out  = reinterpret_cast<Bytef*>(buf);
+    zs.avail_out = sizeof(buf);
+    rc           = inflate(&zs, Z_NO_FLUSH);
+    out.append(buf, sizeof(buf) - zs.avail_out);
+    if (rc == Z_BUF_ERROR && zs.avail_in == 0)
+      break; // truncated input
+  }
+  inflateEnd(&zs);
+
+  if (rc != Z_STREAM_END)
+    return std::nullopt;
+  return out;
+}
+
+} // namespace detail
+
+/// Coding named by a Content-Encoding / Accept-Encoding token
+inline auto from_token(std::string_view name) -> std::optional<Coding>
+{
+  name = detail::trim(name);
+  if (name.empty() || detail::iequals(name, "identity"))
+    return Coding::Identity;
+  if (detail::iequals(name, "zstd"))
+    return Coding::Zstd;
+  if (detail::iequals(name, "gzip") || detail::iequals(name, "x-gzip"))
+    return Coding::Gzip;
+  return std::nullopt;
+}
+
+/// Picks the variant to send for an Accept-Encoding header (RFC 9110 §12.5.3): the
+/// highest q-value among the variants that exist, zstd before gzip on a tie. Identity
+/// when the header is absent or neither variant is acceptable.
+inline auto negotiate(std::string_view accept, bool has_zstd, bool has_gzip) -> Coding
+{
+  double q_zstd = -1.0, q_gzip = -1.0, q_any = -1.0; // -1: not mentioned
+
+  while (!accept.empty())
+  {
+    const auto comma   = accept.find(',');
+    const auto element = accept.substr(0, comma);
+    accept.remove_prefix(comma == std::string_view::npos ? accept.size() : comma + 1);
+
+    const auto semi = element.find(';');
+    const auto name = detail::trim(element.substr(0, semi));
+    const auto q = semi == std::string_view::npos ? 1.0 : detail::qvalue(element.substr(semi + 1));
+
+    if (name == "*")
+      q_any = q;
+    else if (const auto coding = from_token(name); coding == Coding::Zstd)
+      q_zstd = q;
+    else if (coding == Coding::Gzip)
+      q_gzip = q;
+  }
+
+  auto weight = [q_any](double q) { return q >= 0.0 ? q : std::max(q_any, 0.0); };
+
+  const double w_zstd = has_zstd ? weight(q_zstd) : 0.0;
+  const double w_gzip = has_gzip ? weight(q_gzip) : 0.0;
+  if (w_zstd <= 0.0 && w_gzip <= 0.0)
+    return Coding::Identity;
+  return w_zstd >= w_gzip ? Coding::Zstd : Coding::Gzip;
+}
+
+/// `level` is on zstd's scale; gzip is capped at its own maximum of 9
+inline auto compress(Coding coding, std::string_view in,
+                     int level = WAVY_SERVER_PRECOMPRESS_ZSTD_LEVEL) -> std::optional<std::string>
+{
+  switch (coding)
+  {
+    case Coding::Zstd:
+      return detail::zstd_compress(in, level);
+    case Coding::Gzip:
+      return detail::gzip_compress(in, std::clamp(level, 1, Z_BEST_COMPRESSION));
+    default:
+      return std::string(in);
+  }
+}
+
+inline auto decode(Coding coding, std::string_view in) -> std::optional<std::string>
+{
+  switch (coding)
+  {
+    case Coding::Zstd:
+      return detail::zstd_decode(in);
+    case Coding::Gzip:
+      return detail::gzip_decode(in);
+    default:
+      return std::string(in);
+  }
+}
+
+/// A generated response body compressed once and shared by every request that gets it
+/// (the /audio/info listing is rebuilt per library change, not per request).
+struct EncodedBody
+{
+  static constexpr int LEVEL = 3; // cheap enough to run inline on the request that renders
+
+  std::string identity;
+  std::string zstd; // empty when not smaller than identity
+  std::string gzip;
+
+  static auto make(std::string body) -> EncodedBody
+  {
+    EncodedBody encoded{.identity = std::move(body)};
+    if (encoded.identity.size() < WAVY_SERVER_PRECOMPRESS_MIN_SIZE)
+      return encoded;
+
+    auto smaller = [&](Coding coding) -> std::string
+    {
+      auto out = compress(coding, encoded.identity, LEVEL);
+      return out && out->size() < encoded.identity.size() ? std::move(*out) : std::string{};
+    };
+    encoded.zstd = smaller(Coding::Zstd);
+    encoded.gzip = smaller(Coding::Gzip);
+    return encoded;
+  }
+
+  [[nodiscard]] auto pick(std::string_view accept_encoding) const
+    -> std::pair<Coding, const std::string*>
+  {
+    switch (negotiate(accept_encoding, !zstd.empty(), !gzip.empty()))
+    {
+      case Coding::Zstd:
+        return {Coding::Zstd, &zstd};
+      case Coding::Gzip:
+        return {Coding::Gzip, &gzip};
+      default:
+        return {Coding::Identity, &identity};
+    }
+  }
+};
+
+} // namespace libwavy::encoding
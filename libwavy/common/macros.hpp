@@ -28,9 +28,60 @@
 
 enum Macros
 {
-  TRANSPORT_STREAM_START_BYTE   = 0x47, // 0x47 (MPEG-TS sync byte)
-  WAVY_SERVER_PORT_NO           = 8080,
-  WAVY_SERVER_UPLOAD_SIZE_LIMIT = 200 // in MiBs
+  TRANSPORT_STREAM_START_BYTE        = 0x47,     // 0x47 (MPEG-TS sync byte)
+  WAVY_SERVER_PORT_NO                = 8080,
+  WAVY_SERVER_UPLOAD_SIZE_LIMIT      = 200,      // in MiBs
+  WAVY_SERVER_SEGMENT_CACHE_SIZE     = 256,      // in MiBs
+  WAVY_SERVER_CACHE_PREWARM_SEGMENTS = 3,        // segments per playlist warmed after upload
+  WAVY_SERVER_NEGATIVE_CACHE_ENTRIES = 4096,     // not-found answers remembered, all shards
+  WAVY_SERVER_NEGATIVE_CACHE_TTL     = 5,        // secs a remembered not-found is trusted
+  WAVY_SERVER_VALIDATOR_TRACKS       = 4096,     // parsed track manifests kept in memory
+  WAVY_SERVER_PLAYLIST_MAX_AGE       = 10,       // Cache-Control max-age for playlists (secs)
+  WAVY_SERVER_SEGMENT_MAX_AGE        = 31536000, // Cache-Control max-age for segments (1 year)
+  WAVY_SERVER_UPLOAD_QUEUE_DEPTH     = 8,        // uploads waiting for an ingest worker
+  WAVY_SERVER_UPLOAD_QUEUE_MEMORY    = 512,      // in MiBs, bodies of queued and running uploads
+  WAVY_SERVER_UPLOAD_WORKERS         = 2,        // dedicated ingest threads
+  WAVY_SERVER_UPLOAD_JOB_HISTORY     = 256,      // finished upload jobs kept for status polls
+  WAVY_SERVER_EXTRACT_WORKERS        = 4,        // max threads decoding entries of one upload
+  WAVY_SERVER_EXTRACT_ENTRY_LIMIT    = 200,      // in MiBs, decoded bytes of one archive entry
+  WAVY_SERVER_EXTRACT_UPLOAD_LIMIT   = 800,      // in MiBs, decoded bytes of all entries
+  WAVY_SERVER_CATALOG_COMPACT_AFTER  = 4096,     // catalog log records before a new snapshot
+  WAVY_SERVER_CATALOG_PAGE_DEFAULT   = 50,       // /catalog page size without ?limit=
+  WAVY_SERVER_CATALOG_PAGE_MAX       = 500,      // largest /catalog page served
+  WAVY_SERVER_METRICS_OWNER_SERIES   = 1024,     // (owner, route) series before _overflow
+  WAVY_SERVER_METRICS_TRACK_SERIES   = 4096,     // (owner, track) series before _overflow
+  WAVY_SERVER_BUNDLE_MAX_SEGMENTS    = 16,       // segments per /bundle response
+  WAVY_SERVER_PACKED_STORAGE         = 0,        // 1: pack uploads unless ?layout=files
+  WAVY_SERVER_DEDUPE_STORAGE         = 0,        // 1: identical stored files share one inode
+  WAVY_SERVER_DEDUPE_MIN_SIZE        = 4096,     // files smaller than this are never shared
+  WAVY_SERVER_FILE_HANDLE_CACHE      = 256,      // open segment/pack descriptors kept around
+  WAVY_SERVER_IO_THREADS             = 4,        // file I/O threads when io_uring is unavailable
+  WAVY_SERVER_IO_QUEUE_DEPTH         = 128,      // io_uring requests in flight
+  WAVY_SERVER_IO_BUFFERS             = 32,       // 128 KiB I/O buffers registered with the ring
+  WAVY_SERVER_READAHEAD_SEGMENTS     = 2,        // next segments loaded after serving one, 0: off
+  WAVY_SERVER_PRECOMPRESS_MIN_SIZE   = 512,      // text files smaller than this stay identity
+  WAVY_SERVER_PRECOMPRESS_ZSTD_LEVEL = 19,       // zstd level of the .zst variants made at ingest
+  WAVY_SERVER_EGRESS_LIMIT           = 0,        // total egress of file routes (MiB/s), 0: off
+  WAVY_SERVER_CLIENT_RATE_LIMIT      = 0,        // egress per client address (MiB/s), 0: off
+  WAVY_SERVER_OWNER_RATE_LIMIT       = 0,        // egress per owner's tracks (MiB/s), 0: off
+  WAVY_SERVER_SHAPING_BURST_MS       = 2000,     // idle time a bucket can save up, at its rate
+  WAVY_SERVER_SHAPING_MAX_WAIT_MS    = 500,      // longest a response is held back before 429/503
+  WAVY_SERVER_HOUSEKEEPING_INTERVAL  = 5,        // secs between disk / inode checks for /health
+  WAVY_SERVER_TEMP_GC_INTERVAL       = 300,      // secs between sweeps of the temp directory
+  WAVY_SERVER_TEMP_MAX_AGE           = 3600,     // secs untouched before temp data is removed
+  WAVY_SERVER_CATALOG_COMPACT_IDLE   = 60,       // secs without catalog writes before compaction
+  WAVY_SERVER_DELETE_RATE_LIMIT      = 64,       // MiB/s deleted tracks are reclaimed at, 0: off
+  WAVY_SERVER_DEDUPE_SWEEP_INTERVAL  = 600,      // secs between sweeps of unreferenced objects
+  WAVY_SERVER_LIVE_WINDOW            = 6,        // segments listed in a live media playlist
+  WAVY_SERVER_LIVE_MAX_STREAMS       = 64,       // live streams open at once
+  WAVY_SERVER_LIVE_SEGMENT_LIMIT     = 8,        // in MiBs, per pushed live segment
+  WAVY_SERVER_LIVE_MAX_DURATION      = 60,       // secs, longest live segment / target duration
+  WAVY_SERVER_LIVE_MEMORY_LIMIT      = 512,      // in MiBs, live segments held by all streams
+  WAVY_SERVER_LIVE_IDLE_TIMEOUT      = 30,       // secs without a new segment before a stream ends
+  WAVY_SERVER_LIVE_LINGER            = 60,       // secs an ended stream stays readable
+  WAVY_DISPATCH_IO_TIMEOUT           = 30,       // secs an upload response or status poll may take
+  WAVY_DISPATCH_INGEST_TIMEOUT       = 600,      // secs an owner waits for the server to ingest
+  WAVY_LIVE_SEGMENT_DURATION         = 2         // secs of audio per segment cut by a live owner
 };
 
 #define WAVY_SERVER_PORT_NO_STR "8080"
@@ -83,6 +134,8 @@ enum Macros
   X(OWNER_FILE_EXT, ".owner")                                 \
   X(TOML_FILE_EXT, ".toml")                                   \
   X(COMPRESSED_ARCHIVE_EXT, ".tar.gz")                        \
+  X(PACK_FILE_EXT, ".pack")                                   \
+  X(SEEK_INDEX_EXT, ".seek")                                  \
                                                               \
   /* Playlist Content */                                      \
   X(PLAYLIST_GLOBAL_HEADER, "#EXTM3U")                        \
@@ -108,6 +161,9 @@ enum Macros
   X(DISPATCH_ARCHIVE_REL_PATH, "wavy-owner-payload")          \
   X(DISPATCH_ARCHIVE_NAME, "hls_data.tar.gz")                 \
   X(METADATA_FILE, "metadata.toml")                           \
+  X(MANIFEST_FILE, "manifest.sha256")                         \
+  X(CATALOG_SNAPSHOT_FILE, "catalog.snap")                    \
+  X(CATALOG_WAL_FILE, "catalog.wal")                          \
                                                               \
   /* Content Types */                                         \
   X(CONTENT_TYPE_COMPRESSION, "application/gzip")             \
@@ -118,6 +174,7 @@ enum Macros
   /* Locking & Protocol Helpers */                            \
   X(SERVER_LOCK_FILE, "/tmp/wavy_server.lock")                \
   X(NETWORK_TEXT_DELIM, "\r\n\r\n")                           \
+  X(LIVE_TOKEN_HEADER, "X-Wavy-Live-Token")                   \
                                                               \
   /* Certificate & Key Files */                               \
   X(SERVER_CERT, "server.crt")                                \
@@ -126,6 +183,9 @@ enum Macros
   /* Directories */                                           \
   X(SERVER_TEMP_STORAGE_DIR, "/tmp/wavy_temp")                \
   X(SERVER_STORAGE_DIR_KEYS, "/tmp/wavy_storage/.keys")       \
+  X(SERVER_STORAGE_DIR_CATALOG, "/tmp/wavy_storage/.catalog") \
+  X(SERVER_STORAGE_DIR_TRASH, "/tmp/wavy_storage/.trash")     \
+  X(SERVER_STORAGE_DIR_OBJECTS, "/tmp/wavy_storage/.objects") \
   X(SERVER_STORAGE_DIR, "/tmp/wavy_storage") // tmp of server filesystem
 
 #define PROTOCOL_CONSTANTS(X)                                                               \
@@ -5,12 +5,20 @@
 namespace libwavy::routes
 {
 
-inline constexpr char SERVER_PATH_OWNERS[]      = "/owners";
-inline constexpr char SERVER_PATH_TOML_UPLOAD[] = "/upload";
-inline constexpr char SERVER_PATH_AUDIO_INFO[]  = "/audio/info/";
-inline constexpr char SERVER_PATH_PING[]        = "/ping";
-inline constexpr char SERVER_PATH_DOWNLOAD[]    = "/download/<string>/<string>/<string>";
-inline constexpr char SERVER_PATH_STREAM[]      = "/stream/<string>/<string>/<string>";
-inline constexpr char SERVER_PATH_DELETE[]      = "/delete/<string>/<string>";
+inline constexpr char SERVER_PATH_OWNERS[]         = "/owners";
+inline constexpr char SERVER_PATH_TOML_UPLOAD[]    = "/upload";
+inline constexpr char SERVER_PATH_UPLOAD_STATUS[]  = "/upload/status/<string>";
+inline constexpr char SERVER_PATH_AUDIO_INFO[]     = "/audio/info/";
+inline constexpr char SERVER_PATH_PING[]           = "/ping";
+inline constexpr char SERVER_PATH_DOWNLOAD[]       = "/download/<string>/<string>/<string>";
+inline constexpr char SERVER_PATH_STREAM[]         = "/stream/<string>/<string>/<string>";
+inline constexpr char SERVER_PATH_BUNDLE[]         = "/bundle/<string>/<string>/<string>";
+inline constexpr char SERVER_PATH_DELETE[]         = "/delete/<string>/<string>";
+inline constexpr char SERVER_PATH_CATALOG_TRACKS[] = "/catalog/tracks";
+inline constexpr char SERVER_PATH_CATALOG_OWNERS[] = "/catalog/owners";
+inline constexpr char SERVER_PATH_LIVE[]           = "/live";
+inline constexpr char SERVER_PATH_LIVE_INGEST[]    = "/live/ingest/<string>/<string>";
+inline constexpr char SERVER_PATH_LIVE_END[]       = "/live/end/<string>/<string>";
+inline constexpr char SERVER_PATH_LIVE_FILE[]      = "/live/<string>/<string>/<string>";
 
 } // namespace libwavy::routes
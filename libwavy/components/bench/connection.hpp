@@ -0,0 +1,225 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <functional>
+#include <libwavy/common/types.hpp>
+#include <libwavy/components/bench/report.hpp>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+
+/*
+ * @BENCH CONNECTION
+ *
+ * One keep-alive HTTPS connection driven entirely by async operations, so a few io
+ * threads can hold thousands of simulated listeners. Each connection runs on its own
+ * strand and carries one request at a time, the way a player does.
+ *
+ * -> The connection is opened on the first request and reused until the server
+ *    closes it or answers without keep-alive.
+ * -> If a reused connection turns out to be dead (the server dropped it while idle),
+ *    the request is retried once on a fresh one.
+ * -> Certificates are not verified: the bench targets test servers with self-signed
+ *    certs.
+ *
+ */
+
+namespace libwavy::components::bench
+{
+
+namespace asio  = boost::asio;
+namespace beast = boost::beast;
+namespace http  = beast::http;
+namespace ssl   = asio::ssl;
+using tcp       = asio::ip::tcp;
+
+using BenchRequest  = http::request<http::string_body>;
+using BenchResponse = http::response<http::string_body>;
+
+class BenchConnection : public std::enable_shared_from_this<BenchConnection>
+{
+public:
+  using Handler = std::function<void(beast::error_code, BenchResponse&&)>;
+
+  static constexpr auto IO_TIMEOUT = std::chrono::seconds(30);
+
+  BenchConnection(asio::io_context& ioc, ssl::context& ssl_ctx,
+                  const tcp::resolver::results_type& endpoints, std::string host,
+                  BenchReport& report)
+      : m_strand(asio::make_strand(ioc)), m_sslCtx(ssl_ctx), m_endpoints(endpoints),
+        m_host(std::move(host)), m_report(report)
+  {
+  }
+
+  [[nodiscard]] auto executor() const -> const asio::strand<asio::io_context::executor_type>&
+  {
+    return m_strand;
+  }
+
+  [[nodiscard]] auto host() const -> const std::string& { return m_host; }
+
+  /// Sends `req` and calls `done` on this connection's strand. One request at a time.
+  void request(BenchRequest req, Handler done)
+  {
+    m_req = std::move(req);
+    m_req.set(http::field::host, m_host);
+    m_req.set(http::field::user_agent, "wavy_bench");
+    m_req.keep_alive(true);
+    m_req.prepare_payload();
+    m_done    = std::move(done);
+    m_retried = false;
+
+    asio::dispatch(m_strand,
+                   [self = shared_from_this()]
+                   {
+                     if (self->m_stream)
+                       self->write();
+                     else
+                       self->connect();
+                   });
+  }
+
+  /// Drops the socket; the next request reconnects.
+  void close()
+  {
+    if (!m_stream)
+      return;
+    beast::error_code ec;
+    beast::get_lowest_layer(*m_stream).socket().close(ec);
+    m_stream.reset();
+  }
+
+private:
+  using Stream = beast::ssl_stream<beast::tcp_stream>;
+
+  asio::strand<asio::io_context::executor_type>           m_strand;
+  ssl::context&                                           m_sslCtx;
+  const tcp::resolver::results_type&                      m_endpoints;
+  std::string                                             m_host;
+  BenchReport&                                            m_report;
+  std::optional<Stream>                                   m_stream;
+  beast::flat_buffer                                      m_buffer;
+  BenchRequest                                            m_req;
+  std::optional<http::response_parser<http::string_body>> m_parser;
+  Handler                                                 m_done;
+  bool                                                    m_retried = false;
+
+  void connect()
+  {
+    m_stream.emplace(m_strand, m_sslCtx);
+    m_buffer.clear();
+    m_report.record_connect();
+
+    if (!SSL_set_tlsext_host_name(m_stream->native_handle(), m_host.c_str()))
+    {
+      finish(beast::error_code(static_cast<int>(::ERR_get_error()),
+                               asio::error::get_ssl_category()));
+      return;
+    }
+
+    beast::get_lowest_layer(*m_stream).expires_after(IO_TIMEOUT);
+    beast::get_lowest_layer(*m_stream).async_connect(
+      m_endpoints,
+      [self = shared_from_this()](beast::error_code ec, const tcp::endpoint&)
+      {
+        if (ec)
+          return self->finish(ec);
+
+        beast::get_lowest_layer(*self->m_stream).socket().set_option(tcp::no_delay(true));
+        beast::get_lowest_layer(*self->m_stream).expires_after(IO_TIMEOUT);
+        self->m_stream->async_handshake(ssl::stream_base::client,
+                                        [self](beast::error_code hs_ec)
+                                        {
+                                          if (hs_ec)
+                                            return self->finish(hs_ec);
+                                          self->write();
+                                        });
+      });
+  }
+
+  void write()
+  {
+    beast::get_lowest_layer(*m_stream).expires_after(IO_TIMEOUT);
+    http::async_write(*m_stream, m_req,
+                      [self = shared_from_this()](beast::error_code ec, std::size_t)
+                      {
+                        if (ec)
+                          return self->retryOrFinish(ec);
+                        self->read();
+                      });
+  }
+
+  void read()
+  {
+    m_parser.emplace();
+    // Segments, bundles and packs can be large. Not boost::none: older Beast compares the
+    // content length against the optional itself and rejects every sized body.
+    m_parser->body_limit(std::numeric_limits<std::uint64_t>::max());
+
+    beast::get_lowest_layer(*m_stream).expires_after(IO_TIMEOUT);
+    http::async_read(*m_stream, m_buffer, *m_parser,
+                     [self = shared_from_this()](beast::error_code ec, std::size_t)
+                     {
+                       if (ec)
+                         return self->retryOrFinish(ec);
+
+                       auto res = self->m_parser->release();
+                       if (!res.keep_alive())
+                         self->close();
+                       self->finish({}, std::move(res));
+                     });
+  }
+
+  // A keep-alive connection the server already dropped fails on first use: open a new
+  // one and send the request again, once
+  void retryOrFinish(beast::error_code ec)
+  {
+    close();
+    if (m_retried || ec == beast::error::timeout)
+      return finish(ec);
+
+    m_retried = true;
+    connect();
+  }
+
+  void finish(beast::error_code ec, BenchResponse&& res = {})
+  {
+    if (ec)
+      close();
+    auto done = std::move(m_done);
+    m_done    = nullptr;
+    if (done)
+      done(ec, std::move(res));
+  }
+};
+
+} // namespace libwavy::components::bench
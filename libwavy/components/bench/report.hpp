@@ -0,0 +1,187 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <array>
+#include <atomic>
+#include <libwavy/common/types.hpp>
+#include <libwavy/log-macros.hpp>
+#include <libwavy/server/latency-histogram.hpp>
+#include <libwavy/utils/math/entry.hpp>
+#include <ostream>
+#include <string_view>
+
+/*
+ * @BENCH REPORT
+ *
+ * What wavy_bench measures, per route: requests, outcome classes, bytes received and
+ * an HDR latency histogram (the same one the server exports on /metrics, so both sides
+ * report percentiles the same way). Everything is recorded with relaxed atomics from
+ * whatever io thread completed the request.
+ *
+ */
+
+namespace libwavy::components::bench
+{
+
+enum class BenchRoute : ui8
+{
+  Owners,       // discovery
+  Playlist,     // master and media playlists (/download)
+  Download,     // segments over /download
+  Stream,       // segments over /stream
+  Upload,       // POST /upload until 202
+  UploadStatus, // one /upload/status poll
+  Ingest,       // 202 until the job is done or failed (not a request)
+  Count_
+};
+
+inline constexpr std::size_t BENCH_ROUTE_COUNT = static_cast<std::size_t>(BenchRoute::Count_);
+
+inline auto to_string(BenchRoute route) -> std::string_view
+{
+  switch (route)
+  {
+    case BenchRoute::Owners:
+      return "owners";
+    case BenchRoute::Playlist:
+      return "playlist";
+    case BenchRoute::Download:
+      return "download";
+    case BenchRoute::Stream:
+      return "stream";
+    case BenchRoute::Upload:
+      return "upload";
+    case BenchRoute::UploadStatus:
+      return "upload-status";
+    case BenchRoute::Ingest:
+      return "ingest";
+    case BenchRoute::Count_:
+      break;
+  }
+  return "unknown";
+}
+
+struct RouteStats
+{
+  std::atomic<ui64>         requests{0};
+  std::atomic<ui64>         ok{0};         // 2xx, 304
+  std::atomic<ui64>         client_err{0}; // other 4xx
+  std::atomic<ui64>         throttled{0};  // 429, 503 (shaper, upload queue)
+  std::atomic<ui64>         server_err{0}; // other 5xx
+  std::atomic<ui64>         net_err{0};    // connect, TLS, timeout, reset
+  std::atomic<ui64>         bytes{0};      // response bodies
+  server::LatencyHistogram  latency;
+};
+
+class BenchReport
+{
+public:
+  /// `status` 0 marks a transport error (no response)
+  void record(BenchRoute route, unsigned status, ui64 body_bytes, ui64 latency_us)
+  {
+    auto& rs = at(route);
+    rs.requests++;
+    rs.bytes += body_bytes;
+
+    if (status == 0)
+      rs.net_err++;
+    else if ((status >= 200 && status < 300) || status == 304)
+      rs.ok++;
+    else if (status == 429 || status == 503)
+      rs.throttled++;
+    else if (status >= 500)
+      rs.server_err++;
+    else
+      rs.client_err++;
+
+    // Failed connects say nothing about the server's latency
+    if (status != 0)
+      rs.latency.record(latency_us);
+  }
+
+  void record_connect() { m_connects++; }
+
+  [[nodiscard]] auto at(BenchRoute route) -> RouteStats&
+  {
+    return m_routes[static_cast<std::size_t>(route)];
+  }
+
+  [[nodiscard]] auto at(BenchRoute route) const -> const RouteStats&
+  {
+    return m_routes[static_cast<std::size_t>(route)];
+  }
+
+  [[nodiscard]] auto total_requests() const -> ui64
+  {
+    ui64 total = 0;
+    for (std::size_t i = 0; i < BENCH_ROUTE_COUNT; ++i)
+      if (static_cast<BenchRoute>(i) != BenchRoute::Ingest)
+        total += m_routes[i].requests.load();
+    return total;
+  }
+
+  /// One table row per route that saw traffic, latencies in milliseconds
+  void print(std::ostream& out, double elapsed_secs) const
+  {
+    const double secs = elapsed_secs > 0 ? elapsed_secs : 1;
+    const double mib  = static_cast<double>(ONE_MIB);
+
+    out << lwfmt::format(
+      "{:<14}{:>9}{:>9}{:>7}{:>7}{:>7}{:>7}{:>10}{:>9}{:>9}{:>9}{:>9}{:>9}\n", "route", "requests",
+      "req/s", "4xx", "429/3", "5xx", "net", "MiB/s", "p50", "p90", "p99", "p999", "max");
+
+    ui64 bytes = 0;
+    for (std::size_t i = 0; i < BENCH_ROUTE_COUNT; ++i)
+    {
+      const auto& rs = m_routes[i];
+      if (rs.requests.load() == 0)
+        continue;
+
+      const auto snap = rs.latency.snapshot();
+      auto       ms   = [&](double q) { return static_cast<double>(snap.percentile(q)) / 1e3; };
+
+      bytes += rs.bytes.load();
+      out << lwfmt::format(
+        "{:<14}{:>9}{:>9.1f}{:>7}{:>7}{:>7}{:>7}{:>10.2f}"
+        "{:>9.2f}{:>9.2f}{:>9.2f}{:>9.2f}{:>9.2f}\n",
+        to_string(static_cast<BenchRoute>(i)), rs.requests.load(),
+        static_cast<double>(rs.requests.load()) / secs, rs.client_err.load(),
+        rs.throttled.load(), rs.server_err.load(), rs.net_err.load(),
+        static_cast<double>(rs.bytes.load()) / mib / secs, ms(0.50), ms(0.90), ms(0.99),
+        ms(0.999), ms(1.0));
+    }
+
+    out << lwfmt::format("\n{} requests in {:.1f}s ({:.1f} req/s), {:.2f} MiB/s received, {} "
+                         "connections opened\n",
+                         total_requests(), secs, static_cast<double>(total_requests()) / secs,
+                         static_cast<double>(bytes) / mib / secs, m_connects.load());
+  }
+
+private:
+  std::array<RouteStats, BENCH_ROUTE_COUNT> m_routes;
+  std::atomic<ui64>                         m_connects{0};
+};
+
+} // namespace libwavy::components::bench
@@ -0,0 +1,226 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <libwavy/common/network/routes.h>
+#include <libwavy/components/bench/connection.hpp>
+#include <libwavy/components/bench/report.hpp>
+#include <libwavy/components/bench/workload.hpp>
+#include <libwavy/log-macros.hpp>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+/*
+ * @BENCH RUNNER
+ *
+ * Discovers tracks through /owners, starts the listeners and uploaders (spread over
+ * the ramp-up), prints a progress line every few seconds and the per-route report at
+ * the end. All connections share one io_context, run by `threads` threads.
+ *
+ */
+
+namespace libwavy::components::bench
+{
+
+using Bench = libwavy::log::BENCH;
+
+class BenchRunner
+{
+public:
+  static constexpr auto PROGRESS_INTERVAL = std::chrono::seconds(5);
+  static constexpr auto DRAIN_TIME        = std::chrono::seconds(2);
+
+  explicit BenchRunner(BenchConfig config) : m_config(std::move(config)) {}
+
+  auto run(std::ostream& out) -> int
+  {
+    m_sslCtx.set_verify_mode(ssl::verify_none); // self-signed test certificates
+
+    try
+    {
+      tcp::resolver resolver(m_ioc);
+      m_endpoints = resolver.resolve(m_config.server, m_config.port);
+    }
+    catch (const std::exception& e)
+    {
+      log::ERROR<Bench>("Cannot resolve {}:{}: {}", m_config.server, m_config.port, e.what());
+      return WAVY_RET_FAIL;
+    }
+
+    auto work = asio::make_work_guard(m_ioc);
+    const ui32 threads =
+      m_config.threads > 0 ? m_config.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::jthread> pool;
+    for (ui32 i = 0; i < threads; ++i)
+      pool.emplace_back([this] { m_ioc.run(); });
+
+    auto shutdown = [&]
+    {
+      work.reset();
+      m_ioc.stop();
+      pool.clear();
+    };
+
+    auto connection = [&]
+    {
+      return std::make_shared<BenchConnection>(m_ioc, m_sslCtx, m_endpoints, m_config.server,
+                                               m_report);
+    };
+
+    if (!discover(connection()) && m_config.listeners > 0)
+    {
+      shutdown();
+      return WAVY_RET_FAIL;
+    }
+
+    std::shared_ptr<const std::string> archive;
+    if (m_config.uploaders > 0 && !(archive = readArchive()))
+    {
+      shutdown();
+      return WAVY_RET_FAIL;
+    }
+
+    out << lwfmt::format("{} listeners over {} tracks, {} uploaders, {} io threads, {}s\n",
+                         m_config.listeners, m_tracks.size(), m_config.uploaders, threads,
+                         m_config.duration.count());
+
+    std::mt19937_64 seeds(m_config.seed != 0 ? m_config.seed : std::random_device{}());
+    const auto      workers = m_config.listeners + m_config.uploaders;
+    for (ui32 i = 0; i < workers; ++i)
+    {
+      const auto delay = m_config.ramp * i / std::max(workers, 1u);
+      if (i < m_config.listeners)
+        std::make_shared<Listener>(connection(), m_config, m_tracks, m_report, m_stop, seeds())
+          ->start(delay);
+      else
+        std::make_shared<Uploader>(connection(), m_config, archive, m_report, m_stop)
+          ->start(delay);
+    }
+
+    const auto started  = std::chrono::steady_clock::now();
+    const auto deadline = started + m_config.duration;
+    ui64       last     = m_report.total_requests();
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_until(
+        std::min(deadline, std::chrono::steady_clock::now() + PROGRESS_INTERVAL));
+
+      using Seconds      = std::chrono::duration<double>;
+      const ui64 now     = m_report.total_requests();
+      const auto elapsed = Seconds(std::chrono::steady_clock::now() - started);
+      out << lwfmt::format("[{:6.1f}s] {} requests ({:.1f} req/s)\n", elapsed.count(), now,
+                           static_cast<double>(now - last) / Seconds(PROGRESS_INTERVAL).count());
+      last = now;
+    }
+
+    // Requests still in flight are let finish, none is started
+    m_stop             = true;
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started);
+    std::this_thread::sleep_for(DRAIN_TIME);
+    shutdown();
+
+    out << "\n";
+    m_report.print(out, elapsed.count());
+    return WAVY_RET_SUC;
+  }
+
+private:
+  BenchConfig                 m_config;
+  ssl::context                m_sslCtx{ssl::context::tls_client};
+  tcp::resolver::results_type m_endpoints;
+  BenchReport                 m_report;
+  std::atomic<bool>           m_stop{false};
+  std::vector<BenchTrack>     m_tracks;
+  asio::io_context            m_ioc; // last: handlers left in it own workers using the above
+
+  // /owners lists "<owner>:" followed by "  - <audio-id>" lines
+  auto discover(const std::shared_ptr<BenchConnection>& conn) -> bool
+  {
+    std::promise<std::pair<unsigned, std::string>> listing;
+    const auto started = std::chrono::steady_clock::now();
+    conn->request(BenchRequest{http::verb::get, routes::SERVER_PATH_OWNERS, 11},
+                  [&](beast::error_code ec, BenchResponse&& res)
+                  {
+                    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - started);
+                    const unsigned status = ec ? 0 : res.result_int();
+                    m_report.record(BenchRoute::Owners, status, res.body().size(),
+                                    static_cast<ui64>(us.count()));
+                    if (ec)
+                      log::ERROR<Bench>("/owners failed: {}", ec.message());
+                    listing.set_value({status, std::move(res.body())});
+                  });
+
+    const auto [status, body] = listing.get_future().get();
+    if (status != 200)
+    {
+      log::ERROR<Bench>("Track discovery failed (status {})", status);
+      return false;
+    }
+
+    std::istringstream in(body);
+    std::string        line, owner;
+    while (std::getline(in, line))
+    {
+      if (line.starts_with("  - "))
+      {
+        if (m_config.owner.empty() || owner == m_config.owner)
+          m_tracks.push_back({owner, line.substr(4)});
+      }
+      else if (!line.empty() && line.back() == ':')
+      {
+        owner = line.substr(0, line.size() - 1);
+      }
+    }
+
+    if (m_tracks.empty())
+    {
+      log::ERROR<Bench>("No tracks to play{}", m_config.owner.empty() ? "" : " for that owner");
+      return false;
+    }
+    return true;
+  }
+
+  auto readArchive() const -> std::shared_ptr<const std::string>
+  {
+    std::ifstream in(m_config.upload_file, std::ios::binary);
+    if (!in)
+    {
+      log::ERROR<Bench>("Cannot read upload archive: {}", m_config.upload_file);
+      return nullptr;
+    }
+    return std::make_shared<const std::string>(std::istreambuf_iterator<char>(in),
+                                               std::istreambuf_iterator<char>());
+  }
+};
+
+} // namespace libwavy::components::bench
@@ -0,0 +1,378 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <functional>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/network/routes.h>
+#include <libwavy/common/types.hpp>
+#include <libwavy/components/bench/connection.hpp>
+#include <libwavy/components/bench/report.hpp>
+#include <libwavy/log-macros.hpp>
+#include <libwavy/parser/entry.hpp>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * @BENCH WORKLOAD
+ *
+ * -> Listener: plays tracks the way the HLS client does. It fetches the master
+ *    playlist, picks a variant and loads its media playlist. Then it fetches segments
+ *    in order over /download or /stream, with `Range` for packed tracks. It may switch
+ *    variant between segments and waits a think time after each segment. At the end
+ *    of a track it picks another one.
+ * -> Uploader: posts an archive to /upload and polls /upload/status until the job is
+ *    done, then starts over. A full queue (503) is honoured through Retry-After.
+ *
+ * Both are chains of async calls on their connection's strand and stop at the next
+ * step once `stop` is set.
+ *
+ */
+
+namespace libwavy::components::bench
+{
+
+struct BenchTrack
+{
+  StorageOwnerID owner;
+  StorageAudioID audio_id;
+};
+
+struct BenchConfig
+{
+  IPAddr                    server       = "127.0.0.1";
+  std::string               port         = WAVY_SERVER_PORT_NO_STR;
+  ui32                      listeners    = 32;
+  ui32                      uploaders    = 0;
+  ui32                      threads      = 0; // 0: one per core
+  std::chrono::seconds      duration     = std::chrono::seconds(30);
+  std::chrono::milliseconds ramp         = std::chrono::milliseconds(1000);
+  std::chrono::milliseconds think        = std::chrono::milliseconds(0);
+  bool                      realtime     = false; // wait out each segment's EXTINF too
+  double                    stream_ratio = 0.0;   // share of segments fetched over /stream
+  double                    switch_prob  = 0.05;  // chance of a variant switch per segment
+  StorageOwnerID            owner;                // only play this owner's tracks
+  RelPath                   upload_file;
+  std::string               upload_query; // appended to /upload, e.g. "?layout=packed"
+  ui64                      seed = 0;     // 0: random
+};
+
+namespace detail
+{
+
+inline auto file_target(std::string_view route, const BenchTrack& track, const std::string& name)
+  -> std::string
+{
+  return lwfmt::format("/{}/{}/{}/{}", route, track.owner, track.audio_id, name);
+}
+
+// `key=value` line of an /upload or /upload/status body
+inline auto body_field(const std::string& body, const std::string& key) -> std::string
+{
+  std::istringstream in(body);
+  std::string        line;
+  while (std::getline(in, line))
+    if (line.starts_with(key + "="))
+      return line.substr(key.size() + 1);
+  return {};
+}
+
+} // namespace detail
+
+// Shared by Listener and Uploader: one request at a time on its own connection
+class BenchWorker
+{
+protected:
+  using Clock = std::chrono::steady_clock;
+  using Then  = std::function<void(unsigned status, BenchResponse& res)>;
+
+  BenchWorker(std::shared_ptr<BenchConnection> conn, BenchReport& report,
+              const std::atomic<bool>& stop)
+      : m_conn(std::move(conn)), m_report(report), m_stop(stop), m_timer(m_conn->executor())
+  {
+  }
+
+  std::shared_ptr<BenchConnection> m_conn;
+  BenchReport&                     m_report;
+  const std::atomic<bool>&         m_stop;
+  asio::steady_timer               m_timer;
+
+  // `status` is 0 when no response arrived
+  void send(BenchRoute route, BenchRequest req, const std::shared_ptr<void>& self, Then then)
+  {
+    if (m_stop)
+      return;
+
+    const auto started = Clock::now();
+    m_conn->request(std::move(req),
+                    [this, self, route, started, then = std::move(then)](beast::error_code ec,
+                                                                         BenchResponse&& res)
+                    {
+                      const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                        Clock::now() - started)
+                                        .count();
+                      const unsigned status = ec ? 0 : res.result_int();
+                      m_report.record(route, status, ec ? 0 : res.body().size(),
+                                      static_cast<ui64>(us));
+                      then(status, res);
+                    });
+  }
+
+  void after(Clock::duration delay, const std::shared_ptr<void>& self, std::function<void()> fn)
+  {
+    if (m_stop)
+      return;
+
+    m_timer.expires_after(delay);
+    m_timer.async_wait(
+      [this, self, fn = std::move(fn)](beast::error_code ec)
+      {
+        if (ec || m_stop)
+          return;
+        fn();
+      });
+  }
+};
+
+class Listener : public BenchWorker, public std::enable_shared_from_this<Listener>
+{
+public:
+  Listener(std::shared_ptr<BenchConnection> conn, const BenchConfig& config,
+           const std::vector<BenchTrack>& tracks, BenchReport& report,
+           const std::atomic<bool>& stop, ui64 seed)
+      : BenchWorker(std::move(conn), report, stop), m_config(config), m_tracks(tracks),
+        m_rng(seed)
+  {
+  }
+
+  void start(Clock::duration delay)
+  {
+    after(delay, shared_from_this(), [this] { nextTrack(); });
+  }
+
+private:
+  static constexpr auto RETRY_DELAY = std::chrono::seconds(1);
+
+  const BenchConfig&              m_config;
+  const std::vector<BenchTrack>&  m_tracks;
+  std::mt19937_64                 m_rng;
+  const BenchTrack*               m_track = nullptr;
+  std::vector<std::string>        m_variants;
+  std::size_t                     m_variant = 0;
+  hls::parser::ast::MediaPlaylist m_media;
+  std::size_t                     m_segment = 0;
+
+  auto chance(double p) -> bool { return p > 0 && std::bernoulli_distribution(p)(m_rng); }
+
+  auto pick(std::size_t n) -> std::size_t
+  {
+    return std::uniform_int_distribution<std::size_t>(0, n - 1)(m_rng);
+  }
+
+  void get(BenchRoute route, const std::string& target, const std::string& range, Then then)
+  {
+    BenchRequest req{http::verb::get, target, 11};
+    if (!range.empty())
+      req.set(http::field::range, range);
+    send(route, std::move(req), shared_from_this(), std::move(then));
+  }
+
+  void retryLater()
+  {
+    after(RETRY_DELAY, shared_from_this(), [this] { nextTrack(); });
+  }
+
+  void nextTrack()
+  {
+    m_track   = &m_tracks[pick(m_tracks.size())];
+    m_segment = 0;
+    get(BenchRoute::Playlist,
+        detail::file_target("download", *m_track, macros::to_string(macros::MASTER_PLAYLIST)),
+        {},
+        [this](unsigned status, BenchResponse& res)
+        {
+          if (status != 200)
+            return retryLater();
+
+          m_variants.clear();
+          for (auto& variant : hls::parser::M3U8Parser::parseMasterPlaylist(res.body()).variants)
+            m_variants.push_back(std::move(variant.uri));
+          if (m_variants.empty())
+            return retryLater();
+
+          m_variant = pick(m_variants.size());
+          loadVariant();
+        });
+  }
+
+  void loadVariant()
+  {
+    get(BenchRoute::Playlist, detail::file_target("download", *m_track, m_variants[m_variant]),
+        {},
+        [this](unsigned status, BenchResponse& res)
+        {
+          if (status != 200)
+            return retryLater();
+
+          m_media = hls::parser::M3U8Parser::parseMediaPlaylist(res.body(), 0);
+          if (m_media.segments.empty())
+            return retryLater();
+          m_segment = std::min(m_segment, m_media.segments.size() - 1);
+
+          // fMP4 variants need their init segment before any media segment
+          if (!m_media.map_uri)
+            return nextSegment();
+          get(BenchRoute::Download, detail::file_target("download", *m_track, *m_media.map_uri),
+              {}, [this](unsigned, BenchResponse&) { nextSegment(); });
+        });
+  }
+
+  void nextSegment()
+  {
+    if (m_segment >= m_media.segments.size())
+      return nextTrack();
+
+    if (m_segment > 0 && m_variants.size() > 1 && chance(m_config.switch_prob))
+    {
+      const std::size_t other = pick(m_variants.size() - 1);
+      m_variant               = other >= m_variant ? other + 1 : other;
+      return loadVariant();
+    }
+
+    const auto&      segment = m_media.segments[m_segment];
+    const BenchRoute route =
+      chance(m_config.stream_ratio) ? BenchRoute::Stream : BenchRoute::Download;
+
+    std::string range;
+    if (segment.byterange)
+      range = lwfmt::format("bytes={}-{}", segment.byterange->offset,
+                            segment.byterange->offset + segment.byterange->length - 1);
+
+    const auto started  = Clock::now();
+    const auto duration = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(segment.duration));
+
+    get(route,
+        detail::file_target(route == BenchRoute::Stream ? "stream" : "download", *m_track,
+                            segment.uri),
+        range,
+        [this, started, duration](unsigned status, BenchResponse&)
+        {
+          m_segment++;
+
+          Clock::duration wait = m_config.think;
+          if (status == 0)
+            wait = std::max<Clock::duration>(wait, std::chrono::milliseconds(200));
+          if (m_config.realtime)
+            wait += std::max<Clock::duration>(duration - (Clock::now() - started),
+                                              Clock::duration::zero());
+
+          if (wait == Clock::duration::zero())
+            return nextSegment();
+          after(wait, shared_from_this(), [this] { nextSegment(); });
+        });
+  }
+};
+
+class Uploader : public BenchWorker, public std::enable_shared_from_this<Uploader>
+{
+public:
+  Uploader(std::shared_ptr<BenchConnection> conn, const BenchConfig& config,
+           std::shared_ptr<const std::string> archive, BenchReport& report,
+           const std::atomic<bool>& stop)
+      : BenchWorker(std::move(conn), report, stop), m_config(config), m_archive(std::move(archive))
+  {
+  }
+
+  void start(Clock::duration delay)
+  {
+    after(delay, shared_from_this(), [this] { upload(); });
+  }
+
+private:
+  static constexpr auto POLL_INTERVAL = std::chrono::milliseconds(250);
+
+  const BenchConfig&                 m_config;
+  std::shared_ptr<const std::string> m_archive;
+  std::string                        m_statusTarget;
+  Clock::time_point                  m_accepted;
+
+  void upload()
+  {
+    BenchRequest req{http::verb::post,
+                     std::string(routes::SERVER_PATH_TOML_UPLOAD) + m_config.upload_query, 11};
+    req.set(http::field::content_type, macros::to_string(macros::CONTENT_TYPE_GZIP));
+    req.body() = *m_archive;
+
+    send(BenchRoute::Upload, std::move(req), shared_from_this(),
+         [this](unsigned status, BenchResponse& res)
+         {
+           if (status == 202)
+           {
+             m_accepted     = Clock::now();
+             m_statusTarget = std::string(res[http::field::location]);
+             if (m_statusTarget.empty())
+               m_statusTarget = "/upload/status/" + detail::body_field(res.body(), "job_id");
+             return poll();
+           }
+
+           // Queue full: come back when the server says so
+           ui64 retry_secs = 1;
+           if (status == 503 || status == 429)
+           {
+             const auto header = res[http::field::retry_after];
+             std::from_chars(header.data(), header.data() + header.size(), retry_secs);
+           }
+           after(std::chrono::seconds(std::max<ui64>(retry_secs, 1)), shared_from_this(),
+                 [this] { upload(); });
+         });
+  }
+
+  void poll()
+  {
+    send(BenchRoute::UploadStatus, BenchRequest{http::verb::get, m_statusTarget, 11},
+         shared_from_this(),
+         [this](unsigned status, BenchResponse& res)
+         {
+           const std::string state = status == 200 ? detail::body_field(res.body(), "status") : "";
+           if (state == "queued" || state == "running" || status == 0)
+             return after(POLL_INTERVAL, shared_from_this(), [this] { poll(); });
+
+           const auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                                                 m_accepted);
+           m_report.record(BenchRoute::Ingest, state == "done" ? 200 : 500, 0,
+                           static_cast<ui64>(us.count()));
+           upload();
+         });
+  }
+};
+
+} // namespace libwavy::components::bench
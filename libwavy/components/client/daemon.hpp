@@ -24,9 +24,11 @@
  ********************************************************************************/
 
 #include <libwavy/common/types.hpp>
+#include <libwavy/components/client/live.hpp>
 #include <libwavy/tsfetcher/interface.hpp>
 #include <libwavy/tsfetcher/plugin/entry.hpp>
 #include <libwavy/utils/audio/entry.hpp>
+#include <optional>
 #include <utility>
 
 namespace libwavy::components::client
@@ -40,6 +42,9 @@ private:
   int            m_bitrate;
   RelPath        m_audioBackendLibPath;
 
+  // Looks up the `index`-th track of the owner; logs and returns nullopt if there is none
+  auto resolveAudioId(fetch::ISegmentFetcher& fetcher, int index) -> std::optional<StorageAudioID>;
+
 public:
   WavyClient(StorageOwnerID nickname, IPAddr server, RelPath plugin_path, const int bitrate,
              const RelPath& audioBackendLibPath)
@@ -50,5 +55,11 @@ public:
   }
 
   auto start(bool flac_found, int index, const bool& use_chunked_stream) -> int;
+
+  // Plays the `index`-th track from `seconds` in, using the variant's seek index (see seek.hpp)
+  auto startAt(int index, double seconds) -> int;
+
+  // Plays the owner's live stream `stream_id` until it ends (see live.hpp)
+  auto startLive(const std::string& stream_id) -> int;
 };
 } // namespace libwavy::components::client
@@ -0,0 +1,158 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/network/routes.h>
+#include <libwavy/common/state.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/log-macros.hpp>
+#include <libwavy/network/entry.hpp>
+#include <libwavy/parser/entry.hpp>
+#include <optional>
+#include <string>
+#include <thread>
+
+/*
+ * Live playback
+ *
+ * Follows a live stream's sliding-window playlist (GET /live/<owner>/<stream-id>/index.m3u8)
+ * the way RFC 8216 6.3.4 asks a client to: reload after one target duration when the last
+ * load brought new segments, after half of one when it did not, and stop at EXT-X-ENDLIST.
+ * Playback starts LIVE_START_OFFSET segments behind the live edge so a late push does not
+ * starve the player straight away.
+ *
+ * A listener that falls out of the window (its next segment is no longer listed) skips
+ * ahead to the oldest segment still listed.
+ */
+
+namespace libwavy::components::client
+{
+
+class LiveFollower
+{
+public:
+  using SegmentSink = std::function<void(ui64 sequence, AudioData&& data)>;
+
+  static constexpr std::size_t LIVE_START_OFFSET = 3;
+
+  LiveFollower(IPAddr server, StorageOwnerID owner, std::string stream_id)
+      : m_server(std::move(server)), m_owner(std::move(owner)), m_streamId(std::move(stream_id))
+  {
+  }
+
+  // Hands every new segment to `sink`, in order. Returns true once the stream ended (or
+  // `stop` was raised), false if the playlist could not be loaded.
+  auto run(const SegmentSink& sink, const std::atomic<bool>& stop) -> bool
+  {
+    asio::io_context ioc;
+    ssl::context     ctx(ssl::context::tlsv12_client);
+    ctx.set_verify_mode(ssl::verify_none);
+    network::HttpsClient client(ioc, ctx, m_server);
+
+    const std::string base =
+      lwfmt::format("{}/{}/{}", routes::SERVER_PATH_LIVE, m_owner, m_streamId);
+    const std::string playlist_target = base + "/" + macros::to_string(macros::MASTER_PLAYLIST);
+
+    std::optional<ui64> next;
+    ui64                last_end = 0;
+    int                 failures = 0;
+
+    while (!stop)
+    {
+      const auto body = client.get(playlist_target);
+      if (!body.starts_with(macros::PLAYLIST_GLOBAL_HEADER))
+      {
+        if (++failures >= MAX_FAILURES)
+        {
+          log::ERROR<log::CLIENT>("Could not load live playlist {}", playlist_target);
+          return false;
+        }
+        wait(std::chrono::seconds(1), stop);
+        continue;
+      }
+      failures = 0;
+
+      const auto playlist = hls::parser::M3U8Parser::parseMediaPlaylist(body, 0, base);
+      const ui64 first    = playlist.media_sequence;
+      const ui64 end      = first + playlist.segments.size();
+
+      if (!next)
+      {
+        next = end - std::min<ui64>(playlist.segments.size(), LIVE_START_OFFSET);
+        log::INFO<log::CLIENT>("Joined live stream {}/{} at segment {}", m_owner, m_streamId,
+                               *next);
+      }
+      else if (*next < first)
+      {
+        log::WARN<log::CLIENT>("Fell behind the live window, skipping {} segments",
+                               first - *next);
+        next = first;
+      }
+
+      for (; *next < end && !stop; ++*next)
+      {
+        auto data = client.get(playlist.segments[*next - first].uri);
+        if (data.empty() || data.front() != TRANSPORT_STREAM_START_BYTE)
+        {
+          log::WARN<log::CLIENT>("Live segment {} unavailable, skipping it", *next);
+          continue;
+        }
+        sink(*next, std::move(data));
+      }
+
+      if (playlist.ended)
+      {
+        log::INFO<log::CLIENT>("Live stream {}/{} ended", m_owner, m_streamId);
+        return true;
+      }
+
+      const auto target = std::chrono::seconds(std::max(1, playlist.target_duration));
+      wait(end > last_end ? target : target / 2, stop);
+      last_end = end;
+    }
+    return true;
+  }
+
+private:
+  static constexpr int MAX_FAILURES = 5;
+
+  IPAddr         m_server;
+  StorageOwnerID m_owner;
+  std::string    m_streamId;
+
+  static void wait(std::chrono::milliseconds duration, const std::atomic<bool>& stop)
+  {
+    constexpr auto SLICE    = std::chrono::milliseconds(100);
+    const auto     deadline = std::chrono::steady_clock::now() + duration;
+    while (!stop && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(SLICE);
+  }
+};
+
+} // namespace libwavy::components::client
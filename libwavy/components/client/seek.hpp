@@ -0,0 +1,215 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/state.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/log-macros.hpp>
+#include <libwavy/network/entry.hpp>
+#include <libwavy/parser/entry.hpp>
+#include <libwavy/parser/seek-index.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+
+/*
+ * Seeking
+ *
+ * Starts a stored track at a given time without fetching anything before it. The seek index
+ * of the chosen variant (`<stem>.seek`, see libwavy/parser/seek-index.hpp) names the access
+ * point at or before the target, and one range request fetches from there to the end of its
+ * segment. With the index's header in front those bytes decode on their own; the decoder
+ * then drops the audio between the access point and the target.
+ *
+ * The segments after it are fetched whole, in playlist order, while that plays.
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::components::client
+{
+
+class SeekFetcher
+{
+public:
+  using SegmentSink = std::function<void(AudioData&& data)>;
+
+  struct Opening
+  {
+    AudioData data;     // index header + the bytes from the access point
+    double    time = 0; // track time `data` starts at
+    double    skip = 0; // seconds of it to decode and drop
+  };
+
+  SeekFetcher(IPAddr server, StorageOwnerID owner, StorageAudioID audio_id, int bitrate)
+      : m_sslCtx(ssl::context::tlsv12_client), m_owner(std::move(owner)),
+        m_audioId(std::move(audio_id)), m_bitrate(bitrate)
+  {
+    m_sslCtx.set_verify_mode(ssl::verify_none);
+    m_client = std::make_unique<network::HttpsClient>(m_ioCtx, m_sslCtx, std::move(server));
+  }
+
+  // Loads the variant and its seek index, then fetches the bytes that start at `seconds`
+  auto open(double seconds) -> std::optional<Opening>
+  {
+    if (!loadVariant())
+      return std::nullopt;
+
+    const auto target = m_index.locate(seconds);
+    if (!target)
+    {
+      log::ERROR<log::CLIENT>("Cannot seek to {:.3f}s, the track is {:.3f}s long", seconds,
+                              m_index.duration());
+      return std::nullopt;
+    }
+
+    // On packed tracks the index offsets are into the segment's byte range
+    const auto& segment = m_media.segments[target->segment];
+    const ui64  base    = segment.byterange ? segment.byterange->offset : 0;
+    const hls::parser::MediaByteRange range{.length = target->end - target->offset,
+                                            .offset = base + target->offset};
+
+    auto body = m_client->get_range(segment.uri, hls::parser::to_http_range(range));
+    if (body.size() != range.length)
+    {
+      log::ERROR<log::CLIENT>("Range request for {} returned {} bytes, expected {}", segment.uri,
+                              body.size(), range.length);
+      return std::nullopt;
+    }
+
+    log::INFO<log::CLIENT>("Seek to {:.3f}s: segment {} from byte {} ({} bytes, {:.3f}s early)",
+                           seconds, target->segment, target->offset, range.length, target->skip);
+
+    m_next = target->segment + 1;
+    return Opening{.data = m_index.header + body, .time = target->time, .skip = target->skip};
+  }
+
+  // fMP4 variants: what has to precede the segments run() hands out. Empty for MPEG-TS.
+  [[nodiscard]] auto init_segment() const -> const AudioData& { return m_init; }
+  [[nodiscard]] auto fragmented() const -> bool { return m_media.map_uri.has_value(); }
+
+  // Hands the segments after the opening one to `sink` in order, until the end or `stop`.
+  // False if one of them could not be fetched.
+  auto run(const SegmentSink& sink, const std::atomic<bool>& stop) -> bool
+  {
+    for (; m_next < m_media.segments.size() && !stop; ++m_next)
+    {
+      const auto& segment = m_media.segments[m_next];
+      auto        data    = segment.byterange
+                              ? m_client->get_range(segment.uri,
+                                                    hls::parser::to_http_range(*segment.byterange))
+                              : m_client->get(segment.uri);
+      if (data.empty() || (segment.byterange && data.size() != segment.byterange->length))
+      {
+        log::ERROR<log::CLIENT>("Failed to fetch segment {} after the seek point", m_next);
+        return false;
+      }
+      sink(std::move(data));
+    }
+    return true;
+  }
+
+private:
+  asio::io_context                      m_ioCtx;
+  ssl::context                          m_sslCtx;
+  std::unique_ptr<network::HttpsClient> m_client;
+  StorageOwnerID                        m_owner;
+  StorageAudioID                        m_audioId;
+  int                                   m_bitrate;
+
+  hls::parser::ast::MediaPlaylist m_media{};
+  hls::parser::SeekIndex          m_index;
+  AudioData                       m_init;
+  std::size_t                     m_next = 0;
+
+  // Master playlist -> media playlist (same bitrate choice as the fetchers) -> seek index
+  auto loadVariant() -> bool
+  {
+    const std::string base = "/download/" + m_owner + "/" + m_audioId;
+    const std::string master_uri = base + "/" + macros::to_string(macros::MASTER_PLAYLIST);
+
+    const auto master_body = m_client->get(master_uri);
+    if (!master_body.starts_with(macros::PLAYLIST_GLOBAL_HEADER))
+    {
+      log::ERROR<log::CLIENT>("Failed to fetch master playlist {}", master_uri);
+      return false;
+    }
+
+    std::string media_uri = master_uri;
+    const auto  master    = hls::parser::M3U8Parser::parseMasterPlaylist(master_body, base);
+    if (!master.variants.empty())
+    {
+      const auto* chosen = &master.variants.front();
+      for (const auto& variant : master.variants)
+      {
+        if (variant.bitrate == m_bitrate)
+        {
+          chosen = &variant;
+          break;
+        }
+        if (variant.bitrate > chosen->bitrate)
+          chosen = &variant;
+      }
+      media_uri = chosen->uri;
+    }
+
+    const auto media_body = media_uri == master_uri ? master_body : m_client->get(media_uri);
+    m_media               = hls::parser::M3U8Parser::parseMediaPlaylist(
+      media_body, m_bitrate, fs::path(media_uri).parent_path().string());
+    if (m_media.segments.empty())
+    {
+      log::ERROR<log::CLIENT>("No segments in media playlist {}", media_uri);
+      return false;
+    }
+
+    const auto index_uri = fs::path(media_uri)
+                             .replace_extension(macros::to_string(macros::SEEK_INDEX_EXT))
+                             .string();
+    auto index = hls::parser::parse_seek_index(m_client->get(index_uri));
+    if (!index || index->segments.size() != m_media.segments.size())
+    {
+      log::ERROR<log::CLIENT>("{} is missing or does not match its playlist, cannot seek",
+                              index_uri);
+      return false;
+    }
+    m_index = std::move(*index);
+
+    if (m_media.map_uri)
+    {
+      m_init = m_client->get(*m_media.map_uri);
+      if (m_init.empty())
+      {
+        log::ERROR<log::CLIENT>("Failed to fetch init segment {}", *m_media.map_uri);
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+} // namespace libwavy::components::client
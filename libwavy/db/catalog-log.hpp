@@ -0,0 +1,641 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/db/db.h>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Persistent form of the owner -> audio-id index (OwnerAudioIDMap).
+//
+//   <dir>/catalog.snap   full image of the index, rewritten on compaction
+//   <dir>/catalog.wal    upload/delete events appended since that image
+//
+// Startup reads the snapshot and replays the log, so it costs O(catalog) bytes of
+// sequential reads instead of a directory walk over every track in storage.
+//
+// Both files are a cache of the storage tree, not an exchange format: integers are
+// host byte order, and anything that fails its checksum is dropped (torn log tail)
+// or rebuilt from storage (bad snapshot).
+//
+// Mutations go through record_insert / record_erase, which update the index and queue
+// the log record under one mutex, then return. A writer thread appends whatever is
+// queued with a single write + fdatasync (group commit), so neither request threads nor
+// the index mutex ever wait on the disk. Compaction images the index and drops the
+// queued records that image covers under the same mutex, so an event can never be lost
+// between the log and the snapshot that replaces it. Records still queued at a crash are
+// lost from both files. Startup reconcile repairs them from the storage tree, which
+// already reflects every upload and delete before it is recorded.
+//
+// An append that fails to write or to sync is cut back off the log, since replay stops
+// at the first bad record and would drop every later one with it. The change is then
+// recorded by compacting instead. If that fails too, the log is closed and every later
+// batch retries the snapshot until one succeeds.
+
+namespace libwavy
+{
+
+enum class CatalogOp : ui8
+{
+  Insert = 1,
+  Erase  = 2
+};
+
+struct CatalogLoadResult
+{
+  bool   snapshot_loaded = false;
+  size_t relations       = 0; // relations read from the snapshot
+  size_t wal_applied     = 0; // log records replayed on top of it
+  size_t wal_discarded   = 0; // bytes of torn or corrupt log tail cut off
+};
+
+struct CatalogReconcileResult
+{
+  size_t added    = 0; // on disk but missing from the catalog
+  size_t removed  = 0; // in the catalog but no longer on disk
+  bool   finished = false;
+};
+
+class CatalogLog
+{
+public:
+  static constexpr std::string_view SNAPSHOT_MAGIC = "WAVYCAT1";
+
+  CatalogLog(OwnerAudioIDMap& db, std::filesystem::path dir, size_t compact_after)
+      : m_db(db), m_dir(std::move(dir)), m_compactAfter(compact_after)
+  {
+  }
+
+  ~CatalogLog()
+  {
+    if (m_writer.joinable())
+    {
+      m_writer.request_stop();
+      m_cv.notify_all();
+      m_writer.join(); // flushes what is still queued
+    }
+    if (m_walFd >= 0)
+      ::close(m_walFd);
+  }
+
+  CatalogLog(const CatalogLog&)                    = delete;
+  auto operator=(const CatalogLog&) -> CatalogLog& = delete;
+
+  [[nodiscard]] auto snapshot_path() const -> std::filesystem::path
+  {
+    return m_dir / macros::to_string(macros::CATALOG_SNAPSHOT_FILE);
+  }
+
+  [[nodiscard]] auto wal_path() const -> std::filesystem::path
+  {
+    return m_dir / macros::to_string(macros::CATALOG_WAL_FILE);
+  }
+
+  // Fill the (still empty) index from snapshot + log and open the log for appends.
+  //
+  // Without a readable snapshot the index is left untouched and `snapshot_loaded`
+  // is false: the caller rebuilds it from storage and calls compact().
+  auto load() -> CatalogLoadResult
+  {
+    std::lock_guard io(m_ioMutex);
+    std::lock_guard lock(m_mutex);
+
+    CatalogLoadResult result;
+    std::error_code   ec;
+    std::filesystem::create_directories(m_dir, ec);
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> image;
+    std::string                                                   snapshot;
+    if (read_file(snapshot_path(), snapshot) && parse_snapshot(snapshot, image))
+    {
+      std::string wal;
+      read_file(wal_path(), wal);
+
+      m_db.update_db(
+        [&](OwnerAudioIDMap& db)
+        {
+          for (const auto& [owner, audios] : image)
+          {
+            for (const auto& audio : audios)
+              db.insert(owner, audio);
+            result.relations += audios.size();
+          }
+
+          const size_t good = replay_wal(wal, db, result.wal_applied);
+          result.wal_discarded = wal.size() - good;
+          if (result.wal_discarded > 0)
+            std::filesystem::resize_file(wal_path(), good, ec);
+        });
+
+      result.snapshot_loaded = true;
+      m_walRecords           = result.wal_applied;
+    }
+
+    m_walFd   = ::open(wal_path().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    m_logging = true;
+    if (!m_writer.joinable())
+      m_writer = std::jthread([this](const std::stop_token& stop) { write_loop(stop); });
+    return result;
+  }
+
+  // Add (owner -> audio) to the index and queue its log record; false if it was already there
+  auto record_insert(const StorageOwnerID& owner, const StorageAudioID& audio) -> bool
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      if (!m_db.insert(owner, audio))
+        return false;
+      enqueue_locked(CatalogOp::Insert, owner, audio);
+    }
+    m_cv.notify_one();
+    return true;
+  }
+
+  // Drop (owner -> audio) from the index and queue its log record; false if it was not there
+  auto record_erase(const StorageOwnerID& owner, const StorageAudioID& audio) -> bool
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      if (!m_db.erase(owner, audio))
+        return false;
+      enqueue_locked(CatalogOp::Erase, owner, audio);
+    }
+    m_cv.notify_one();
+    return true;
+  }
+
+  // Write the current index as the new snapshot and empty the log
+  auto compact() -> bool
+  {
+    std::lock_guard io(m_ioMutex);
+    return compact_locked();
+  }
+
+  // Blocks until every record queued so far is in the log (or in a snapshot)
+  void flush()
+  {
+    std::lock_guard io(m_ioMutex);
+    flush_locked();
+  }
+
+  // Compare the index with what is really in storage and fix the differences.
+  //
+  // Meant for a background thread right after startup: the snapshot may predate a
+  // crash, or files may have been moved by hand. Every fix re-checks the track
+  // directory under the catalog mutex, so an upload or delete racing with the walk
+  // is never undone.
+  auto reconcile(const std::filesystem::path& storage_root, const std::stop_token& stop)
+    -> CatalogReconcileResult
+  {
+    namespace fs = std::filesystem;
+
+    CatalogReconcileResult                                           result;
+    std::unordered_map<std::string, std::unordered_set<std::string>> on_disk;
+    std::error_code                                                  ec;
+
+    for (fs::directory_iterator owners(storage_root, ec), end; !ec && owners != end;
+         owners.increment(ec))
+    {
+      if (stop.stop_requested())
+        return result;
+
+      const auto owner = owners->path().filename().string();
+      if (owner.empty() || owner.front() == '.' || !owners->is_directory(ec))
+        continue;
+
+      auto& audios = on_disk[owner];
+      for (fs::directory_iterator it(owners->path(), ec), e; !ec && it != e; it.increment(ec))
+      {
+        if (it->is_directory(ec))
+          audios.insert(it->path().filename().string());
+      }
+      ec.clear();
+    }
+
+    auto track_dir = [&](const std::string& owner, const std::string& audio)
+    { return storage_root / owner / audio; };
+
+    for (const auto& [owner, audios] : on_disk)
+    {
+      for (const auto& audio : audios)
+      {
+        if (m_db.has(owner, audio))
+          continue;
+
+        std::lock_guard lock(m_mutex);
+        if (fs::is_directory(track_dir(owner, audio), ec) && m_db.insert(owner, audio))
+        {
+          enqueue_locked(CatalogOp::Insert, owner, audio);
+          ++result.added;
+        }
+      }
+    }
+
+    std::vector<std::pair<std::string, std::string>> stale;
+    m_db.for_each(
+      [&](const StorageOwnerID& owner, const StorageAudioID& audio)
+      {
+        auto it = on_disk.find(owner);
+        if (it == on_disk.end() || !it->second.contains(audio))
+          stale.emplace_back(owner, audio);
+      });
+
+    for (const auto& [owner, audio] : stale)
+    {
+      if (stop.stop_requested())
+        return result;
+
+      std::lock_guard lock(m_mutex);
+      if (!fs::exists(track_dir(owner, audio), ec) && m_db.erase(owner, audio))
+      {
+        enqueue_locked(CatalogOp::Erase, owner, audio);
+        ++result.removed;
+      }
+    }
+
+    if (result.added + result.removed > 0)
+      compact();
+
+    result.finished = true;
+    return result;
+  }
+
+  // Records in the log or queued for it since the last snapshot
+  [[nodiscard]] auto wal_records() const -> size_t
+  {
+    std::lock_guard io(m_ioMutex);
+    std::lock_guard lock(m_mutex);
+    return m_walRecords + m_pendingRecords;
+  }
+
+private:
+  OwnerAudioIDMap&      m_db;
+  std::filesystem::path m_dir;
+  size_t                m_compactAfter;
+
+  // Index and queue; never held across disk I/O
+  mutable std::mutex          m_mutex;
+  std::condition_variable_any m_cv;
+  std::string                 m_pending; // encoded records not written yet
+  size_t                      m_pendingRecords = 0;
+  bool                        m_logging        = false; // load() ran, records are queued
+
+  // Log and snapshot files; taken before m_mutex when both are needed
+  mutable std::mutex m_ioMutex;
+  int                m_walFd      = -1;
+  size_t             m_walRecords = 0;
+  bool               m_walBroken  = false; // index is ahead of both files
+
+  std::jthread m_writer; // last: stopped and joined before the rest goes away
+
+  // FNV-1a: cheap, and only has to catch torn writes and bit rot
+  static auto checksum(const char* data, size_t len) -> ui64
+  {
+    ui64 h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; ++i)
+    {
+      h ^= static_cast<unsigned char>(data[i]);
+      h *= 0x100000001b3ULL;
+    }
+    return h;
+  }
+
+  template <typename T> static void put(std::string& out, T v)
+  {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+
+  static void put_str(std::string& out, std::string_view s)
+  {
+    put<ui32>(out, static_cast<ui32>(s.size()));
+    out.append(s);
+  }
+
+  // Bounds-checked cursor over a loaded file
+  struct Reader
+  {
+    std::string_view buf;
+    size_t           pos = 0;
+
+    template <typename T> auto get(T& v) -> bool
+    {
+      if (buf.size() - pos < sizeof(T))
+        return false;
+      std::memcpy(&v, buf.data() + pos, sizeof(T));
+      pos += sizeof(T);
+      return true;
+    }
+
+    auto get_str(std::string& s) -> bool
+    {
+      ui32 len = 0;
+      if (!get(len) || buf.size() - pos < len)
+        return false;
+      s.assign(buf.data() + pos, len);
+      pos += len;
+      return true;
+    }
+  };
+
+  static auto read_file(const std::filesystem::path& path, std::string& out) -> bool
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  static auto write_all(int fd, const char* data, size_t len) -> bool
+  {
+    while (len > 0)
+    {
+      const ssize_t n = ::write(fd, data, len);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      data += n;
+      len -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  // magic | u32 owners | { str owner | u32 n | str audio * n } * owners | u64 checksum
+  static auto parse_snapshot(std::string_view buf,
+                             std::vector<std::pair<std::string, std::vector<std::string>>>& image)
+    -> bool
+  {
+    const size_t header = SNAPSHOT_MAGIC.size();
+    if (buf.size() < header + sizeof(ui32) + sizeof(ui64) ||
+        buf.substr(0, header) != SNAPSHOT_MAGIC)
+      return false;
+
+    const size_t body_end = buf.size() - sizeof(ui64);
+    ui64         stored   = 0;
+    std::memcpy(&stored, buf.data() + body_end, sizeof(stored));
+    if (stored != checksum(buf.data() + header, body_end - header))
+      return false;
+
+    Reader r{buf.substr(0, body_end), header};
+    ui32   owners = 0;
+    if (!r.get(owners))
+      return false;
+
+    image.reserve(owners);
+    for (ui32 i = 0; i < owners; ++i)
+    {
+      auto& [owner, audios] = image.emplace_back();
+      ui32  count           = 0;
+      if (!r.get_str(owner) || !r.get(count))
+        return false;
+
+      audios.resize(count);
+      for (auto& audio : audios)
+      {
+        if (!r.get_str(audio))
+          return false;
+      }
+    }
+    return r.pos == r.buf.size();
+  }
+
+  // u32 len | { u8 op | str owner | str audio } | u64 checksum
+  static auto encode_record(CatalogOp op, std::string_view owner, std::string_view audio)
+    -> std::string
+  {
+    std::string body;
+    put<ui8>(body, static_cast<ui8>(op));
+    put_str(body, owner);
+    put_str(body, audio);
+
+    std::string rec;
+    rec.reserve(sizeof(ui32) + body.size() + sizeof(ui64));
+    put<ui32>(rec, static_cast<ui32>(body.size()));
+    rec += body;
+    put<ui64>(rec, checksum(body.data(), body.size()));
+    return rec;
+  }
+
+  // Applies records until the first incomplete or corrupt one; returns the good prefix length
+  static auto replay_wal(std::string_view wal, OwnerAudioIDMap& db, size_t& applied) -> size_t
+  {
+    Reader r{wal};
+    while (r.pos < wal.size())
+    {
+      const size_t start = r.pos;
+      ui32         len   = 0;
+      ui64         sum   = 0;
+      if (!r.get(len) || wal.size() - r.pos < static_cast<size_t>(len) + sizeof(ui64))
+        return start;
+
+      const std::string_view body = wal.substr(r.pos, len);
+      r.pos += len;
+      r.get(sum);
+      if (sum != checksum(body.data(), body.size()))
+        return start;
+
+      Reader      b{body};
+      ui8         op = 0;
+      std::string owner, audio;
+      if (!b.get(op) || !b.get_str(owner) || !b.get_str(audio) || b.pos != body.size())
+        return start;
+
+      if (op == static_cast<ui8>(CatalogOp::Insert))
+        db.insert(owner, audio);
+      else if (op == static_cast<ui8>(CatalogOp::Erase))
+        db.erase(owner, audio);
+      else
+        return start;
+      ++applied;
+    }
+    return r.pos;
+  }
+
+  // Under m_mutex. Before load() nothing is logged: reconcile will repair the files.
+  void enqueue_locked(CatalogOp op, const StorageOwnerID& owner, const StorageAudioID& audio)
+  {
+    if (!m_logging)
+      return;
+    m_pending += encode_record(op, owner, audio);
+    ++m_pendingRecords;
+  }
+
+  void write_loop(const std::stop_token& stop)
+  {
+    while (true)
+    {
+      {
+        std::unique_lock lock(m_mutex);
+        if (!m_cv.wait(lock, stop, [this] { return !m_pending.empty(); }))
+          break;
+      }
+      std::lock_guard io(m_ioMutex);
+      flush_locked();
+    }
+
+    std::lock_guard io(m_ioMutex);
+    flush_locked();
+  }
+
+  // Under m_ioMutex: appends every queued record with one write and one sync
+  void flush_locked()
+  {
+    std::string batch;
+    size_t      records = 0;
+    {
+      std::lock_guard lock(m_mutex);
+      batch.swap(m_pending);
+      records = std::exchange(m_pendingRecords, 0);
+    }
+    if (batch.empty())
+      return;
+
+    if (m_walFd < 0)
+    {
+      if (m_walBroken)
+        reopen_locked(); // the snapshot it writes already holds the batch
+      return;
+    }
+
+    const off_t end = ::lseek(m_walFd, 0, SEEK_END);
+    if (end >= 0 && write_all(m_walFd, batch.data(), batch.size()) && ::fdatasync(m_walFd) == 0)
+    {
+      m_walRecords += records;
+      if (m_walRecords >= m_compactAfter)
+        compact_locked();
+      return;
+    }
+
+    // The changes are already in the index: drop whatever part of the batch made it to
+    // the log and let a snapshot carry them instead
+    if (end < 0 || ::ftruncate(m_walFd, end) != 0 || !compact_locked())
+    {
+      ::close(m_walFd);
+      m_walFd     = -1;
+      m_walBroken = true;
+    }
+  }
+
+  // After a failed append: a snapshot of the index supersedes the log, which restarts
+  // empty. Stays broken (and is retried on the next batch) while that fails.
+  void reopen_locked()
+  {
+    if (!compact_locked())
+      return;
+
+    m_walFd = ::open(wal_path().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                     0644);
+    if (m_walFd < 0)
+      return;
+    m_walRecords = 0;
+    m_walBroken  = false;
+  }
+
+  // Under m_ioMutex. The index is imaged under m_mutex together with the queue, so the
+  // records queued by then are exactly the ones the snapshot makes redundant.
+  auto compact_locked() -> bool
+  {
+    std::string buf(SNAPSHOT_MAGIC);
+    put<ui32>(buf, 0); // owner count, patched below
+    ui32   owners          = 0;
+    size_t covered_bytes   = 0;
+    size_t covered_records = 0;
+
+    {
+      std::lock_guard lock(m_mutex);
+      m_db.for_each_owner(
+        [&](const StorageOwnerID& owner, const OwnerAudioIDMap::audio_set& audios)
+        {
+          put_str(buf, owner);
+          put<ui32>(buf, static_cast<ui32>(audios.size()));
+          for (const auto& audio : audios)
+            put_str(buf, audio);
+          ++owners;
+        });
+      covered_bytes   = m_pending.size();
+      covered_records = m_pendingRecords;
+    }
+
+    std::memcpy(buf.data() + SNAPSHOT_MAGIC.size(), &owners, sizeof(owners));
+    put<ui64>(buf, checksum(buf.data() + SNAPSHOT_MAGIC.size(),
+                            buf.size() - SNAPSHOT_MAGIC.size()));
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_dir, ec);
+
+    const auto tmp = snapshot_path().string() + ".tmp";
+    const int  fd  = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+      return false;
+
+    const bool written = write_all(fd, buf.data(), buf.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!written || ::rename(tmp.c_str(), snapshot_path().c_str()) != 0)
+    {
+      ::unlink(tmp.c_str());
+      return false;
+    }
+
+    // Make the rename itself durable before the log it replaces goes away
+    if (const int dfd = ::open(m_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); dfd >= 0)
+    {
+      ::fsync(dfd);
+      ::close(dfd);
+    }
+
+    // With the log closed after a failed append its stale records must still go
+    const bool emptied =
+      m_walFd >= 0 ? ::ftruncate(m_walFd, 0) == 0 : ::truncate(wal_path().c_str(), 0) == 0;
+    if (emptied)
+      m_walRecords = 0;
+
+    // Only the writer and compaction take records off the queue, both under m_ioMutex
+    std::lock_guard lock(m_mutex);
+    m_pending.erase(0, covered_bytes);
+    m_pendingRecords -= covered_records;
+    return true;
+  }
+};
+
+} // namespace libwavy
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <functional>
+#include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
@@ -9,115 +14,230 @@
 namespace libwavy
 {
 
+// Owner -> AudioID index shared by every Crow worker.
+//
+// Owners are spread over `ShardCount` shards by hash, each guarded by its own
+// shared_mutex: readers of different (or the same) owners never block each other
+// and an upload only locks the shard of its owner.
+//
+// Visitors (`for_each`, `for_each_owner`, `with_audio_ids`) run under the shard's
+// shared lock and see the live sets without copying them. They must not call
+// insert/erase/clear on the same DB from inside the callback.
 template <typename Owner, typename AudioID, typename OwnerHash = std::hash<Owner>,
           typename OwnerEq = std::equal_to<Owner>, typename AudioHash = std::hash<AudioID>,
-          typename AudioEq = std::equal_to<AudioID>>
+          typename AudioEq = std::equal_to<AudioID>, std::size_t ShardCount = 16>
 class MiniDB
 {
+  static_assert(ShardCount > 0, "MiniDB needs at least one shard");
+
 public:
   using owner_type   = Owner;
   using audio_type   = AudioID;
   using audio_set    = std::unordered_set<AudioID, AudioHash, AudioEq>;
   using storage_type = std::unordered_map<Owner, audio_set, OwnerHash, OwnerEq>;
 
+  static constexpr std::size_t shard_count = ShardCount;
+
 private:
-  storage_type data_;
-  bool         db_initialized_ = false;
-  bool         modified_       = false; // insert/delete marks this true
+  // Own cache line per shard so writers on neighbouring shards don't false-share.
+  struct alignas(64) Shard
+  {
+    mutable std::shared_mutex mutex;
+    storage_type              data;
+  };
+
+  std::array<Shard, ShardCount> shards_;
+  std::atomic<bool>             db_initialized_{false};
+  std::atomic<bool>             modified_{false}; // insert/delete marks this true
+
+  auto shard_for(const Owner& owner) -> Shard& { return shards_[OwnerHash{}(owner) % ShardCount]; }
+  auto shard_for(const Owner& owner) const -> const Shard&
+  {
+    return shards_[OwnerHash{}(owner) % ShardCount];
+  }
 
 public:
   MiniDB() = default;
 
+  MiniDB(const MiniDB&)                    = delete;
+  auto operator=(const MiniDB&) -> MiniDB& = delete;
+
   // Single-use initialization function
   void update_db(std::function<void(MiniDB&)> init_fn)
   {
-    if (modified_)
+    if (modified_.load(std::memory_order_acquire))
       throw std::runtime_error("DB already modified. Cannot call update_db after insert/delete.");
 
-    if (db_initialized_)
-      throw std::runtime_error("update_db can only be called once.");
-
     if (!init_fn)
       throw std::invalid_argument("Initialization function cannot be empty.");
 
+    if (db_initialized_.exchange(true, std::memory_order_acq_rel))
+      throw std::runtime_error("update_db can only be called once.");
+
     init_fn(*this);
-    db_initialized_ = true;
   }
 
   // Insert relation (Owner -> AudioID)
   auto insert(const Owner& owner, const AudioID& audio) -> bool
   {
-    modified_ = true;
-    return data_[owner].insert(audio).second; // true if inserted new audio_id
+    auto&            shard = shard_for(owner);
+    std::unique_lock lock(shard.mutex);
+    modified_.store(true, std::memory_order_release);
+    return shard.data[owner].insert(audio).second; // true if inserted new audio_id
+  }
+
+  // Remove relation (Owner -> AudioID); the owner goes away with its last audio
+  auto erase(const Owner& owner, const AudioID& audio) -> bool
+  {
+    auto&            shard = shard_for(owner);
+    std::unique_lock lock(shard.mutex);
+
+    auto it = shard.data.find(owner);
+    if (it == shard.data.end() || it->second.erase(audio) == 0)
+      return false;
+
+    if (it->second.empty())
+      shard.data.erase(it);
+    modified_.store(true, std::memory_order_release);
+    return true;
+  }
+
+  // Remove an owner and all of its relations, returns how many were dropped
+  auto erase_owner(const Owner& owner) -> std::size_t
+  {
+    auto&            shard = shard_for(owner);
+    std::unique_lock lock(shard.mutex);
+
+    auto it = shard.data.find(owner);
+    if (it == shard.data.end())
+      return 0;
+
+    const auto dropped = it->second.size();
+    shard.data.erase(it);
+    modified_.store(true, std::memory_order_release);
+    return dropped;
   }
 
   // Check if owner exists
-  auto has_owner(const Owner& owner) const -> bool { return data_.find(owner) != data_.end(); }
+  auto has_owner(const Owner& owner) const -> bool
+  {
+    const auto&      shard = shard_for(owner);
+    std::shared_lock lock(shard.mutex);
+    return shard.data.find(owner) != shard.data.end();
+  }
 
   // Check if (owner, audio) relation exists
   auto has(const Owner& owner, const AudioID& audio) const -> bool
   {
-    auto it = data_.find(owner);
-    if (it == data_.end())
+    const auto&      shard = shard_for(owner);
+    std::shared_lock lock(shard.mutex);
+
+    auto it = shard.data.find(owner);
+    if (it == shard.data.end())
       return false;
     return it->second.find(audio) != it->second.end();
   }
 
-  // Get all audio IDs for an owner (const ref)
-  auto audio_ids(const Owner& owner) const -> const audio_set&
+  // Apply fn(audio_set) to an owner's audio IDs in place; false if the owner is unknown
+  template <typename Fn> auto with_audio_ids(const Owner& owner, Fn&& fn) const -> bool
+  {
+    const auto&      shard = shard_for(owner);
+    std::shared_lock lock(shard.mutex);
+
+    auto it = shard.data.find(owner);
+    if (it == shard.data.end())
+      return false;
+    fn(static_cast<const audio_set&>(it->second));
+    return true;
+  }
+
+  // Get all audio IDs for an owner (copy: the live set may change once the lock is dropped)
+  auto audio_ids(const Owner& owner) const -> audio_set
   {
-    static const audio_set empty{};
-    auto                   it = data_.find(owner);
-    return it == data_.end() ? empty : it->second;
+    audio_set result;
+    with_audio_ids(owner, [&](const audio_set& audios) { result = audios; });
+    return result;
   }
 
   // Iterate over all owners
   auto owners() const
   {
     std::vector<Owner> result;
-    result.reserve(data_.size());
-    for (auto& [owner, _] : data_)
-      result.push_back(owner);
+    for (const auto& shard : shards_)
+    {
+      std::shared_lock lock(shard.mutex);
+      result.reserve(result.size() + shard.data.size());
+      for (const auto& [owner, _] : shard.data)
+        result.push_back(owner);
+    }
     return result;
   }
 
   // Apply fn(owner, audio_id) for all relations
   template <typename Fn> void for_each(Fn&& fn) const
   {
-    for (auto& [owner, audios] : data_)
+    for (const auto& shard : shards_)
     {
-      for (auto& audio : audios)
+      std::shared_lock lock(shard.mutex);
+      for (const auto& [owner, audios] : shard.data)
       {
-        fn(owner, audio);
+        for (const auto& audio : audios)
+        {
+          fn(owner, audio);
+        }
       }
     }
   }
 
   // Apply fn(owner, audio_set) for all owners
+  //
+  // Each shard is a consistent view; the walk as a whole is not a global snapshot, so an
+  // owner added mid-walk may or may not be visited.
   template <typename Fn> void for_each_owner(Fn&& fn) const
   {
-    for (auto& [owner, audios] : data_)
+    for (const auto& shard : shards_)
     {
-      fn(owner, audios);
+      std::shared_lock lock(shard.mutex);
+      for (const auto& [owner, audios] : shard.data)
+      {
+        fn(owner, static_cast<const audio_set&>(audios));
+      }
     }
   }
 
   // Number of owners
-  [[nodiscard]] auto owner_count() const -> size_t { return data_.size(); }
+  [[nodiscard]] auto owner_count() const -> size_t
+  {
+    size_t total = 0;
+    for (const auto& shard : shards_)
+    {
+      std::shared_lock lock(shard.mutex);
+      total += shard.data.size();
+    }
+    return total;
+  }
 
   // Number of total relations
   [[nodiscard]] auto relation_count() const -> size_t
   {
     size_t total = 0;
-    for (auto& [_, audios] : data_)
-      total += audios.size();
+    for (const auto& shard : shards_)
+    {
+      std::shared_lock lock(shard.mutex);
+      for (const auto& [_, audios] : shard.data)
+        total += audios.size();
+    }
     return total;
   }
 
   void clear()
   {
-    data_.clear();
-    modified_ = true;
+    for (auto& shard : shards_)
+    {
+      std::unique_lock lock(shard.mutex);
+      shard.data.clear();
+    }
+    modified_.store(true, std::memory_order_release);
   }
 };
 
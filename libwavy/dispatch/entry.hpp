@@ -34,6 +34,8 @@
 #include <fstream>
 #include <iostream>
 #include <libwavy/common/api/entry.hpp>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 
 #include <libwavy/common/macros.hpp>
@@ -564,15 +566,37 @@ private:
       asio::write(m_socket, asio::buffer("0\r\n\r\n"));
 
       http::response<http::string_body> res;
-      http::read(m_socket, buffer, res);
+      if (const auto ec = run_with_timeout([&](auto handler)
+                                           { http::async_read(m_socket, buffer, res, handler); },
+                                           IO_TIMEOUT))
+      {
+        log::ERROR<Dispatch>("No response to the upload: {}", ec.message());
+        return false;
+      }
 
-      if (res.result() != http::status::ok)
+      if (res.result() == http::status::service_unavailable)
+      {
+        log::ERROR<Dispatch>("Server upload queue is full, retry in {}s",
+                             std::string(res[http::field::retry_after]));
+        return false;
+      }
+
+      if (res.result() != http::status::accepted && res.result() != http::status::ok)
       {
         log::ERROR<Dispatch>("Upload failed: {}", res.result_int());
         return false;
       }
 
-      log::INFO<Dispatch>("Response from server: \n{}", res.body());
+      log::INFO<Dispatch>("Upload sent ({}), waiting for the server to ingest it...",
+                          utils::math::bytesFormat(total_sent));
+
+      // Older servers answer 200 with the final result directly
+      const std::string result =
+        res.result() == http::status::ok ? res.body() : wait_for_upload_job(res.body(), buffer);
+      if (result.empty())
+        return false;
+
+      log::INFO<Dispatch>("Response from server: \n{}", result);
 
       log::INFO<Dispatch>("Upload completed successfully ({} sent)",
                           utils::math::bytesFormat(total_sent));
@@ -586,6 +610,110 @@ private:
     }
   }
 
+  static auto upload_field(const std::string& body, const std::string& key) -> std::string
+  {
+    std::istringstream in(body);
+    std::string        line;
+    while (std::getline(in, line))
+      if (line.starts_with(key + "="))
+        return line.substr(key.size() + 1);
+    return {};
+  }
+
+  static constexpr std::chrono::seconds IO_TIMEOUT{WAVY_DISPATCH_IO_TIMEOUT};
+  static constexpr std::chrono::seconds INGEST_TIMEOUT{WAVY_DISPATCH_INGEST_TIMEOUT};
+
+  // Runs one async operation (`start` gets its completion handler) on m_ioCtx for at most
+  // `timeout`. A stalled server gets the socket closed instead of blocking us forever.
+  template <typename Start>
+  auto run_with_timeout(Start&& start, std::chrono::steady_clock::duration timeout)
+    -> beast::error_code
+  {
+    beast::error_code result = asio::error::would_block;
+    start([&result](const beast::error_code& ec, std::size_t) { result = ec; });
+
+    m_ioCtx.restart();
+    m_ioCtx.run_for(timeout);
+    if (result != asio::error::would_block)
+      return result;
+
+    beast::error_code ignored;
+    beast::get_lowest_layer(m_socket).close(ignored);
+    m_ioCtx.restart();
+    m_ioCtx.run(); // the aborted operation still has to complete
+    return asio::error::timed_out;
+  }
+
+  // Polls /upload/status/<job-id> on the same connection until the job is done.
+  // Returns the final status body, or an empty string if ingest failed or did not
+  // finish within INGEST_TIMEOUT.
+  auto wait_for_upload_job(const std::string& accepted_body, beast::flat_buffer& buffer)
+    -> std::string
+  {
+    const std::string job_id = upload_field(accepted_body, "job_id");
+    if (job_id.empty())
+    {
+      log::ERROR<Dispatch>("Server accepted the upload without a job id");
+      return {};
+    }
+
+    const std::string target   = "/upload/status/" + job_id;
+    const auto        deadline = std::chrono::steady_clock::now() + INGEST_TIMEOUT;
+    auto              delay    = std::chrono::milliseconds(250);
+
+    while (true)
+    {
+      const auto left = deadline - std::chrono::steady_clock::now();
+      if (left <= std::chrono::steady_clock::duration::zero())
+      {
+        log::ERROR<Dispatch>("Upload job {} did not finish within {}s", job_id,
+                             INGEST_TIMEOUT.count());
+        return {};
+      }
+      const auto timeout = std::min<std::chrono::steady_clock::duration>(left, IO_TIMEOUT);
+
+      http::request<http::empty_body> req{http::verb::get, target, 11};
+      req.set(http::field::host, m_server);
+      req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+
+      http::response<http::string_body> res;
+      auto ec = run_with_timeout([&](auto handler) { http::async_write(m_socket, req, handler); },
+                                 timeout);
+      if (!ec)
+        ec = run_with_timeout([&](auto handler)
+                              { http::async_read(m_socket, buffer, res, handler); },
+                              timeout);
+      if (ec)
+      {
+        log::ERROR<Dispatch>("Upload status request for job {} failed: {}", job_id,
+                             ec.message());
+        return {};
+      }
+
+      if (res.result() != http::status::ok)
+      {
+        log::ERROR<Dispatch>("Upload status request failed: {}", res.result_int());
+        return {};
+      }
+
+      const std::string status = upload_field(res.body(), "status");
+      if (status == "done")
+        return res.body();
+      if (status == "failed")
+      {
+        log::ERROR<Dispatch>("Server failed to ingest upload: {}",
+                             upload_field(res.body(), "error"));
+        return {};
+      }
+
+      log::TRACE<Dispatch>("Upload job {} is {}", job_id, status);
+
+      std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+        delay, deadline - std::chrono::steady_clock::now()));
+      delay = std::min(delay * 2, std::chrono::milliseconds(2000));
+    }
+  }
+
   void print_hierarchy()
   {
     log::INFO<log::NONE>("\n HLS Playlist Hierarchy:\n");
@@ -0,0 +1,291 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/network/routes.h>
+#include <libwavy/common/state.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/log-macros.hpp>
+#include <mutex>
+#include <openssl/rand.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/*
+ * LIVE PUBLISHER
+ *
+ * Pushes the segments of a live stream to the server as the segmenter produces them
+ * (POST /live/ingest/<owner>/<stream-id>), over one kept-alive TLS connection.
+ *
+ * Segments are queued and sent from a worker thread so a slow request never holds up the
+ * segmenter. The queue is bounded: once the server falls too far behind the oldest queued
+ * segment is dropped, since listeners would be past it by the time it arrived anyway. The
+ * server marks the hole as a discontinuity.
+ *
+ * Every request carries a token drawn once per publisher. The first push binds the stream
+ * to it on the server, so nobody else can push to or end the stream, and a retried first
+ * push is still recognised as ours.
+ */
+
+namespace libwavy::dispatch
+{
+
+namespace beast = boost::beast;
+namespace http  = beast::http;
+namespace asio  = boost::asio;
+namespace ssl   = boost::asio::ssl;
+using tcp       = asio::ip::tcp;
+
+using LiveDispatch = libwavy::log::DISPATCH;
+
+struct LivePublisherStats
+{
+  ui64 sent    = 0;
+  ui64 dropped = 0; // queue overflow
+  ui64 failed  = 0; // refused by the server or out of retries
+};
+
+class WAVY_API LivePublisher
+{
+public:
+  LivePublisher(IPAddr server, StorageOwnerID owner, std::string stream_id, int target_duration,
+                std::size_t queue_limit = QUEUE_LIMIT)
+      : m_sslCtx(ssl::context::sslv23), m_server(std::move(server)), m_owner(std::move(owner)),
+        m_streamId(std::move(stream_id)), m_token(make_token()), m_target(target_duration),
+        m_queueLimit(queue_limit)
+  {
+    m_sslCtx.set_default_verify_paths();
+    m_worker = std::thread([this] { run(); });
+  }
+
+  ~LivePublisher() { finish(); }
+
+  LivePublisher(const LivePublisher&)                    = delete;
+  auto operator=(const LivePublisher&) -> LivePublisher& = delete;
+
+  void push(ui64 sequence, double duration, std::string&& data)
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      if (m_queue.size() >= m_queueLimit)
+      {
+        log::WARN<LiveDispatch>(LogMode::Async, "Server is behind, dropping live segment {}",
+                                m_queue.front().sequence);
+        m_queue.pop_front();
+        m_stats.dropped++;
+      }
+      m_queue.push_back({sequence, duration, std::move(data)});
+    }
+    m_cv.notify_one();
+  }
+
+  // Sends what is still queued, then ends the stream on the server. Safe to call twice.
+  auto finish() -> bool
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      if (m_finished)
+        return m_endAcked;
+      m_finished = true;
+    }
+    m_cv.notify_one();
+    if (m_worker.joinable())
+      m_worker.join();
+
+    const auto res =
+      send(lwfmt::format("{}/end/{}/{}", routes::SERVER_PATH_LIVE, m_owner, m_streamId), {});
+    m_endAcked     = res && res->result_int() == 200;
+    if (!m_endAcked)
+      log::WARN<LiveDispatch>("Could not end live stream {}/{} on the server", m_owner,
+                              m_streamId);
+    close();
+    return m_endAcked;
+  }
+
+  [[nodiscard]] auto stats() const -> LivePublisherStats
+  {
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+  }
+
+private:
+  struct Pending
+  {
+    ui64        sequence;
+    double      duration;
+    std::string data;
+  };
+
+  using Response = http::response<http::string_body>;
+
+  static constexpr std::size_t QUEUE_LIMIT  = 8;
+  static constexpr int         MAX_ATTEMPTS = 3;
+
+  asio::io_context                              m_ioCtx;
+  ssl::context                                  m_sslCtx;
+  std::optional<beast::ssl_stream<tcp::socket>> m_stream;
+  IPAddr                                        m_server;
+  StorageOwnerID                                m_owner;
+  std::string                                   m_streamId;
+  std::string                                   m_token;
+  int                                           m_target;
+  std::size_t                                   m_queueLimit;
+  mutable std::mutex                            m_mutex;
+  std::condition_variable                       m_cv;
+  std::deque<Pending>                           m_queue;
+  LivePublisherStats                            m_stats;
+  bool                                          m_finished = false;
+  bool                                          m_endAcked = false;
+  std::thread                                   m_worker;
+
+  void run()
+  {
+    for (;;)
+    {
+      Pending segment;
+      {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_finished || !m_queue.empty(); });
+        if (m_queue.empty())
+          return;
+        segment = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+
+      const auto target = lwfmt::format("{}/ingest/{}/{}?seq={}&duration={:.3f}&target={}",
+                                        routes::SERVER_PATH_LIVE, m_owner, m_streamId,
+                                        segment.sequence, segment.duration, m_target);
+
+      bool delivered = false;
+      for (int attempt = 1; attempt <= MAX_ATTEMPTS && !delivered; ++attempt)
+      {
+        const auto res = send(target, segment.data);
+        if (!res)
+          continue; // connection dropped, send() reconnects
+
+        const auto status = res->result_int();
+        if (status == 200)
+        {
+          delivered = true;
+          break;
+        }
+
+        log::WARN<LiveDispatch>(LogMode::Async, "Live segment {} refused ({}): {}",
+                                segment.sequence, status, res->body());
+        if (status != 503)
+          break; // the server will not take it on a retry either
+
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+      }
+
+      std::lock_guard lock(m_mutex);
+      if (delivered)
+        m_stats.sent++;
+      else
+        m_stats.failed++;
+    }
+  }
+
+  // One request on the kept-alive connection; nullopt when the connection failed
+  auto send(const std::string& target, const std::string& body) -> std::optional<Response>
+  {
+    try
+    {
+      if (!m_stream)
+        connect();
+
+      http::request<http::string_body> req{http::verb::post, target, 11};
+      req.set(http::field::host, m_server);
+      req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+      req.set(http::field::content_type, "video/mp2t");
+      req.set(macros::to_string(macros::LIVE_TOKEN_HEADER), m_token);
+      req.keep_alive(true);
+      req.body() = body;
+      req.prepare_payload();
+      http::write(*m_stream, req);
+
+      beast::flat_buffer buffer;
+      Response           res;
+      http::read(*m_stream, buffer, res);
+      if (!res.keep_alive())
+        close();
+      return res;
+    }
+    catch (const std::exception& e)
+    {
+      log::WARN<LiveDispatch>(LogMode::Async, "Live push to {} failed: {}", m_server, e.what());
+      close();
+      return std::nullopt;
+    }
+  }
+
+  // 32 random bytes as hex
+  static auto make_token() -> std::string
+  {
+    unsigned char bytes[32];
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1)
+      throw std::runtime_error("No randomness for the live stream token");
+
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string           token;
+    token.reserve(2 * sizeof(bytes));
+    for (const unsigned char b : bytes)
+    {
+      token += digits[b >> 4];
+      token += digits[b & 0x0f];
+    }
+    return token;
+  }
+
+  void connect()
+  {
+    tcp::resolver resolver(m_ioCtx);
+    m_stream.emplace(m_ioCtx, m_sslCtx);
+    m_stream->set_verify_mode(ssl::verify_none); // [TODO]: Improve SSL verification
+    asio::connect(m_stream->next_layer(), resolver.resolve(m_server, WAVY_SERVER_PORT_NO_STR));
+    m_stream->handshake(ssl::stream_base::client);
+  }
+
+  void close()
+  {
+    if (!m_stream)
+      return;
+    beast::error_code ec;
+    m_stream->next_layer().shutdown(tcp::socket::shutdown_both, ec);
+    m_stream->next_layer().close(ec);
+    m_stream.reset();
+  }
+};
+
+} // namespace libwavy::dispatch
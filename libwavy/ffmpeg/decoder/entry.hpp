@@ -42,29 +42,43 @@ extern "C"
 
 inline constexpr const ByteCount DefaultAVIOBufferSize = 32768;
 
+// Read position of one decode in its segments, so decodes can follow each other
+struct AVIOSegmentCursor
+{
+  TotalAudioData* segments      = nullptr;
+  size_t          segment_index = 0;
+  AudioOffset     read_offset   = 0;
+};
+
 // Custom AVIO read function
 inline static auto readAVIO(void* opaque, AudioByte* buf, int buf_size) -> int
 {
-  auto*              segments      = static_cast<TotalAudioData*>(opaque);
-  static size_t      segment_index = 0;
-  static AudioOffset read_offset   = 0;
+  auto* cursor   = static_cast<AVIOSegmentCursor*>(opaque);
+  auto* segments = cursor->segments;
+
+  // Empty segments would read as EOF
+  while (cursor->segment_index < segments->size() &&
+         (*segments)[cursor->segment_index].size() == 0)
+    cursor->segment_index++;
 
-  if (segment_index >= segments->size())
+  if (cursor->segment_index >= segments->size())
   {
     return AVERROR_EOF; // No more data
   }
 
-  size_t segment_size  = (*segments)[segment_index].size();
-  size_t bytes_to_copy = std::min(static_cast<size_t>(buf_size), segment_size - read_offset);
+  const auto& segment      = (*segments)[cursor->segment_index];
+  size_t      segment_size = segment.size();
+  size_t      bytes_to_copy =
+    std::min(static_cast<size_t>(buf_size), segment_size - cursor->read_offset);
 
-  memcpy(buf, (*segments)[segment_index].data() + read_offset, bytes_to_copy);
-  read_offset += bytes_to_copy;
+  memcpy(buf, segment.data() + cursor->read_offset, bytes_to_copy);
+  cursor->read_offset += bytes_to_copy;
 
-  if (read_offset >= segment_size)
+  if (cursor->read_offset >= segment_size)
   {
     // Move to the next segment
-    segment_index++;
-    read_offset = 0;
+    cursor->segment_index++;
+    cursor->read_offset = 0;
   }
 
   return bytes_to_copy;
@@ -83,18 +97,21 @@ public:
   MediaDecoder();
   ~MediaDecoder();
 
-  auto decode(TotalAudioData& ts_segments, TotalDecodedAudioData& output_audio) -> bool;
+  // `skip_seconds` of decoded audio are dropped from the front (seeking into a segment)
+  auto decode(TotalAudioData& ts_segments, TotalDecodedAudioData& output_audio,
+              double skip_seconds = 0.0) -> bool;
 
 private:
   auto is_lossless_codec(AVCodecID codec_id) -> bool;
 
   void print_audio_metadata(AVFormatContext* formatCtx, AVCodecParameters* codecParams);
-  auto init_input_context(TotalAudioData& ts_segments, AVFormatContext*& ctx) -> bool;
+  auto init_input_context(AVIOSegmentCursor& cursor, AVFormatContext*& ctx) -> bool;
   void detect_format(AVFormatContext* ctx);
   auto find_audio_stream(AVFormatContext* ctx, AudioStreamIdx& index) -> bool;
   auto setup_codec(AVCodecParameters* codec_params, AVCodecContext*& codec_ctx) -> bool;
   auto process_packets(AVFormatContext* ctx, AVCodecContext* codec_ctx, AudioStreamIdx stream_idx,
-                       AVCodecParameters* codec_params, TotalDecodedAudioData& output) -> bool;
+                       AVCodecParameters* codec_params, TotalDecodedAudioData& output,
+                       i64 skip_samples) -> bool;
   void cleanup(AVFormatContext* ctx, AVCodecContext* codec_ctx = nullptr);
 };
 
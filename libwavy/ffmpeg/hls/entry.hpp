@@ -69,6 +69,9 @@ public:
 
 private:
   auto encode_variant(CStrRelPath input_file, CStrRelPath output_playlist, int bitrate) -> bool;
+
+  // `<stem>.seek` next to the media playlist (see seek-index.hpp)
+  void writeSeekIndex(const AbsPath& playlist);
 };
 
 } // namespace libwavy::ffmpeg::hls
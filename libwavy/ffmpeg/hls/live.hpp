@@ -0,0 +1,83 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <atomic>
+#include <functional>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/state.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/log-macros.hpp>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+}
+
+/*
+ * Live segmenter
+ *
+ * Cuts a source (a file, or stdin for a pipe from an encoder) into MPEG-TS segments as it is
+ * read, instead of writing a whole HLS tree to disk first. The audio stream is copied, not
+ * re-encoded, so the source has to carry a codec MPEG-TS can hold (MP3, AAC, AC-3, Opus);
+ * FLAC sources are refused.
+ *
+ * Segments are cut on packet boundaries once they reach `segment_duration` seconds, and each
+ * one is muxed on its own (PAT/PMT up front) so it can be played without the ones before it.
+ * With `realtime` set reading is paced against the wall clock, the way a live source would
+ * produce it.
+ */
+
+namespace libwavy::ffmpeg::hls
+{
+
+// Returning false from the sink stops the segmenter
+using LiveSegmentSink = std::function<bool(ui64 sequence, double duration, std::string&& data)>;
+
+class WAVY_API LiveSegmenter
+{
+public:
+  explicit LiveSegmenter(double segment_duration = WAVY_LIVE_SEGMENT_DURATION,
+                         bool   realtime         = true);
+
+  // `input` of "-" reads stdin. Returns false if the source could not be opened or muxing
+  // failed; a sink that stops the run or `stop` being raised is not an error.
+  auto run(const std::string& input, const LiveSegmentSink& sink, const std::atomic<bool>& stop)
+    -> bool;
+
+  [[nodiscard]] auto segment_duration() const -> double { return m_segmentDuration; }
+
+private:
+  double m_segmentDuration;
+  bool   m_realtime;
+
+  static auto mux_segment(const AVCodecParameters* codecpar, AVRational time_base,
+                          std::vector<AVPacket*>& packets, std::string& out) -> int;
+};
+
+} // namespace libwavy::ffmpeg::hls
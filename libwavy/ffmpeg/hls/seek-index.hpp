@@ -0,0 +1,469 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/parser/entry.hpp>
+#include <libwavy/parser/seek-index.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Builds the seek index (libwavy/parser/seek-index.hpp) of a media playlist the segmenter has
+ * just written, from the segment files themselves:
+ *
+ * -> MPEG-TS: every packet of the audio PID that starts a PES with a PTS, at 90 kHz. The
+ *    packets ahead of the first PES (PAT, PMT, SDT) become the header.
+ * -> fMP4: the samples of every fragment (moof/traf: tfhd, tfdt, trun) at the track's
+ *    timescale. When init.mp4 describes FLAC (dfLa) every sample is a point and the header
+ *    is a native FLAC stream header; otherwise every fragment is one point and init.mp4 is
+ *    the header.
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::ffmpeg::hls
+{
+
+namespace m3u8 = libwavy::hls::parser;
+
+class SeekIndexBuilder
+{
+public:
+  static constexpr ui32 TS_TIMESCALE = 90000;
+
+  // Writes `<stem>.seek` next to `playlist`
+  static auto write(const fs::path& playlist) -> bool
+  {
+    const auto index = build(playlist);
+    if (!index)
+      return false;
+
+    fs::path out = playlist;
+    out.replace_extension(macros::to_string(macros::SEEK_INDEX_EXT));
+    std::ofstream ofs(out, std::ios::binary | std::ios::trunc);
+    ofs << m3u8::format_seek_index(*index);
+    return static_cast<bool>(ofs);
+  }
+
+  static auto build(const fs::path& playlist) -> std::optional<m3u8::SeekIndex>
+  {
+    // A string is taken as playlist content, so read it here
+    std::string content;
+    if (!readFile(playlist, content))
+      return std::nullopt;
+
+    const auto media =
+      m3u8::M3U8Parser::parseMediaPlaylist(content, 0, playlist.parent_path().string());
+    if (media.segments.empty())
+      return std::nullopt;
+
+    return media.map_uri ? buildFragmented(media) : buildTransportStream(media);
+  }
+
+private:
+  struct Box
+  {
+    std::string_view type;
+    std::size_t      offset = 0; // of the box header
+    std::string_view body;
+  };
+
+  struct TrackInfo
+  {
+    ui32        timescale        = 0;
+    ui32        default_duration = 0; // trex
+    ui32        default_size     = 0;
+    std::string flac_header;          // "fLaC" + the dfLa metadata blocks
+  };
+
+  static auto readFile(const fs::path& path, std::string& out) -> bool
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+    out.assign(std::istreambuf_iterator<char>(in), {});
+    return true;
+  }
+
+  static auto u8(std::string_view s, std::size_t at) -> ui32
+  {
+    return static_cast<unsigned char>(s[at]);
+  }
+  static auto be32(std::string_view s, std::size_t at) -> ui32
+  {
+    return u8(s, at) << 24 | u8(s, at + 1) << 16 | u8(s, at + 2) << 8 | u8(s, at + 3);
+  }
+  static auto be64(std::string_view s, std::size_t at) -> ui64
+  {
+    return static_cast<ui64>(be32(s, at)) << 32 | be32(s, at + 4);
+  }
+
+  // Rounds an EXTINF duration to ticks
+  static auto ticks(float seconds, ui32 timescale) -> ui64
+  {
+    return static_cast<ui64>(std::llround(static_cast<double>(seconds) * timescale));
+  }
+
+  // Segments without points of their own start where the previous one ended
+  static void fillDurations(m3u8::SeekIndex& index, const m3u8::ast::Segments& list)
+  {
+    auto& segments = index.segments;
+    for (std::size_t i = 0; i < segments.size(); ++i)
+    {
+      if (i > 0 && segments[i].points.empty())
+        segments[i].start = segments[i - 1].start + segments[i - 1].duration;
+
+      const bool next_known = i + 1 < segments.size() && !segments[i + 1].points.empty() &&
+                              segments[i + 1].start > segments[i].start;
+      segments[i].duration = next_known ? segments[i + 1].start - segments[i].start
+                                        : ticks(list[i].duration, index.timescale);
+    }
+  }
+
+  /* ------------------------------- MPEG-TS ------------------------------- */
+
+  static auto buildTransportStream(const m3u8::ast::MediaPlaylist& media)
+    -> std::optional<m3u8::SeekIndex>
+  {
+    m3u8::SeekIndex index;
+    index.timescale = TS_TIMESCALE;
+
+    std::optional<ui64> track_start;
+    int                 audio_pid = -1;
+
+    for (const auto& entry : media.segments)
+    {
+      std::string data;
+      if (entry.byterange || !readFile(entry.uri, data) || data.size() % TS_PACKET_SIZE != 0)
+        return std::nullopt;
+
+      m3u8::SeekSegment segment;
+      segment.end = data.size();
+
+      std::optional<ui64> first_pts;
+      for (std::size_t off = 0; off < data.size(); off += TS_PACKET_SIZE)
+      {
+        const std::string_view packet(data.data() + off, TS_PACKET_SIZE);
+        if (u8(packet, 0) != TRANSPORT_STREAM_START_BYTE)
+          return std::nullopt;
+
+        const auto pts = pesTimestamp(packet, audio_pid);
+        if (!pts)
+        {
+          // Everything before the first PES of the track is PSI
+          if (!track_start && index.segments.empty())
+            index.header.append(packet);
+          continue;
+        }
+
+        if (!track_start)
+          track_start = *pts;
+        if (!first_pts)
+        {
+          first_pts     = *pts;
+          segment.start = *pts > *track_start ? *pts - *track_start : 0;
+        }
+        segment.points.push_back(
+          {.time = *pts > *first_pts ? *pts - *first_pts : 0, .offset = off});
+      }
+      index.segments.push_back(std::move(segment));
+    }
+
+    if (!track_start)
+      return std::nullopt;
+
+    fillDurations(index, media.segments);
+    return index;
+  }
+
+  // PTS of the PES this packet starts, if it is one of the audio PID. The first audio PES
+  // seen picks the PID.
+  static auto pesTimestamp(std::string_view packet, int& audio_pid) -> std::optional<ui64>
+  {
+    const bool pusi       = (u8(packet, 1) & 0x40) != 0;
+    const int  pid        = static_cast<int>((u8(packet, 1) & 0x1F) << 8 | u8(packet, 2));
+    const ui32 adaptation = (u8(packet, 3) >> 4) & 0x3;
+    if (!pusi || !(adaptation & 0x1) || (audio_pid >= 0 && pid != audio_pid))
+      return std::nullopt;
+
+    std::size_t payload = 4;
+    if (adaptation & 0x2)
+      payload += 1 + u8(packet, 4);
+    if (payload + 14 > packet.size())
+      return std::nullopt;
+
+    const auto pes = packet.substr(payload);
+    if (u8(pes, 0) != 0 || u8(pes, 1) != 0 || u8(pes, 2) != 1)
+      return std::nullopt;
+
+    // MPEG audio streams, or private stream 1
+    const ui32 stream_id = u8(pes, 3);
+    if (!((stream_id >= 0xC0 && stream_id <= 0xDF) || stream_id == 0xBD))
+      return std::nullopt;
+    if (!(u8(pes, 7) & 0x80))
+      return std::nullopt;
+
+    audio_pid = pid;
+    return static_cast<ui64>((u8(pes, 9) >> 1) & 0x7) << 30 | static_cast<ui64>(u8(pes, 10)) << 22 |
+           static_cast<ui64>(u8(pes, 11) >> 1) << 15 | static_cast<ui64>(u8(pes, 12)) << 7 |
+           static_cast<ui64>(u8(pes, 13) >> 1);
+  }
+
+  /* -------------------------------- fMP4 -------------------------------- */
+
+  static auto buildFragmented(const m3u8::ast::MediaPlaylist& media)
+    -> std::optional<m3u8::SeekIndex>
+  {
+    std::string init;
+    TrackInfo   track;
+    if (!readFile(*media.map_uri, init) || !parseInit(init, track) || track.timescale == 0)
+      return std::nullopt;
+
+    const bool      flac = !track.flac_header.empty();
+    m3u8::SeekIndex index;
+    index.timescale = track.timescale;
+    index.header    = flac ? track.flac_header : init;
+
+    std::optional<ui64> track_start;
+    for (const auto& entry : media.segments)
+    {
+      std::string data;
+      if (entry.byterange || !readFile(entry.uri, data))
+        return std::nullopt;
+
+      m3u8::SeekSegment segment;
+      segment.end = flac ? 0 : data.size();
+
+      std::optional<ui64> first_time;
+      for (const auto& box : boxes(data, 0))
+      {
+        if (box.type != "moof")
+          continue;
+
+        ui64 time = 0;
+        if (!scanFragment(box, track, flac, time, segment))
+          return std::nullopt;
+
+        if (!track_start)
+          track_start = time;
+        if (!first_time)
+        {
+          first_time    = time;
+          segment.start = time > *track_start ? time - *track_start : 0;
+        }
+      }
+
+      // Sample times were absolute until the segment's own start was known
+      for (auto& point : segment.points)
+        point.time = first_time && point.time > *first_time ? point.time - *first_time : 0;
+      index.segments.push_back(std::move(segment));
+    }
+
+    if (!track_start)
+      return std::nullopt;
+
+    fillDurations(index, media.segments);
+    return index;
+  }
+
+  // Top-level boxes of `data` (or of a box body), stopping at the first malformed one
+  static auto boxes(std::string_view data, std::size_t base) -> std::vector<Box>
+  {
+    std::vector<Box> out;
+    std::size_t      at = 0;
+    while (at + 8 <= data.size())
+    {
+      ui64        size   = be32(data, at);
+      std::size_t header = 8;
+      if (size == 1)
+      {
+        if (at + 16 > data.size())
+          break;
+        size   = be64(data, at + 8);
+        header = 16;
+      }
+      else if (size == 0)
+      {
+        size = data.size() - at;
+      }
+      if (size < header || size > data.size() - at)
+        break;
+
+      out.push_back({.type   = data.substr(at + 4, 4),
+                     .offset = base + at,
+                     .body   = data.substr(at + header, size - header)});
+      at += size;
+    }
+    return out;
+  }
+
+  static auto child(std::string_view body, std::string_view type, std::size_t skip = 0)
+    -> std::optional<Box>
+  {
+    if (body.size() < skip)
+      return std::nullopt;
+    for (const auto& box : boxes(body.substr(skip), 0))
+      if (box.type == type)
+        return box;
+    return std::nullopt;
+  }
+
+  static auto parseInit(std::string_view init, TrackInfo& track) -> bool
+  {
+    const auto moov = child(init, "moov");
+    if (!moov)
+      return false;
+
+    if (const auto mvex = child(moov->body, "mvex"))
+      if (const auto trex = child(mvex->body, "trex"); trex && trex->body.size() >= 24)
+      {
+        track.default_duration = be32(trex->body, 12);
+        track.default_size     = be32(trex->body, 16);
+      }
+
+    const auto trak = child(moov->body, "trak");
+    const auto mdia = trak ? child(trak->body, "mdia") : std::nullopt;
+    const auto mdhd = mdia ? child(mdia->body, "mdhd") : std::nullopt;
+    if (!mdhd || mdhd->body.size() < 24)
+      return false;
+    track.timescale = be32(mdhd->body, u8(mdhd->body, 0) == 1 ? 20 : 12);
+
+    const auto minf = child(mdia->body, "minf");
+    const auto stbl = minf ? child(minf->body, "stbl") : std::nullopt;
+    const auto stsd = stbl ? child(stbl->body, "stsd") : std::nullopt;
+    // stsd: version/flags, entry count, then sample entries. An audio sample entry has
+    // 28 bytes of fields before its child boxes.
+    const auto entry = stsd ? child(stsd->body, "fLaC", 8) : std::nullopt;
+    const auto dfla  = entry ? child(entry->body, "dfLa", 28) : std::nullopt;
+    if (dfla && dfla->body.size() > 4)
+      track.flac_header = "fLaC" + std::string(dfla->body.substr(4));
+    return true;
+  }
+
+  // Adds the fragment's points to `segment`, with absolute times; `time` is its tfdt
+  static auto scanFragment(const Box& moof, const TrackInfo& track, bool flac, ui64& time,
+                           m3u8::SeekSegment& segment) -> bool
+  {
+    const auto traf = child(moof.body, "traf");
+    const auto tfhd = traf ? child(traf->body, "tfhd") : std::nullopt;
+    const auto tfdt = traf ? child(traf->body, "tfdt") : std::nullopt;
+    if (!tfhd || !tfdt || tfhd->body.size() < 8 || tfdt->body.size() < 8)
+      return false;
+
+    time = u8(tfdt->body, 0) == 1 ? (tfdt->body.size() >= 12 ? be64(tfdt->body, 4) : 0)
+                                  : be32(tfdt->body, 4);
+
+    // tfhd: version/flags, track id, then the optional fields its flags announce
+    const ui32  tf_flags         = be32(tfhd->body, 0) & 0xFFFFFF;
+    std::size_t at               = 8;
+    ui64        base             = moof.offset;
+    ui32        default_duration = track.default_duration;
+    ui32        default_size     = track.default_size;
+    auto        field            = [&](std::size_t width) -> std::optional<ui64>
+    {
+      if (at + width > tfhd->body.size())
+        return std::nullopt;
+      const ui64 v = width == 8 ? be64(tfhd->body, at) : be32(tfhd->body, at);
+      at += width;
+      return v;
+    };
+    if (tf_flags & 0x01)
+      base = field(8).value_or(base);
+    if (tf_flags & 0x02)
+      field(4);
+    if (tf_flags & 0x08)
+      default_duration = static_cast<ui32>(field(4).value_or(default_duration));
+    if (tf_flags & 0x10)
+      default_size = static_cast<ui32>(field(4).value_or(default_size));
+
+    if (!flac)
+    {
+      segment.points.push_back({.time = time, .offset = moof.offset});
+      return true;
+    }
+
+    ui64 sample_time = time;
+    ui64 data_at     = base;
+    for (const auto& trun : boxes(traf->body, 0))
+    {
+      if (trun.type != "trun" || trun.body.size() < 8)
+        continue;
+
+      const auto  body  = trun.body;
+      const ui32  flags = be32(body, 0) & 0xFFFFFF;
+      const ui32  count = be32(body, 4);
+      std::size_t pos   = 8;
+      if (flags & 0x01)
+      {
+        if (pos + 4 > body.size())
+          return false;
+        data_at = base + static_cast<i32>(be32(body, pos));
+        pos += 4;
+      }
+      if (flags & 0x04)
+        pos += 4;
+
+      const std::size_t per_sample = 4 * (((flags & 0x100) != 0) + ((flags & 0x200) != 0) +
+                                          ((flags & 0x400) != 0) + ((flags & 0x800) != 0));
+      if (pos + static_cast<ui64>(count) * per_sample > body.size())
+        return false;
+
+      for (ui32 i = 0; i < count; ++i)
+      {
+        ui32 duration = default_duration;
+        ui32 size     = default_size;
+        if (flags & 0x100)
+        {
+          duration = be32(body, pos);
+          pos += 4;
+        }
+        if (flags & 0x200)
+        {
+          size = be32(body, pos);
+          pos += 4;
+        }
+        pos += 4 * (((flags & 0x400) != 0) + ((flags & 0x800) != 0));
+
+        segment.points.push_back({.time = sample_time, .offset = data_at});
+        sample_time += duration;
+        data_at += size;
+      }
+      segment.end = std::max<ui64>(segment.end, data_at);
+    }
+    return true;
+  }
+
+  static constexpr std::size_t TS_PACKET_SIZE = 188;
+};
+
+} // namespace libwavy::ffmpeg::hls
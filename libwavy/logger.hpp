@@ -100,8 +100,10 @@ constexpr const char* REL_PATH_LOGS = ".cache/wavy/logs";
   X(SERVER_UPLD,     "#SERVER_UPLD_LOG     ")  \
   X(SERVER_EXTRACT,  "#SERVER_EXTRACT_LOG  ")  \
   X(SERVER_VALIDATE, "#SERVER_VALIDATE_LOG ")  \
+  X(SERVER_LIVE,     "#SERVER_LIVE_LOG     ")  \
   X(OWNER,           "#OWNER_LOG           ")  \
   X(CLIENT,          "#CLIENT_LOG          ")  \
+  X(BENCH,           "#BENCH_LOG           ")  \
   X(FLAC,            "#FLAC_LOG            ")  \
   X(NONE,            "")
 // clang-format on
@@ -30,6 +30,7 @@
 #include <boost/beast/http.hpp>
 #include <boost/beast/ssl.hpp>
 
+#include <libwavy/common/content-encoding.hpp>
 #include <libwavy/common/macros.hpp>
 #include <libwavy/common/types.hpp>
 #include <libwavy/log-macros.hpp>
@@ -68,6 +69,12 @@ public:
     return makeRequest(http::verb::get, target, "");
   }
 
+  // GET of part of a resource, `range` being a `Range` header value ("bytes=a-b")
+  auto get_range(const NetTarget& target, const std::string& range) -> NetResponse
+  {
+    return makeRequest(http::verb::get, target, "", range);
+  }
+
   auto post(const NetTarget& target, const std::string& body) -> NetResponse
   {
     return makeRequest(http::verb::post, target, body);
@@ -191,8 +198,8 @@ private:
 
   std::unique_ptr<beast::ssl_stream<tcp::socket>> m_socket;
 
-  auto makeRequest(http::verb method, const NetTarget& target, const std::string& body)
-    -> NetResponse
+  auto makeRequest(http::verb method, const NetTarget& target, const std::string& body,
+                   const std::string& range = {}) -> NetResponse
   {
     try
     {
@@ -223,6 +230,10 @@ private:
       http::request<http::string_body> req{method, target, 11};
       req.set(http::field::host, m_server);
       req.set(http::field::user_agent, "WavyClient");
+      if (!range.empty())
+        req.set(http::field::range, range);
+      else if (method == http::verb::get)
+        req.set(http::field::accept_encoding, std::string(encoding::ACCEPT_ENCODING));
 
       if (method == http::verb::post)
       {
@@ -252,6 +263,26 @@ private:
       if (ec == asio::error::eof)
         ec.clear();
 
+      // Playlists and metadata come precompressed when the server has a variant
+      const auto content_encoding = res[http::field::content_encoding];
+      const auto coding =
+        encoding::from_token(std::string_view(content_encoding.data(), content_encoding.size()));
+      if (!coding)
+      {
+        log::ERROR<Network>("Unsupported Content-Encoding in response");
+        return "";
+      }
+      if (*coding != encoding::Coding::Identity)
+      {
+        auto decoded = encoding::decode(*coding, response_data);
+        if (!decoded)
+        {
+          log::ERROR<Network>("Failed to decode {} response body", encoding::token(*coding));
+          return "";
+        }
+        response_data = std::move(*decoded);
+      }
+
       return response_data;
     }
     catch (const std::exception& e)
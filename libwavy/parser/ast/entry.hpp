@@ -23,6 +23,7 @@
  *  See LICENSE file for full legal details.                                    *
  ********************************************************************************/
 
+#include <libwavy/parser/byterange.hpp>
 #include <map>
 #include <optional>
 #include <string>
@@ -43,8 +44,11 @@ struct VariantStream
 
 struct Segment
 {
-  float       duration = 0.0f; // #EXTINF: duration
-  std::string uri;             // URI of the media segment
+  float                         duration = 0.0f; // #EXTINF: duration
+  std::string                   uri;             // URI of the media segment
+  std::optional<MediaByteRange> byterange;       // #EXT-X-BYTERANGE: part of `uri` (packed)
+  // #EXT-X-DISCONTINUITY before it: timestamps or encoding may not follow the previous one
+  bool discontinuity = false;
 };
 
 using Segments       = std::vector<Segment>;
@@ -54,7 +58,10 @@ struct MediaPlaylist
 {
   int                        bitrate; // Derived from the master playlist
   std::optional<std::string> map_uri;
-  Segments                   segments; // .ts or .m4s segments
+  Segments                   segments;                // .ts or .m4s segments
+  ui64                       media_sequence  = 0;     // #EXT-X-MEDIA-SEQUENCE: of segments[0]
+  int                        target_duration = 0;     // #EXT-X-TARGETDURATION:
+  bool                       ended           = false; // #EXT-X-ENDLIST, live playlists lack it
 };
 
 struct MasterPlaylist
@@ -0,0 +1,92 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <charconv>
+#include <libwavy/common/types.hpp>
+#include <libwavy/parser/macros.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// `#EXT-X-BYTERANGE:<length>[@<offset>]` (RFC 8216 §4.3.2.2): the next media segment is
+// `length` bytes of its URI starting at `offset`. Without `@offset` the range starts
+// right after the previous sub-range of the same resource.
+//
+// Packed tracks (see libwavy/server/packfile.hpp) describe every segment this way.
+
+namespace libwavy::hls::parser
+{
+
+// HLS needs at least this EXT-X-VERSION for EXT-X-BYTERANGE
+inline constexpr int BYTERANGE_MIN_VERSION = 4;
+
+struct MediaByteRange
+{
+  ui64 length = 0;
+  ui64 offset = 0;
+
+  [[nodiscard]] auto end() const -> ui64 { return offset + length; }
+};
+
+// `next_offset` is where a range without `@offset` starts (end of the previous one)
+inline auto parse_byterange(std::string_view line, ui64 next_offset = 0)
+  -> std::optional<MediaByteRange>
+{
+  if (!line.starts_with(macro::EXT_X_BYTERANGE))
+    return std::nullopt;
+  line.remove_prefix(macro::EXT_X_BYTERANGE.size());
+  while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+    line.remove_suffix(1);
+
+  auto read = [](std::string_view s, ui64& out)
+  {
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return !s.empty() && ec == std::errc{} && ptr == s.data() + s.size();
+  };
+
+  MediaByteRange range;
+  const auto     at = line.find('@');
+  if (!read(line.substr(0, at), range.length) || range.length == 0)
+    return std::nullopt;
+
+  range.offset = next_offset;
+  if (at != std::string_view::npos && !read(line.substr(at + 1), range.offset))
+    return std::nullopt;
+  return range;
+}
+
+inline auto format_byterange(const MediaByteRange& range) -> std::string
+{
+  return std::string(macro::EXT_X_BYTERANGE) + std::to_string(range.length) + "@" +
+         std::to_string(range.offset);
+}
+
+// Value for an HTTP `Range` header selecting the same bytes
+inline auto to_http_range(const MediaByteRange& range) -> std::string
+{
+  return "bytes=" + std::to_string(range.offset) + "-" + std::to_string(range.end() - 1);
+}
+
+} // namespace libwavy::hls::parser
@@ -25,6 +25,7 @@
 
 #include <algorithm>
 #include <autogen/config.h>
+#include <charconv>
 #include <filesystem>
 #include <fstream>
 #include <libwavy/common/api/entry.hpp>
@@ -170,8 +171,11 @@ private:
 
     std::istringstream   ss(content);
     std::string          line;
-    std::optional<float> pending_duration;
-    bool                 map_found = false;
+    std::optional<float>          pending_duration;
+    std::optional<MediaByteRange> pending_range;
+    ui64                          next_offset           = 0; // where an `@`-less range starts
+    bool                          map_found             = false;
+    bool                          pending_discontinuity = false;
 
     while (std::getline(ss, line))
     {
@@ -220,6 +224,32 @@ private:
           pending_duration.reset(); // Defensive
         }
       }
+      else if (sv.starts_with(macro::EXT_X_MEDIA_SEQUENCE))
+      {
+        const auto value = sv.substr(macro::EXT_X_MEDIA_SEQUENCE.size());
+        std::from_chars(value.data(), value.data() + value.size(), media.media_sequence);
+      }
+      else if (sv.starts_with(macro::EXT_X_TARGETDURATION))
+      {
+        const auto value = sv.substr(macro::EXT_X_TARGETDURATION.size());
+        std::from_chars(value.data(), value.data() + value.size(), media.target_duration);
+      }
+      else if (sv == macro::EXT_X_DISCONTINUITY)
+      {
+        pending_discontinuity = true;
+      }
+      else if (sv == macro::EXT_X_ENDLIST)
+      {
+        media.ended = true;
+      }
+      else if (sv.starts_with(macro::EXT_X_BYTERANGE))
+      {
+        pending_range = parse_byterange(sv, next_offset);
+        if (pending_range)
+          next_offset = pending_range->end();
+        else
+          log::WARN<M3U8>("Failed to parse EXT-X-BYTERANGE: {}", sv);
+      }
       else if (sv.front() != '#')
       {
         if (pending_duration.has_value())
@@ -228,10 +258,15 @@ private:
           fs::path    full_path = fs::path(base_path) / seg_uri;
           std::string norm_uri  = full_path.lexically_normal().string();
 
-          media.segments.emplace_back(ast::Segment{.duration = *pending_duration, .uri = norm_uri});
+          media.segments.emplace_back(ast::Segment{.duration      = *pending_duration,
+                                                   .uri           = norm_uri,
+                                                   .byterange     = pending_range,
+                                                   .discontinuity = pending_discontinuity});
 
           log::DBG<M3U8>("Added Segment: duration={}, uri={}", *pending_duration, norm_uri);
           pending_duration.reset();
+          pending_range.reset();
+          pending_discontinuity = false;
         }
         else
         {
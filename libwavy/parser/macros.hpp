@@ -25,14 +25,20 @@
 
 #include <string_view>
 
-#define HLS_KEYWORDS(MACRO)                      \
-  MACRO(CODECS, "CODECS=")                       \
-  MACRO(BANDWIDTH, "BANDWIDTH=")                 \
-  MACRO(URI, "URI=")                             \
-  MACRO(AVERAGE_BANDWIDTH, "AVERAGE-BANDWIDTH=") \
-  MACRO(RESOLUTION, "RESOLUTION=")               \
-  MACRO(EXT_X_STREAM_INF, "#EXT-X-STREAM-INF:")  \
-  MACRO(EXT_X_MAP, "#EXT-X-MAP:")                \
+#define HLS_KEYWORDS(MACRO)                             \
+  MACRO(CODECS, "CODECS=")                              \
+  MACRO(BANDWIDTH, "BANDWIDTH=")                        \
+  MACRO(URI, "URI=")                                    \
+  MACRO(AVERAGE_BANDWIDTH, "AVERAGE-BANDWIDTH=")        \
+  MACRO(RESOLUTION, "RESOLUTION=")                      \
+  MACRO(EXT_X_STREAM_INF, "#EXT-X-STREAM-INF:")         \
+  MACRO(EXT_X_MAP, "#EXT-X-MAP:")                       \
+  MACRO(EXT_X_BYTERANGE, "#EXT-X-BYTERANGE:")           \
+  MACRO(EXT_X_VERSION, "#EXT-X-VERSION:")               \
+  MACRO(EXT_X_TARGETDURATION, "#EXT-X-TARGETDURATION:") \
+  MACRO(EXT_X_MEDIA_SEQUENCE, "#EXT-X-MEDIA-SEQUENCE:") \
+  MACRO(EXT_X_DISCONTINUITY, "#EXT-X-DISCONTINUITY")    \
+  MACRO(EXT_X_ENDLIST, "#EXT-X-ENDLIST")                \
   MACRO(EXTINF, "#EXTINF:")
 
 namespace libwavy::hls::parser::macro
@@ -0,0 +1,302 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <libwavy/common/types.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Seek index
+ *
+ * Every media playlist can have a `<stem>.seek` next to it that maps a time to bytes a decoder
+ * can start on, so seeking costs one range request instead of every segment up to the target.
+ * It is text, one line per media segment in playlist order:
+ *
+ *   #WAVY-SEEK:1
+ *   #TIMESCALE:90000
+ *   #HEADER:<hex>
+ *   <start> <duration> <end> <time>@<offset> <time>@<offset> ...
+ *
+ * -> Times are TIMESCALE ticks: `start` from the start of the track, point times from the
+ *    start of their segment.
+ * -> Offsets are bytes into the segment (into its EXT-X-BYTERANGE on packed tracks). The bytes
+ *    from a point's offset up to `end`, with HEADER in front, decode on their own.
+ * -> MPEG-TS: a point is a packet that starts a PES with a PTS, HEADER is the PAT and PMT.
+ *    FLAC in fMP4: a point is a FLAC frame, HEADER is a native `fLaC` stream header, so the
+ *    range decodes as plain FLAC. Other fMP4 gets a point per fragment and init.mp4 as HEADER.
+ *
+ * Lines match playlist segments by position, not name: packing a track renames its segments
+ * but keeps their order.
+ */
+
+namespace libwavy::hls::parser
+{
+
+inline constexpr std::string_view SEEK_INDEX_TAG     = "#WAVY-SEEK:";
+inline constexpr std::string_view SEEK_TIMESCALE_TAG = "#TIMESCALE:";
+inline constexpr std::string_view SEEK_HEADER_TAG    = "#HEADER:";
+inline constexpr int              SEEK_INDEX_VERSION = 1;
+
+struct SeekPoint
+{
+  ui64 time   = 0; // ticks from the start of the segment
+  ui64 offset = 0; // bytes into the segment
+};
+
+struct SeekSegment
+{
+  ui64                   start    = 0; // ticks from the start of the track
+  ui64                   duration = 0;
+  ui64                   end      = 0; // where a range starting at one of `points` stops
+  std::vector<SeekPoint> points;
+};
+
+/// Bytes to fetch for a seek, and how much of what they decode to comes before the target
+struct SeekTarget
+{
+  std::size_t segment = 0; // position in the media playlist
+  ui64        offset  = 0; // first byte, into the segment
+  ui64        end     = 0; // one past the last byte
+  double      time    = 0; // track time the bytes start at
+  double      skip    = 0; // seconds to decode and drop before the target
+};
+
+struct SeekIndex
+{
+  ui32                     timescale = 0;
+  std::string              header; // put in front of every range
+  std::vector<SeekSegment> segments;
+
+  [[nodiscard]] auto empty() const -> bool { return timescale == 0 || segments.empty(); }
+
+  [[nodiscard]] auto duration() const -> double
+  {
+    if (empty())
+      return 0;
+    const auto& last = segments.back();
+    return static_cast<double>(last.start + last.duration) / timescale;
+  }
+
+  // nullopt past the end of the track
+  [[nodiscard]] auto locate(double seconds) const -> std::optional<SeekTarget>
+  {
+    if (empty() || !(seconds >= 0) || seconds >= duration())
+      return std::nullopt;
+
+    const auto ticks = static_cast<ui64>(std::llround(seconds * timescale));
+    auto       seg   = std::ranges::upper_bound(segments, ticks, {}, &SeekSegment::start);
+    if (seg != segments.begin())
+      --seg;
+
+    SeekTarget target;
+    target.segment = static_cast<std::size_t>(std::distance(segments.begin(), seg));
+    target.end     = seg->end;
+
+    ui64 point_time = 0;
+    if (!seg->points.empty())
+    {
+      const ui64 into  = ticks > seg->start ? ticks - seg->start : 0;
+      auto       point = std::ranges::upper_bound(seg->points, into, {}, &SeekPoint::time);
+      if (point != seg->points.begin())
+        --point;
+      target.offset = point->offset;
+      point_time    = point->time;
+    }
+
+    target.time = static_cast<double>(seg->start + point_time) / timescale;
+    target.skip = std::max(0.0, seconds - target.time);
+    return target;
+  }
+};
+
+namespace detail
+{
+
+inline auto parse_u64(std::string_view s, ui64& out) -> bool
+{
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+  return !s.empty() && ec == std::errc{} && ptr == s.data() + s.size();
+}
+
+inline auto hex_value(char c) -> int
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+inline auto next_field(std::string_view& line) -> std::string_view
+{
+  const auto start = line.find_first_not_of(' ');
+  if (start == std::string_view::npos)
+  {
+    line = {};
+    return {};
+  }
+  line.remove_prefix(start);
+  const auto end   = line.find(' ');
+  const auto field = line.substr(0, end);
+  line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+  return field;
+}
+
+inline auto parse_segment(std::string_view line, SeekSegment& segment) -> bool
+{
+  if (!parse_u64(next_field(line), segment.start) ||
+      !parse_u64(next_field(line), segment.duration) || !parse_u64(next_field(line), segment.end))
+    return false;
+
+  for (auto field = next_field(line); !field.empty(); field = next_field(line))
+  {
+    const auto at = field.find('@');
+    SeekPoint  point;
+    if (at == std::string_view::npos || !parse_u64(field.substr(0, at), point.time) ||
+        !parse_u64(field.substr(at + 1), point.offset) || point.offset >= segment.end)
+      return false;
+    if (!segment.points.empty() && point.time < segment.points.back().time)
+      return false;
+    segment.points.push_back(point);
+  }
+  return true;
+}
+
+} // namespace detail
+
+inline auto format_seek_index(const SeekIndex& index) -> std::string
+{
+  static constexpr char HEX[] = "0123456789abcdef";
+
+  std::string out;
+  out += SEEK_INDEX_TAG;
+  out += std::to_string(SEEK_INDEX_VERSION);
+  out += '\n';
+  out += SEEK_TIMESCALE_TAG;
+  out += std::to_string(index.timescale);
+  out += '\n';
+
+  out += SEEK_HEADER_TAG;
+  for (const unsigned char c : index.header)
+  {
+    out += HEX[c >> 4];
+    out += HEX[c & 0xF];
+  }
+  out += '\n';
+
+  for (const auto& segment : index.segments)
+  {
+    out += std::to_string(segment.start);
+    out += ' ';
+    out += std::to_string(segment.duration);
+    out += ' ';
+    out += std::to_string(segment.end);
+    for (const auto& point : segment.points)
+    {
+      out += ' ';
+      out += std::to_string(point.time);
+      out += '@';
+      out += std::to_string(point.offset);
+    }
+    out += '\n';
+  }
+  return out;
+}
+
+// nullopt unless `body` is a complete index of a version this build reads
+inline auto parse_seek_index(std::string_view body) -> std::optional<SeekIndex>
+{
+  SeekIndex index;
+  bool      tagged = false;
+
+  while (!body.empty())
+  {
+    const auto       eol  = body.find('\n');
+    std::string_view line = body.substr(0, eol);
+    body.remove_prefix(eol == std::string_view::npos ? body.size() : eol + 1);
+    if (!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+    if (line.empty())
+      continue;
+
+    if (line.starts_with(SEEK_INDEX_TAG))
+    {
+      ui64 version = 0;
+      if (!detail::parse_u64(line.substr(SEEK_INDEX_TAG.size()), version) ||
+          version != SEEK_INDEX_VERSION)
+        return std::nullopt;
+      tagged = true;
+    }
+    else if (line.starts_with(SEEK_TIMESCALE_TAG))
+    {
+      ui64 timescale = 0;
+      if (!detail::parse_u64(line.substr(SEEK_TIMESCALE_TAG.size()), timescale) ||
+          timescale == 0 || timescale > UINT32_MAX)
+        return std::nullopt;
+      index.timescale = static_cast<ui32>(timescale);
+    }
+    else if (line.starts_with(SEEK_HEADER_TAG))
+    {
+      line.remove_prefix(SEEK_HEADER_TAG.size());
+      if (line.size() % 2 != 0)
+        return std::nullopt;
+      index.header.clear();
+      index.header.reserve(line.size() / 2);
+      for (std::size_t i = 0; i < line.size(); i += 2)
+      {
+        const int hi = detail::hex_value(line[i]), lo = detail::hex_value(line[i + 1]);
+        if (hi < 0 || lo < 0)
+          return std::nullopt;
+        index.header += static_cast<char>((hi << 4) | lo);
+      }
+    }
+    else if (line.front() == '#')
+    {
+      continue; // tags from later versions
+    }
+    else
+    {
+      SeekSegment segment;
+      if (!tagged || !detail::parse_segment(line, segment))
+        return std::nullopt;
+      index.segments.push_back(std::move(segment));
+    }
+  }
+
+  if (!tagged || index.timescale == 0)
+    return std::nullopt;
+  return index;
+}
+
+} // namespace libwavy::hls::parser
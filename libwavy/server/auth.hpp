@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <libwavy/common/macros.hpp>
@@ -7,6 +9,8 @@
 #include <libwavy/log-macros.hpp>
 #include <openssl/evp.h>
 #include <optional>
+#include <thread>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -66,6 +70,132 @@ static auto compute_sha256_hex(const std::string& file_path) -> std::optional<st
   return oss.str();
 }
 
+// Same as above for bytes that are already in memory (e.g. files validated at ingest)
+static auto compute_sha256_hex(const void* data, std::size_t len) -> std::optional<std::string>
+{
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int  digest_len = 0;
+  if (EVP_Digest(data, len, digest, &digest_len, EVP_sha256(), nullptr) != 1)
+    return std::nullopt;
+
+  std::ostringstream oss;
+  for (unsigned int i = 0; i < digest_len; ++i)
+  {
+    oss << std::hex << std::setw(2) << std::setfill('0') << (int)digest[i];
+  }
+  return oss.str();
+}
+
+// Incremental SHA-256 for data that only passes by once (archive entries while they are
+// extracted, request bodies while they are read).
+class Sha256Stream
+{
+public:
+  Sha256Stream() : m_ctx(EVP_MD_CTX_new())
+  {
+    m_ok = m_ctx && EVP_DigestInit_ex(m_ctx, EVP_sha256(), nullptr) == 1;
+  }
+
+  Sha256Stream(const Sha256Stream&)                    = delete;
+  auto operator=(const Sha256Stream&) -> Sha256Stream& = delete;
+
+  ~Sha256Stream()
+  {
+    if (m_ctx)
+      EVP_MD_CTX_free(m_ctx);
+  }
+
+  void update(const void* data, std::size_t len)
+  {
+    if (m_ok && len > 0)
+      m_ok = EVP_DigestUpdate(m_ctx, data, len) == 1;
+  }
+
+  /// Hex digest, or std::nullopt if any step failed. The stream cannot be reused after.
+  auto final_hex() -> std::optional<std::string>
+  {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int  digest_len = 0;
+    if (!m_ok || EVP_DigestFinal_ex(m_ctx, digest, &digest_len) != 1)
+      return std::nullopt;
+    m_ok = false;
+
+    std::ostringstream oss;
+    for (unsigned int i = 0; i < digest_len; ++i)
+    {
+      oss << std::hex << std::setw(2) << std::setfill('0') << (int)digest[i];
+    }
+    return oss.str();
+  }
+
+private:
+  EVP_MD_CTX* m_ctx;
+  bool        m_ok = false;
+};
+
+// Tree SHA-256 ("sha256-tree"), for large lossless uploads where a single sequential
+// digest is the slow part of ingest:
+//
+//   leaf_i = SHA256(0x00 || chunk_i)          chunk_i = bytes [i * chunk_size, ...)
+//   root   = SHA256(0x01 || leaf_0 || leaf_1 || ...)
+//
+// Leaves are hashed on up to `threads` threads. The prefixes keep leaf and root
+// digests from ever colliding. The result is NOT the plain SHA-256 of the data.
+static auto compute_tree_sha256_hex(const void* data, std::size_t len,
+                                    std::size_t chunk_size = 1024 * 1024,
+                                    std::size_t threads    = std::thread::hardware_concurrency())
+  -> std::optional<std::string>
+{
+  const auto*       bytes  = static_cast<const unsigned char*>(data);
+  const std::size_t leaves = len == 0 ? 1 : (len + chunk_size - 1) / chunk_size;
+
+  std::vector<unsigned char> digests(leaves * 32);
+  std::atomic<std::size_t>   next{0};
+  std::atomic<bool>          failed{false};
+
+  auto worker = [&]
+  {
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx)
+    {
+      failed = true;
+      return;
+    }
+
+    const unsigned char leaf_prefix = 0x00;
+    for (std::size_t i = next++; i < leaves; i = next++)
+    {
+      const std::size_t offset = i * chunk_size;
+      const std::size_t n      = std::min(chunk_size, len - std::min(len, offset));
+      unsigned int      out    = 0;
+
+      if (EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1 ||
+          EVP_DigestUpdate(ctx, &leaf_prefix, 1) != 1 ||
+          EVP_DigestUpdate(ctx, bytes + offset, n) != 1 ||
+          EVP_DigestFinal_ex(ctx, digests.data() + i * 32, &out) != 1)
+        failed = true;
+    }
+    EVP_MD_CTX_free(ctx);
+  };
+
+  const std::size_t        thread_count = std::clamp<std::size_t>(threads, 1, leaves);
+  std::vector<std::thread> pool;
+  for (std::size_t t = 1; t < thread_count; ++t)
+    pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool)
+    t.join();
+
+  if (failed)
+    return std::nullopt;
+
+  Sha256Stream        root;
+  const unsigned char root_prefix = 0x01;
+  root.update(&root_prefix, 1);
+  root.update(digests.data(), digests.size());
+  return root.final_hex();
+}
+
 // helper: persist key to keystore
 static auto persist_key(const StorageAudioID& audio_id, const std::string& key) -> bool
 {
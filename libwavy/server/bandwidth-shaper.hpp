@@ -0,0 +1,521 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * @BANDWIDTH SHAPER
+ *
+ * Egress budgets for the file routes (/download, /stream, /bundle), checked before a
+ * response body is handed to Crow:
+ *
+ * -> One token bucket per client address, one per owner (bytes of that owner's tracks)
+ *    and a global one. Each refills at its rate and saves up at most
+ *    WAVY_SERVER_SHAPING_BURST_MS of idle time, so a listener fetching a segment every
+ *    few seconds never waits; a prefetcher pulling a lossless track does.
+ * -> Client buckets are per address, not per connection: Crow does not tell a handler
+ *    which connection a request came in on. Everyone behind one NAT (or every
+ *    connection of a load generator on 127.0.0.1) shares one budget, which is why all
+ *    buckets default to off and are meant to be sized for the deployment.
+ * -> A response over budget is held until its bytes are paid for. When that would take
+ *    longer than WAVY_SERVER_SHAPING_MAX_WAIT_MS, or half the Crow workers are already
+ *    holding responses, it is refused with Retry-After instead (429 when it is the
+ *    client's own budget, 503 otherwise), so held responses never starve other clients
+ *    of workers.
+ * -> While the global bucket is short, held responses are granted in deficit round
+ *    robin order across clients: a client's large bundles cannot push other clients'
+ *    segments to the back of the line.
+ *
+ * Crow builds the whole body before writing it, so shaping delays the start of a
+ * response rather than pacing its bytes. A held response sleeps on its Crow worker for up
+ * to WAVY_SERVER_SHAPING_MAX_WAIT_MS, hence that bound and the cap on held responses.
+ * Every bucket is one atomic (GCRA), so an admission within budget costs three
+ * compare-exchanges and two shared-lock lookups; the fair queue's mutex is only taken
+ * while the global bucket is short.
+ *
+ */
+
+namespace libwavy::server
+{
+
+using ShapingClock = std::chrono::steady_clock;
+
+inline auto shaping_now() -> i64
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           ShapingClock::now().time_since_epoch())
+    .count();
+}
+
+// Token bucket kept as GCRA: `m_paidUntil` is the time (ns) by which every byte reserved
+// so far has been paid for at the bucket's rate. A reservation cannot start earlier than
+// `now - burst`, which caps the credit an idle bucket saves up. A reservation larger than
+// the whole burst goes out as soon as the bucket is full and leaves the bucket in debt.
+class TokenBucket
+{
+public:
+  TokenBucket(ui64 bytes_per_sec, i64 burst_ns) : m_rate(bytes_per_sec), m_burst(burst_ns) {}
+
+  TokenBucket(const TokenBucket&)                    = delete;
+  auto operator=(const TokenBucket&) -> TokenBucket& = delete;
+
+  [[nodiscard]] auto unlimited() const -> bool { return m_rate == 0; }
+
+  /// Reserves `bytes` and returns how long (ns) the caller has to wait before sending
+  /// them, or std::nullopt, with nothing reserved, if that is longer than `max_wait`.
+  auto reserve(ui64 bytes, i64 now, i64 max_wait) -> std::optional<i64>
+  {
+    if (unlimited())
+      return 0;
+
+    const i64 cost = cost_of(bytes);
+    i64       paid = m_paidUntil.load(std::memory_order_relaxed);
+    while (true)
+    {
+      const i64 start = std::max(paid, now - m_burst);
+      const i64 wait  = waitFrom(start, cost, now);
+      if (wait > max_wait)
+        return std::nullopt;
+      if (m_paidUntil.compare_exchange_weak(paid, start + cost, std::memory_order_relaxed))
+        return wait;
+    }
+  }
+
+  /// How long until `bytes` could be reserved without waiting
+  [[nodiscard]] auto wait_for(ui64 bytes, i64 now) const -> i64
+  {
+    if (unlimited())
+      return 0;
+    const i64 start = std::max(m_paidUntil.load(std::memory_order_relaxed), now - m_burst);
+    return waitFrom(start, cost_of(bytes), now);
+  }
+
+  /// Gives back a reservation whose response is not going to be sent
+  void refund(ui64 bytes)
+  {
+    if (!unlimited())
+      m_paidUntil.fetch_sub(cost_of(bytes), std::memory_order_relaxed);
+  }
+
+  /// Idle long enough to be full again, i.e. no different from a fresh bucket
+  [[nodiscard]] auto idle(i64 now) const -> bool
+  {
+    return m_paidUntil.load(std::memory_order_relaxed) <= now - m_burst;
+  }
+
+private:
+  ui64             m_rate; // bytes per second, 0: unlimited
+  i64              m_burst;
+  std::atomic<i64> m_paidUntil{0};
+
+  [[nodiscard]] auto cost_of(ui64 bytes) const -> i64
+  {
+    return static_cast<i64>(static_cast<long double>(bytes) * 1'000'000'000.0L / m_rate);
+  }
+
+  [[nodiscard]] auto waitFrom(i64 start, i64 cost, i64 now) const -> i64
+  {
+    return std::max<i64>(start + std::min(cost, m_burst) - now, 0);
+  }
+};
+
+// Buckets by key (client address, owner), created on first use. Once a shard holds its
+// share of `max_keys`, idle buckets are dropped: a full bucket is the same as a new one.
+class BucketTable
+{
+public:
+  BucketTable(ui64 bytes_per_sec, i64 burst_ns, std::size_t max_keys,
+              std::size_t shard_count = 16)
+      : m_rate(bytes_per_sec), m_burst(burst_ns), m_shards(shard_count == 0 ? 1 : shard_count),
+        m_unlimited(std::make_shared<TokenBucket>(0, burst_ns))
+  {
+    m_maxPerShard = std::max<std::size_t>(1, max_keys / m_shards.size());
+  }
+
+  /// Bucket of `key`; one shared unlimited bucket when the table has no rate
+  auto get(const std::string& key, i64 now) -> std::shared_ptr<TokenBucket>
+  {
+    if (m_rate == 0)
+      return m_unlimited;
+
+    auto& shard = m_shards[std::hash<std::string>{}(key) % m_shards.size()];
+    {
+      std::shared_lock lock(shard.mutex);
+      if (auto it = shard.buckets.find(key); it != shard.buckets.end())
+        return it->second;
+    }
+
+    std::unique_lock lock(shard.mutex);
+    if (auto it = shard.buckets.find(key); it != shard.buckets.end())
+      return it->second;
+
+    if (shard.buckets.size() >= m_maxPerShard)
+      std::erase_if(shard.buckets, [now](const auto& kv) { return kv.second->idle(now); });
+
+    auto bucket = std::make_shared<TokenBucket>(m_rate, m_burst);
+    shard.buckets.emplace(key, bucket);
+    return bucket;
+  }
+
+private:
+  struct Shard
+  {
+    std::shared_mutex                                             mutex;
+    std::unordered_map<std::string, std::shared_ptr<TokenBucket>> buckets;
+  };
+
+  ui64                         m_rate;
+  i64                          m_burst;
+  std::vector<Shard>           m_shards;
+  std::shared_ptr<TokenBucket> m_unlimited;
+  std::size_t                  m_maxPerShard = 1;
+};
+
+// Deficit round robin over the clients waiting for the global bucket. A client's oldest
+// held response is granted once its deficit covers it and the bucket has the tokens;
+// a client short of deficit gets another QUANTUM bytes and goes to the back.
+//
+// As in fq_codel, a client that was not queued starts in a separate "new" round that is
+// served first, so a listener asking for one segment waits for the tokens only, not
+// behind every prefetcher's turn. A client leaves the new round once served and has to
+// drain the old round before it can be new again.
+//
+// There is no scheduler thread: held requests run the round themselves when they wake.
+class FairQueue
+{
+public:
+  static constexpr ui64 QUANTUM   = 256 * 1024;
+  static constexpr i64  MIN_SLEEP = 200'000; // ns
+
+  explicit FairQueue(TokenBucket& bucket) : m_bucket(bucket) {}
+
+  /// Reserves `bytes` from the bucket only if nobody is queued and it needs no wait
+  auto try_acquire(ui64 bytes, i64 now) -> bool
+  {
+    return m_bucket.unlimited() || (m_waiting.load(std::memory_order_acquire) == 0 &&
+                                    m_bucket.reserve(bytes, now, 0).has_value());
+  }
+
+  /// Reserves `bytes` in fair order; false if it was not granted by `deadline`
+  auto acquire(const std::string& flow, ui64 bytes, i64 deadline) -> bool
+  {
+    if (try_acquire(bytes, shaping_now()))
+      return true;
+
+    std::unique_lock lock(m_mutex);
+    Waiter           waiter{bytes};
+    enqueue(flow, waiter);
+
+    while (true)
+    {
+      const i64 now = shaping_now();
+      pump(now);
+      if (waiter.granted)
+        return true;
+
+      if (now >= deadline)
+      {
+        dequeue(flow, waiter);
+        return false;
+      }
+
+      const i64 wake = std::min(deadline, now + std::max(nextGrantIn(now), MIN_SLEEP));
+      m_cv.wait_until(lock, ShapingClock::time_point(std::chrono::nanoseconds(wake)));
+    }
+  }
+
+  [[nodiscard]] auto waiting() const -> ui64 { return m_waiting.load(std::memory_order_relaxed); }
+
+private:
+  struct Waiter
+  {
+    ui64 bytes;
+    bool granted = false;
+  };
+
+  struct Flow
+  {
+    std::string         key;
+    ui64                deficit = 0;
+    std::deque<Waiter*> waiters;
+  };
+
+  using FlowList = std::list<Flow>;
+
+  struct FlowRef
+  {
+    FlowList*          list;
+    FlowList::iterator it;
+  };
+
+  TokenBucket&                             m_bucket;
+  std::mutex                               m_mutex;
+  std::condition_variable                  m_cv;
+  FlowList                                 m_new; // clients that just started waiting
+  FlowList                                 m_old; // everyone else, round robin order
+  std::unordered_map<std::string, FlowRef> m_flows;
+  std::atomic<ui64>                        m_waiting{0};
+
+  void enqueue(const std::string& key, Waiter& waiter)
+  {
+    auto it = m_flows.find(key);
+    if (it == m_flows.end())
+    {
+      m_new.push_back(Flow{.key = key, .deficit = QUANTUM});
+      it = m_flows.emplace(key, FlowRef{&m_new, std::prev(m_new.end())}).first;
+    }
+    it->second.it->waiters.push_back(&waiter);
+    m_waiting.fetch_add(1, std::memory_order_release);
+  }
+
+  void dequeue(const std::string& key, Waiter& waiter)
+  {
+    auto& waiters = m_flows.at(key).it->waiters;
+    waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+    released();
+    m_cv.notify_all(); // the head of the round may have changed
+  }
+
+  // Emptied flows stay put (a client cannot re-enter the new round by going idle for a
+  // moment); the whole state is dropped once nobody waits.
+  void released()
+  {
+    if (m_waiting.fetch_sub(1, std::memory_order_release) != 1)
+      return;
+    m_new.clear();
+    m_old.clear();
+    m_flows.clear();
+  }
+
+  void moveToOld(FlowList& from)
+  {
+    auto& ref = m_flows.at(from.front().key);
+    m_old.splice(m_old.end(), from, from.begin());
+    ref = {&m_old, std::prev(m_old.end())};
+  }
+
+  void pump(i64 now)
+  {
+    bool granted = false;
+    while (!m_new.empty() || !m_old.empty())
+    {
+      const bool is_new = !m_new.empty();
+      FlowList&  round  = is_new ? m_new : m_old;
+      Flow&      flow   = round.front();
+
+      if (flow.waiters.empty())
+      {
+        if (is_new)
+          moveToOld(round);
+        else
+        {
+          m_flows.erase(flow.key);
+          round.pop_front();
+        }
+        continue;
+      }
+
+      Waiter* head = flow.waiters.front();
+      if (flow.deficit < head->bytes)
+      {
+        flow.deficit += QUANTUM;
+        moveToOld(round);
+        continue;
+      }
+
+      if (!m_bucket.reserve(head->bytes, now, 0))
+        break; // the flow keeps its turn until the tokens are there
+
+      flow.deficit -= head->bytes;
+      head->granted = true;
+      flow.waiters.pop_front();
+      granted = true;
+      released();
+    }
+
+    if (granted)
+      m_cv.notify_all();
+  }
+
+  [[nodiscard]] auto nextGrantIn(i64 now) const -> i64
+  {
+    for (const FlowList* round : {&m_new, &m_old})
+      for (const auto& flow : *round)
+        if (!flow.waiters.empty())
+          return m_bucket.wait_for(flow.waiters.front()->bytes, now);
+    return 0;
+  }
+};
+
+struct ShapingStats
+{
+  std::atomic<ui64> admitted{0}; // responses let through
+  std::atomic<ui64> delayed{0};  // ... of which were held back first
+  std::atomic<ui64> rejected{0}; // refused with 429/503
+  std::atomic<ui64> wait_us{0};  // total time responses were held back
+};
+
+enum class Admission
+{
+  Admitted,
+  ClientLimited, // over the client's own budget (429)
+  Saturated      // owner or global budget, or too many held responses (503)
+};
+
+struct AdmitResult
+{
+  Admission            outcome = Admission::Admitted;
+  std::chrono::seconds retry_after{0};
+};
+
+class BandwidthShaper
+{
+public:
+  static constexpr ui64        MIB      = 1024 * 1024;
+  static constexpr std::size_t MAX_KEYS = 65536; // per table, before idle buckets go
+
+  BandwidthShaper(ui64 client_rate = WAVY_SERVER_CLIENT_RATE_LIMIT * MIB,
+                  ui64 owner_rate  = WAVY_SERVER_OWNER_RATE_LIMIT * MIB,
+                  ui64 global_rate = WAVY_SERVER_EGRESS_LIMIT * MIB,
+                  std::chrono::milliseconds burst =
+                    std::chrono::milliseconds(WAVY_SERVER_SHAPING_BURST_MS),
+                  std::chrono::milliseconds max_wait =
+                    std::chrono::milliseconds(WAVY_SERVER_SHAPING_MAX_WAIT_MS),
+                  ui32 max_held = default_max_held())
+      : m_clients(client_rate, to_ns(burst), MAX_KEYS),
+        m_owners(owner_rate, to_ns(burst), MAX_KEYS), m_global(global_rate, to_ns(burst)),
+        m_fair(m_global), m_maxWait(to_ns(max_wait)),
+        m_maxHeld(std::max<ui32>(1, max_held)),
+        m_enabled(client_rate > 0 || owner_rate > 0 || global_rate > 0)
+  {
+  }
+
+  BandwidthShaper(const BandwidthShaper&)                    = delete;
+  auto operator=(const BandwidthShaper&) -> BandwidthShaper& = delete;
+
+  /// Half of Crow's workers (one per hardware thread) may hold a response
+  static auto default_max_held() -> ui32 { return std::thread::hardware_concurrency() / 2; }
+
+  [[nodiscard]] auto enabled() const -> bool { return m_enabled; }
+  [[nodiscard]] auto stats() const -> const ShapingStats& { return m_stats; }
+  [[nodiscard]] auto queued() const -> ui64 { return m_fair.waiting(); }
+
+  /// Returns once `bytes` for `client` (from `owner`'s tracks) may be sent, or with the
+  /// reason they may not.
+  auto admit(const std::string& client, const StorageOwnerID& owner, ui64 bytes) -> AdmitResult
+  {
+    if (!m_enabled || bytes == 0)
+      return {};
+
+    const i64 start    = shaping_now();
+    const i64 deadline = start + m_maxWait;
+
+    auto       client_bucket = m_clients.get(client, start);
+    const auto client_wait   = client_bucket->reserve(bytes, start, m_maxWait);
+    if (!client_wait)
+      return reject(Admission::ClientLimited, client_bucket->wait_for(bytes, start));
+
+    auto       owner_bucket = m_owners.get(owner, start);
+    const auto owner_wait   = owner_bucket->reserve(bytes, start, m_maxWait);
+    if (!owner_wait)
+    {
+      client_bucket->refund(bytes);
+      return reject(Admission::Saturated, owner_bucket->wait_for(bytes, start));
+    }
+
+    const i64 wait = std::max(*client_wait, *owner_wait);
+    if (wait == 0 && m_fair.try_acquire(bytes, start))
+    {
+      m_stats.admitted++;
+      return {};
+    }
+
+    // Held from here on: bounded so refused clients cannot tie up every worker
+    if (m_held.fetch_add(1, std::memory_order_relaxed) >= m_maxHeld)
+    {
+      m_held.fetch_sub(1, std::memory_order_relaxed);
+      client_bucket->refund(bytes);
+      owner_bucket->refund(bytes);
+      return reject(Admission::Saturated, wait);
+    }
+
+    if (wait > 0)
+      std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+    const bool granted = m_fair.acquire(client, bytes, deadline);
+    m_held.fetch_sub(1, std::memory_order_relaxed);
+
+    if (!granted)
+    {
+      client_bucket->refund(bytes);
+      owner_bucket->refund(bytes);
+      return reject(Admission::Saturated, m_global.wait_for(bytes, shaping_now()));
+    }
+
+    m_stats.admitted++;
+    m_stats.delayed++;
+    m_stats.wait_us += static_cast<ui64>((shaping_now() - start) / 1000);
+    return {};
+  }
+
+private:
+  BucketTable       m_clients;
+  BucketTable       m_owners;
+  TokenBucket       m_global;
+  FairQueue         m_fair;
+  i64               m_maxWait;
+  ui32              m_maxHeld;
+  bool              m_enabled;
+  std::atomic<ui32> m_held{0};
+  ShapingStats      m_stats;
+
+  static auto to_ns(std::chrono::milliseconds ms) -> i64
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(ms).count();
+  }
+
+  auto reject(Admission outcome, i64 wait_ns) -> AdmitResult
+  {
+    m_stats.rejected++;
+    const auto secs = std::max<i64>(1, (wait_ns + 999'999'999) / 1'000'000'000);
+    return {.outcome = outcome, .retry_after = std::chrono::seconds(secs)};
+  }
+};
+
+} // namespace libwavy::server
@@ -0,0 +1,659 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <archive.h>
+#include <archive_entry.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <libwavy/common/content-encoding.hpp>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/parser/seek-index.hpp>
+#include <libwavy/server/auth.hpp>
+#include <libwavy/utils/io/async/entry.hpp>
+#include <libwavy/utils/math/entry.hpp>
+#include <libwavy/zstd/stream.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * @EXTRACT PIPELINE
+ *
+ * Turns an uploaded `.tar.gz` (already in memory) into the final files of a track in a
+ * staging directory, in a single pass:
+ *
+ *   archive reader (1 thread)  ->  per-entry chunk queues  ->  entry workers (N threads)
+ *                                                              zstd -> validate -> sha256 -> write
+ *
+ * -> The gzip/tar stream is inherently sequential, so one thread walks it and copies each
+ *    block into a buffer from a fixed pool. Everything after that (zstd decoding, format
+ *    validation, hashing, the write) runs per entry on a worker, so entries overlap.
+ * -> The pool bounds memory: when workers fall behind the reader blocks on `acquire()`.
+ * -> Entries only ever wait for their own data, and the reader finishes an entry before
+ *    starting the next, so a worker that holds an entry can always run it to completion.
+ * -> Every decoded byte is written exactly once and never read back; validation and the
+ *    manifest hash see it on the way to the file. The raw payload can be tapped the same
+ *    way (`PayloadObserver`) as libarchive pulls it in.
+ * -> Files are written behind the workers through the server's async file backend
+ *    (utils/io/async): a worker decodes its next chunk while the previous ones are on
+ *    their way to disk.
+ *
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server::ingest
+{
+
+enum class EntryKind
+{
+  Playlist,
+  TransportStream,
+  Fragment,
+  Mp4,
+  Metadata,
+  SeekIndex,
+  Unknown
+};
+
+inline auto classify(const FileName& filename) -> EntryKind
+{
+  if (filename.ends_with(macros::PLAYLIST_EXT))
+    return EntryKind::Playlist;
+  if (filename.ends_with(macros::TRANSPORT_STREAM_EXT))
+    return EntryKind::TransportStream;
+  if (filename.ends_with(macros::M4S_FILE_EXT))
+    return EntryKind::Fragment;
+  if (filename.ends_with(macros::MP4_FILE_EXT))
+    return EntryKind::Mp4;
+  if (filename.ends_with(macros::TOML_FILE_EXT))
+    return EntryKind::Metadata;
+  if (filename.ends_with(macros::SEEK_INDEX_EXT))
+    return EntryKind::SeekIndex;
+  return EntryKind::Unknown;
+}
+
+/// The checks extract_and_validate() used to run on fully re-read files, done on the fly.
+class StreamValidator
+{
+public:
+  explicit StreamValidator(EntryKind kind) : m_kind(kind) {}
+
+  void feed(const char* data, std::size_t len)
+  {
+    if (len == 0)
+      return;
+
+    switch (m_kind)
+    {
+      case EntryKind::TransportStream:
+        if (m_seen == 0)
+          m_valid = static_cast<ui8>(data[0]) == TRANSPORT_STREAM_START_BYTE;
+        break;
+
+      case EntryKind::Playlist:
+        if (!m_valid)
+          search_header(std::string_view(data, len));
+        break;
+
+      case EntryKind::SeekIndex:
+        // Small enough to keep whole and parse once it is complete
+        if (!m_oversized && m_body.size() + len <= MAX_SEEK_INDEX_SIZE)
+          m_body.append(data, len);
+        else
+          m_oversized = true;
+        break;
+
+      default:
+        break;
+    }
+    m_seen += len;
+  }
+
+  [[nodiscard]] auto ok() const -> bool
+  {
+    switch (m_kind)
+    {
+      case EntryKind::Playlist:
+      case EntryKind::TransportStream:
+        return m_valid;
+      case EntryKind::SeekIndex:
+        return !m_oversized && hls::parser::parse_seek_index(m_body).has_value();
+      default:
+        return true;
+    }
+  }
+
+  [[nodiscard]] auto reason() const -> const char*
+  {
+    switch (m_kind)
+    {
+      case EntryKind::Playlist:
+        return "invalid M3U8 file";
+      case EntryKind::TransportStream:
+        return "invalid TS file";
+      case EntryKind::SeekIndex:
+        return "invalid seek index";
+      default:
+        return "invalid file";
+    }
+  }
+
+private:
+  static constexpr std::size_t MAX_SEEK_INDEX_SIZE = 4 * 1024 * 1024;
+
+  EntryKind   m_kind;
+  bool        m_valid     = false;
+  bool        m_oversized = false;
+  std::size_t m_seen      = 0;
+  std::string m_tail; // carry-over so the header can straddle two chunks
+  std::string m_body; // whole seek index
+
+  void search_header(std::string_view chunk)
+  {
+    constexpr std::string_view header = macros::PLAYLIST_GLOBAL_HEADER;
+
+    m_tail.append(chunk.substr(0, header.size() - 1));
+    if (m_tail.find(header) != std::string::npos || chunk.find(header) != std::string_view::npos)
+    {
+      m_valid = true;
+      return;
+    }
+
+    const auto keep = std::min(chunk.size(), header.size() - 1);
+    m_tail.assign(chunk.substr(chunk.size() - keep));
+  }
+};
+
+struct ExtractedFile
+{
+  FileName    name;
+  EntryKind   kind = EntryKind::Unknown;
+  std::string sha256;
+  ui64        size = 0;
+};
+
+struct RejectedFile
+{
+  FileName    name;
+  std::string reason;
+};
+
+struct ExtractResult
+{
+  StorageOwnerID             owner;
+  std::vector<ExtractedFile> files; // written to the staging directory, archive order
+  std::vector<RejectedFile>  rejected;
+  std::string                error; // set when the archive itself could not be read
+};
+
+/// Sees every byte of the payload exactly once, in order, as libarchive consumes it
+/// (used to derive the upload key without a separate pass over the body).
+using PayloadObserver = std::function<void(const char* data, std::size_t len)>;
+
+class BufferPool
+{
+public:
+  BufferPool(std::size_t count, std::size_t size) : m_size(size)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+      m_free.emplace_back(size);
+  }
+
+  [[nodiscard]] auto buffer_size() const -> std::size_t { return m_size; }
+
+  auto acquire() -> std::vector<char>
+  {
+    std::unique_lock lock(m_mutex);
+    m_cv.wait(lock, [this] { return !m_free.empty(); });
+    auto buf = std::move(m_free.back());
+    m_free.pop_back();
+    return buf;
+  }
+
+  void release(std::vector<char>&& buf)
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      m_free.push_back(std::move(buf));
+    }
+    m_cv.notify_one();
+  }
+
+private:
+  std::size_t                    m_size;
+  std::mutex                     m_mutex;
+  std::condition_variable        m_cv;
+  std::vector<std::vector<char>> m_free;
+};
+
+class ExtractPipeline
+{
+public:
+  static constexpr std::size_t CHUNK_SIZE        = 128 * 1024;
+  static constexpr std::size_t CHUNKS_PER_WORKER = 4;
+
+  explicit ExtractPipeline(utils::aio::FileIO& io, std::size_t workers = default_workers())
+      : m_io(io), m_workerCount(workers == 0 ? 1 : workers),
+        m_pool(m_workerCount * CHUNKS_PER_WORKER, CHUNK_SIZE)
+  {
+  }
+
+  static auto default_workers() -> std::size_t
+  {
+    const std::size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    return std::min<std::size_t>(hw, WAVY_SERVER_EXTRACT_WORKERS);
+  }
+
+  /// Extracts `payload` into `staging_dir`. Returns false if the archive could not be
+  /// read to the end; individual bad entries only end up in `out.rejected`.
+  auto run(std::string_view payload, const fs::path& staging_dir, ExtractResult& out,
+           const PayloadObserver& on_payload = {}) -> bool
+  {
+    struct archive*       a = archive_read_new();
+    struct archive_entry* entry;
+
+    archive_read_support_filter_gzip(a);
+    archive_read_support_format_tar(a);
+
+    MemorySource source{payload, 0, on_payload};
+    if (archive_read_open(a, &source, nullptr, &MemorySource::read, nullptr) != ARCHIVE_OK)
+    {
+      out.error = archive_error_string(a) ? archive_error_string(a) : "failed to open archive";
+      archive_read_free(a);
+      return false;
+    }
+
+    m_decoded = 0;
+    start_workers();
+
+    const std::string zst_suffix = "." + macros::to_string(macros::ZSTD_FILE_EXT);
+
+    std::vector<std::shared_ptr<Job>> jobs;
+    std::unordered_set<FileName>      seen;
+    bool                              ok = true;
+    int                               rc;
+
+    while ((rc = archive_read_next_header(a, &entry)) == ARCHIVE_OK)
+    {
+      if (archive_entry_filetype(entry) != AE_IFREG)
+        continue;
+
+      // Payloads are flat, never let an entry name escape the staging directory
+      FileName name = fs::path(archive_entry_pathname(entry)).filename().string();
+      if (name.empty() || name == "." || name == "..")
+        continue;
+
+      if (name.ends_with(macros::OWNER_FILE_EXT))
+      {
+        out.owner = name;
+        archive_read_data_skip(a);
+        continue;
+      }
+
+      const bool compressed = name.ends_with(zst_suffix);
+      if (compressed)
+        name.resize(name.size() - zst_suffix.size());
+
+      const EntryKind kind = classify(name);
+      if (kind == EntryKind::Unknown || !seen.insert(name).second)
+      {
+        out.rejected.push_back({name, kind == EntryKind::Unknown ? "unknown file" : "duplicate"});
+        archive_read_data_skip(a);
+        continue;
+      }
+
+      auto job        = std::make_shared<Job>();
+      job->name       = name;
+      job->kind       = kind;
+      job->compressed = compressed;
+      job->path       = staging_dir / name;
+      jobs.push_back(job);
+      submit(job);
+
+      if (!feed_entry(a, *job))
+      {
+        out.error = archive_error_string(a) ? archive_error_string(a) : "truncated archive";
+        ok        = false;
+        break;
+      }
+    }
+
+    if (ok && rc != ARCHIVE_EOF)
+    {
+      out.error = archive_error_string(a) ? archive_error_string(a) : "corrupt archive";
+      ok        = false;
+    }
+
+    stop_workers();
+    archive_read_free(a);
+
+    // libarchive stops at the tar end marker and may leave gzip padding unread
+    if (ok)
+      source.drain();
+
+    for (const auto& job : jobs)
+    {
+      if (job->ok)
+        out.files.push_back({job->name, job->kind, std::move(job->sha256), job->size});
+      else
+        out.rejected.push_back({job->name, job->error});
+    }
+
+    return ok;
+  }
+
+private:
+  static constexpr std::size_t READ_SLICE = 1024 * 1024;
+
+  // Same as archive_read_open_memory(), plus the observer tap
+  struct MemorySource
+  {
+    std::string_view       data;
+    std::size_t            pos;
+    const PayloadObserver& observer;
+
+    static auto read(struct archive*, void* user, const void** buf) -> la_ssize_t
+    {
+      auto*             src = static_cast<MemorySource*>(user);
+      const std::size_t n   = std::min(READ_SLICE, src->data.size() - src->pos);
+
+      *buf = src->data.data() + src->pos;
+      if (n > 0 && src->observer)
+        src->observer(src->data.data() + src->pos, n);
+      src->pos += n;
+      return static_cast<la_ssize_t>(n);
+    }
+
+    void drain()
+    {
+      if (pos < data.size() && observer)
+        observer(data.data() + pos, data.size() - pos);
+      pos = data.size();
+    }
+  };
+
+  struct Chunk
+  {
+    std::vector<char> buf;
+    std::size_t       len;
+  };
+
+  struct Job
+  {
+    FileName  name;
+    EntryKind kind       = EntryKind::Unknown;
+    bool      compressed = false;
+    fs::path  path;
+
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::deque<Chunk>       chunks;
+    bool                    end     = false; // reader is done with this entry
+    bool                    aborted = false; // ... because the archive broke mid-entry
+
+    // Written by the worker, read after join
+    bool        ok = false;
+    std::string sha256;
+    ui64        size = 0;
+    std::string error;
+  };
+
+  utils::aio::FileIO& m_io;
+  std::size_t         m_workerCount;
+  BufferPool          m_pool;
+  std::atomic<ui64>   m_decoded{0}; // written bytes of the current run, all entries
+
+  // A small .zst can expand without bound: cap what an entry and a whole upload may
+  // write after decoding, an entry past either cap is rejected
+  const ui64 m_entryLimit  = static_cast<ui64>(WAVY_SERVER_EXTRACT_ENTRY_LIMIT) * ONE_MIB;
+  const ui64 m_uploadLimit = static_cast<ui64>(WAVY_SERVER_EXTRACT_UPLOAD_LIMIT) * ONE_MIB;
+
+  std::mutex                       m_mutex;
+  std::condition_variable          m_cv;
+  std::deque<std::shared_ptr<Job>> m_pending;
+  bool                             m_closed = false;
+  std::vector<std::thread>         m_workers;
+
+  void start_workers()
+  {
+    m_closed = false;
+    for (std::size_t i = 0; i < m_workerCount; ++i)
+      m_workers.emplace_back([this] { worker_loop(); });
+  }
+
+  void stop_workers()
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      m_closed = true;
+    }
+    m_cv.notify_all();
+    for (auto& worker : m_workers)
+      worker.join();
+    m_workers.clear();
+  }
+
+  void submit(const std::shared_ptr<Job>& job)
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      m_pending.push_back(job);
+    }
+    m_cv.notify_one();
+  }
+
+  static void push(Job& job, Chunk&& chunk)
+  {
+    {
+      std::lock_guard lock(job.mutex);
+      job.chunks.push_back(std::move(chunk));
+    }
+    job.cv.notify_one();
+  }
+
+  static void finish(Job& job, bool aborted)
+  {
+    {
+      std::lock_guard lock(job.mutex);
+      job.end     = true;
+      job.aborted = aborted;
+    }
+    job.cv.notify_one();
+  }
+
+  // Copies the entry's data blocks into pool buffers and hands them to its job
+  auto feed_entry(struct archive* a, Job& job) -> bool
+  {
+    const void* block;
+    size_t      block_size;
+    la_int64_t  block_offset;
+    int         rc;
+
+    while ((rc = archive_read_data_block(a, &block, &block_size, &block_offset)) == ARCHIVE_OK)
+    {
+      const char* data = static_cast<const char*>(block);
+      while (block_size > 0)
+      {
+        Chunk chunk{m_pool.acquire(), 0};
+        chunk.len = std::min(block_size, m_pool.buffer_size());
+        std::copy_n(data, chunk.len, chunk.buf.data());
+
+        data += chunk.len;
+        block_size -= chunk.len;
+        push(job, std::move(chunk));
+      }
+    }
+
+    const bool ok = rc == ARCHIVE_EOF;
+    finish(job, !ok);
+    return ok;
+  }
+
+  void worker_loop()
+  {
+    zstd::StreamDecoder decoder; // reused for every entry this worker runs
+
+    while (true)
+    {
+      std::shared_ptr<Job> job;
+      {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_closed || !m_pending.empty(); });
+        if (m_pending.empty())
+          return;
+        job = m_pending.front();
+        m_pending.pop_front();
+      }
+      run_job(*job, decoder);
+    }
+  }
+
+  void run_job(Job& job, zstd::StreamDecoder& decoder)
+  {
+    // Write-behind: the worker decodes the next chunk while the last one is written
+    utils::aio::AsyncFileWriter ofs(m_io);
+    auth::Sha256Stream          sha;
+    StreamValidator             validator(job.kind);
+    bool                        healthy = ofs.open(job.path);
+
+    if (!healthy)
+      job.error = "cannot open staging file";
+    else if (job.compressed && !decoder.reset())
+    {
+      job.error = "cannot reset zstd stream";
+      healthy   = false;
+    }
+
+    // A text file uploaded as .zst keeps those bytes as its zstd variant (precompress.hpp)
+    fs::path                    raw_path = job.path;
+    utils::aio::AsyncFileWriter raw(m_io);
+    raw_path += encoding::file_suffix(encoding::Coding::Zstd);
+    if (healthy && job.compressed && encoding::is_precompressible(job.name))
+      raw.open(raw_path);
+
+    const char* over_limit = nullptr;
+    auto        sink       = [&](const char* data, std::size_t len) -> bool
+    {
+      job.size += len;
+      if (job.size > m_entryLimit)
+        over_limit = "entry exceeds decoded size limit";
+      else if (m_decoded.fetch_add(len, std::memory_order_relaxed) + len > m_uploadLimit)
+        over_limit = "upload exceeds decoded size limit";
+      if (over_limit)
+        return false;
+
+      validator.feed(data, len);
+      sha.update(data, len);
+      return ofs.write(data, len);
+    };
+
+    bool aborted = false;
+    while (true)
+    {
+      Chunk chunk;
+      {
+        std::unique_lock lock(job.mutex);
+        job.cv.wait(lock, [&] { return job.end || !job.chunks.empty(); });
+        if (job.chunks.empty())
+        {
+          aborted = job.aborted;
+          break;
+        }
+        chunk = std::move(job.chunks.front());
+        job.chunks.pop_front();
+      }
+
+      // Once something went wrong keep draining, the buffers must go back to the pool
+      if (healthy)
+      {
+        if (raw.is_open())
+          raw.write(chunk.buf.data(), chunk.len);
+        healthy = job.compressed ? decoder.feed(chunk.buf.data(), chunk.len, sink)
+                                 : sink(chunk.buf.data(), chunk.len);
+        if (over_limit)
+          job.error = over_limit;
+        else if (!healthy)
+          job.error = job.compressed && decoder.error() ? decoder.error() : "write failed";
+      }
+      m_pool.release(std::move(chunk.buf));
+    }
+
+    if (healthy && aborted)
+    {
+      job.error = "truncated archive entry";
+      healthy   = false;
+    }
+    if (healthy && job.compressed && !decoder.finished())
+    {
+      job.error = "truncated zstd stream";
+      healthy   = false;
+    }
+    if (healthy && !validator.ok())
+    {
+      job.error = validator.reason();
+      healthy   = false;
+    }
+
+    if (!ofs.close() && healthy)
+    {
+      job.error = "write failed";
+      healthy   = false;
+    }
+
+    if (healthy)
+    {
+      auto digest = sha.final_hex();
+      job.sha256  = digest.value_or("");
+    }
+    else
+    {
+      std::error_code ec;
+      fs::remove(job.path, ec);
+    }
+
+    if (raw.is_open())
+    {
+      const bool      raw_ok = raw.close();
+      std::error_code ec;
+      if (!healthy || !raw_ok)
+        fs::remove(raw_path, ec);
+    }
+
+    job.ok = healthy;
+  }
+};
+
+} // namespace libwavy::server::ingest
@@ -0,0 +1,187 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <atomic>
+#include <filesystem>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/server/track-generations.hpp>
+#include <libwavy/utils/io/pread/entry.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * @FILE HANDLE CACHE
+ *
+ * Sharded LRU of open read-only descriptors keyed like the segment cache
+ * ("<owner>/<audio-id>/<filename>"), for reads that bypass the segment cache: range
+ * requests and packfiles, which are usually larger than any cacheable object.
+ *
+ * -> Handles are `shared_ptr<const PositionedFile>`. Reads are pread(2), which never
+ *    moves a shared offset, so concurrent responses can use one descriptor, and an
+ *    evicted handle stays open until its last reader lets go.
+ * -> Storage is immutable apart from delete, which must call invalidate_track(): an
+ *    open descriptor would otherwise keep serving the unlinked file. A descriptor opened
+ *    just before the delete still answers its own request but is never cached.
+ *
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server
+{
+
+using FileHandle = std::shared_ptr<const utils::PositionedFile>;
+
+struct FileHandleCacheStats
+{
+  std::atomic<ui64> hits{0};
+  std::atomic<ui64> opens{0};       // misses that had to open(2)
+  std::atomic<ui64> evictions{0};
+  std::atomic<ui64> stale_opens{0}; // opened while their track was being invalidated
+  std::atomic<ui64> entries{0};
+};
+
+class FileHandleCache
+{
+public:
+  explicit FileHandleCache(std::size_t capacity    = WAVY_SERVER_FILE_HANDLE_CACHE,
+                           std::size_t shard_count = 8)
+      : m_shards(shard_count == 0 ? 1 : shard_count)
+  {
+    const std::size_t per_shard = capacity / m_shards.size();
+    for (auto& shard : m_shards)
+      shard.capacity = per_shard == 0 ? 1 : per_shard;
+  }
+
+  [[nodiscard]] auto stats() const -> const FileHandleCacheStats& { return m_stats; }
+
+  /// Open handle for a file of a track, or nullptr if it cannot be opened.
+  auto open(const StorageOwnerID& owner, const StorageAudioID& audio_id, const FileName& filename)
+    -> FileHandle
+  {
+    const std::string track = TrackGenerations::track_of(owner, audio_id);
+    const std::string key   = track + "/" + filename;
+    auto&             shard = shard_for(key);
+    const ui64        gen   = m_generations.current(track);
+
+    {
+      std::lock_guard lock(shard.mutex);
+      if (auto it = shard.index.find(key); it != shard.index.end())
+      {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        m_stats.hits++;
+        return it->second->handle;
+      }
+    }
+
+    // Opened outside the lock, a slow disk must not stall the rest of the shard
+    const fs::path path =
+      fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / owner / audio_id / filename;
+    auto file = std::make_shared<utils::PositionedFile>();
+    if (!file->open(path.string()))
+      return nullptr;
+    m_stats.opens++;
+
+    std::lock_guard lock(shard.mutex);
+    if (gen != m_generations.current(track))
+    {
+      m_stats.stale_opens++;
+      return file; // may be the unlinked file: good for this request, not for the next
+    }
+    if (auto it = shard.index.find(key); it != shard.index.end())
+      return it->second->handle; // another request opened it first
+
+    while (shard.lru.size() >= shard.capacity)
+    {
+      erase(shard, std::prev(shard.lru.end()));
+      m_stats.evictions++;
+    }
+
+    shard.lru.push_front(Entry{key, std::move(file)});
+    shard.index.emplace(key, shard.lru.begin());
+    m_stats.entries++;
+    return shard.lru.front().handle;
+  }
+
+  /// Closes (once in-flight reads finish) every handle of a track.
+  void invalidate_track(const StorageOwnerID& owner, const StorageAudioID& audio_id)
+  {
+    const std::string track  = TrackGenerations::track_of(owner, audio_id);
+    const std::string prefix = track + "/";
+
+    // Bumped before the sweep, see SegmentCache::invalidate_track()
+    m_generations.bump(track);
+
+    for (auto& shard : m_shards)
+    {
+      std::lock_guard lock(shard.mutex);
+      for (auto it = shard.lru.begin(); it != shard.lru.end();)
+      {
+        auto next = std::next(it);
+        if (it->key.starts_with(prefix))
+          erase(shard, it);
+        it = next;
+      }
+    }
+  }
+
+private:
+  struct Entry
+  {
+    std::string key;
+    FileHandle  handle;
+  };
+
+  struct Shard
+  {
+    std::mutex                                                   mutex;
+    std::list<Entry>                                             lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::size_t                                                  capacity = 1;
+  };
+
+  std::vector<Shard>   m_shards;
+  TrackGenerations     m_generations;
+  FileHandleCacheStats m_stats;
+
+  auto shard_for(const std::string& key) -> Shard&
+  {
+    return m_shards[std::hash<std::string>{}(key) % m_shards.size()];
+  }
+
+  void erase(Shard& shard, std::list<Entry>::iterator it)
+  {
+    m_stats.entries--;
+    shard.index.erase(it->key);
+    shard.lru.erase(it);
+  }
+};
+
+} // namespace libwavy::server
@@ -23,17 +23,40 @@
  *  See LICENSE file for full legal details.                                    *
  ********************************************************************************/
 
+#include <chrono>
 #include <filesystem>
 #include <libwavy/common/macros.hpp>
 #include <libwavy/common/types.hpp>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <sys/statvfs.h>
 #include <unordered_map>
 
+/*
+ * @HEALTH
+ *
+ * The checks touch the filesystem (statvfs, mkdir), so they are not run per request:
+ * the housekeeping thread calls `HealthState::refresh()` every
+ * `WAVY_SERVER_HOUSEKEEPING_INTERVAL` seconds, which renders the /health body once.
+ * The route only copies the last report out.
+ *
+ */
+
 namespace fs = std::filesystem;
 
 namespace libwavy::server
 {
 
+struct DiskStats
+{
+  ui64 capacity     = 0; // bytes
+  ui64 available    = 0; // bytes usable by the server (non-root)
+  ui64 inodes       = 0;
+  ui64 inodes_avail = 0;
+};
+
 class HealthChecker
 {
 public:
@@ -42,15 +65,24 @@ public:
     bool                                         is_healthy     = true;
     std::string                                  status_message = "OK";
     std::unordered_map<std::string, std::string> checks;
+    DiskStats                                    disk;
+    ui64                                         checked_at = 0; // unix seconds
   };
 
+  static constexpr double MIN_FREE_GB         = 1.0;
+  static constexpr double MIN_FREE_INODES_PCT = 1.0;
+
   static auto check_system_health() -> HealthStatus
   {
     HealthStatus status;
+    status.checked_at = static_cast<ui64>(std::chrono::duration_cast<std::chrono::seconds>(
+                                            std::chrono::system_clock::now().time_since_epoch())
+                                            .count());
 
     // Check storage directory
-    AbsPath storage_path = macros::to_string(macros::SERVER_STORAGE_DIR);
-    if (!fs::exists(storage_path) || !fs::is_directory(storage_path))
+    AbsPath         storage_path = macros::to_string(macros::SERVER_STORAGE_DIR);
+    std::error_code ec;
+    if (!fs::is_directory(storage_path, ec))
     {
       status.is_healthy        = false;
       status.checks["storage"] = "FAIL - Directory not accessible";
@@ -62,24 +94,34 @@ public:
 
     // Check temp directory
     AbsPath temp_path = macros::to_string(macros::SERVER_TEMP_STORAGE_DIR);
-    try
+    fs::create_directories(temp_path, ec);
+    if (ec)
     {
-      fs::create_directories(temp_path);
-      status.checks["temp_storage"] = "OK";
+      status.is_healthy             = false;
+      status.checks["temp_storage"] = "FAIL - " + ec.message();
     }
-    catch (const std::exception& e)
+    else
     {
-      status.is_healthy             = false;
-      status.checks["temp_storage"] = "FAIL - " + std::string(e.what());
+      status.checks["temp_storage"] = "OK";
     }
 
-    // Check disk space (simplified)
-    try
+    // Disk space and inodes come from one statvfs(2)
+    struct statvfs vfs{};
+    if (::statvfs(storage_path.c_str(), &vfs) != 0)
+    {
+      status.checks["disk_space"] = "UNKNOWN - statvfs failed";
+      status.checks["inodes"]     = "UNKNOWN - statvfs failed";
+    }
+    else
     {
-      auto   space   = fs::space(storage_path);
-      double free_gb = static_cast<double>(space.free) / (1024 * 1024 * 1024);
-      if (free_gb < 1.0)
-      { // Less than 1GB free
+      status.disk.capacity     = static_cast<ui64>(vfs.f_blocks) * vfs.f_frsize;
+      status.disk.available    = static_cast<ui64>(vfs.f_bavail) * vfs.f_frsize;
+      status.disk.inodes       = vfs.f_files;
+      status.disk.inodes_avail = vfs.f_favail;
+
+      double free_gb = static_cast<double>(status.disk.available) / (1024 * 1024 * 1024);
+      if (free_gb < MIN_FREE_GB)
+      {
         status.is_healthy           = false;
         status.checks["disk_space"] = "WARN - Low disk space: " + std::to_string(free_gb) + "GB";
       }
@@ -87,10 +129,26 @@ public:
       {
         status.checks["disk_space"] = "OK - " + std::to_string(free_gb) + "GB free";
       }
-    }
-    catch (const std::exception& e)
-    {
-      status.checks["disk_space"] = "UNKNOWN - " + std::string(e.what());
+
+      // Filesystems without an inode limit report 0 of them
+      if (status.disk.inodes == 0)
+      {
+        status.checks["inodes"] = "OK - not limited";
+      }
+      else
+      {
+        double free_pct = 100.0 * static_cast<double>(status.disk.inodes_avail) /
+                          static_cast<double>(status.disk.inodes);
+        if (free_pct < MIN_FREE_INODES_PCT)
+        {
+          status.is_healthy       = false;
+          status.checks["inodes"] = "WARN - Low inodes: " + std::to_string(free_pct) + "% free";
+        }
+        else
+        {
+          status.checks["inodes"] = "OK - " + std::to_string(status.disk.inodes_avail) + " free";
+        }
+      }
     }
 
     // Update overall status message
@@ -101,6 +159,71 @@ public:
 
     return status;
   }
+
+  static auto to_json(const HealthStatus& health) -> std::string
+  {
+    std::ostringstream response;
+    response << "{\n";
+    response << R"(  "status": ")" << health.status_message << "\",\n";
+    response << "  \"healthy\": " << (health.is_healthy ? "true" : "false") << ",\n";
+    response << "  \"checked_at\": " << health.checked_at << ",\n";
+    response << "  \"checks\": {\n";
+
+    bool first = true;
+    for (const auto& check : health.checks)
+    {
+      if (!first)
+        response << ",\n";
+      response << "    \"" << check.first << "\": \"" << check.second << "\"";
+      first = false;
+    }
+
+    response << "\n  }\n}";
+    return response.str();
+  }
+};
+
+struct HealthReport
+{
+  HealthChecker::HealthStatus status;
+  std::string                 body; // rendered /health response
+};
+
+/// Last health report, written by the housekeeping thread and read by /health.
+class HealthState
+{
+public:
+  HealthState() : m_report(starting()) {}
+
+  void refresh()
+  {
+    auto report    = std::make_shared<HealthReport>();
+    report->status = HealthChecker::check_system_health();
+    report->body   = HealthChecker::to_json(report->status);
+
+    std::lock_guard lock(m_mutex);
+    m_report = std::move(report);
+  }
+
+  [[nodiscard]] auto current() const -> std::shared_ptr<const HealthReport>
+  {
+    std::lock_guard lock(m_mutex);
+    return m_report;
+  }
+
+private:
+  mutable std::mutex                  m_mutex;
+  std::shared_ptr<const HealthReport> m_report;
+
+  // Served until the first refresh, which the server runs before it starts listening
+  static auto starting() -> std::shared_ptr<const HealthReport>
+  {
+    auto report                   = std::make_shared<HealthReport>();
+    report->status.is_healthy     = false;
+    report->status.status_message = "STARTING";
+    report->body                  = HealthChecker::to_json(report->status);
+    return report;
+  }
 };
 
 } // namespace libwavy::server
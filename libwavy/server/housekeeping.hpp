@@ -0,0 +1,231 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <libwavy/common/types.hpp>
+#include <libwavy/utils/sched/entry.hpp>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * @HOUSEKEEPING
+ *
+ * One low priority thread runs the periodic jobs of the server:
+ *
+ * -> refreshing the disk and inode stats behind /health (`health.hpp`);
+ * -> removing staging directories and archives that crashed uploads left in the temp
+ *    directory;
+ * -> compacting the catalog log once writes have gone quiet, instead of on the upload
+ *    or delete that crosses the threshold.
+ *
+ * Each task has its own interval, and the thread sleeps until the earliest one is due.
+ * Tasks run one after another, so a slow sweep only delays the others.
+ *
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server
+{
+
+struct HousekeepingStats
+{
+  std::atomic<ui64> temp_removed{0};
+  std::atomic<ui64> temp_bytes{0};
+  std::atomic<ui64> catalog_compactions{0};
+};
+
+struct HousekeepingTaskStats
+{
+  std::string name;
+  ui64        runs     = 0;
+  ui64        total_us = 0;
+};
+
+class Housekeeper
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  using Task  = std::function<void(const std::stop_token&)>;
+
+  Housekeeper() = default;
+
+  Housekeeper(const Housekeeper&)                    = delete;
+  auto operator=(const Housekeeper&) -> Housekeeper& = delete;
+
+  ~Housekeeper() { stop(); }
+
+  /// Tasks are registered before start(). The first run of each one is due immediately.
+  void add(std::string name, std::chrono::milliseconds every, Task task)
+  {
+    auto entry   = std::make_unique<Entry>();
+    entry->name  = std::move(name);
+    entry->every = std::max(every, std::chrono::milliseconds(1));
+    entry->task  = std::move(task);
+    entry->due   = Clock::now();
+    m_tasks.push_back(std::move(entry));
+  }
+
+  void start()
+  {
+    if (m_thread.joinable() || m_tasks.empty())
+      return;
+    m_thread = std::jthread([this](const std::stop_token& stop) { loop(stop); });
+  }
+
+  /// Waits for a running task to notice the stop token.
+  void stop()
+  {
+    if (!m_thread.joinable())
+      return;
+    m_thread.request_stop();
+    m_thread.join();
+  }
+
+  [[nodiscard]] auto stats() -> HousekeepingStats& { return m_stats; }
+  [[nodiscard]] auto stats() const -> const HousekeepingStats& { return m_stats; }
+
+  [[nodiscard]] auto task_stats() const -> std::vector<HousekeepingTaskStats>
+  {
+    std::vector<HousekeepingTaskStats> out;
+    out.reserve(m_tasks.size());
+    for (const auto& entry : m_tasks)
+      out.push_back({entry->name, entry->runs.load(), entry->total_us.load()});
+    return out;
+  }
+
+private:
+  struct Entry
+  {
+    std::string               name;
+    std::chrono::milliseconds every{};
+    Task                      task;
+    Clock::time_point         due;
+    std::atomic<ui64>         runs{0};
+    std::atomic<ui64>         total_us{0};
+  };
+
+  std::vector<std::unique_ptr<Entry>> m_tasks;
+  HousekeepingStats                   m_stats;
+  std::jthread                        m_thread; // last: joined before the tasks go away
+
+  void loop(const std::stop_token& stop)
+  {
+    utils::lower_thread_priority();
+
+    // Only the stop token ever wakes this up early
+    std::mutex                  mutex;
+    std::condition_variable_any wake;
+
+    while (!stop.stop_requested())
+    {
+      auto& next = **std::ranges::min_element(
+        m_tasks, [](const auto& a, const auto& b) { return a->due < b->due; });
+
+      {
+        std::unique_lock lock(mutex);
+        wake.wait_until(lock, stop, next.due, [] { return false; });
+      }
+      if (stop.stop_requested())
+        break;
+
+      const auto started = Clock::now();
+      next.task(stop);
+      const auto finished = Clock::now();
+
+      next.runs++;
+      next.total_us += static_cast<ui64>(
+        std::chrono::duration_cast<std::chrono::microseconds>(finished - started).count());
+      // Measured from the end of the run, so a slow task cannot queue up behind itself
+      next.due = finished + next.every;
+    }
+  }
+};
+
+struct TempSweepResult
+{
+  std::size_t removed = 0; // top-level entries deleted
+  ui64        bytes   = 0;
+};
+
+/// Deletes the entries directly under `dir` (staging directories, archives) in which
+/// nothing has been written for `max_age`. A staging directory counts as written to
+/// whenever any file below it is, so an upload that is still extracting is left alone.
+inline auto sweep_temp_dir(const fs::path& dir, std::chrono::seconds max_age,
+                           const std::stop_token& stop) -> TempSweepResult
+{
+  TempSweepResult result;
+  std::error_code ec;
+  const auto      cutoff = fs::file_time_type::clock::now() - max_age;
+
+  for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+  {
+    if (stop.stop_requested())
+      break;
+
+    std::error_code entry_ec;
+    auto            newest = fs::last_write_time(it->path(), entry_ec);
+    ui64            bytes  = 0;
+    if (entry_ec)
+      continue;
+
+    if (it->is_directory(entry_ec))
+    {
+      for (fs::recursive_directory_iterator sub(it->path(), entry_ec), sub_end;
+           !entry_ec && sub != sub_end; sub.increment(entry_ec))
+      {
+        std::error_code file_ec;
+        newest = std::max(newest, fs::last_write_time(sub->path(), file_ec));
+        if (sub->is_regular_file(file_ec))
+          bytes += sub->file_size(file_ec);
+      }
+    }
+    else
+    {
+      bytes = it->file_size(entry_ec);
+    }
+
+    if (newest > cutoff)
+      continue;
+
+    if (fs::remove_all(it->path(), entry_ec) > 0 && !entry_ec)
+    {
+      result.removed++;
+      result.bytes += bytes;
+    }
+  }
+  return result;
+}
+
+} // namespace libwavy::server
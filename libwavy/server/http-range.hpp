@@ -0,0 +1,286 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * @HTTP RANGE
+ *
+ * Parsing of `Range: bytes=...` (RFC 9110 §14) and assembly of the matching
+ * 206 / 416 bodies.
+ *
+ * -> A header we cannot parse, or with an unit other than `bytes`, is ignored and the
+ *    full representation is served (as the RFC asks).
+ * -> Satisfiable ranges are sorted and overlapping / adjacent ones coalesced, so a
+ *    client cannot make us send the same bytes twice.
+ * -> More than `WAVY_MAX_RANGES` ranges in one request is treated as abuse and ignored.
+ *
+ * Reading is left to the caller through a `read(offset, len, out)` callable that
+ * appends exactly `len` bytes to `out`, so the same code serves cached bodies and
+ * positioned reads from disk.
+ *
+ */
+
+namespace libwavy::server
+{
+
+constexpr std::size_t WAVY_MAX_RANGES = 16;
+
+struct ByteRange
+{
+  ui64 first;
+  ui64 last; // inclusive
+
+  [[nodiscard]] auto length() const -> ui64 { return last - first + 1; }
+};
+
+enum class RangeStatus
+{
+  None,         // no (usable) Range header -> 200 with the whole file
+  Satisfiable,  // 206
+  Unsatisfiable // 416
+};
+
+struct RangeRequest
+{
+  RangeStatus            status = RangeStatus::None;
+  std::vector<ByteRange> ranges;
+};
+
+namespace detail
+{
+
+inline auto trim(std::string_view s) -> std::string_view
+{
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    s.remove_suffix(1);
+  return s;
+}
+
+inline auto parse_u64(std::string_view s, ui64& out) -> bool
+{
+  if (s.empty())
+    return false;
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+  return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+} // namespace detail
+
+inline auto parse_range_header(std::string_view header, ui64 size) -> RangeRequest
+{
+  RangeRequest result;
+
+  header = detail::trim(header);
+
+  constexpr std::string_view unit = "bytes=";
+  if (header.size() <= unit.size() ||
+      !std::equal(unit.begin(), unit.end(), header.begin(),
+                  [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); }))
+    return result;
+  header.remove_prefix(unit.size());
+
+  std::vector<ByteRange> ranges;
+  std::size_t            specs = 0;
+
+  while (!header.empty())
+  {
+    const auto             comma = header.find(',');
+    const std::string_view spec  = detail::trim(header.substr(0, comma));
+    header.remove_prefix(comma == std::string_view::npos ? header.size() : comma + 1);
+
+    // RFC allows empty list elements ("bytes=0-1,,5-6")
+    if (spec.empty())
+      continue;
+
+    if (++specs > WAVY_MAX_RANGES)
+      return {};
+
+    const auto dash = spec.find('-');
+    if (dash == std::string_view::npos)
+      return {};
+
+    const std::string_view first_str = spec.substr(0, dash);
+    const std::string_view last_str  = spec.substr(dash + 1);
+
+    ui64 first = 0;
+    ui64 last  = 0;
+
+    if (first_str.empty())
+    {
+      // Suffix range: the last N bytes
+      ui64 suffix = 0;
+      if (!detail::parse_u64(last_str, suffix))
+        return {};
+      if (suffix == 0 || size == 0)
+        continue;
+      first = suffix >= size ? 0 : size - suffix;
+      last  = size - 1;
+    }
+    else
+    {
+      if (!detail::parse_u64(first_str, first))
+        return {};
+      if (last_str.empty())
+        last = size == 0 ? 0 : size - 1;
+      else
+      {
+        if (!detail::parse_u64(last_str, last) || last < first)
+          return {};
+        last = std::min(last, size == 0 ? 0 : size - 1);
+      }
+      if (first >= size)
+        continue;
+    }
+
+    ranges.push_back({first, last});
+  }
+
+  if (specs == 0)
+    return {};
+
+  if (ranges.empty())
+  {
+    result.status = RangeStatus::Unsatisfiable;
+    return result;
+  }
+
+  std::ranges::sort(ranges, {}, &ByteRange::first);
+  for (const auto& r : ranges)
+  {
+    if (!result.ranges.empty() && r.first <= result.ranges.back().last + 1)
+      result.ranges.back().last = std::max(result.ranges.back().last, r.last);
+    else
+      result.ranges.push_back(r);
+  }
+
+  result.status = RangeStatus::Satisfiable;
+  return result;
+}
+
+inline auto content_range(const ByteRange& r, ui64 size) -> std::string
+{
+  return "bytes " + std::to_string(r.first) + "-" + std::to_string(r.last) + "/" +
+         std::to_string(size);
+}
+
+inline auto unsatisfied_content_range(ui64 size) -> std::string
+{
+  return "bytes */" + std::to_string(size);
+}
+
+inline auto make_multipart_boundary() -> std::string
+{
+  thread_local std::mt19937_64 rng{std::random_device{}()};
+  constexpr char               hex[] = "0123456789abcdef";
+
+  std::string boundary = "wavy-byteranges-";
+  ui64        bits     = rng();
+  for (int i = 0; i < 16; ++i, bits >>= 4)
+    boundary += hex[bits & 0xF];
+  return boundary;
+}
+
+/// Range reader over bytes that are already in memory (cached bodies, mappings).
+inline auto memory_range_reader(std::string_view source)
+{
+  return [source](ui64 offset, ui64 len, std::string& out)
+  {
+    out.append(source.substr(offset, len));
+    return true;
+  };
+}
+
+struct RangeBody
+{
+  int         code;
+  std::string content_type;
+  std::string content_range; // empty for multipart responses
+  std::string body;
+};
+
+/// Builds the 206 / 416 response for `range` against a representation of `size` bytes.
+/// Returns std::nullopt if `read` fails.
+template <typename ReadFn>
+auto build_range_body(const RangeRequest& range, ui64 size, const std::string& content_type,
+                      ReadFn&& read) -> std::optional<RangeBody>
+{
+  RangeBody out;
+
+  if (range.status == RangeStatus::Unsatisfiable)
+  {
+    out.code          = 416;
+    out.content_type  = content_type;
+    out.content_range = unsatisfied_content_range(size);
+    return out;
+  }
+
+  out.code = 206;
+
+  if (range.ranges.size() == 1)
+  {
+    const auto& r     = range.ranges.front();
+    out.content_type  = content_type;
+    out.content_range = content_range(r, size);
+    out.body.reserve(r.length());
+    if (!read(r.first, r.length(), out.body))
+      return std::nullopt;
+    return out;
+  }
+
+  const std::string boundary = make_multipart_boundary();
+  out.content_type           = "multipart/byteranges; boundary=" + boundary;
+
+  std::size_t payload = 0;
+  for (const auto& r : range.ranges)
+    payload += r.length() + boundary.size() + content_type.size() + 96;
+  out.body.reserve(payload + boundary.size() + 8);
+
+  for (const auto& r : range.ranges)
+  {
+    out.body += "--" + boundary + CRLF;
+    out.body += "Content-Type: " + content_type + CRLF;
+    out.body += "Content-Range: " + content_range(r, size) + CRLF2;
+    if (!read(r.first, r.length(), out.body))
+      return std::nullopt;
+    out.body += CRLF;
+  }
+  out.body += "--" + boundary + "--" + CRLF;
+
+  return out;
+}
+
+} // namespace libwavy::server
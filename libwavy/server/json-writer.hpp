@@ -0,0 +1,184 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <libwavy/common/types.hpp>
+#include <string>
+#include <string_view>
+
+// Minimal streaming JSON writer.
+//
+// Appends straight into the caller's buffer (usually `crow::response::body`), so a
+// listing is escaped and written in one pass with no intermediate DOM or
+// ostringstream. The writer only tracks comma placement; it does not validate
+// that objects and arrays are closed in order.
+
+namespace libwavy::server
+{
+
+class JsonWriter
+{
+public:
+  static constexpr std::size_t MAX_DEPTH = 32;
+
+  explicit JsonWriter(std::string& out) : m_out(out) {}
+
+  auto begin_object() -> JsonWriter& { return open('{'); }
+  auto end_object() -> JsonWriter& { return close('}'); }
+  auto begin_array() -> JsonWriter& { return open('['); }
+  auto end_array() -> JsonWriter& { return close(']'); }
+
+  auto key(std::string_view k) -> JsonWriter&
+  {
+    separate();
+    write_string(k);
+    m_out += ':';
+    m_afterKey = true;
+    return *this;
+  }
+
+  auto value(std::string_view v) -> JsonWriter&
+  {
+    separate();
+    write_string(v);
+    return *this;
+  }
+
+  auto value(const char* v) -> JsonWriter& { return value(std::string_view(v)); }
+
+  auto value(i64 v) -> JsonWriter&
+  {
+    separate();
+    m_out += std::to_string(v);
+    return *this;
+  }
+
+  auto value(int v) -> JsonWriter& { return value(static_cast<i64>(v)); }
+
+  auto value(ui64 v) -> JsonWriter&
+  {
+    separate();
+    m_out += std::to_string(v);
+    return *this;
+  }
+
+  auto value(bool v) -> JsonWriter&
+  {
+    separate();
+    m_out += v ? "true" : "false";
+    return *this;
+  }
+
+  auto null() -> JsonWriter&
+  {
+    separate();
+    m_out += "null";
+    return *this;
+  }
+
+  template <typename T> auto field(std::string_view k, const T& v) -> JsonWriter&
+  {
+    key(k);
+    return value(v);
+  }
+
+private:
+  std::string&                m_out;
+  std::array<bool, MAX_DEPTH> m_hasItems{};
+  std::size_t                 m_depth    = 0;
+  bool                        m_afterKey = false;
+
+  auto open(char c) -> JsonWriter&
+  {
+    separate();
+    m_out += c;
+    if (m_depth + 1 < MAX_DEPTH)
+      m_hasItems[++m_depth] = false;
+    return *this;
+  }
+
+  auto close(char c) -> JsonWriter&
+  {
+    m_out += c;
+    if (m_depth > 0)
+      --m_depth;
+    return *this;
+  }
+
+  // Comma before every element except the first of its container, none after a key
+  void separate()
+  {
+    if (m_afterKey)
+    {
+      m_afterKey = false;
+      return;
+    }
+    if (m_hasItems[m_depth])
+      m_out += ',';
+    m_hasItems[m_depth] = true;
+  }
+
+  void write_string(std::string_view s)
+  {
+    m_out += '"';
+    for (const char ch : s)
+    {
+      switch (ch)
+      {
+        case '"':
+          m_out += "\\\"";
+          break;
+        case '\\':
+          m_out += "\\\\";
+          break;
+        case '\n':
+          m_out += "\\n";
+          break;
+        case '\r':
+          m_out += "\\r";
+          break;
+        case '\t':
+          m_out += "\\t";
+          break;
+        default:
+          if (static_cast<unsigned char>(ch) < 0x20)
+          {
+            std::array<char, 8> esc{};
+            std::snprintf(esc.data(), esc.size(), "\\u%04x", static_cast<unsigned char>(ch));
+            m_out += esc.data();
+          }
+          else
+          {
+            m_out += ch;
+          }
+      }
+    }
+    m_out += '"';
+  }
+};
+
+} // namespace libwavy::server
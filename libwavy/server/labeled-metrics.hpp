@@ -0,0 +1,337 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <libwavy/common/types.hpp>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Labeled counters (requests, bytes, errors, cache hits) keyed by a fixed set of label
+// values, e.g. (owner, route) or (owner, track).
+//
+// The hot path takes no lock: every thread keeps its own label -> series index, so
+// after the first sample for a series an update is one thread-local hash lookup plus
+// relaxed atomic adds on a per-thread shard of that series. Only the first touch of a
+// series by a thread takes the family mutex (to find or register it).
+//
+// A family holds at most `max_series` series. Samples for label values past that cap
+// are folded into a single `_overflow` series, so a client cycling through owner or
+// track names cannot grow the registry (or /metrics) without bound. While a family is
+// full, a thread's first touch of a label set only takes the family lock shared (so
+// threads never wait on each other), and unseen values go straight to `_overflow`.
+//
+// retire() drops a series (e.g. of a deleted track) and frees its slot for new label
+// values. Series are never deallocated, only recycled, so pointers cached by other
+// threads stay valid; the family's epoch tells those threads to drop their index. A
+// sample racing the retirement may land on the series that reuses the slot.
+
+namespace libwavy::server
+{
+
+struct LabeledSample
+{
+  ui64 requests   = 0;
+  ui64 bytes      = 0;
+  ui64 errors     = 0;
+  ui64 cache_hits = 0;
+
+  void merge(const LabeledSample& other)
+  {
+    requests += other.requests;
+    bytes += other.bytes;
+    errors += other.errors;
+    cache_hits += other.cache_hits;
+  }
+};
+
+class LabeledSeries
+{
+public:
+  static constexpr size_t SHARDS = 4;
+
+  void reset()
+  {
+    for (auto& shard : m_shards)
+    {
+      shard.requests.store(0, std::memory_order_relaxed);
+      shard.bytes.store(0, std::memory_order_relaxed);
+      shard.errors.store(0, std::memory_order_relaxed);
+      shard.cache_hits.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void add(const LabeledSample& s)
+  {
+    auto& shard = m_shards[shard_index()];
+    shard.requests.fetch_add(s.requests, std::memory_order_relaxed);
+    if (s.bytes != 0)
+      shard.bytes.fetch_add(s.bytes, std::memory_order_relaxed);
+    if (s.errors != 0)
+      shard.errors.fetch_add(s.errors, std::memory_order_relaxed);
+    if (s.cache_hits != 0)
+      shard.cache_hits.fetch_add(s.cache_hits, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto snapshot() const -> LabeledSample
+  {
+    LabeledSample total;
+    for (const auto& shard : m_shards)
+    {
+      total.requests += shard.requests.load(std::memory_order_relaxed);
+      total.bytes += shard.bytes.load(std::memory_order_relaxed);
+      total.errors += shard.errors.load(std::memory_order_relaxed);
+      total.cache_hits += shard.cache_hits.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+private:
+  struct alignas(64) Shard
+  {
+    std::atomic<ui64> requests{0};
+    std::atomic<ui64> bytes{0};
+    std::atomic<ui64> errors{0};
+    std::atomic<ui64> cache_hits{0};
+  };
+
+  std::array<Shard, SHARDS> m_shards;
+
+  static auto shard_index() -> size_t
+  {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t  index = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return index;
+  }
+};
+
+template <size_t N> class LabeledFamily
+{
+  static_assert(N > 0, "a labeled family needs at least one label");
+
+public:
+  using Names  = std::array<std::string_view, N>;
+  using Values = std::array<std::string_view, N>;
+  using Labels = std::array<std::string, N>;
+
+  static constexpr std::string_view OVERFLOW_LABEL = "_overflow";
+
+  LabeledFamily(Names names, size_t max_series)
+      : m_names(names), m_maxSeries(max_series),
+        m_id(s_nextId.fetch_add(1, std::memory_order_relaxed)), m_full(max_series == 0)
+  {
+  }
+
+  LabeledFamily(const LabeledFamily&)                    = delete;
+  auto operator=(const LabeledFamily&) -> LabeledFamily& = delete;
+
+  void add(const Values& values, const LabeledSample& sample) { series(values).add(sample); }
+
+  // For samples whose label values are not worth a series of their own (e.g. names taken
+  // from a request that matched nothing)
+  void add_overflow(const LabeledSample& sample)
+  {
+    m_overflowed.fetch_add(1, std::memory_order_relaxed);
+    m_overflow.add(sample);
+  }
+
+  // Current totals for one series (zero if it was never recorded)
+  [[nodiscard]] auto get(const Values& values) const -> LabeledSample
+  {
+    std::shared_lock lock(m_mutex);
+    auto             it = m_series.find(to_labels(values));
+    return it == m_series.end() ? LabeledSample{} : it->second->snapshot();
+  }
+
+  // Drops one series and frees its slot. Its totals disappear from for_each() and get().
+  void retire(const Values& values)
+  {
+    std::lock_guard lock(m_mutex);
+    auto            it = m_series.find(to_labels(values));
+    if (it == m_series.end())
+      return;
+
+    m_free.push_back(it->second);
+    m_series.erase(it);
+    m_full.store(false, std::memory_order_relaxed);
+    m_epoch.fetch_add(1, std::memory_order_release);
+  }
+
+  // fn(labels, totals) for every series in label order, then the overflow series if any
+  // sample landed there
+  template <typename Fn> void for_each(Fn&& fn) const
+  {
+    // Totals are read under the lock: a retired series may be reused for other labels
+    std::vector<std::pair<Labels, LabeledSample>> series;
+    {
+      std::shared_lock lock(m_mutex);
+      series.reserve(m_series.size());
+      for (const auto& [labels, s] : m_series)
+        series.emplace_back(labels, s->snapshot());
+    }
+
+    for (const auto& [labels, totals] : series)
+      fn(labels, totals);
+
+    if (m_overflowed.load(std::memory_order_relaxed) != 0)
+    {
+      Labels overflow;
+      overflow.fill(std::string(OVERFLOW_LABEL));
+      fn(static_cast<const Labels&>(overflow), m_overflow.snapshot());
+    }
+  }
+
+  [[nodiscard]] auto names() const -> const Names& { return m_names; }
+  [[nodiscard]] auto max_series() const -> size_t { return m_maxSeries; }
+
+  [[nodiscard]] auto series_count() const -> size_t
+  {
+    std::shared_lock lock(m_mutex);
+    return m_series.size();
+  }
+
+  // Samples folded into `_overflow` because the family was full
+  [[nodiscard]] auto overflowed() const -> ui64
+  {
+    return m_overflowed.load(std::memory_order_relaxed);
+  }
+
+private:
+  using SeriesMap = std::map<Labels, LabeledSeries*>;
+
+  struct LocalIndex
+  {
+    ui64                                            epoch = 0;
+    std::unordered_map<std::string, LabeledSeries*> series;
+  };
+
+  inline static std::atomic<ui64> s_nextId{0};
+
+  Names                       m_names;
+  size_t                      m_maxSeries;
+  ui64                        m_id;
+  mutable std::shared_mutex   m_mutex;
+  SeriesMap                   m_series;
+  std::deque<LabeledSeries>   m_storage; // never shrinks, so addresses stay put
+  std::vector<LabeledSeries*> m_free;    // retired, ready for reuse
+  LabeledSeries               m_overflow;
+  std::atomic<ui64>           m_overflowed{0};
+  std::atomic<ui64>           m_epoch{0}; // bumped by every retire()
+  std::atomic<bool>           m_full;     // m_series.size() >= m_maxSeries
+
+  static auto to_labels(const Values& values) -> Labels
+  {
+    Labels labels;
+    for (size_t i = 0; i < N; ++i)
+      labels[i] = std::string(values[i]);
+    return labels;
+  }
+
+  // This thread's view of the family; keyed by family id rather than address so a
+  // family allocated where a destroyed one lived never sees stale pointers
+  auto local_index() const -> LocalIndex&
+  {
+    thread_local std::unordered_map<ui64, LocalIndex> indexes;
+    return indexes[m_id];
+  }
+
+  auto series(const Values& values) -> LabeledSeries&
+  {
+    thread_local std::string key;
+    key.clear();
+    for (const auto v : values)
+    {
+      key.append(v);
+      key.push_back('\x1f'); // unit separator: cannot appear in owner or audio IDs
+    }
+
+    auto&      index = local_index();
+    const auto epoch = m_epoch.load(std::memory_order_acquire);
+    if (index.epoch != epoch)
+    {
+      // Something was retired: cached pointers may now belong to other label values
+      index.series.clear();
+      index.epoch = epoch;
+    }
+    if (auto it = index.series.find(key); it != index.series.end())
+      return *it->second;
+
+    // Overflow is not cached locally: the local index must stay as bounded as the family
+    if (m_full.load(std::memory_order_relaxed))
+    {
+      std::shared_lock lock(m_mutex);
+      if (m_full.load(std::memory_order_relaxed))
+      {
+        auto it = m_series.find(to_labels(values));
+        if (it == m_series.end())
+        {
+          m_overflowed.fetch_add(1, std::memory_order_relaxed);
+          return m_overflow;
+        }
+        index.series.emplace(key, it->second);
+        return *it->second;
+      }
+    }
+
+    std::unique_lock lock(m_mutex);
+    auto            labels = to_labels(values);
+    auto            it     = m_series.find(labels);
+    if (it == m_series.end())
+    {
+      if (m_series.size() >= m_maxSeries)
+      {
+        m_overflowed.fetch_add(1, std::memory_order_relaxed);
+        return m_overflow;
+      }
+
+      LabeledSeries* slot = nullptr;
+      if (!m_free.empty())
+      {
+        slot = m_free.back();
+        m_free.pop_back();
+        slot->reset();
+      }
+      else
+        slot = &m_storage.emplace_back();
+
+      it = m_series.emplace(std::move(labels), slot).first;
+      if (m_series.size() >= m_maxSeries)
+        m_full.store(true, std::memory_order_relaxed);
+    }
+
+    index.series.emplace(key, it->second);
+    return *it->second;
+  }
+};
+
+} // namespace libwavy::server
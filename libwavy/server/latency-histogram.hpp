@@ -0,0 +1,316 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <libwavy/common/types.hpp>
+#include <memory>
+#include <string_view>
+
+// Request latency histograms (HDR-style, microsecond resolution).
+//
+// Values are bucketed log-linearly: exact below 64 us, then 32 sub-buckets per
+// power of two up to 2^27 us (~134 s), so any recorded value is reported within
+// ~3% and a histogram has a fixed 736 buckets whatever the traffic.
+//
+// Recording is two relaxed atomic adds on one of SHARDS shards, dealt out to threads
+// round-robin (no locks; with more request threads than shards, a few threads share
+// a shard's cache lines). Readers merge the shards into a Snapshot;
+// a snapshot taken under load may be a few samples behind, never inconsistent in
+// a way that matters for percentiles.
+
+namespace libwavy::server
+{
+
+enum class MetricsRoute : ui8
+{
+  Ping,
+  Owners,
+  AudioInfo,
+  Catalog,
+  Upload,
+  UploadStatus,
+  Download,
+  Stream,
+  Bundle,
+  Delete,
+  Health,
+  Metrics,
+  OwnerMetrics,
+  LiveIngest,
+  Live,
+  Other,
+  Count
+};
+
+enum class StatusClass : ui8
+{
+  Success,     // 2xx/3xx
+  ClientError, // 4xx
+  ServerError, // 5xx
+  Unmarked,    // handler never reported an outcome
+  Count
+};
+
+inline auto to_string(MetricsRoute route) -> std::string_view
+{
+  switch (route)
+  {
+    case MetricsRoute::Ping:
+      return "ping";
+    case MetricsRoute::Owners:
+      return "owners";
+    case MetricsRoute::AudioInfo:
+      return "audio_info";
+    case MetricsRoute::Catalog:
+      return "catalog";
+    case MetricsRoute::Upload:
+      return "upload";
+    case MetricsRoute::UploadStatus:
+      return "upload_status";
+    case MetricsRoute::Download:
+      return "download";
+    case MetricsRoute::Stream:
+      return "stream";
+    case MetricsRoute::Bundle:
+      return "bundle";
+    case MetricsRoute::Delete:
+      return "delete";
+    case MetricsRoute::Health:
+      return "health";
+    case MetricsRoute::Metrics:
+      return "metrics";
+    case MetricsRoute::OwnerMetrics:
+      return "owner_metrics";
+    case MetricsRoute::LiveIngest:
+      return "live_ingest";
+    case MetricsRoute::Live:
+      return "live";
+    default:
+      return "other";
+  }
+}
+
+inline auto to_string(StatusClass cls) -> std::string_view
+{
+  switch (cls)
+  {
+    case StatusClass::Success:
+      return "2xx";
+    case StatusClass::ClientError:
+      return "4xx";
+    case StatusClass::ServerError:
+      return "5xx";
+    default:
+      return "unmarked";
+  }
+}
+
+class LatencyHistogram
+{
+public:
+  static constexpr ui32   SUB_BITS  = 5;
+  static constexpr ui64   SUB_COUNT = 1ULL << SUB_BITS;
+  static constexpr ui32   MAX_MSB   = 26;
+  static constexpr ui64   MAX_VALUE = (1ULL << (MAX_MSB + 1)) - 1; // larger values clamp here
+  static constexpr size_t BUCKETS   = (MAX_MSB - SUB_BITS) * SUB_COUNT + 2 * SUB_COUNT;
+  static constexpr size_t SHARDS    = 4;
+
+  static constexpr auto bucket_of(ui64 us) -> size_t
+  {
+    if (us > MAX_VALUE)
+      us = MAX_VALUE;
+    if (us < 2 * SUB_COUNT)
+      return static_cast<size_t>(us);
+
+    const ui32 shift = static_cast<ui32>(std::bit_width(us)) - 1 - SUB_BITS;
+    return static_cast<size_t>(shift * SUB_COUNT + (us >> shift));
+  }
+
+  static constexpr auto lower_bound_of(size_t bucket) -> ui64
+  {
+    if (bucket < 2 * SUB_COUNT)
+      return bucket;
+
+    const ui64 shift = bucket / SUB_COUNT - 1;
+    return (bucket - shift * SUB_COUNT) << shift;
+  }
+
+  // Highest value that lands in `bucket` (what percentiles report)
+  static constexpr auto upper_bound_of(size_t bucket) -> ui64
+  {
+    return bucket + 1 < BUCKETS ? lower_bound_of(bucket + 1) - 1 : MAX_VALUE;
+  }
+
+  struct Snapshot
+  {
+    std::array<ui64, BUCKETS> counts{};
+    ui64                      count  = 0;
+    ui64                      sum_us = 0;
+
+    // Value at quantile q in [0, 1], in microseconds
+    [[nodiscard]] auto percentile(double q) const -> ui64
+    {
+      if (count == 0)
+        return 0;
+
+      auto rank = static_cast<ui64>(q * static_cast<double>(count) + 0.5);
+      rank      = rank == 0 ? 1 : (rank > count ? count : rank);
+
+      ui64 seen = 0;
+      for (size_t i = 0; i < BUCKETS; ++i)
+      {
+        seen += counts[i];
+        if (seen >= rank)
+          return upper_bound_of(i);
+      }
+      return MAX_VALUE;
+    }
+
+    // Samples at or below `le_us` (Prometheus `le` is inclusive). The bucket `le_us` falls
+    // in counts whole, so a sample up to ~3% above the bound may be included; none at or
+    // below it is ever left out.
+    [[nodiscard]] auto count_at_or_below(ui64 le_us) const -> ui64
+    {
+      ui64 total = 0;
+      for (size_t i = 0; i <= bucket_of(le_us); ++i)
+        total += counts[i];
+      return total;
+    }
+
+    void merge(const Snapshot& other)
+    {
+      for (size_t i = 0; i < BUCKETS; ++i)
+        counts[i] += other.counts[i];
+      count += other.count;
+      sum_us += other.sum_us;
+    }
+  };
+
+  void record(ui64 us)
+  {
+    auto& shard = m_shards[shard_index()];
+    shard.counts[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum_us.fetch_add(us, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto snapshot() const -> Snapshot
+  {
+    Snapshot snap;
+    for (const auto& shard : m_shards)
+    {
+      for (size_t i = 0; i < BUCKETS; ++i)
+      {
+        const ui64 n = shard.counts[i].load(std::memory_order_relaxed);
+        snap.counts[i] += n;
+        snap.count += n;
+      }
+      snap.sum_us += shard.sum_us.load(std::memory_order_relaxed);
+    }
+    return snap;
+  }
+
+private:
+  struct alignas(64) Shard
+  {
+    std::array<std::atomic<ui64>, BUCKETS> counts{};
+    std::atomic<ui64>                      sum_us{0};
+  };
+
+  std::array<Shard, SHARDS> m_shards;
+
+  // Threads are dealt out to shards round-robin on their first sample
+  static auto shard_index() -> size_t
+  {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t  index = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return index;
+  }
+};
+
+static_assert(LatencyHistogram::bucket_of(LatencyHistogram::MAX_VALUE) ==
+                LatencyHistogram::BUCKETS - 1,
+              "bucket layout must cover MAX_VALUE exactly");
+
+// One histogram per (route, status class), allocated on first use
+class LatencyTable
+{
+public:
+  static constexpr size_t ROUTES  = static_cast<size_t>(MetricsRoute::Count);
+  static constexpr size_t CLASSES = static_cast<size_t>(StatusClass::Count);
+
+  LatencyTable() = default;
+  ~LatencyTable()
+  {
+    for (auto& slot : m_slots)
+      delete slot.load(std::memory_order_acquire);
+  }
+
+  LatencyTable(const LatencyTable&)                    = delete;
+  auto operator=(const LatencyTable&) -> LatencyTable& = delete;
+
+  void record(MetricsRoute route, StatusClass cls, ui64 us) { histogram(route, cls).record(us); }
+
+  // fn(route, class, snapshot) for every combination that has seen traffic
+  template <typename Fn> void for_each(Fn&& fn) const
+  {
+    for (size_t r = 0; r < ROUTES; ++r)
+    {
+      for (size_t c = 0; c < CLASSES; ++c)
+      {
+        if (const auto* h = m_slots[r * CLASSES + c].load(std::memory_order_acquire))
+          fn(static_cast<MetricsRoute>(r), static_cast<StatusClass>(c), h->snapshot());
+      }
+    }
+  }
+
+  [[nodiscard]] auto overall() const -> LatencyHistogram::Snapshot
+  {
+    LatencyHistogram::Snapshot total;
+    for_each([&](MetricsRoute, StatusClass, const LatencyHistogram::Snapshot& s)
+             { total.merge(s); });
+    return total;
+  }
+
+private:
+  std::array<std::atomic<LatencyHistogram*>, ROUTES * CLASSES> m_slots{};
+
+  auto histogram(MetricsRoute route, StatusClass cls) -> LatencyHistogram&
+  {
+    auto& slot = m_slots[static_cast<size_t>(route) * CLASSES + static_cast<size_t>(cls)];
+    if (auto* h = slot.load(std::memory_order_acquire))
+      return *h;
+
+    auto              fresh    = std::make_unique<LatencyHistogram>();
+    LatencyHistogram* expected = nullptr;
+    if (slot.compare_exchange_strong(expected, fresh.get(), std::memory_order_acq_rel))
+      return *fresh.release();
+    return *expected; // another thread won the race
+  }
+};
+
+} // namespace libwavy::server
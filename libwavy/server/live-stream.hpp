@@ -0,0 +1,429 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/log-macros.hpp>
+#include <libwavy/server/segment-cache.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * @LIVE STREAMS
+ *
+ * A live stream is pushed one MPEG-TS segment at a time by its owner and played from a
+ * sliding-window media playlist. Nothing of it touches the disk: the last
+ * `2 * WAVY_SERVER_LIVE_WINDOW` segments are kept in memory, the newest
+ * `WAVY_SERVER_LIVE_WINDOW` of them are listed, and the older half stays fetchable for
+ * clients still working through a playlist they loaded earlier (RFC 8216 §6.2.2).
+ *
+ * Appending a segment is O(1): push to the back of a deque, pop from the front, and
+ * re-render a playlist of at most WINDOW entries. Readers get the rendered playlist and
+ * the segment bodies as shared pointers, so serving them never copies under the lock.
+ *
+ * Segments are named after their media sequence number (`<n>.ts`), assigned here. A
+ * stream's first number is the wall clock in milliseconds when it was opened, so a
+ * restarted stream never reuses a name some cache still holds for the previous one and
+ * segments can be served as immutable. The owner sends its own counter with each push:
+ * a repeat of the last one is a retry and is acknowledged without being appended again,
+ * a gap (the owner gave up on a segment) is marked with EXT-X-DISCONTINUITY.
+ *
+ * The first push also carries the publisher's token (a random secret it picked). The
+ * stream keeps it and only takes further pushes, and its end, from requests carrying the
+ * same token. Segments of all streams share one byte budget
+ * (WAVY_SERVER_LIVE_MEMORY_LIMIT); a push that does not fit is refused until older
+ * segments or streams are dropped.
+ *
+ */
+
+namespace libwavy::server
+{
+
+struct LiveSegment
+{
+  ui64       sequence      = 0;     // media sequence number, also the segment's name
+  double     duration      = 0;     // EXTINF, seconds
+  bool       discontinuity = false; // the owner skipped segments before this one
+  CachedBody body;
+};
+
+enum class LiveAppend
+{
+  Appended,
+  Duplicate, // owner sequence already appended (a retried push)
+  OutOfOrder,
+  TooLong,    // longer than the stream's target duration allows
+  OverBudget, // all live streams together hold WAVY_SERVER_LIVE_MEMORY_LIMIT already
+  Ended
+};
+
+struct LiveStreamInfo
+{
+  StorageOwnerID owner;
+  std::string    id;
+  ui64           segments = 0; // appended since the stream was opened
+  ui64           next     = 0; // media sequence of the next segment
+  bool           ended    = false;
+};
+
+struct LiveStats
+{
+  std::atomic<ui64> opened{0};
+  std::atomic<ui64> segments{0};
+  std::atomic<ui64> bytes{0};
+  std::atomic<ui64> rejected{0};
+  std::atomic<ui64> over_budget{0}; // pushes refused by the shared memory budget
+  std::atomic<ui64> ended_idle{0};  // streams ended because their owner stopped pushing
+};
+
+/// Bytes of live segments held across all streams, against a fixed limit.
+class LiveMemoryBudget
+{
+public:
+  explicit LiveMemoryBudget(ui64 limit) : m_limit(limit) {}
+
+  auto try_reserve(ui64 bytes) -> bool
+  {
+    ui64 held = m_held.load(std::memory_order_relaxed);
+    do
+    {
+      if (held + bytes > m_limit)
+        return false;
+    } while (!m_held.compare_exchange_weak(held, held + bytes, std::memory_order_relaxed));
+    return true;
+  }
+
+  void release(ui64 bytes) { m_held.fetch_sub(bytes, std::memory_order_relaxed); }
+
+  [[nodiscard]] auto held() const -> ui64 { return m_held.load(std::memory_order_relaxed); }
+  [[nodiscard]] auto limit() const -> ui64 { return m_limit; }
+
+private:
+  const ui64        m_limit;
+  std::atomic<ui64> m_held{0};
+};
+
+class LiveStream
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  LiveStream(StorageOwnerID owner, std::string id, std::string token, int target_duration,
+             std::shared_ptr<LiveMemoryBudget> budget, ui64 first_sequence = 0,
+             std::size_t window = WAVY_SERVER_LIVE_WINDOW)
+      : m_owner(std::move(owner)), m_id(std::move(id)), m_token(std::move(token)),
+        m_target(std::max(target_duration, 1)), m_window(std::max<std::size_t>(window, 1)),
+        m_budget(std::move(budget)), m_nextSequence(first_sequence), m_updated(Clock::now())
+  {
+    render();
+  }
+
+  LiveStream(const LiveStream&)                    = delete;
+  auto operator=(const LiveStream&) -> LiveStream& = delete;
+
+  ~LiveStream() { m_budget->release(m_bytes); }
+
+  /// Whether `token` is the one the stream was opened with. Compares in constant time.
+  [[nodiscard]] auto authorized(std::string_view token) const -> bool
+  {
+    if (token.size() != m_token.size())
+      return false;
+    unsigned char diff = 0;
+    for (std::size_t i = 0; i < token.size(); ++i)
+      diff |= static_cast<unsigned char>(token[i] ^ m_token[i]);
+    return diff == 0;
+  }
+
+  auto append(ui64 owner_sequence, double duration, CachedBody body) -> LiveAppend
+  {
+    std::unique_lock lock(m_mutex);
+
+    if (m_ended)
+      return LiveAppend::Ended;
+    if (m_lastOwnerSequence && owner_sequence == *m_lastOwnerSequence)
+      return LiveAppend::Duplicate;
+    if (m_lastOwnerSequence && owner_sequence < *m_lastOwnerSequence)
+      return LiveAppend::OutOfOrder;
+    // EXTINF rounded to the nearest integer must not exceed EXT-X-TARGETDURATION. Compared
+    // as a double first: lround of NaN or of anything past long is undefined.
+    if (!(duration > 0 && duration <= m_target + 1) || std::lround(duration) > m_target)
+      return LiveAppend::TooLong;
+    if (!m_budget->try_reserve(body->size()))
+      return LiveAppend::OverBudget;
+    m_bytes += body->size();
+
+    const bool gap = m_lastOwnerSequence && owner_sequence != *m_lastOwnerSequence + 1;
+
+    // The oldest listed segment drops out of the playlist
+    if (m_segments.size() >= m_window && m_segments[m_segments.size() - m_window].discontinuity)
+      m_discontinuitySequence++;
+
+    m_segments.push_back(LiveSegment{.sequence      = m_nextSequence++,
+                                     .duration      = duration,
+                                     .discontinuity = gap,
+                                     .body          = std::move(body)});
+    while (m_segments.size() > 2 * m_window)
+    {
+      m_bytes -= m_segments.front().body->size();
+      m_budget->release(m_segments.front().body->size());
+      m_segments.pop_front();
+    }
+
+    m_lastOwnerSequence = owner_sequence;
+    m_appended++;
+    m_updated = Clock::now();
+    render();
+    return LiveAppend::Appended;
+  }
+
+  void end()
+  {
+    std::unique_lock lock(m_mutex);
+    if (m_ended)
+      return;
+    m_ended   = true;
+    m_updated = Clock::now();
+    render();
+  }
+
+  [[nodiscard]] auto playlist() const -> CachedBody
+  {
+    std::unique_lock lock(m_mutex);
+    return m_playlist;
+  }
+
+  // `sequence` is the number a segment URI names; nullptr once it has been dropped
+  [[nodiscard]] auto segment(ui64 sequence) const -> CachedBody
+  {
+    std::unique_lock lock(m_mutex);
+    if (m_segments.empty() || sequence < m_segments.front().sequence ||
+        sequence > m_segments.back().sequence)
+      return nullptr;
+    return m_segments[sequence - m_segments.front().sequence].body;
+  }
+
+  [[nodiscard]] auto info() const -> LiveStreamInfo
+  {
+    std::unique_lock lock(m_mutex);
+    return {m_owner, m_id, m_appended, m_nextSequence, m_ended};
+  }
+
+  [[nodiscard]] auto ended() const -> bool
+  {
+    std::unique_lock lock(m_mutex);
+    return m_ended;
+  }
+
+  [[nodiscard]] auto last_update() const -> Clock::time_point
+  {
+    std::unique_lock lock(m_mutex);
+    return m_updated;
+  }
+
+  [[nodiscard]] auto target_duration() const -> int { return m_target; }
+
+private:
+  const StorageOwnerID                    m_owner;
+  const std::string                       m_id;
+  const std::string                       m_token;
+  const int                               m_target;
+  const std::size_t                       m_window;
+  const std::shared_ptr<LiveMemoryBudget> m_budget;
+
+  mutable std::mutex      m_mutex;
+  std::deque<LiveSegment> m_segments; // listed window plus as many already dropped from it
+  ui64                    m_nextSequence          = 0;
+  ui64                    m_discontinuitySequence = 0;
+  ui64                    m_bytes                 = 0; // of m_segments, charged to m_budget
+  std::optional<ui64>     m_lastOwnerSequence;
+  ui64                    m_appended = 0;
+  bool                    m_ended    = false;
+  Clock::time_point       m_updated;
+  CachedBody              m_playlist;
+
+  // Called with the lock held, touches at most `m_window` segments
+  void render()
+  {
+    const std::size_t first = m_segments.size() > m_window ? m_segments.size() - m_window : 0;
+
+    std::string out;
+    out.reserve(128 + (m_segments.size() - first) * 32);
+    out += "#EXTM3U\n#EXT-X-VERSION:3\n";
+    out += "#EXT-X-TARGETDURATION:" + std::to_string(m_target) + "\n";
+    out += "#EXT-X-MEDIA-SEQUENCE:" +
+           std::to_string(first < m_segments.size() ? m_segments[first].sequence : m_nextSequence) +
+           "\n";
+    if (m_discontinuitySequence > 0)
+      out += "#EXT-X-DISCONTINUITY-SEQUENCE:" + std::to_string(m_discontinuitySequence) + "\n";
+
+    char extinf[48];
+    for (std::size_t i = first; i < m_segments.size(); ++i)
+    {
+      const auto& segment = m_segments[i];
+      if (segment.discontinuity)
+        out += "#EXT-X-DISCONTINUITY\n";
+      std::snprintf(extinf, sizeof(extinf), "#EXTINF:%.3f,\n", segment.duration);
+      out += extinf;
+      out += std::to_string(segment.sequence);
+      out += macros::TRANSPORT_STREAM_EXT;
+      out += '\n';
+    }
+
+    if (m_ended)
+      out += "#EXT-X-ENDLIST\n";
+
+    m_playlist = std::make_shared<const std::string>(std::move(out));
+  }
+};
+
+/// Every open (or recently ended) live stream, keyed by "<owner>/<stream-id>".
+class LiveRegistry
+{
+public:
+  using StreamPtr = std::shared_ptr<LiveStream>;
+
+  static constexpr auto IDLE_TIMEOUT = std::chrono::seconds(WAVY_SERVER_LIVE_IDLE_TIMEOUT);
+  static constexpr auto LINGER       = std::chrono::seconds(WAVY_SERVER_LIVE_LINGER);
+
+  explicit LiveRegistry(std::size_t max_streams = WAVY_SERVER_LIVE_MAX_STREAMS,
+                        ui64        memory_limit =
+                          static_cast<ui64>(WAVY_SERVER_LIVE_MEMORY_LIMIT) * ONE_MIB)
+      : m_maxStreams(max_streams), m_budget(std::make_shared<LiveMemoryBudget>(memory_limit))
+  {
+  }
+
+  static auto make_key(const StorageOwnerID& owner, const std::string& id) -> std::string
+  {
+    return owner + "/" + id;
+  }
+
+  // The stream a push goes to: the open one, or a new one owned by `token` if there is
+  // none or the previous one under that name has ended. nullptr when the registry is
+  // full. The caller checks the returned stream's authorized(token).
+  auto open(const StorageOwnerID& owner, const std::string& id, const std::string& token,
+            int target_duration) -> StreamPtr
+  {
+    const auto key = make_key(owner, id);
+    {
+      std::shared_lock lock(m_mutex);
+      if (auto it = m_streams.find(key); it != m_streams.end() && !it->second->ended())
+        return it->second;
+    }
+
+    std::unique_lock lock(m_mutex);
+    auto             it = m_streams.find(key);
+    if (it != m_streams.end() && !it->second->ended())
+      return it->second;
+    if (it == m_streams.end() && m_streams.size() >= m_maxStreams)
+      return nullptr;
+
+    const auto first  = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+    auto       stream = std::make_shared<LiveStream>(owner, id, token, target_duration, m_budget,
+                                                     static_cast<ui64>(first.count()));
+
+    m_streams[key] = stream;
+    m_stats.opened++;
+    return stream;
+  }
+
+  [[nodiscard]] auto find(const StorageOwnerID& owner, const std::string& id) const -> StreamPtr
+  {
+    std::shared_lock lock(m_mutex);
+    auto             it = m_streams.find(make_key(owner, id));
+    return it == m_streams.end() ? nullptr : it->second;
+  }
+
+  [[nodiscard]] auto list() const -> std::vector<LiveStreamInfo>
+  {
+    std::vector<LiveStreamInfo> out;
+    {
+      std::shared_lock lock(m_mutex);
+      out.reserve(m_streams.size());
+      for (const auto& [_, stream] : m_streams)
+        out.push_back(stream->info());
+    }
+    std::ranges::sort(out, [](const auto& a, const auto& b)
+                      { return std::tie(a.owner, a.id) < std::tie(b.owner, b.id); });
+    return out;
+  }
+
+  // Ends streams whose owner stopped pushing and forgets ended ones after `linger`
+  void sweep(std::chrono::seconds idle_timeout = IDLE_TIMEOUT, std::chrono::seconds linger = LINGER)
+  {
+    const auto now = LiveStream::Clock::now();
+
+    std::unique_lock lock(m_mutex);
+    std::erase_if(m_streams,
+                  [&](const auto& entry)
+                  {
+                    const auto& stream = entry.second;
+                    if (!stream->ended())
+                    {
+                      if (now - stream->last_update() < idle_timeout)
+                        return false;
+                      stream->end();
+                      m_stats.ended_idle++;
+                      log::INFO<log::SERVER_LIVE>(LogMode::Async,
+                                                  "Live stream {} ended: no segment for {}s",
+                                                  entry.first, idle_timeout.count());
+                      return false;
+                    }
+                    return now - stream->last_update() >= linger;
+                  });
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t
+  {
+    std::shared_lock lock(m_mutex);
+    return m_streams.size();
+  }
+
+  [[nodiscard]] auto stats() -> LiveStats& { return m_stats; }
+  [[nodiscard]] auto stats() const -> const LiveStats& { return m_stats; }
+  [[nodiscard]] auto budget() const -> const LiveMemoryBudget& { return *m_budget; }
+
+private:
+  const std::size_t                          m_maxStreams;
+  std::shared_ptr<LiveMemoryBudget>          m_budget;
+  mutable std::shared_mutex                  m_mutex;
+  std::unordered_map<std::string, StreamPtr> m_streams;
+  LiveStats                                  m_stats;
+};
+
+} // namespace libwavy::server
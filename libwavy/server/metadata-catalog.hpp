@@ -0,0 +1,483 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <atomic>
+#include <filesystem>
+#include <iterator>
+#include <libwavy/common/content-encoding.hpp>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/state.hpp>
+#include <libwavy/db/db.h>
+#include <libwavy/toml/toml_parser.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <optional>
+#include <shared_mutex>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parsed `metadata.toml` of every stored track, kept in memory for /audio/info and
+// the /catalog API.
+//
+// Each track's TOML is parsed once: at ingest (load after the track is published)
+// or once after startup (sync_with). Deletes drop the entry. Every change bumps
+// `generation()`, and the rendered /audio/info body is cached against it, so a
+// request costs a pointer copy unless the library changed since the last render.
+//
+// Tracks are kept ordered by (owner, audio-id), which is also the pagination
+// order of the catalog API: a cursor is just the last key of the previous page.
+// Artist, album and codec have secondary indexes so filtered pages are served
+// without scanning the library.
+
+namespace libwavy::server
+{
+
+// Only what the listings show, not the whole AudioMetadata
+struct TrackInfo
+{
+  std::string      title;
+  std::string      artist;
+  std::string      album;
+  std::string      sample_format;
+  std::string      codec;
+  int              duration       = 0;
+  int              bitrate        = 0;
+  int              sample_rate    = 0;
+  int              stream_bitrate = 0;
+  std::vector<int> bitrates;
+  bool             has_metadata = false; // false: track is stored but its TOML is unreadable
+
+  static auto from(const AudioMetadata& m) -> TrackInfo
+  {
+    TrackInfo t;
+    t.title          = m.title;
+    t.artist         = m.artist;
+    t.album          = m.album;
+    t.sample_format  = m.audio_stream.sample_format;
+    t.codec          = m.audio_stream.codec;
+    t.duration       = m.duration;
+    t.bitrate        = m.bitrate;
+    t.sample_rate    = m.audio_stream.sample_rate;
+    t.stream_bitrate = m.audio_stream.bitrate;
+    t.bitrates       = m.bitrates;
+    t.has_metadata   = true;
+    return t;
+  }
+};
+
+using TrackKey = std::pair<StorageOwnerID, StorageAudioID>;
+
+// Exact-match filters; empty means "any"
+struct TrackQuery
+{
+  std::string             owner;
+  std::string             artist;
+  std::string             album;
+  std::string             codec;
+  std::optional<TrackKey> after; // resume strictly after this key
+  size_t                  limit = 50;
+};
+
+struct MetadataSyncResult
+{
+  size_t loaded  = 0; // tracks parsed and added
+  size_t dropped = 0; // entries whose track is no longer in the index
+  size_t failed  = 0; // metadata.toml missing or unparsable
+};
+
+class MetadataCatalog
+{
+public:
+  using Tracks  = std::map<StorageAudioID, TrackInfo>;
+  using Catalog = std::map<StorageOwnerID, Tracks>;
+
+  // Parse a published track's metadata.toml into the catalog. The track is listed
+  // even if that fails; the return value says whether metadata was found.
+  auto load(const StorageOwnerID& owner, const StorageAudioID& audio_id,
+            const std::filesystem::path& storage_root) -> bool
+  {
+    auto info = parse(storage_root / owner / audio_id / macros::to_string(macros::METADATA_FILE));
+    const bool parsed = info.has_metadata;
+
+    std::unique_lock lock(m_mutex);
+    put_locked(owner, audio_id, std::move(info));
+    return parsed;
+  }
+
+  auto erase(const StorageOwnerID& owner, const StorageAudioID& audio_id) -> bool
+  {
+    std::unique_lock lock(m_mutex);
+    auto             it = m_catalog.find(owner);
+    if (it == m_catalog.end())
+      return false;
+
+    auto track = it->second.find(audio_id);
+    if (track == it->second.end())
+      return false;
+
+    unindex({owner, audio_id}, track->second);
+    it->second.erase(track);
+    if (it->second.empty())
+      m_catalog.erase(it);
+    m_generation.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+  // Bring the catalog in line with the owner/audio index: parse tracks it does not
+  // know yet and drop the ones the index no longer has. Cheap once warm, since
+  // only the differences are touched.
+  auto sync_with(const OwnerAudioIDMap& index, const std::filesystem::path& storage_root,
+                 const std::stop_token& stop) -> MetadataSyncResult
+  {
+    MetadataSyncResult result;
+
+    std::vector<TrackKey> missing, extra;
+    index.for_each(
+      [&](const StorageOwnerID& owner, const StorageAudioID& audio_id)
+      {
+        if (!contains(owner, audio_id))
+          missing.emplace_back(owner, audio_id);
+      });
+
+    {
+      std::shared_lock lock(m_mutex);
+      for (const auto& [owner, tracks] : m_catalog)
+        for (const auto& [audio_id, _] : tracks)
+          if (!index.has(owner, audio_id))
+            extra.emplace_back(owner, audio_id);
+    }
+
+    for (const auto& [owner, audio_id] : missing)
+    {
+      if (stop.stop_requested())
+        return result;
+
+      auto info =
+        parse(storage_root / owner / audio_id / macros::to_string(macros::METADATA_FILE));
+      if (!info.has_metadata)
+        ++result.failed;
+
+      // A delete erases the index before the catalog, so re-checking the index
+      // under our lock keeps a racing delete from being undone
+      std::unique_lock lock(m_mutex);
+      if (!index.has(owner, audio_id) || has_locked(owner, audio_id))
+        continue;
+      put_locked(owner, audio_id, std::move(info));
+      ++result.loaded;
+    }
+
+    for (const auto& [owner, audio_id] : extra)
+    {
+      if (!index.has(owner, audio_id) && erase(owner, audio_id))
+        ++result.dropped;
+    }
+
+    return result;
+  }
+
+  [[nodiscard]] auto contains(const StorageOwnerID& owner, const StorageAudioID& audio_id) const
+    -> bool
+  {
+    std::shared_lock lock(m_mutex);
+    return has_locked(owner, audio_id);
+  }
+
+  [[nodiscard]] auto track_count() const -> size_t
+  {
+    std::shared_lock lock(m_mutex);
+    size_t           total = 0;
+    for (const auto& [_, tracks] : m_catalog)
+      total += tracks.size();
+    return total;
+  }
+
+  [[nodiscard]] auto generation() const -> ui64
+  {
+    return m_generation.load(std::memory_order_acquire);
+  }
+
+  // Visit fn(owner, audio_id, info) for up to `q.limit` matching tracks in key order,
+  // starting after `q.after`. Returns the last visited key when more tracks match,
+  // i.e. the cursor for the next page.
+  //
+  // Unfiltered and owner-only queries seek in the primary map; a field filter walks
+  // that field's index instead. Either way the cost is O(log n + page), plus the
+  // tracks skipped when several field filters are combined.
+  template <typename Fn>
+  auto visit_tracks(const TrackQuery& q, Fn&& fn) const -> std::optional<TrackKey>
+  {
+    std::shared_lock        lock(m_mutex);
+    size_t                  emitted = 0;
+    std::optional<TrackKey> last;
+    bool                    more = false;
+
+    // false: page is full and another match exists
+    auto offer = [&](const StorageOwnerID& owner, const StorageAudioID& audio_id,
+                     const TrackInfo& info) -> bool
+    {
+      if (!matches(q, owner, info))
+        return true;
+      if (emitted == q.limit)
+      {
+        more = true;
+        return false;
+      }
+      fn(owner, audio_id, info);
+      last = TrackKey{owner, audio_id};
+      ++emitted;
+      return true;
+    };
+
+    if (const auto* keys = pick_index(q))
+    {
+      auto it = q.after ? keys->upper_bound(*q.after) : keys->begin();
+      if (!q.owner.empty() && (!q.after || q.after->first < q.owner))
+        it = keys->lower_bound(TrackKey{q.owner, {}});
+
+      for (; it != keys->end(); ++it)
+      {
+        if (!q.owner.empty() && it->first != q.owner)
+          break;
+        if (!offer(it->first, it->second, m_catalog.at(it->first).at(it->second)))
+          break;
+      }
+      return more ? last : std::nullopt;
+    }
+
+    auto owner_it = m_catalog.begin();
+    if (!q.owner.empty())
+      owner_it = m_catalog.find(q.owner);
+    else if (q.after)
+      owner_it = m_catalog.lower_bound(q.after->first);
+
+    for (; owner_it != m_catalog.end(); ++owner_it)
+    {
+      const auto& [owner, tracks] = *owner_it;
+      if (q.after && owner < q.after->first)
+        break; // owner filter points before the cursor: nothing left
+
+      auto track_it = (q.after && q.after->first == owner) ? tracks.upper_bound(q.after->second)
+                                                             : tracks.begin();
+      for (; track_it != tracks.end(); ++track_it)
+      {
+        if (!offer(owner, track_it->first, track_it->second))
+          return last;
+      }
+
+      if (!q.owner.empty())
+        break;
+    }
+    return std::nullopt;
+  }
+
+  // Visit fn(owner, track_count) for up to `limit` owners after `after`; returns the
+  // last visited owner when more remain
+  template <typename Fn>
+  auto visit_owners(const std::optional<StorageOwnerID>& after, size_t limit, Fn&& fn) const
+    -> std::optional<StorageOwnerID>
+  {
+    std::shared_lock lock(m_mutex);
+    auto             it = after ? m_catalog.upper_bound(*after) : m_catalog.begin();
+    for (size_t n = 0; it != m_catalog.end(); ++it, ++n)
+    {
+      if (n == limit)
+        return std::prev(it)->first;
+      fn(it->first, it->second.size());
+    }
+    return std::nullopt;
+  }
+
+  // The /audio/info body with its zstd/gzip variants; nullptr when no track has metadata.
+  //
+  // Rebuilt (and compressed) at most once per generation: concurrent callers on a stale cache wait
+  // for the one render instead of each walking the catalog.
+  auto render_info() -> std::shared_ptr<const encoding::EncodedBody>
+  {
+    std::lock_guard render_lock(m_renderMutex);
+    if (m_renderedGeneration == generation())
+      return m_rendered;
+
+    std::shared_lock   lock(m_mutex);
+    std::ostringstream out;
+    bool               entries_found = false;
+
+    for (const auto& [owner, tracks] : m_catalog)
+    {
+      out << owner << ":\n";
+      for (const auto& [audio_id, t] : tracks)
+      {
+        if (!t.has_metadata)
+          continue;
+        write_track(out, audio_id, t);
+        entries_found = true;
+      }
+    }
+
+    // Generation cannot move while the shared lock is held
+    m_renderedGeneration = generation();
+    m_rendered.reset();
+    if (entries_found)
+      m_rendered = std::make_shared<const encoding::EncodedBody>(
+        encoding::EncodedBody::make(std::move(out).str()));
+    return m_rendered;
+  }
+
+  static void write_track(std::ostringstream& out, const StorageAudioID& audio_id,
+                          const TrackInfo& t)
+  {
+    out << "  - " << audio_id << "\n";
+    out << "      1. Title: " << t.title << "\n";
+    out << "      2. Artist: " << t.artist << "\n";
+    out << "      3. Duration: " << t.duration << " secs\n";
+    out << "      4. Album: " << t.album << "\n";
+    out << "      5. Bitrate: " << t.bitrate << " kbps\n";
+    out << "      6. Sample Rate: " << t.sample_rate << " Hz\n";
+    out << "      7. Sample Format: " << t.sample_format << "\n";
+    out << "      8. Audio Bitrate: " << t.stream_bitrate << " kbps\n";
+    out << "      9. Codec: " << t.codec << "\n";
+    out << "      10. Available Bitrates: [";
+    for (auto br : t.bitrates)
+      out << br << ",";
+    out << "]\n";
+  }
+
+private:
+  using KeySet     = std::set<TrackKey>;
+  using FieldIndex = std::map<std::string, KeySet, std::less<>>;
+
+  mutable std::shared_mutex                    m_mutex;
+  Catalog                                      m_catalog;
+  FieldIndex                                   m_byArtist;
+  FieldIndex                                   m_byAlbum;
+  FieldIndex                                   m_byCodec;
+  std::atomic<ui64>                            m_generation{1};
+  std::mutex                                   m_renderMutex;
+  ui64                                         m_renderedGeneration = 0;
+  std::shared_ptr<const encoding::EncodedBody> m_rendered;
+
+  static auto parse(const std::filesystem::path& metadata_path) -> TrackInfo
+  {
+    std::error_code ec;
+    if (!std::filesystem::exists(metadata_path, ec))
+      return {};
+
+    try
+    {
+      return TrackInfo::from(parseAudioMetadata(metadata_path.string()));
+    }
+    catch (const std::exception&)
+    {
+      return {};
+    }
+  }
+
+  static auto matches(const TrackQuery& q, const StorageOwnerID& owner, const TrackInfo& t)
+    -> bool
+  {
+    if (!q.owner.empty() && owner != q.owner)
+      return false;
+    if (q.artist.empty() && q.album.empty() && q.codec.empty())
+      return true;
+    return t.has_metadata && (q.artist.empty() || t.artist == q.artist) &&
+           (q.album.empty() || t.album == q.album) && (q.codec.empty() || t.codec == q.codec);
+  }
+
+  // Smallest index set among the requested field filters; nullptr if there are none
+  auto pick_index(const TrackQuery& q) const -> const KeySet*
+  {
+    static const KeySet none;
+    const KeySet*       best     = nullptr;
+    bool                filtered = false;
+
+    auto consider = [&](const FieldIndex& index, const std::string& value)
+    {
+      if (value.empty())
+        return;
+      filtered          = true;
+      auto          it   = index.find(value);
+      const KeySet* keys = it == index.end() ? &none : &it->second;
+      if (!best || keys->size() < best->size())
+        best = keys;
+    };
+
+    consider(m_byArtist, q.artist);
+    consider(m_byAlbum, q.album);
+    consider(m_byCodec, q.codec);
+    return filtered ? best : nullptr;
+  }
+
+  auto has_locked(const StorageOwnerID& owner, const StorageAudioID& audio_id) const -> bool
+  {
+    auto it = m_catalog.find(owner);
+    return it != m_catalog.end() && it->second.contains(audio_id);
+  }
+
+  void put_locked(const StorageOwnerID& owner, const StorageAudioID& audio_id, TrackInfo info)
+  {
+    auto& tracks = m_catalog[owner];
+    if (auto old = tracks.find(audio_id); old != tracks.end())
+      unindex({owner, audio_id}, old->second);
+
+    index({owner, audio_id}, info);
+    tracks.insert_or_assign(audio_id, std::move(info));
+    m_generation.fetch_add(1, std::memory_order_release);
+  }
+
+  void index(const TrackKey& key, const TrackInfo& t)
+  {
+    if (!t.has_metadata)
+      return;
+    m_byArtist[t.artist].insert(key);
+    m_byAlbum[t.album].insert(key);
+    m_byCodec[t.codec].insert(key);
+  }
+
+  void unindex(const TrackKey& key, const TrackInfo& t)
+  {
+    if (!t.has_metadata)
+      return;
+
+    auto drop = [&](FieldIndex& index, const std::string& value)
+    {
+      auto it = index.find(value);
+      if (it == index.end())
+        return;
+      it->second.erase(key);
+      if (it->second.empty())
+        index.erase(it);
+    };
+
+    drop(m_byArtist, t.artist);
+    drop(m_byAlbum, t.album);
+    drop(m_byCodec, t.codec);
+  }
+};
+
+} // namespace libwavy::server
@@ -0,0 +1,344 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <charconv>
+#include <crow.h>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/log-macros.hpp>
+#include <libwavy/server/json-writer.hpp>
+#include <libwavy/server/metadata-catalog.hpp>
+#include <libwavy/server/metrics.hpp>
+#include <libwavy/server/request-timer.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+
+using Server = libwavy::log::SERVER;
+
+/*
+ * JSON catalog API (GET /catalog/tracks, GET /catalog/owners)
+ *
+ * Pages are ordered by (owner, audio-id) and addressed with an opaque cursor, the
+ * key of the last item of the previous page, so inserts and deletes never shift or
+ * repeat items across pages. Each page is answered from MetadataCatalog in
+ * O(log n + limit) and written straight into the response body by JsonWriter.
+ *
+ *   /catalog/tracks?limit=&cursor=&owner=&artist=&album=&codec=&fields=title,artist
+ *   /catalog/owners?limit=&cursor=
+ */
+
+namespace libwavy::server::methods
+{
+
+enum TrackField : ui16
+{
+  TRACK_FIELD_TITLE         = 1 << 0,
+  TRACK_FIELD_ARTIST        = 1 << 1,
+  TRACK_FIELD_ALBUM         = 1 << 2,
+  TRACK_FIELD_DURATION      = 1 << 3,
+  TRACK_FIELD_BITRATE       = 1 << 4,
+  TRACK_FIELD_SAMPLE_RATE   = 1 << 5,
+  TRACK_FIELD_SAMPLE_FORMAT = 1 << 6,
+  TRACK_FIELD_AUDIO_BITRATE = 1 << 7,
+  TRACK_FIELD_CODEC         = 1 << 8,
+  TRACK_FIELD_BITRATES      = 1 << 9,
+  TRACK_FIELD_ALL           = (1 << 10) - 1
+};
+
+class CatalogManager
+{
+public:
+  CatalogManager(Metrics& metrics, MetadataCatalog& catalog)
+      : m_metrics(metrics), m_catalog(catalog)
+  {
+  }
+
+  auto list_tracks(const crow::request& req) -> crow::response
+  {
+    RequestTimer req_timer(m_metrics, MetricsRoute::Catalog);
+
+    TrackQuery q;
+    ui16       fields = TRACK_FIELD_ALL;
+
+    if (!parse_limit(req, q.limit) || !parse_fields(req.url_params.get("fields"), fields))
+      return bad_request(req_timer, "invalid 'limit' or 'fields'");
+
+    if (const char* cursor = req.url_params.get("cursor"))
+    {
+      auto key = decode_cursor(cursor);
+      auto sep = key ? key->find('\0') : std::string::npos;
+      if (sep == std::string::npos)
+        return bad_request(req_timer, "invalid 'cursor'");
+      q.after = TrackKey{key->substr(0, sep), key->substr(sep + 1)};
+    }
+
+    q.owner  = param(req, "owner");
+    q.artist = param(req, "artist");
+    q.album  = param(req, "album");
+    q.codec  = param(req, "codec");
+
+    crow::response res;
+    res.body.reserve(q.limit * 256);
+    JsonWriter json(res.body);
+
+    json.begin_object().field("generation", m_catalog.generation()).key("items").begin_array();
+
+    size_t count = 0;
+    auto   next  = m_catalog.visit_tracks(
+      q,
+      [&](const StorageOwnerID& owner, const StorageAudioID& audio_id, const TrackInfo& t)
+      {
+        write_track(json, owner, audio_id, t, fields);
+        ++count;
+      });
+
+    json.end_array().field("count", static_cast<ui64>(count)).key("next_cursor");
+    if (next)
+      json.value(encode_cursor(next->first + '\0' + next->second));
+    else
+      json.null();
+    json.end_object();
+
+    return finish(req_timer, res);
+  }
+
+  auto list_owners(const crow::request& req) -> crow::response
+  {
+    RequestTimer req_timer(m_metrics, MetricsRoute::Catalog);
+
+    size_t                        limit = WAVY_SERVER_CATALOG_PAGE_DEFAULT;
+    std::optional<StorageOwnerID> after;
+
+    if (!parse_limit(req, limit))
+      return bad_request(req_timer, "invalid 'limit'");
+
+    if (const char* cursor = req.url_params.get("cursor"))
+    {
+      after = decode_cursor(cursor);
+      if (!after)
+        return bad_request(req_timer, "invalid 'cursor'");
+    }
+
+    crow::response res;
+    JsonWriter     json(res.body);
+
+    json.begin_object().field("generation", m_catalog.generation()).key("items").begin_array();
+
+    auto next = m_catalog.visit_owners(
+      after, limit,
+      [&](const StorageOwnerID& owner, size_t tracks)
+      {
+        json.begin_object()
+          .field("owner", owner)
+          .field("tracks", static_cast<ui64>(tracks))
+          .end_object();
+      });
+
+    json.end_array().key("next_cursor");
+    if (next)
+      json.value(encode_cursor(*next));
+    else
+      json.null();
+    json.end_object();
+
+    return finish(req_timer, res);
+  }
+
+private:
+  Metrics&         m_metrics;
+  MetadataCatalog& m_catalog;
+
+  static auto param(const crow::request& req, const char* name) -> std::string
+  {
+    const char* v = req.url_params.get(name);
+    return v ? v : "";
+  }
+
+  static auto parse_limit(const crow::request& req, size_t& limit) -> bool
+  {
+    const char* v = req.url_params.get("limit");
+    if (!v)
+    {
+      limit = WAVY_SERVER_CATALOG_PAGE_DEFAULT;
+      return true;
+    }
+
+    const std::string_view s(v);
+    size_t                 n = 0;
+    auto [ptr, ec]           = std::from_chars(s.data(), s.data() + s.size(), n);
+    if (ec != std::errc{} || ptr != s.data() + s.size() || n == 0)
+      return false;
+
+    limit = std::min<size_t>(n, WAVY_SERVER_CATALOG_PAGE_MAX);
+    return true;
+  }
+
+  static auto parse_fields(const char* v, ui16& fields) -> bool
+  {
+    if (!v)
+      return true;
+
+    fields = 0;
+    std::string_view rest(v);
+    while (!rest.empty())
+    {
+      const auto comma = rest.find(',');
+      const auto name  = rest.substr(0, comma);
+      rest             = comma == std::string_view::npos ? "" : rest.substr(comma + 1);
+
+      const ui16 bit = field_bit(name);
+      if (bit == 0)
+        return false;
+      fields |= bit;
+    }
+    return fields != 0;
+  }
+
+  static auto field_bit(std::string_view name) -> ui16
+  {
+    if (name == "title")
+      return TRACK_FIELD_TITLE;
+    if (name == "artist")
+      return TRACK_FIELD_ARTIST;
+    if (name == "album")
+      return TRACK_FIELD_ALBUM;
+    if (name == "duration")
+      return TRACK_FIELD_DURATION;
+    if (name == "bitrate")
+      return TRACK_FIELD_BITRATE;
+    if (name == "sample_rate")
+      return TRACK_FIELD_SAMPLE_RATE;
+    if (name == "sample_format")
+      return TRACK_FIELD_SAMPLE_FORMAT;
+    if (name == "audio_bitrate")
+      return TRACK_FIELD_AUDIO_BITRATE;
+    if (name == "codec")
+      return TRACK_FIELD_CODEC;
+    if (name == "bitrates")
+      return TRACK_FIELD_BITRATES;
+    return 0;
+  }
+
+  static void write_track(JsonWriter& json, const StorageOwnerID& owner,
+                          const StorageAudioID& audio_id, const TrackInfo& t, ui16 fields)
+  {
+    json.begin_object().field("owner", owner).field("audio_id", audio_id);
+
+    if (!t.has_metadata)
+    {
+      json.field("has_metadata", false).end_object();
+      return;
+    }
+
+    if (fields & TRACK_FIELD_TITLE)
+      json.field("title", t.title);
+    if (fields & TRACK_FIELD_ARTIST)
+      json.field("artist", t.artist);
+    if (fields & TRACK_FIELD_ALBUM)
+      json.field("album", t.album);
+    if (fields & TRACK_FIELD_DURATION)
+      json.field("duration", t.duration);
+    if (fields & TRACK_FIELD_BITRATE)
+      json.field("bitrate", t.bitrate);
+    if (fields & TRACK_FIELD_SAMPLE_RATE)
+      json.field("sample_rate", t.sample_rate);
+    if (fields & TRACK_FIELD_SAMPLE_FORMAT)
+      json.field("sample_format", t.sample_format);
+    if (fields & TRACK_FIELD_AUDIO_BITRATE)
+      json.field("audio_bitrate", t.stream_bitrate);
+    if (fields & TRACK_FIELD_CODEC)
+      json.field("codec", t.codec);
+    if (fields & TRACK_FIELD_BITRATES)
+    {
+      json.key("bitrates").begin_array();
+      for (int br : t.bitrates)
+        json.value(br);
+      json.end_array();
+    }
+
+    json.end_object();
+  }
+
+  // Cursors are hex so they survive any query string untouched
+  static auto encode_cursor(std::string_view key) -> std::string
+  {
+    static constexpr char digits[] = "0123456789abcdef";
+
+    std::string out;
+    out.reserve(key.size() * 2);
+    for (const unsigned char c : key)
+    {
+      out += digits[c >> 4];
+      out += digits[c & 0x0f];
+    }
+    return out;
+  }
+
+  static auto decode_cursor(std::string_view hex) -> std::optional<std::string>
+  {
+    if (hex.empty() || hex.size() % 2 != 0)
+      return std::nullopt;
+
+    auto nibble = [](char c) -> int
+    {
+      if (c >= '0' && c <= '9')
+        return c - '0';
+      if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+      return -1;
+    };
+
+    std::string out;
+    out.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2)
+    {
+      const int hi = nibble(hex[i]);
+      const int lo = nibble(hex[i + 1]);
+      if (hi < 0 || lo < 0)
+        return std::nullopt;
+      out += static_cast<char>((hi << 4) | lo);
+    }
+    return out;
+  }
+
+  static auto bad_request(RequestTimer& req_timer, const std::string& why) -> crow::response
+  {
+    log::WARN<Server>(LogMode::Async, "Catalog request rejected: {}", why);
+    req_timer.mark_error_400();
+    return {400, why};
+  }
+
+  static auto finish(RequestTimer& req_timer, crow::response& res) -> crow::response
+  {
+    res.code = 200;
+    res.set_header("Content-Type", macros::to_string(macros::CONTENT_TYPE_JSON));
+    res.set_header("Cache-Control", "no-cache");
+    req_timer.mark_success();
+    return std::move(res);
+  }
+};
+
+} // namespace libwavy::server::methods
@@ -24,15 +24,32 @@
  ********************************************************************************/
 
 #include <crow.h>
+#include <libwavy/common/bundle.hpp>
+#include <libwavy/common/content-encoding.hpp>
 #include <libwavy/common/macros.hpp>
 #include <libwavy/common/types.hpp>
 #include <libwavy/log-macros.hpp>
+#include <libwavy/parser/byterange.hpp>
+#include <libwavy/server/bandwidth-shaper.hpp>
+#include <libwavy/server/file-handle-cache.hpp>
+#include <libwavy/server/http-range.hpp>
 #include <libwavy/server/metrics.hpp>
 #include <libwavy/server/prototypes.hpp>
 #include <libwavy/server/request-timer.hpp>
-
-#include <fstream>
+#include <libwavy/server/segment-cache.hpp>
+#include <libwavy/server/segment-loader.hpp>
+#include <libwavy/server/validators.hpp>
+#include <libwavy/utils/io/mmap/entry.hpp>
+#include <libwavy/utils/io/pread/entry.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -47,85 +64,210 @@ inline auto detectStreamMIMEType(const AbsPath& filename) -> const std::string
     return "application/vnd.apple.mpegurl";
   if (filename.ends_with(macros::TRANSPORT_STREAM_EXT))
     return "video/mp2t";
+  if (filename.ends_with(macros::TOML_FILE_EXT))
+    return "application/toml";
+  if (filename.ends_with(macros::SEEK_INDEX_EXT))
+    return "text/plain; charset=utf-8";
   return macros::to_string(macros::CONTENT_TYPE_OCTET_STREAM);
 }
 
 class DownloadManager
 {
 public:
-  DownloadManager(Metrics& metrics, StorageOwnerID owner_id, StorageAudioID audio_id,
+  DownloadManager(Metrics& metrics, SegmentCache& cache, SegmentLoader& loader,
+                  FileHandleCache& files, BandwidthShaper& shaper, ValidatorStore& validators,
+                  const OwnerAudioIDMap& tracks, StorageOwnerID owner_id, StorageAudioID audio_id,
                   const crow::request& req)
-      : m_metrics(metrics), m_ownerID(std::move(owner_id)), m_audioID(std::move(audio_id)),
+      : m_metrics(metrics), m_cache(cache), m_loader(loader), m_files(files), m_shaper(shaper),
+        m_validators(validators), m_tracks(tracks), m_ownerID(std::move(owner_id)),
+        m_audioID(std::move(audio_id)), m_generation(cache.generation(m_ownerID, m_audioID)),
         m_request(req)
   {
   }
 
   auto runDirect(const AbsPath& filename) -> crow::response
   {
-    RequestTimer timer(m_metrics);
+    RequestTimer timer(m_metrics, MetricsRoute::Download);
+    OwnerTraffic traffic(*this, timer, MetricsRoute::Download);
     m_metrics.download_requests++;
 
-    m_metrics.owners[m_ownerID].downloads++;
+    m_trackValidators = m_validators.get(m_ownerID, m_audioID);
+    negotiateCoding(filename);
 
-    const fs::path file_path =
-      fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / m_ownerID / m_audioID / filename;
+    // Everything below works on the stored representation: the file or one of its variants
+    const std::string stored = storedName(filename);
+    const fs::path    file_path =
+      fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / m_ownerID / m_audioID / stored;
+    const std::string key          = SegmentCache::make_key(m_ownerID, m_audioID, stored);
+    const std::string content_type = detectStreamMIMEType(filename);
 
     log::INFO<ServerDownload>(LogMode::Async, "Attempting to serve file: {}", file_path.string());
 
-    if (!fs::exists(file_path))
+    if (isNotModified(filename))
+    {
+      crow::response res;
+      fillNotModified(res, filename, timer);
+      return res;
+    }
+
+    const std::string range_header = effectiveRange(filename);
+
+    CachedBody body;
+    switch (m_cache.get(key, body))
+    {
+      case SegmentCache::Lookup::Hit:
+        m_served.cache_hits = 1;
+        if (!range_header.empty())
+        {
+          const auto range = parse_range_header(range_header, body->size());
+          if (range.status != RangeStatus::None)
+            return serveRange(range, body->size(), content_type, filename, timer,
+                              memory_range_reader(*body));
+        }
+        return serveBody(body, content_type, filename, timer);
+
+      case SegmentCache::Lookup::Negative:
+        log::ERROR<ServerDownload>(LogMode::Async, "File not found (cached): {}",
+                                   file_path.string());
+        timer.mark_error_404();
+        return {404, "File not found."};
+
+      case SegmentCache::Lookup::Miss:
+        break;
+    }
+
+    std::error_code ec;
+    const auto      file_size = fs::file_size(file_path, ec);
+    if (ec)
     {
       log::ERROR<ServerDownload>(LogMode::Async, "File not found: {}", file_path.string());
+      rememberMissing(key, file_path);
+      timer.mark_error_404();
       return {404, "File not found."};
     }
 
-    std::string content_type = detectStreamMIMEType(filename);
+    // Partial requests only ever read the requested window and bypass the cache, a
+    // resuming client should not pull the whole segment into memory on our side.
+    if (!range_header.empty())
+    {
+      const auto file = m_files.open(m_ownerID, m_audioID, filename.str());
+      if (!file)
+      {
+        log::ERROR<ServerDownload>(LogMode::Async, "File vanished before serving: {}",
+                                   file_path.string());
+        timer.mark_error_404();
+        return {404, "File not found."};
+      }
+
+      const auto range = parse_range_header(range_header, file->size());
+      if (range.status != RangeStatus::None)
+        return serveRange(range, file->size(), content_type, filename, timer,
+                          [&file](ui64 offset, ui64 len, std::string& out)
+                          { return file->read_at(offset, len, out); });
+    }
+
+    // Small enough to keep around: read it once, cache it and serve from memory
+    if (file_size <= m_cache.max_object_size())
+    {
+      if ((body = m_loader.load(file_path)))
+      {
+        m_cache.put(key, body, m_generation);
+        return serveBody(body, content_type, filename, timer);
+      }
+    }
 
+    // Hand the file over to Crow's static file writer: it streams the file to the
+    // socket in `stream_threshold` sized pieces, so we never hold the whole segment
+    // in a heap allocated body.
     crow::response res;
-    res.code = 200;
+    if (!admit(file_size, res, timer))
+      return res;
+    readAhead(filename);
+
+    res.set_static_file_info_unsafe(file_path.string());
+    if (!res.is_static_type())
+    {
+      log::ERROR<ServerDownload>(LogMode::Async, "File vanished before serving: {}",
+                                 file_path.string());
+      timer.mark_error_404();
+      return {404, "File not found."};
+    }
+
     res.set_header("Server", "Wavy Server");
     res.set_header("Content-Type", content_type);
-    res.body = readFile(file_path.string());
-    res.set_header("Content-Length", std::to_string(res.body.size()));
+    res.set_header("Accept-Ranges", "bytes");
+    setCacheHeaders(res, filename);
+    if (m_coding != encoding::Coding::Identity)
+      m_metrics.encoded_responses++;
 
-    log::INFO<ServerDownload>(LogMode::Async, "Serving '{}' ({} bytes) [{}]", filename.str(),
-                              res.body.size(), content_type);
+    log::INFO<ServerDownload>(LogMode::Async, "Serving '{}' ({} bytes) [{}, {}]", filename.str(),
+                              file_size, content_type, encoding::token(m_coding));
 
-    guessDownloadSize(res, timer);
+    countBytes(file_size);
+    timer.mark_success();
 
     return res;
   }
 
   auto runStream(const AbsPath& filename, crow::response& res) -> void
   {
-    RequestTimer timer(m_metrics);
+    RequestTimer timer(m_metrics, MetricsRoute::Stream);
+    OwnerTraffic traffic(*this, timer, MetricsRoute::Stream);
     m_metrics.download_requests++;
-    m_metrics.owners[m_ownerID].downloads++;
 
     const fs::path file_path =
       fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / m_ownerID / m_audioID / filename;
+    const std::string key = SegmentCache::make_key(m_ownerID, m_audioID, filename);
 
-    // Set content type
-    const std::string content_type = detectStreamMIMEType(filename);
-    res.set_header("Content-Type", content_type);
-    res.set_header("Transfer-Encoding", "chunked");
+    m_trackValidators = m_validators.get(m_ownerID, m_audioID);
+    if (isNotModified(filename))
+    {
+      fillNotModified(res, filename, timer);
+      res.end();
+      return;
+    }
+
+    const std::string range_header = effectiveRange(filename);
+
+    // Either a cached body or (for range requests) a positioned reader backs `source`.
+    // A whole file too large to cache goes to Crow's static file writer like /download.
+    CachedBody       cached;
+    FileHandle       partial;
+    std::string_view source;
+    std::string      ranged;
+    ui64             static_size = 0;
 
-    // Helper lambda to write a chunk
-    auto L_WriteChunk = [&res](const std::string& data)
+    auto lookup = m_cache.get(key, cached);
+    if (lookup == SegmentCache::Lookup::Hit)
+      m_served.cache_hits = 1;
+    else if (lookup == SegmentCache::Lookup::Miss && !range_header.empty())
     {
-      if (!data.empty())
+      partial = m_files.open(m_ownerID, m_audioID, filename.str());
+      if (!partial)
       {
-        std::stringstream hex_size;
-        hex_size << std::hex << data.size();
-        res.write(hex_size.str() + CRLF);
-        res.write(data + CRLF);
+        rememberMissing(key, file_path);
+        lookup = SegmentCache::Lookup::Negative;
       }
-    };
-
-    constexpr size_t CHUNK            = 64 * 1024;
-    size_t           total_bytes_sent = 0;
+    }
+    else if (lookup == SegmentCache::Lookup::Miss)
+    {
+      std::error_code ec;
+      const auto      size = fs::file_size(file_path, ec);
+      if (!ec && size <= m_cache.max_object_size())
+        cached = m_loader.load(file_path);
+
+      if (cached)
+        m_cache.put(key, cached, m_generation);
+      else if (!ec && size > m_cache.max_object_size())
+        static_size = size;
+      else
+      {
+        rememberMissing(key, file_path);
+        lookup = SegmentCache::Lookup::Negative;
+      }
+    }
 
-    std::ifstream file(file_path.string(), std::ios::binary);
-    if (!file)
+    if (lookup == SegmentCache::Lookup::Negative)
     {
       log::ERROR<ServerDownload>("Failed to open file '{}'", file_path.string());
       timer.mark_error_404();
@@ -134,68 +276,623 @@ public:
       return;
     }
 
-    std::vector<char> buffer(CHUNK);
+    if (cached)
+      source = *cached;
 
-    while (file)
+    std::string content_type = detectStreamMIMEType(filename);
+
+    if (!range_header.empty())
     {
-      file.read(buffer.data(), buffer.size());
-      std::streamsize bytes_read = file.gcount();
-      if (bytes_read > 0)
-      {
-        L_WriteChunk(std::string(buffer.data(), static_cast<size_t>(bytes_read)));
-        total_bytes_sent += static_cast<size_t>(bytes_read);
+      const ui64 size  = partial ? partial->size() : source.size();
+      const auto range = parse_range_header(range_header, size);
 
-        log::DBG<ServerDownload>("Wrote {} bytes to response (total: {})", bytes_read,
-                                 total_bytes_sent);
+      if (range.status != RangeStatus::None)
+      {
+        m_metrics.range_requests++;
+
+        auto body = partial
+                      ? build_range_body(range, size, content_type,
+                                         [&partial](ui64 offset, ui64 len, std::string& out)
+                                         { return partial->read_at(offset, len, out); })
+                      : build_range_body(range, size, content_type, memory_range_reader(source));
+        if (!body)
+        {
+          log::ERROR<ServerDownload>("Failed to read requested range of '{}'",
+                                     file_path.string());
+          timer.mark_error_500();
+          res.code = 500;
+          res.end();
+          return;
+        }
+
+        res.code     = body->code;
+        content_type = body->content_type;
+        if (!body->content_range.empty())
+          res.set_header("Content-Range", body->content_range);
+        if (body->code == 416)
+          timer.mark_error_416();
+
+        ranged = std::move(body->body);
+        source = ranged;
+      }
+      else if (partial)
+      {
+        // Header was ignored, fall back to the whole file
+        if (!partial->read_at(0, size, ranged))
+        {
+          timer.mark_error_500();
+          res.code = 500;
+          res.end();
+          return;
+        }
+        source = ranged;
       }
     }
 
-    // Final empty chunk
-    res.write(std::format("0{}", CRLF2));
+    const ui64 total_bytes = static_size > 0 ? static_size : source.size();
+    if (res.code != 416 && !admit(total_bytes, res, timer))
+    {
+      res.end();
+      return;
+    }
+    if (res.code != 416)
+      readAhead(filename);
 
-    log::INFO<ServerDownload>("Finished streaming {} bytes for '{}'", total_bytes_sent,
-                              filename.str());
+    res.set_header("Content-Type", content_type);
+    res.set_header("Accept-Ranges", "bytes");
+    if (res.code != 416)
+      setCacheHeaders(res, filename);
+
+    // Crow frames the response (Content-Length) and writes it to the socket in
+    // `stream_threshold` sized pieces; a static file is never held in memory at all
+    if (static_size > 0)
+    {
+      res.set_static_file_info_unsafe(file_path.string());
+      if (!res.is_static_type())
+      {
+        log::ERROR<ServerDownload>("File vanished before streaming: {}", file_path.string());
+        timer.mark_error_404();
+        res = crow::response(404, "File not found.");
+        res.end();
+        return;
+      }
+    }
+    else if (source.data() == ranged.data())
+      res.body = std::move(ranged);
+    else
+      res.body.assign(source);
+
+    log::INFO<ServerDownload>("Streaming {} bytes of '{}'", total_bytes, filename.str());
     res.end();
 
     // Update metrics
-    m_metrics.bytes_downloaded += total_bytes_sent;
+    countBytes(total_bytes);
+    if (res.code != 416)
+      timer.mark_success();
+  }
+
+  // Up to `count` consecutive segments of a media playlist, starting at segment `start`,
+  // in one response (framing in libwavy/common/bundle.hpp). `?playlist=1` puts the
+  // playlist itself in front. `X-Wavy-Bundle-Next` carries the index to ask for next and
+  // is absent once the playlist is exhausted.
+  auto runBundle(const AbsPath& playlist) -> crow::response
+  {
+    RequestTimer timer(m_metrics, MetricsRoute::Bundle);
+    OwnerTraffic traffic(*this, timer, MetricsRoute::Bundle);
+    m_metrics.download_requests++;
+
+    size_t start = 0;
+    size_t count = WAVY_SERVER_BUNDLE_MAX_SEGMENTS;
+    if (!playlist.ends_with(macros::PLAYLIST_EXT) || !parseIndex("start", start) ||
+        !parseIndex("count", count) || count == 0)
+    {
+      timer.mark_error_400();
+      return {400, "Expected a playlist and numeric 'start'/'count'."};
+    }
+    count = std::min<size_t>(count, WAVY_SERVER_BUNDLE_MAX_SEGMENTS);
+
+    const char* with_playlist = m_request.url_params.get("playlist");
+    const bool  include_playlist =
+      with_playlist && (std::string_view(with_playlist) == "1" ||
+                        std::string_view(with_playlist) == "true");
+
+    auto playlist_part = openPart(playlist.str());
+    if (!playlist_part || !loadCold(std::span(&*playlist_part, 1)))
+    {
+      timer.mark_error_404();
+      return {404, "Playlist not found."};
+    }
+
+    // Segment URIs in playlist order; a master playlist only lists other playlists.
+    // Packed tracks address each segment as an EXT-X-BYTERANGE of the pack.
+    struct Entry
+    {
+      std::string_view                           uri;
+      std::optional<hls::parser::MediaByteRange> range;
+    };
+    std::vector<Entry>                         entries;
+    std::optional<hls::parser::MediaByteRange> pending_range;
+    ui64                                       next_offset = 0;
+
+    for (const auto line_range : std::views::split(playlist_part->data, '\n'))
+    {
+      std::string_view line(line_range.begin(), line_range.end());
+      if (line.ends_with('\r'))
+        line.remove_suffix(1);
+      if (line.starts_with(hls::parser::macro::EXT_X_BYTERANGE))
+      {
+        if ((pending_range = hls::parser::parse_byterange(line, next_offset)))
+          next_offset = pending_range->end();
+        continue;
+      }
+      if (line.empty() || line.starts_with('#'))
+        continue;
+      if (line.ends_with(macros::PLAYLIST_EXT))
+      {
+        timer.mark_error_400();
+        return {400, "Bundles are only served for media playlists."};
+      }
+      entries.push_back({line, std::exchange(pending_range, std::nullopt)});
+    }
+
+    if (start >= entries.size())
+    {
+      timer.mark_error_416();
+      return {416, "Playlist has " + std::to_string(entries.size()) + " segments."};
+    }
+
+    // Each distinct file is opened once, however many packed segments come out of it
+    const size_t                                 end = std::min(entries.size(), start + count);
+    std::vector<Part>                            files;
+    std::vector<size_t>                          file_of; // entry - start -> files
+    std::unordered_map<std::string_view, size_t> file_index;
+    files.reserve(end - start);
+    file_of.reserve(end - start);
+
+    for (size_t i = start; i < end; ++i)
+    {
+      // Only plain file names of this track, never paths out of its directory
+      const std::string_view uri = entries[i].uri;
+      if (uri.find('/') != std::string_view::npos || uri == "..")
+      {
+        log::ERROR<ServerDownload>(LogMode::Async, "Refusing segment '{}' of '{}'", uri,
+                                   playlist.str());
+        timer.mark_error_500();
+        return {500, "Playlist references a file outside its track."};
+      }
+
+      auto [it, fresh] = file_index.try_emplace(uri, files.size());
+      if (fresh)
+      {
+        auto part = openPart(std::string(uri));
+        if (!part)
+        {
+          timer.mark_error_404();
+          return {404, "Segment '" + std::string(uri) + "' not found."};
+        }
+        files.push_back(std::move(*part));
+      }
+      file_of.push_back(it->second);
+    }
+
+    // Every segment missing from the cache is read in one batch, with one wait
+    const bool warm = std::ranges::all_of(files, &Part::cached);
+    if (!loadCold(files))
+    {
+      timer.mark_error_404();
+      return {404, "Segment vanished before serving."};
+    }
+
+    std::vector<bundle::Frame> frames;
+    frames.reserve(end - start + 1);
+    if (include_playlist)
+      frames.push_back({playlist.str(), playlist_part->data});
+
+    for (size_t i = start; i < end; ++i)
+    {
+      const auto& [uri, range] = entries[i];
+      const auto& data         = files[file_of[i - start]].data;
+      if (range && range->end() > data.size())
+      {
+        log::ERROR<ServerDownload>(LogMode::Async, "Byte range past the end of '{}'", uri);
+        timer.mark_error_500();
+        return {500, "Playlist byte range is out of bounds."};
+      }
+      frames.push_back({uri, range ? data.substr(range->offset, range->length) : data});
+    }
+
+    // One allocation for the whole bundle, one copy per segment out of the cache or the
+    // page cache
+    size_t total = bundle::HEADER_SIZE;
+    for (const auto& frame : frames)
+      total += bundle::frame_size(frame.name.size(), frame.payload.size());
+
+    crow::response res(200);
+    if (!admit(total, res, timer))
+      return res;
+
+    // A client walking the playlist asks for the following segments next
+    {
+      std::vector<FileName> upcoming;
+      for (size_t i = end; i < entries.size() && upcoming.size() < m_loader.readahead(); ++i)
+        upcoming.emplace_back(entries[i].uri);
+      m_loader.prefetch(m_ownerID, m_audioID, upcoming);
+    }
+
+    res.body.reserve(total);
+    bundle::append_header(res.body, static_cast<ui32>(frames.size()));
+    for (const auto& frame : frames)
+      bundle::append_frame(res.body, frame.name, frame.payload);
+
+    res.set_header("Server", "Wavy Server");
+    res.set_header("Content-Type", std::string(bundle::CONTENT_TYPE));
+    // Segments never change; with the playlist inside, the bundle ages like the playlist
+    res.set_header("Cache-Control",
+                   cache_control_for(include_playlist ? playlist.str() : files.back().name));
+    if (end < entries.size())
+      res.set_header("X-Wavy-Bundle-Next", std::to_string(end));
+
+    log::INFO<ServerDownload>(LogMode::Async, "Bundled {} files ({} bytes) from '{}'",
+                              frames.size(), res.body.size(), playlist.str());
+
+    m_served.cache_hits = warm ? 1 : 0;
+    countBytes(res.body.size());
     timer.mark_success();
+    return res;
   }
 
 private:
-  StorageOwnerID       m_ownerID;
-  StorageAudioID       m_audioID;
-  const crow::request& m_request;
-  Metrics&             m_metrics;
+  Metrics&               m_metrics;
+  SegmentCache&          m_cache;
+  SegmentLoader&         m_loader;
+  FileHandleCache&       m_files;
+  BandwidthShaper&       m_shaper;
+  ValidatorStore&        m_validators;
+  const OwnerAudioIDMap& m_tracks;
+  StorageOwnerID         m_ownerID;
+  StorageAudioID         m_audioID;
+  ui64                   m_generation; // of the track before anything of it was read
+  const crow::request&   m_request;
+  TrackValidatorsPtr     m_trackValidators;
+  LabeledSample          m_served; // this request's share of the owner/track counters
+  encoding::Coding       m_coding = encoding::Coding::Identity; // representation being sent
+  bool                   m_varies = false; // response depends on Accept-Encoding
+
+  // Files the request under its owner, track and route when the handler returns, or under
+  // `_overflow` when the URL named a track that is not stored. Must be constructed after
+  // the handler's RequestTimer so it runs first and sees the final class.
+  class OwnerTraffic
+  {
+  public:
+    OwnerTraffic(DownloadManager& dm, const RequestTimer& timer, MetricsRoute route)
+        : m_dm(dm), m_timer(timer), m_route(route)
+    {
+      m_dm.m_served = {.requests = 1};
+    }
+
+    OwnerTraffic(const OwnerTraffic&)                    = delete;
+    auto operator=(const OwnerTraffic&) -> OwnerTraffic& = delete;
+
+    ~OwnerTraffic()
+    {
+      const auto cls = m_timer.status_class();
+      if (cls == StatusClass::ClientError || cls == StatusClass::ServerError)
+        m_dm.m_served.errors = 1;
+      if (m_dm.m_tracks.has(m_dm.m_ownerID, m_dm.m_audioID))
+        m_dm.m_metrics.record_owner_traffic(m_dm.m_ownerID, m_dm.m_audioID, m_route,
+                                            m_dm.m_served);
+      else
+        m_dm.m_metrics.record_unknown_traffic(m_dm.m_served);
+    }
+
+  private:
+    DownloadManager&    m_dm;
+    const RequestTimer& m_timer;
+    MetricsRoute        m_route;
+  };
+
+  // Holds the response until the shaper lets `bytes` out. When it refuses, `res` becomes
+  // the 429 (client over budget) or 503 with Retry-After and false is returned.
+  auto admit(ui64 bytes, crow::response& res, RequestTimer& timer) -> bool
+  {
+    const auto admission = m_shaper.admit(m_request.remote_ip_address, m_ownerID, bytes);
+    if (admission.outcome == Admission::Admitted)
+      return true;
+
+    const bool client_limited = admission.outcome == Admission::ClientLimited;
+    log::WARN<ServerDownload>(LogMode::Async, "Refused {} bytes to {} ({}), retry in {}s", bytes,
+                              m_request.remote_ip_address,
+                              client_limited ? "client over budget" : "egress saturated",
+                              admission.retry_after.count());
+
+    res.code = client_limited ? 429 : 503;
+    res.body = client_limited ? "Egress budget exceeded, retry later\n"
+                              : "Server egress saturated, retry later\n";
+    res.set_header("Server", "Wavy Server");
+    res.set_header("Content-Type", "text/plain");
+    res.set_header("Retry-After", std::to_string(admission.retry_after.count()));
+
+    if (client_limited)
+      timer.mark_error_429();
+    else
+      timer.mark_failure();
+    return false;
+  }
+
+  // Only for a file that was found and admitted: the following segments are read in the
+  // background while this one is sent, made-up names never get that far
+  void readAhead(const AbsPath& served)
+  {
+    m_loader.prefetch_after(m_ownerID, m_audioID, served.str());
+  }
+
+  void countBytes(ui64 bytes)
+  {
+    m_metrics.bytes_downloaded += bytes;
+    m_served.bytes += bytes;
+  }
+
+  // Text files go out as one of their precompressed variants when the client accepts
+  // one. Which variants exist comes from the manifest, so this costs no disk access.
+  // Partial requests always get the identity file.
+  void negotiateCoding(const AbsPath& filename)
+  {
+    m_varies = encoding::is_precompressible(filename.str());
+    if (!m_varies || !m_trackValidators || !m_request.get_header_value("Range").empty())
+      return;
 
-  auto readFile(const AbsPath& path) -> std::string
+    auto stored = [&](encoding::Coding coding)
+    { return m_trackValidators->etag_for(encoding::variant_name(filename.str(), coding)); };
+
+    m_coding = encoding::negotiate(m_request.get_header_value("Accept-Encoding"),
+                                   stored(encoding::Coding::Zstd) != nullptr,
+                                   stored(encoding::Coding::Gzip) != nullptr);
+  }
+
+  [[nodiscard]] auto storedName(const AbsPath& filename) const -> std::string
+  {
+    return encoding::variant_name(filename.str(), m_coding);
+  }
+
+  void setCacheHeaders(crow::response& res, const AbsPath& filename) const
+  {
+    res.set_header("Cache-Control", cache_control_for(filename.str()));
+    if (m_varies)
+      res.set_header("Vary", "Accept-Encoding");
+    if (m_coding != encoding::Coding::Identity)
+      res.set_header("Content-Encoding", std::string(encoding::token(m_coding)));
+    if (!m_trackValidators)
+      return;
+
+    if (const auto* etag = m_trackValidators->etag_for(storedName(filename)))
+      res.set_header("ETag", *etag);
+    if (!m_trackValidators->last_modified_http.empty())
+      res.set_header("Last-Modified", m_trackValidators->last_modified_http);
+  }
+
+  [[nodiscard]] auto isNotModified(const AbsPath& filename) const -> bool
+  {
+    if (!m_trackValidators)
+      return false;
+
+    return is_not_modified(m_request.get_header_value("If-None-Match"),
+                           m_request.get_header_value("If-Modified-Since"),
+                           m_trackValidators->etag_for(storedName(filename)),
+                           m_trackValidators->last_modified);
+  }
+
+  void fillNotModified(crow::response& res, const AbsPath& filename, RequestTimer& timer)
+  {
+    res.code = 304;
+    res.set_header("Server", "Wavy Server");
+    setCacheHeaders(res, filename);
+
+    log::DBG<ServerDownload>(LogMode::Async, "Not modified: '{}'", filename.str());
+
+    m_metrics.not_modified_responses++;
+    timer.mark_success();
+  }
+
+  // If-Range: the client only wants the partial body if its copy is still current,
+  // otherwise the whole file (RFC 9110 §13.1.5). ETags compare strongly, dates exactly.
+  [[nodiscard]] auto effectiveRange(const AbsPath& filename) const -> std::string
   {
-    std::ifstream ifs(path, std::ios::binary);
-    if (!ifs)
+    std::string       range    = m_request.get_header_value("Range");
+    const std::string if_range = m_request.get_header_value("If-Range");
+    if (range.empty() || if_range.empty())
+      return range;
+
+    if (!m_trackValidators)
       return {};
-    return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+
+    if (if_range.starts_with('"'))
+    {
+      const auto* etag = m_trackValidators->etag_for(filename.str());
+      return etag && *etag == if_range ? range : std::string{};
+    }
+
+    const auto date = parse_http_date(if_range);
+    return date && *date == m_trackValidators->last_modified ? range : std::string{};
   }
 
-  void guessDownloadSize(crow::response& response, RequestTimer& timer)
+  auto serveBody(const CachedBody& body, const std::string& content_type,
+                 const AbsPath& filename, RequestTimer& timer) -> crow::response
   {
-    // Try to estimate downloaded bytes from response
-    if (response.code == 200 && !response.body.empty())
+    crow::response res;
+    if (!admit(body->size(), res, timer))
+      return res;
+    readAhead(filename);
+
+    res.code = 200;
+    res.set_header("Server", "Wavy Server");
+    res.set_header("Content-Type", content_type);
+    res.set_header("Accept-Ranges", "bytes");
+    setCacheHeaders(res, filename);
+    res.body = *body;
+    if (m_coding != encoding::Coding::Identity)
+      m_metrics.encoded_responses++;
+
+    log::INFO<ServerDownload>(LogMode::Async, "Serving '{}' ({} bytes) [{}, {}] from cache",
+                              filename.str(), res.body.size(), content_type,
+                              encoding::token(m_coding));
+
+    countBytes(res.body.size());
+    timer.mark_success();
+    return res;
+  }
+
+  template <typename ReadFn>
+  auto serveRange(const RangeRequest& range, ui64 size, const std::string& content_type,
+                  const AbsPath& filename, RequestTimer& timer, ReadFn&& read) -> crow::response
+  {
+    m_metrics.range_requests++;
+
+    auto ranged = build_range_body(range, size, content_type, std::forward<ReadFn>(read));
+    if (!ranged)
     {
-      m_metrics.bytes_downloaded += response.body.size();
-      timer.mark_success();
+      log::ERROR<ServerDownload>(LogMode::Async, "Failed to read requested range of '{}'",
+                                 filename.str());
+      timer.mark_error_500();
+      return {500, "Failed to read requested range."};
     }
-    else if (response.code == 404)
+
+    crow::response res;
+    if (ranged->code != 416 && !admit(ranged->body.size(), res, timer))
+      return res;
+
+    res.code = ranged->code;
+    res.set_header("Server", "Wavy Server");
+    res.set_header("Accept-Ranges", "bytes");
+    res.set_header("Content-Type", ranged->content_type);
+    if (!ranged->content_range.empty())
+      res.set_header("Content-Range", ranged->content_range);
+
+    if (ranged->code == 416)
     {
-      timer.mark_error_404();
+      log::ERROR<ServerDownload>(LogMode::Async, "Unsatisfiable range for '{}' ({} bytes)",
+                                 filename.str(), size);
+      timer.mark_error_416();
+      return res;
     }
-    else if (response.code >= 400 && response.code < 500)
+
+    readAhead(filename);
+    setCacheHeaders(res, filename);
+    res.body = std::move(ranged->body);
+
+    log::INFO<ServerDownload>(LogMode::Async, "Serving {} range(s) of '{}' ({} of {} bytes)",
+                              range.ranges.size(), filename.str(), res.body.size(), size);
+
+    countBytes(res.body.size());
+    timer.mark_success();
+    return res;
+  }
+
+  // A file of this track held either by the segment cache or by a mapping. `cold` ones
+  // still have to be read (loadCold()), `data` is empty until then.
+  struct Part
+  {
+    std::string       name;
+    CachedBody        body;
+    utils::MappedFile file;
+    std::string_view  data;
+    bool              cached = false;
+    bool              cold   = false;
+  };
+
+  auto openPart(std::string name) -> std::optional<Part>
+  {
+    const fs::path file_path =
+      fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / m_ownerID / m_audioID / name;
+    const std::string key = SegmentCache::make_key(m_ownerID, m_audioID, name);
+
+    Part part;
+    switch (m_cache.get(key, part.body))
     {
-      timer.mark_error_400();
+      case SegmentCache::Lookup::Hit:
+        part.data   = *part.body;
+        part.cached = true;
+        break;
+
+      case SegmentCache::Lookup::Negative:
+        return std::nullopt;
+
+      case SegmentCache::Lookup::Miss:
+      {
+        std::error_code ec;
+        const auto      size = fs::file_size(file_path, ec);
+        if (!ec && size <= m_cache.max_object_size() && !name.ends_with(macros::PACK_FILE_EXT))
+        {
+          part.cold = true;
+          break;
+        }
+        if (!part.file.open(file_path.string()))
+        {
+          rememberMissing(key, file_path);
+          return std::nullopt;
+        }
+        part.data = part.file.view();
+        break;
+      }
     }
-    else if (response.code >= 500)
+
+    part.name = std::move(name);
+    return part;
+  }
+
+  // Reads all cold parts in one batch. They stay out of the cache like mapped ones.
+  auto loadCold(std::span<Part> parts) -> bool
+  {
+    const fs::path track_dir =
+      fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / m_ownerID / m_audioID;
+
+    std::vector<Part*>    cold;
+    std::vector<fs::path> paths;
+    for (auto& part : parts)
     {
-      timer.mark_error_500();
+      if (!part.cold)
+        continue;
+      cold.push_back(&part);
+      paths.push_back(track_dir / part.name);
     }
+    if (cold.empty())
+      return true;
+
+    auto bodies = m_loader.load_many(paths);
+    for (size_t i = 0; i < cold.size(); ++i)
+    {
+      if (!bodies[i])
+        return false;
+
+      cold[i]->body = std::move(bodies[i]);
+      cold[i]->data = *cold[i]->body;
+      cold[i]->cold = false;
+    }
+    return true;
+  }
+
+  // Unsigned query parameter; absent leaves `out` untouched
+  [[nodiscard]] auto parseIndex(const char* name, size_t& out) const -> bool
+  {
+    const char* v = m_request.url_params.get(name);
+    if (!v)
+      return true;
+
+    const std::string_view s(v);
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc{} && ptr == s.data() + s.size() && !s.empty();
+  }
+
+  // Only a definite ENOENT is worth remembering, transient open errors are not. Neither
+  // are misses of tracks the index does not know: anyone can make those names up, and a
+  // scan of them would push real misses out of the negative LRU.
+  void rememberMissing(const std::string& key, const fs::path& file_path)
+  {
+    if (!m_tracks.has(m_ownerID, m_audioID))
+      return;
+
+    std::error_code ec;
+    if (!fs::exists(file_path, ec) && !ec)
+      m_cache.put_negative(key, m_generation);
   }
 };
 
@@ -0,0 +1,349 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <crow.h>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/log-macros.hpp>
+#include <libwavy/server/bandwidth-shaper.hpp>
+#include <libwavy/server/live-stream.hpp>
+#include <libwavy/server/metrics.hpp>
+#include <libwavy/server/request-timer.hpp>
+#include <libwavy/utils/math/entry.hpp>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+using ServerLive = libwavy::log::SERVER_LIVE;
+
+/*
+ * Live ingest and playback (see live-stream.hpp)
+ *
+ *   POST /live/ingest/<owner>/<stream-id>?seq=&duration=[&target=]   body: one .ts segment
+ *   POST /live/end/<owner>/<stream-id>                               appends EXT-X-ENDLIST
+ *   GET  /live/<owner>/<stream-id>/index.m3u8                        sliding-window playlist
+ *   GET  /live/<owner>/<stream-id>/<n>.ts                            segment n
+ *   GET  /live                                                       open streams, as /owners
+ *
+ * The first push opens the stream; `target` (EXT-X-TARGETDURATION, whole seconds) is only
+ * read then and defaults to the first segment's duration rounded up. Both are capped at
+ * WAVY_SERVER_LIVE_MAX_DURATION seconds.
+ *
+ * Both POSTs carry `X-Wavy-Live-Token`: a secret of 32 to 128 characters the publisher
+ * picks for the stream. The first push binds the stream to it, later pushes and the end
+ * are refused with 403 unless they present the same one.
+ */
+
+namespace libwavy::server::methods
+{
+
+class LiveManager
+{
+public:
+  LiveManager(Metrics& metrics, LiveRegistry& registry, BandwidthShaper& shaper)
+      : m_metrics(metrics), m_registry(registry), m_shaper(shaper)
+  {
+  }
+
+  auto ingest(const crow::request& req, const StorageOwnerID& owner, const std::string& id)
+    -> crow::response
+  {
+    RequestTimer timer(m_metrics, MetricsRoute::LiveIngest);
+
+    const auto sequence = param<ui64>(req, "seq");
+    const auto duration = param<double>(req, "duration");
+    if (!valid_name(owner) || !valid_name(id) || !sequence || !duration)
+      return reject(timer, 400, "expected /live/ingest/<owner>/<stream-id>?seq=&duration=");
+    // Negated so NaN fails too; bounded before anything rounds it into an int
+    if (!(*duration > 0 && *duration <= static_cast<double>(WAVY_SERVER_LIVE_MAX_DURATION)))
+      return reject(timer, 400,
+                    "duration must be in (0, " +
+                      std::to_string(WAVY_SERVER_LIVE_MAX_DURATION) + "] seconds");
+
+    const std::string token = req.get_header_value(std::string(macros::LIVE_TOKEN_HEADER));
+    if (!valid_token(token))
+      return reject(timer, 400, "expected a 32 to 128 character X-Wavy-Live-Token");
+
+    if (req.body.empty() || req.body.front() != static_cast<char>(TRANSPORT_STREAM_START_BYTE))
+      return reject(timer, 400, "segment is not an MPEG-TS stream");
+    if (req.body.size() > static_cast<std::size_t>(WAVY_SERVER_LIVE_SEGMENT_LIMIT) * ONE_MIB)
+      return reject(timer, 413, "segment too large");
+
+    const int target = param<int>(req, "target").value_or(static_cast<int>(std::ceil(*duration)));
+    if (target <= 0 || target > WAVY_SERVER_LIVE_MAX_DURATION)
+      return reject(timer, 400,
+                    "target must be in [1, " + std::to_string(WAVY_SERVER_LIVE_MAX_DURATION) +
+                      "] seconds");
+    auto stream = m_registry.open(owner, id, token, target);
+    if (!stream)
+    {
+      crow::response res = reject(timer, 503, "too many live streams", false);
+      res.set_header("Retry-After", std::to_string(WAVY_SERVER_LIVE_IDLE_TIMEOUT));
+      timer.mark_failure();
+      return res;
+    }
+    if (!stream->authorized(token))
+      return reject(timer, 403, "live stream is published with another token");
+
+    const auto bytes = req.body.size();
+    switch (stream->append(*sequence, *duration, std::make_shared<const std::string>(req.body)))
+    {
+      case LiveAppend::Appended:
+        m_registry.stats().segments++;
+        m_registry.stats().bytes += bytes;
+        log::TRACE<ServerLive>(LogMode::Async, "Live {}/{}: segment {} ({} bytes, {:.3f}s)", owner,
+                               id, *sequence, bytes, *duration);
+        break;
+
+      case LiveAppend::Duplicate:
+        break;
+
+      case LiveAppend::TooLong:
+        return reject(timer, 400,
+                      "segment longer than the stream's target duration (" +
+                        std::to_string(stream->target_duration()) + "s)");
+
+      case LiveAppend::OutOfOrder:
+        return reject(timer, 409, "sequence is behind the last segment pushed");
+
+      case LiveAppend::OverBudget:
+      {
+        m_registry.stats().over_budget++;
+        crow::response res = reject(timer, 503, "live segment memory is full", false);
+        res.set_header("Retry-After", std::to_string(WAVY_LIVE_SEGMENT_DURATION));
+        timer.mark_failure();
+        return res;
+      }
+
+      case LiveAppend::Ended:
+        return reject(timer, 409, "stream has ended");
+    }
+
+    timer.mark_success();
+    return text(200, "next=" + std::to_string(stream->info().next) + "\n");
+  }
+
+  auto end(const crow::request& req, const StorageOwnerID& owner, const std::string& id)
+    -> crow::response
+  {
+    RequestTimer timer(m_metrics, MetricsRoute::LiveIngest);
+
+    auto stream = m_registry.find(owner, id);
+    if (!stream)
+      return reject(timer, 404, "unknown live stream");
+    if (!stream->authorized(req.get_header_value(std::string(macros::LIVE_TOKEN_HEADER))))
+      return reject(timer, 403, "live stream is published with another token");
+
+    stream->end();
+    log::INFO<ServerLive>(LogMode::Async, "Live stream {}/{} ended by its owner ({} segments)",
+                          owner, id, stream->info().segments);
+    timer.mark_success();
+    return text(200, "ended\n");
+  }
+
+  auto list() -> crow::response
+  {
+    RequestTimer timer(m_metrics, MetricsRoute::Live);
+
+    std::ostringstream body;
+    StorageOwnerID     owner;
+    for (const auto& info : m_registry.list())
+    {
+      if (info.ended)
+        continue;
+      if (info.owner != owner)
+        body << (owner = info.owner) << ":\n";
+      body << "  - " << info.id << "\n";
+    }
+
+    timer.mark_success();
+    crow::response res = text(200, body.str());
+    res.set_header("Cache-Control", "no-store");
+    return res;
+  }
+
+  auto serve(const crow::request& req, const StorageOwnerID& owner, const std::string& id,
+             const FileName& filename) -> crow::response
+  {
+    RequestTimer timer(m_metrics, MetricsRoute::Live);
+
+    auto stream = m_registry.find(owner, id);
+    if (!stream)
+      return reject(timer, 404, "unknown live stream");
+
+    if (filename == macros::MASTER_PLAYLIST)
+    {
+      auto playlist = stream->playlist();
+
+      crow::response res(200, *playlist);
+      res.set_header("Server", "Wavy Server");
+      res.set_header("Content-Type", "application/vnd.apple.mpegurl");
+      // Clients reload it every target duration; an ended stream no longer changes
+      res.set_header("Cache-Control", stream->ended() ? "max-age=" + std::to_string(LINGER)
+                                                      : std::string("no-cache"));
+      timer.mark_success();
+      return res;
+    }
+
+    const auto sequence = segment_sequence(filename);
+    if (!sequence)
+      return reject(timer, 404, "not a live playlist or segment");
+
+    auto body = stream->segment(*sequence);
+    if (!body)
+      return reject(timer, 404, "segment is no longer (or not yet) available");
+
+    const auto admission = m_shaper.admit(req.remote_ip_address, owner, body->size());
+    if (admission.outcome != Admission::Admitted)
+    {
+      const bool client_limited = admission.outcome == Admission::ClientLimited;
+      log::WARN<ServerLive>(LogMode::Async, "Refused {} bytes of {}/{} to {} ({})", body->size(),
+                            owner, id, req.remote_ip_address,
+                            client_limited ? "client over budget" : "egress saturated");
+
+      crow::response res = text(client_limited ? 429 : 503,
+                                client_limited ? "Egress budget exceeded, retry later\n"
+                                               : "Server egress saturated, retry later\n");
+      res.set_header("Retry-After", std::to_string(admission.retry_after.count()));
+      if (client_limited)
+        timer.mark_error_429();
+      else
+        timer.mark_failure();
+      return res;
+    }
+
+    m_metrics.bytes_downloaded += body->size();
+
+    crow::response res(200, *body);
+    res.set_header("Server", "Wavy Server");
+    res.set_header("Content-Type", "video/mp2t");
+    // Names are never reused, see live-stream.hpp
+    res.set_header("Cache-Control", "public, max-age=" +
+                                      std::to_string(WAVY_SERVER_SEGMENT_MAX_AGE) + ", immutable");
+    timer.mark_success();
+    return res;
+  }
+
+private:
+  Metrics&         m_metrics;
+  LiveRegistry&    m_registry;
+  BandwidthShaper& m_shaper;
+
+  static constexpr std::size_t MAX_NAME  = 64;
+  static constexpr std::size_t MIN_TOKEN = 32;
+  static constexpr std::size_t MAX_TOKEN = 128;
+  static constexpr int         LINGER    = WAVY_SERVER_LIVE_LINGER;
+
+  // "<n>.ts" -> n
+  static auto segment_sequence(std::string_view filename) -> std::optional<ui64>
+  {
+    if (!filename.ends_with(macros::TRANSPORT_STREAM_EXT))
+      return std::nullopt;
+
+    const auto stem     = filename.substr(0, filename.size() - macros::TRANSPORT_STREAM_EXT.size());
+    ui64       sequence = 0;
+    const auto [end, ec] = std::from_chars(stem.data(), stem.data() + stem.size(), sequence);
+    if (stem.empty() || ec != std::errc{} || end != stem.data() + stem.size())
+      return std::nullopt;
+    return sequence;
+  }
+
+  // Owner and stream names end up in URIs and log lines, nowhere on disk
+  static auto valid_name(std::string_view name) -> bool
+  {
+    return !name.empty() && name.size() <= MAX_NAME &&
+           std::ranges::all_of(name, [](char c)
+                               { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' ||
+                                        c == '_'; });
+  }
+
+  // Publishers send 64 hex characters; anything printable without spaces is accepted
+  static auto valid_token(std::string_view token) -> bool
+  {
+    return token.size() >= MIN_TOKEN && token.size() <= MAX_TOKEN &&
+           std::ranges::all_of(token, [](char c) { return c > ' ' && c < 0x7f; });
+  }
+
+  template <typename T>
+  static auto param(const crow::request& req, const char* key) -> std::optional<T>
+  {
+    const char* value = req.url_params.get(key);
+    if (!value)
+      return std::nullopt;
+
+    const std::string_view sv(value);
+    T                      out{};
+    if constexpr (std::is_floating_point_v<T>)
+    {
+      // from_chars for doubles is missing from older standard libraries
+      char*      end    = nullptr;
+      const auto parsed = std::strtod(value, &end);
+      if (end == value || *end != '\0' || !std::isfinite(parsed))
+        return std::nullopt;
+      out = static_cast<T>(parsed);
+    }
+    else
+    {
+      auto [end, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), out);
+      if (ec != std::errc{} || end != sv.data() + sv.size())
+        return std::nullopt;
+    }
+    return out;
+  }
+
+  static auto text(int code, std::string body) -> crow::response
+  {
+    crow::response res(code, std::move(body));
+    res.set_header("Server", "Wavy Server");
+    res.set_header("Content-Type", "text/plain");
+    return res;
+  }
+
+  auto reject(RequestTimer& timer, int code, const std::string& reason, bool mark = true)
+    -> crow::response
+  {
+    if (mark)
+    {
+      if (code == 404)
+        timer.mark_error_404();
+      else if (code == 403)
+        timer.mark_error_403();
+      else
+        timer.mark_error_400();
+    }
+    if (code != 404)
+      m_registry.stats().rejected++;
+    return text(code, reason + "\n");
+  }
+};
+
+} // namespace libwavy::server::methods
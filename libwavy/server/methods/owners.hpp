@@ -29,9 +29,18 @@
 #include <libwavy/common/macros.hpp>
 #include <libwavy/log-macros.hpp>
 #include <libwavy/server/auth.hpp>
+#include <libwavy/server/file-handle-cache.hpp>
+#include <libwavy/server/metadata-catalog.hpp>
+#include <libwavy/server/object-store.hpp>
 #include <libwavy/server/prototypes.hpp>
 #include <libwavy/server/request-timer.hpp>
+#include <libwavy/server/segment-cache.hpp>
+#include <libwavy/server/trash.hpp>
+#include <libwavy/server/upload-queue.hpp>
+#include <libwavy/server/validators.hpp>
 #include <libwavy/toml/toml_parser.hpp>
+#include <libwavy/utils/io/async/entry.hpp>
+#include <future>
 #include <sstream>
 
 using Server       = libwavy::log::SERVER;
@@ -43,14 +52,19 @@ namespace libwavy::server::methods
 class OwnerManager
 {
 public:
-  OwnerManager(Metrics& metrics, OwnerAudioIDMap& g_owner_audio_db)
-      : m_metrics(metrics), m_owner_audio_db(g_owner_audio_db)
+  OwnerManager(Metrics& metrics, SegmentCache& cache, FileHandleCache& files,
+               ValidatorStore& validators, UploadJobQueue& uploads, TrashReclaimer& trash,
+               ObjectStore& objects, OwnerAudioIDMap& g_owner_audio_db, CatalogLog& catalog,
+               MetadataCatalog& metadata, utils::aio::FileIO& io)
+      : m_metrics(metrics), m_cache(cache), m_files(files), m_validators(validators),
+        m_uploads(uploads), m_trash(trash), m_objects(objects),
+        m_owner_audio_db(g_owner_audio_db), m_catalog(catalog), m_metadata(metadata), m_io(io)
   {
   }
 
   auto list_owners() -> crow::response
   {
-    RequestTimer req_timer(m_metrics);
+    RequestTimer req_timer(m_metrics, MetricsRoute::Owners);
 
     try
     {
@@ -95,71 +109,36 @@ public:
     }
   }
 
-  auto list_audio_info() -> crow::response
+  auto list_audio_info(const crow::request& req) -> crow::response
   {
-    RequestTimer req_timer(m_metrics);
+    RequestTimer req_timer(m_metrics, MetricsRoute::AudioInfo);
 
     try
     {
       log::INFO<Server>(LogMode::Async, "Handling Audio Metadata Listing request (AMLR)");
 
-      std::ostringstream response_stream;
-      bool               entries_found = false;
-
-      m_owner_audio_db.for_each_owner(
-        [&](const StorageOwnerID& owner, const auto& audio_ids)
-        {
-          response_stream << owner << ":\n";
-
-          for (const auto& audio_id : audio_ids)
-          {
-            // build metadata path from storage directory
-            AbsPath metadata_path =
-              AbsPath(macros::SERVER_STORAGE_DIR) / owner / audio_id / macros::METADATA_FILE;
-
-            if (fs::exists(metadata_path))
-            {
-              try
-              {
-                AudioMetadata metadata = parseAudioMetadata(metadata_path);
-
-                response_stream << "  - " << audio_id << "\n";
-                response_stream << "      1. Title: " << metadata.title << "\n";
-                response_stream << "      2. Artist: " << metadata.artist << "\n";
-                response_stream << "      3. Duration: " << metadata.duration << " secs\n";
-                response_stream << "      4. Album: " << metadata.album << "\n";
-                response_stream << "      5. Bitrate: " << metadata.bitrate << " kbps\n";
-                response_stream << "      6. Sample Rate: " << metadata.audio_stream.sample_rate
-                                << " Hz\n";
-                response_stream << "      7. Sample Format: " << metadata.audio_stream.sample_format
-                                << "\n";
-                response_stream << "      8. Audio Bitrate: " << metadata.audio_stream.bitrate
-                                << " kbps\n";
-                response_stream << "      9. Codec: " << metadata.audio_stream.codec << "\n";
-                response_stream << "      10. Available Bitrates: [";
-                for (auto br : metadata.bitrates)
-                  response_stream << br << ",";
-                response_stream << "]\n";
-
-                entries_found = true;
-              }
-              catch (const std::exception& e)
-              {
-                log::ERROR<Server>(LogMode::Async, "Error parsing metadata for Audio-ID {}: {}",
-                                   audio_id, e.what());
-              }
-            }
-          }
-        });
+      // Rendered from the in-memory catalog, re-rendered only after an upload or delete
+      auto body = m_metadata.render_info();
 
-      if (!entries_found)
+      if (!body)
       {
         req_timer.mark_error_404();
         return {404, macros::to_string(macros::SERVER_ERROR_404)};
       }
 
+      // Compressed along with the render, here we only pick the variant
+      const auto [coding, payload] = body->pick(req.get_header_value("Accept-Encoding"));
+
+      crow::response res(200, *payload);
+      res.set_header("Vary", "Accept-Encoding");
+      if (coding != encoding::Coding::Identity)
+      {
+        res.set_header("Content-Encoding", std::string(encoding::token(coding)));
+        m_metrics.encoded_responses++;
+      }
+
       req_timer.mark_success();
-      return {200, response_stream.str()};
+      return res;
     }
     catch (const std::exception& e)
     {
@@ -169,9 +148,11 @@ public:
     }
   }
 
+  // Only validates and enqueues, the actual ingest runs on the upload workers
+  // (see process_upload). The client polls /upload/status/<job-id> for the outcome.
   auto handle_upload(const crow::request& req) -> crow::response
   {
-    RequestTimer req_timer(m_metrics);
+    RequestTimer req_timer(m_metrics, MetricsRoute::Upload);
 
     try
     {
@@ -192,80 +173,70 @@ public:
         return {413, "Upload too large"};
       }
 
-      const StorageAudioID audio_id = boost::uuids::to_string(boost::uuids::random_generator()());
-      const AbsPath        gzip_path =
-        AbsPath(macros::SERVER_TEMP_STORAGE_DIR) / audio_id + macros::COMPRESSED_ARCHIVE_EXT;
-
-      fs::create_directories(macros::SERVER_TEMP_STORAGE_DIR);
-
-      std::ofstream output_file(gzip_path, std::ios::binary);
-      if (!output_file)
-      {
-        log::ERROR<ServerUpload>(LogMode::Async, "Failed to create temp file: {}", gzip_path.str());
-        req_timer.mark_error_500();
-        return {500, "Failed to create temporary file"};
-      }
-
-      output_file.write(req.body.data(), req.body.size());
-      output_file.close();
-
-      if (!fs::exists(gzip_path) || fs::file_size(gzip_path) == 0)
+      // ?hash=sha256-tree selects the parallel tree digest for the upload key
+      UploadOptions options;
+      if (const char* hash = req.url_params.get("hash"); hash)
       {
-        log::ERROR<ServerUpload>(LogMode::Async, "GZIP upload failed: File is empty or missing!");
-        req_timer.mark_error_400();
-        return {400, "GZIP upload failed"};
+        const std::string_view requested(hash);
+        if (requested == to_string(UploadKeyHash::Sha256Tree) || requested == "tree")
+          options.key_hash = UploadKeyHash::Sha256Tree;
+        else if (requested != to_string(UploadKeyHash::Sha256))
+        {
+          log::ERROR<ServerUpload>(LogMode::Async, "Unknown key hash requested: {}", requested);
+          req_timer.mark_error_400();
+          return {400, "Unknown 'hash' parameter (sha256 | sha256-tree)"};
+        }
       }
 
-      StorageOwnerID ownerNickname =
-        helpers::extract_and_validate(gzip_path, audio_id, m_owner_audio_db);
-      m_metrics.record_owner_upload(ownerNickname, req.body.size());
-
-      if (!ownerNickname.empty())
+      // ?layout=packed|files overrides WAVY_SERVER_PACKED_STORAGE for this track
+      if (const char* layout = req.url_params.get("layout"); layout)
       {
-        log::TRACE<ServerUpload>("Computing HASH for Owner: {}", ownerNickname);
-
-        auto sha_opt = auth::compute_sha256_hex(gzip_path);
-        if (!sha_opt)
+        const std::string_view requested(layout);
+        if (requested == to_string(ingest::StorageLayout::Packed))
+          options.layout = ingest::StorageLayout::Packed;
+        else if (requested == to_string(ingest::StorageLayout::Files))
+          options.layout = ingest::StorageLayout::Files;
+        else
         {
-          log::ERROR<ServerUpload>(LogMode::Async, "Failed to compute SHA-256 for Audio-ID: {}",
-                                   audio_id);
+          log::ERROR<ServerUpload>(LogMode::Async, "Unknown storage layout requested: {}",
+                                   requested);
+          req_timer.mark_error_400();
+          return {400, "Unknown 'layout' parameter (files | packed)"};
         }
-        bool key_persisted = false;
-        if (sha_opt)
-          key_persisted = auth::persist_key(audio_id, *sha_opt);
-
-        // Clean up temporary archive
-        fs::remove(gzip_path);
-
-        req_timer.mark_success();
-        log::INFO<ServerUpload>(LogMode::Async, "Upload successful, Audio-ID: {}", audio_id);
+      }
 
-        std::ostringstream body;
-        body << "audio_id=" << audio_id << "\n";
+      const auto body_size = req.body.size();
 
-        if (sha_opt)
-        {
-          body << "sha256=" << *sha_opt << "\n";
-          body << "key_persisted=" << (key_persisted ? "true" : "false") << "\n";
-        }
-        else
-        {
-          body << "sha256=\n";
-          body << "key_persisted=false\n";
-        }
+      // Crow owns the request object (it is only const here), and does not look at the
+      // body again once the handler has run. Moving it saves copying the whole archive.
+      auto job_id = m_uploads.submit(std::move(const_cast<crow::request&>(req).body), options);
+      if (!job_id)
+      {
+        const auto retry_after = m_uploads.retry_after_seconds();
+        log::WARN<ServerUpload>(LogMode::Async, "Upload queue full, retry after {}s",
+                                retry_after);
+        req_timer.mark_failure();
 
-        crow::response res;
-        res.code = 200;
+        crow::response res(503, "Upload queue is full, retry later\n");
+        res.set_header("Retry-After", std::to_string(retry_after));
         res.set_header("Content-Type", "text/plain");
-        res.body = body.str();
         return res;
       }
-      else
-      {
-        fs::remove(gzip_path);
-        req_timer.mark_error_400();
-        return {400, macros::to_string(macros::SERVER_ERROR_400)};
-      }
+
+      log::INFO<ServerUpload>(LogMode::Async, "Upload queued ({} bytes), Job-ID: {}", body_size,
+                              *job_id);
+      req_timer.mark_success();
+
+      std::ostringstream body;
+      body << "job_id=" << *job_id << "\n";
+      body << "status=" << to_string(UploadJobState::Queued) << "\n";
+
+      crow::response res;
+      res.code = 202;
+      res.set_header("Content-Type", "text/plain");
+      res.set_header("Location", "/upload/status/" + *job_id);
+      res.body = body.str();
+      return res;
     }
     catch (const std::exception& e)
     {
@@ -275,10 +246,134 @@ public:
     }
   }
 
+  auto upload_status(const std::string& job_id) -> crow::response
+  {
+    RequestTimer req_timer(m_metrics, MetricsRoute::UploadStatus);
+
+    auto status = m_uploads.status(job_id);
+    if (!status)
+    {
+      req_timer.mark_error_404();
+      return {404, "Unknown upload job\n"};
+    }
+
+    std::ostringstream body;
+    body << "job_id=" << status->id << "\n";
+    body << "status=" << to_string(status->state) << "\n";
+
+    switch (status->state)
+    {
+      case UploadJobState::Queued:
+        body << "position=" << status->position << "\n";
+        break;
+
+      case UploadJobState::Running:
+        break;
+
+      case UploadJobState::Done:
+        body << "audio_id=" << status->result.audio_id << "\n";
+        body << "sha256=" << status->result.sha256.value_or("") << "\n";
+        body << "key_hash=" << to_string(status->result.key_hash) << "\n";
+        body << "layout=" << to_string(status->result.layout) << "\n";
+        body << "key_persisted=" << (status->result.key_persisted ? "true" : "false") << "\n";
+        break;
+
+      case UploadJobState::Failed:
+        body << "error=" << status->result.error << "\n";
+        break;
+    }
+
+    req_timer.mark_success();
+
+    crow::response res;
+    res.code = 200;
+    res.set_header("Content-Type", "text/plain");
+    res.set_header("Cache-Control", "no-store");
+    res.body = body.str();
+    return res;
+  }
+
+  // Runs on an upload worker thread
+  auto process_upload(const std::string& payload, const UploadOptions& options) -> UploadResult
+  {
+    const auto   key_hash = options.key_hash;
+    UploadResult result;
+    result.key_hash = key_hash;
+    result.layout   = options.layout;
+
+    const StorageAudioID audio_id = boost::uuids::to_string(boost::uuids::random_generator()());
+
+    fs::create_directories(macros::SERVER_TEMP_STORAGE_DIR);
+
+    // The key is derived without another pass over the body: the plain digest is fed by
+    // libarchive's reads during extraction, the tree digest runs next to it on its own
+    // threads.
+    auth::Sha256Stream                       inline_sha;
+    std::future<std::optional<std::string>> tree_sha;
+    ingest::PayloadObserver                  on_payload;
+
+    if (key_hash == UploadKeyHash::Sha256Tree)
+      tree_sha = std::async(
+        std::launch::async,
+        [&payload] { return auth::compute_tree_sha256_hex(payload.data(), payload.size()); });
+    else
+      on_payload = [&inline_sha](const char* data, std::size_t len)
+      { inline_sha.update(data, len); };
+
+    StorageOwnerID ownerNickname =
+      helpers::extract_and_validate(payload, audio_id, m_catalog, m_io,
+                                    WAVY_SERVER_DEDUPE_STORAGE ? &m_objects : nullptr,
+                                    options.layout, on_payload);
+
+    if (ownerNickname.empty())
+    {
+      log::ERROR<ServerUpload>(LogMode::Async, "Upload rejected: invalid payload");
+      result.error = "invalid payload";
+      return result;
+    }
+
+    m_metrics.record_owner_upload(ownerNickname, payload.size());
+    m_metrics.record_owner_traffic(ownerNickname, audio_id, MetricsRoute::Upload,
+                                   {.requests = 1, .bytes = payload.size()});
+    m_metrics.bytes_uploaded += payload.size();
+
+    log::TRACE<ServerUpload>("Finalizing {} key for Owner: {}", to_string(key_hash),
+                             ownerNickname);
+
+    auto sha_opt = tree_sha.valid() ? tree_sha.get() : inline_sha.final_hex();
+    if (!sha_opt)
+    {
+      log::ERROR<ServerUpload>(LogMode::Async, "Failed to compute SHA-256 for Audio-ID: {}",
+                               audio_id);
+    }
+    bool key_persisted = false;
+    if (sha_opt)
+      key_persisted = auth::persist_key(audio_id, *sha_opt);
+
+    // Retire anything remembered about this track (e.g. 404s from early polling)
+    // and pull its playlists and first segments into memory
+    m_cache.publish_track(ownerNickname, audio_id);
+    m_validators.invalidate(ownerNickname, audio_id);
+    if (!m_metadata.load(ownerNickname, audio_id, macros::to_string(macros::SERVER_STORAGE_DIR)))
+      log::WARN<ServerUpload>(LogMode::Async, "No readable metadata for Audio-ID: {}", audio_id);
+    auto warmed = m_cache.prewarm(ownerNickname, audio_id, WAVY_SERVER_CACHE_PREWARM_SEGMENTS);
+    log::DBG<ServerUpload>(LogMode::Async, "Prewarmed {} files for Audio-ID: {}", warmed,
+                           audio_id);
+
+    log::INFO<ServerUpload>(LogMode::Async, "Upload successful, Audio-ID: {}", audio_id);
+
+    result.ok            = true;
+    result.owner         = ownerNickname;
+    result.audio_id      = audio_id;
+    result.sha256        = std::move(sha_opt);
+    result.key_persisted = key_persisted;
+    return result;
+  }
+
   auto handle_delete(const crow::request& req, const StorageOwnerID& ownerID,
                      const StorageAudioID& audio_id) -> crow::response
   {
-    RequestTimer req_timer(m_metrics);
+    RequestTimer req_timer(m_metrics, MetricsRoute::Delete);
     m_metrics.record_owner_delete(ownerID);
 
     try
@@ -319,16 +414,29 @@ public:
         return {403, "Invalid key"};
       }
 
-      // Delete the audio directory
-      const AbsPath audio_dir = AbsPath(macros::SERVER_STORAGE_DIR) / ownerID / audio_id;
-      if (fs::exists(audio_dir) && fs::is_directory(audio_dir))
+      // Unpublish the track with one rename into the trash; its files are reclaimed in
+      // the background, so the delete costs the same for any track size
+      const fs::path audio_dir =
+        fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / ownerID / audio_id;
+      std::error_code ec;
+      if (fs::is_directory(audio_dir, ec) && !m_trash.discard(audio_dir))
       {
-        fs::remove_all(audio_dir);
+        log::WARN<Server>(LogMode::Async,
+                          "Could not move Audio-ID {} to the trash, removing it in place",
+                          audio_id);
+        fs::remove_all(audio_dir, ec);
       }
 
       // Remove the key file
       fs::remove(key_file);
 
+      m_catalog.record_erase(ownerID, audio_id);
+      m_metadata.erase(ownerID, audio_id);
+      m_metrics.retire_track(ownerID, audio_id);
+      m_cache.invalidate_track(ownerID, audio_id);
+      m_files.invalidate_track(ownerID, audio_id);
+      m_validators.invalidate(ownerID, audio_id);
+
       req_timer.mark_success();
       log::INFO<Server>(LogMode::Async, "Successfully deleted Audio-ID: {}", audio_id);
 
@@ -347,8 +455,17 @@ public:
   }
 
 private:
-  Metrics&         m_metrics;
-  OwnerAudioIDMap& m_owner_audio_db;
+  Metrics&            m_metrics;
+  SegmentCache&       m_cache;
+  FileHandleCache&    m_files;
+  ValidatorStore&     m_validators;
+  UploadJobQueue&     m_uploads;
+  TrashReclaimer&     m_trash;
+  ObjectStore&        m_objects;
+  OwnerAudioIDMap&    m_owner_audio_db;
+  CatalogLog&         m_catalog;
+  MetadataCatalog&    m_metadata;
+  utils::aio::FileIO& m_io;
 };
 
 } // namespace libwavy::server::methods
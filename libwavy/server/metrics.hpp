@@ -23,8 +23,23 @@
  *  See LICENSE file for full legal details.                                    *
  ********************************************************************************/
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/server/bandwidth-shaper.hpp>
+#include <libwavy/server/file-handle-cache.hpp>
+#include <libwavy/server/health.hpp>
+#include <libwavy/server/housekeeping.hpp>
+#include <libwavy/server/labeled-metrics.hpp>
+#include <libwavy/server/latency-histogram.hpp>
+#include <libwavy/server/live-stream.hpp>
+#include <libwavy/server/object-store.hpp>
 #include <libwavy/server/owner-metrics.hpp>
+#include <libwavy/server/segment-cache.hpp>
+#include <libwavy/server/segment-loader.hpp>
+#include <libwavy/server/trash.hpp>
+#include <libwavy/server/upload-queue.hpp>
 #include <libwavy/utils/math/entry.hpp>
 #include <mutex>
 #include <optional>
@@ -45,33 +60,37 @@ struct Metrics
   std::atomic<ui64> upload_requests{0};
   std::atomic<ui64> delete_requests{0};
   std::atomic<ui64> download_requests{0};
+  std::atomic<ui64> range_requests{0};
+  std::atomic<ui64> not_modified_responses{0};
+  std::atomic<ui64> encoded_responses{0};
   std::atomic<ui64> bytes_uploaded{0};
   std::atomic<ui64> bytes_downloaded{0};
   std::atomic<ui64> active_connections{0};
   std::atomic<ui64> total_connections{0};
 
-  // Response time tracking
-  mutable std::mutex                     response_times_mutex;
-  std::vector<std::chrono::milliseconds> recent_response_times;
-  static const size_t                    MAX_RESPONSE_TIMES = 1000;
+  // Response time tracking (per route and status class, microseconds)
+  LatencyTable latency;
 
   // Error tracking
   std::atomic<ui64> error_500_count{0};
   std::atomic<ui64> error_400_count{0};
   std::atomic<ui64> error_404_count{0};
   std::atomic<ui64> error_403_count{0};
+  std::atomic<ui64> error_416_count{0};
+  std::atomic<ui64> error_429_count{0};
 
   // key = owner nickname
   mutable std::shared_mutex                     owners_mutex;
   std::unordered_map<std::string, OwnerMetrics> owners;
 
+  // Per-owner traffic, updated from request threads without a shared lock
+  LabeledFamily<2> owner_routes{{"owner", "route"}, WAVY_SERVER_METRICS_OWNER_SERIES};
+  LabeledFamily<2> owner_tracks{{"owner", "track"}, WAVY_SERVER_METRICS_TRACK_SERIES};
+
   // Uptime tracking
   std::chrono::steady_clock::time_point start_time;
 
-  Metrics() : start_time(std::chrono::steady_clock::now())
-  {
-    recent_response_times.reserve(MAX_RESPONSE_TIMES);
-  }
+  Metrics() : start_time(std::chrono::steady_clock::now()) {}
 
   void record_owner_upload(const StorageOwnerID& owner_id, ui64 bytes)
   {
@@ -123,10 +142,12 @@ struct Metrics
     return top_owner;
   }
 
-  auto get_owner_metrics(const StorageOwnerID& owner_id)
+  // Entries are never erased, so the reference outlives the lock
+  auto get_owner_metrics(const StorageOwnerID& owner_id) const
     -> std::optional<std::reference_wrapper<const OwnerMetrics>>
   {
-    auto it = owners.find(owner_id);
+    std::shared_lock lock(owners_mutex);
+    auto             it = owners.find(owner_id);
     if (it != owners.end())
     {
       return std::cref(it->second);
@@ -134,28 +155,67 @@ struct Metrics
     return std::nullopt;
   }
 
-  void record_response_time(std::chrono::milliseconds duration)
+  // Files one request under (owner, route) and, when it targets a track, (owner, track).
+  // Downloads are also counted on the owner's entry, which is not capped like the families.
+  void record_owner_traffic(std::string_view owner, std::string_view track, MetricsRoute route,
+                            const LabeledSample& sample)
+  {
+    owner_routes.add({owner, to_string(route)}, sample);
+    if (!track.empty())
+      owner_tracks.add({owner, track}, sample);
+    if (route == MetricsRoute::Download || route == MetricsRoute::Stream)
+      owner_entry(owner).downloads++;
+  }
+
+  // A deleted track's series is dropped, so its slot can go to a new track
+  void retire_track(std::string_view owner, std::string_view track)
+  {
+    owner_tracks.retire({owner, track});
+  }
+
+  // Traffic for an owner/track that is not stored: the names come straight from the URL,
+  // so they are counted under `_overflow` instead of getting series of their own
+  void record_unknown_traffic(const LabeledSample& sample)
   {
-    std::lock_guard<std::mutex> lock(response_times_mutex);
-    recent_response_times.push_back(duration);
-    if (recent_response_times.size() > MAX_RESPONSE_TIMES)
+    owner_routes.add_overflow(sample);
+    owner_tracks.add_overflow(sample);
+  }
+
+  // Downloads and streams served for an owner since startup
+  [[nodiscard]] auto get_owner_downloads(const StorageOwnerID& owner) const -> ui64
+  {
+    std::shared_lock lock(owners_mutex);
+    auto             it = owners.find(owner);
+    return it == owners.end() ? 0 : it->second.downloads.load();
+  }
+
+  // Only called for owners with stored tracks, so the map stays as small as the catalog.
+  // Entries are never erased, so the reference outlives the lock.
+  auto owner_entry(std::string_view owner) -> OwnerMetrics&
+  {
+    const std::string key(owner);
     {
-      recent_response_times.erase(recent_response_times.begin());
+      std::shared_lock lock(owners_mutex);
+      if (auto it = owners.find(key); it != owners.end())
+        return it->second;
     }
+    std::unique_lock lock(owners_mutex);
+    return owners[key];
   }
 
+  void record_response_time(MetricsRoute route, StatusClass cls,
+                            std::chrono::microseconds duration)
+  {
+    latency.record(route, cls, static_cast<ui64>(duration.count()));
+  }
+
+  // Mean over every request since startup, in milliseconds
   [[nodiscard]] auto get_avg_response_time() const -> double
   {
-    std::lock_guard<std::mutex> lock(response_times_mutex);
-    if (recent_response_times.empty())
+    const auto all = latency.overall();
+    if (all.count == 0)
       return 0.0;
-
-    auto total = std::chrono::milliseconds(0);
-    for (const auto& time : recent_response_times)
-    {
-      total += time;
-    }
-    return static_cast<double>(total.count()) / recent_response_times.size();
+    return static_cast<double>(all.sum_us) / static_cast<double>(all.count) / 1000.0;
   }
 
   [[nodiscard]] auto get_uptime() const -> std::chrono::seconds
@@ -172,52 +232,411 @@ public:
   {
     std::ostringstream out;
 
-    // Helper lambda to reduce duplication
-    auto metric = [&](const std::string& name, const std::string& type, const std::string& help,
-                      const std::atomic<ui64>& value)
-    {
-      out << "# HELP " << name << " " << help << "\n";
-      out << "# TYPE " << name << " " << type << "\n";
-      out << name << " " << value << "\n\n";
-    };
-
-    metric("wavy_requests_total", "counter", "Total number of HTTP requests", m.total_requests);
-    metric("wavy_requests_successful", "counter", "Total successful requests",
+    metric(out, "wavy_requests_total", "counter", "Total number of HTTP requests",
+           m.total_requests);
+    metric(out, "wavy_requests_successful", "counter", "Total successful requests",
            m.successful_requests);
-    metric("wavy_requests_failed", "counter", "Total failed requests", m.failed_requests);
-    metric("wavy_delete_requests", "counter", "Total DELETE requests", m.delete_requests);
+    metric(out, "wavy_requests_failed", "counter", "Total failed requests", m.failed_requests);
+    metric(out, "wavy_delete_requests", "counter", "Total DELETE requests", m.delete_requests);
+    metric(out, "wavy_range_requests", "counter", "Total partial (Range) download requests",
+           m.range_requests);
+    metric(out, "wavy_range_not_satisfiable", "counter", "Total 416 responses", m.error_416_count);
+    metric(out, "wavy_rate_limited", "counter",
+           "Total 429 (client over its egress budget) responses", m.error_429_count);
+    metric(out, "wavy_not_modified_responses", "counter", "Total 304 (conditional hit) responses",
+           m.not_modified_responses);
+    metric(out, "wavy_encoded_responses", "counter",
+           "Total responses sent from a precompressed (zstd/gzip) variant", m.encoded_responses);
 
-    metric("wavy_active_connections", "gauge", "Current active connections", m.active_connections);
-    metric("wavy_response_time_avg", "gauge", "Average response time in milliseconds",
-           m.get_avg_response_time());
+    metric(out, "wavy_active_connections", "gauge", "Current active connections",
+           m.active_connections);
+    metric(out, "wavy_response_time_avg", "gauge", "Average response time in milliseconds",
+           static_cast<ui64>(m.get_avg_response_time()));
 
-    metric("wavy_uptime_seconds", "gauge", "Server uptime in seconds", m.get_uptime().count());
+    metric(out, "wavy_uptime_seconds", "gauge", "Server uptime in seconds", m.get_uptime().count());
 
-    metric("wavy_bytes_uploaded_total", "counter", "Total bytes uploaded", m.bytes_uploaded);
-    metric("wavy_bytes_downloaded_total", "counter", "Total bytes downloaded", m.bytes_downloaded);
+    metric(out, "wavy_bytes_uploaded_total", "counter", "Total bytes uploaded", m.bytes_uploaded);
+    metric(out, "wavy_bytes_downloaded_total", "counter", "Total bytes downloaded",
+           m.bytes_downloaded);
 
     return out.str();
   }
 
-  static auto owner_to_prometheus_format(const StorageOwnerID& owner_id, const OwnerMetrics& om)
+  static auto cache_to_prometheus_format(const SegmentCacheStats& cs) -> std::string
+  {
+    std::ostringstream out;
+
+    metric(out, "wavy_segment_cache_hits_total", "counter", "Segment cache hits", cs.hits);
+    metric(out, "wavy_segment_cache_negative_hits_total", "counter",
+           "Lookups answered by a cached not-found entry", cs.negative_hits);
+    metric(out, "wavy_segment_cache_misses_total", "counter", "Segment cache misses", cs.misses);
+    metric(out, "wavy_segment_cache_insertions_total", "counter", "Entries inserted into the cache",
+           cs.insertions);
+    metric(out, "wavy_segment_cache_evictions_total", "counter",
+           "Entries evicted by the byte budget", cs.evictions);
+    metric(out, "wavy_segment_cache_invalidations_total", "counter",
+           "Entries dropped by upload or delete", cs.invalidations);
+    metric(out, "wavy_segment_cache_stale_fills_total", "counter",
+           "Loads not cached because their track was deleted or replaced meanwhile",
+           cs.stale_fills);
+    metric(out, "wavy_segment_cache_bytes", "gauge", "Bytes charged against the cache budget",
+           cs.bytes);
+    metric(out, "wavy_segment_cache_entries", "gauge", "Entries currently cached", cs.entries);
+    metric(out, "wavy_segment_cache_negative_entries", "gauge",
+           "Not-found answers currently remembered", cs.negative_entries);
+
+    return out.str();
+  }
+
+  static auto shaping_to_prometheus_format(const BandwidthShaper& shaper) -> std::string
+  {
+    std::ostringstream out;
+    const auto&        ss = shaper.stats();
+
+    metric(out, "wavy_shaping_admitted_total", "counter",
+           "Responses let out by the bandwidth shaper", ss.admitted.load());
+    metric(out, "wavy_shaping_delayed_total", "counter",
+           "Admitted responses that were held back first", ss.delayed.load());
+    metric(out, "wavy_shaping_rejected_total", "counter", "Responses refused with 429 or 503",
+           ss.rejected.load());
+    metric(out, "wavy_shaping_wait_seconds_total", "counter", "Time responses spent held back",
+           static_cast<double>(ss.wait_us.load()) / 1e6);
+    metric(out, "wavy_shaping_queued", "gauge", "Responses waiting for the global egress budget",
+           shaper.queued());
+
+    return out.str();
+  }
+
+  static auto housekeeping_to_prometheus_format(const Housekeeper&                  housekeeper,
+                                                const HealthChecker::HealthStatus& health)
     -> std::string
   {
     std::ostringstream out;
+    const auto&        hs = housekeeper.stats();
+
+    const auto tasks = housekeeper.task_stats();
+    out << "# HELP wavy_housekeeping_runs_total Runs of each housekeeping task\n";
+    out << "# TYPE wavy_housekeeping_runs_total counter\n";
+    for (const auto& task : tasks)
+      out << "wavy_housekeeping_runs_total{task=\"" << task.name << "\"} " << task.runs << "\n";
+    out << "\n";
+    out << "# HELP wavy_housekeeping_seconds_total Time spent in each housekeeping task\n";
+    out << "# TYPE wavy_housekeeping_seconds_total counter\n";
+    for (const auto& task : tasks)
+      out << "wavy_housekeeping_seconds_total{task=\"" << task.name << "\"} "
+          << static_cast<double>(task.total_us) / 1e6 << "\n";
+    out << "\n";
+
+    metric(out, "wavy_temp_removed_total", "counter", "Abandoned temp entries removed",
+           hs.temp_removed.load());
+    metric(out, "wavy_temp_removed_bytes_total", "counter", "Bytes freed by removing temp entries",
+           hs.temp_bytes.load());
+    metric(out, "wavy_catalog_compactions_total", "counter",
+           "Catalog compactions run by housekeeping", hs.catalog_compactions.load());
+
+    // As of the last health refresh
+    metric(out, "wavy_storage_capacity_bytes", "gauge", "Size of the storage filesystem",
+           health.disk.capacity);
+    metric(out, "wavy_storage_available_bytes", "gauge",
+           "Bytes available on the storage filesystem", health.disk.available);
+    metric(out, "wavy_storage_inodes_available", "gauge",
+           "Inodes available on the storage filesystem", health.disk.inodes_avail);
+
+    return out.str();
+  }
+
+  static auto trash_to_prometheus_format(const TrashStats& ts) -> std::string
+  {
+    std::ostringstream out;
+
+    metric(out, "wavy_trash_discarded_total", "counter", "Deleted tracks moved into the trash",
+           ts.discarded);
+    metric(out, "wavy_trash_reclaimed_total", "counter", "Trash entries removed from disk",
+           ts.reclaimed);
+    metric(out, "wavy_trash_reclaimed_bytes_total", "counter", "Bytes freed by the trash worker",
+           ts.reclaimed_bytes);
+    metric(out, "wavy_trash_pending", "gauge", "Trash entries waiting to be reclaimed", ts.pending);
+
+    return out.str();
+  }
+
+  static auto dedupe_to_prometheus_format(const ObjectStoreStats& os) -> std::string
+  {
+    std::ostringstream out;
+
+    metric(out, "wavy_dedupe_objects", "gauge", "Distinct files in the object store", os.objects);
+    metric(out, "wavy_dedupe_physical_bytes", "gauge", "Bytes the object store takes on disk",
+           os.physical_bytes);
+    metric(out, "wavy_dedupe_logical_bytes", "gauge", "Bytes of the track files linked to objects",
+           os.logical_bytes);
+
+    // Logical over physical: 1 without duplicates, 2 when every file is stored twice
+    const ui64   physical = os.physical_bytes.load();
+    const double ratio =
+      physical == 0 ? 1.0 : static_cast<double>(os.logical_bytes.load()) / physical;
+    metric(out, "wavy_dedupe_ratio", "gauge", "Logical over physical bytes of deduplicated files",
+           ratio);
+
+    metric(out, "wavy_dedupe_shared_files_total", "counter",
+           "Uploaded files replaced by a link to stored content", os.shared_files);
+    metric(out, "wavy_dedupe_shared_bytes_total", "counter", "Bytes uploads did not store again",
+           os.shared_bytes);
+    metric(out, "wavy_dedupe_reclaimed_total", "counter", "Unreferenced objects removed",
+           os.reclaimed);
+    metric(out, "wavy_dedupe_reclaimed_bytes_total", "counter", "Bytes freed by removing objects",
+           os.reclaimed_bytes);
+
+    return out.str();
+  }
+
+  static auto live_to_prometheus_format(const LiveRegistry& live) -> std::string
+  {
+    std::ostringstream out;
+    const LiveStats&   ls = live.stats();
+
+    metric(out, "wavy_live_streams", "gauge", "Live streams held in memory (open or lingering)",
+           live.size());
+    metric(out, "wavy_live_memory_bytes", "gauge", "Bytes of live segments held by all streams",
+           live.budget().held());
 
-    auto metric = [&](const std::string& name, const std::string& help, ui64 value)
+    metric(out, "wavy_live_opened_total", "counter", "Live streams opened by a first push",
+           ls.opened);
+    metric(out, "wavy_live_segments_total", "counter", "Live segments accepted", ls.segments);
+    metric(out, "wavy_live_segment_bytes_total", "counter", "Bytes of live segments accepted",
+           ls.bytes);
+    metric(out, "wavy_live_rejected_total", "counter", "Live pushes refused", ls.rejected);
+    metric(out, "wavy_live_ended_idle_total", "counter", "Live streams ended for lack of pushes",
+           ls.ended_idle);
+    metric(out, "wavy_live_over_budget_total", "counter",
+           "Live pushes refused because WAVY_SERVER_LIVE_MEMORY_LIMIT was reached", ls.over_budget);
+
+    return out.str();
+  }
+
+  static auto file_handles_to_prometheus_format(const FileHandleCacheStats& hs) -> std::string
+  {
+    std::ostringstream out;
+
+    metric(out, "wavy_file_handle_hits_total", "counter",
+           "Reads served by an already open descriptor", hs.hits);
+    metric(out, "wavy_file_handle_opens_total", "counter",
+           "Descriptors opened for range and pack reads", hs.opens);
+    metric(out, "wavy_file_handle_evictions_total", "counter", "Descriptors closed by the LRU",
+           hs.evictions);
+    metric(out, "wavy_file_handle_stale_opens_total", "counter",
+           "Descriptors not cached because their track was deleted meanwhile", hs.stale_opens);
+    metric(out, "wavy_file_handles_open", "gauge", "Descriptors currently cached", hs.entries);
+
+    return out.str();
+  }
+
+  static auto file_io_to_prometheus_format(const SegmentLoader& loader) -> std::string
+  {
+    std::ostringstream out;
+
+    out << "# HELP wavy_file_io_backend Backend running segment reads and ingest writes\n";
+    out << "# TYPE wavy_file_io_backend gauge\n";
+    out << "wavy_file_io_backend{backend=\"" << loader.backend() << "\"} 1\n\n";
+
+    const auto& rs = loader.stats();
+    metric(out, "wavy_readahead_issued_total", "counter",
+           "Segment reads queued after a served segment", rs.issued);
+    metric(out, "wavy_readahead_loaded_total", "counter", "Read ahead segments put in the cache",
+           rs.loaded);
+    metric(out, "wavy_readahead_missed_total", "counter",
+           "Read ahead segments that did not exist, were too large or failed", rs.missed);
+    metric(out, "wavy_readahead_skipped_total", "counter",
+           "Read ahead segments already cached or being read", rs.skipped);
+
+    return out.str();
+  }
+
+  static auto upload_queue_to_prometheus_format(const UploadQueueStats& qs) -> std::string
+  {
+    std::ostringstream out;
+
+    metric(out, "wavy_upload_jobs_accepted_total", "counter", "Uploads accepted into the job queue",
+           qs.accepted);
+    metric(out, "wavy_upload_jobs_rejected_total", "counter", "Uploads turned away with 503",
+           qs.rejected);
+    metric(out, "wavy_upload_jobs_completed_total", "counter", "Upload jobs ingested successfully",
+           qs.completed);
+    metric(out, "wavy_upload_jobs_failed_total", "counter", "Upload jobs that failed ingest",
+           qs.failed);
+    metric(out, "wavy_upload_jobs_queued", "gauge", "Upload jobs waiting for a worker", qs.queued);
+    metric(out, "wavy_upload_jobs_running", "gauge", "Upload jobs being ingested", qs.running);
+    metric(out, "wavy_upload_jobs_payload_bytes", "gauge",
+           "Request bodies held by queued and running upload jobs", qs.payload_bytes);
+
+    return out.str();
+  }
+
+  // Prometheus histogram (coarse `le` buckets folded from the fine HDR buckets) plus a
+  // summary with p50/p90/p99/p999 (within ~3%), both labelled by route and class
+  static auto latency_to_prometheus_format(const LatencyTable& table) -> std::string
+  {
+    // Bucket bounds in microseconds, 100 us .. 10 s
+    static constexpr std::array<ui64, 16> LE_US = {
+      100, 250, 500, 1'000, 2'500, 5'000, 10'000, 25'000, 50'000, 100'000, 250'000, 500'000,
+      1'000'000, 2'500'000, 5'000'000, 10'000'000};
+    static constexpr std::array<std::pair<const char*, double>, 4> QUANTILES = {
+      {{"0.5", 0.5}, {"0.9", 0.9}, {"0.99", 0.99}, {"0.999", 0.999}}};
+
+    std::ostringstream histogram, summary;
+    histogram << "# HELP wavy_request_duration_seconds Request latency by route and status "
+                 "class\n";
+    histogram << "# TYPE wavy_request_duration_seconds histogram\n";
+    summary << "# HELP wavy_request_duration_quantile_seconds Request latency percentiles by "
+               "route and status class\n";
+    summary << "# TYPE wavy_request_duration_quantile_seconds summary\n";
+
+    auto seconds = [](ui64 us) { return static_cast<double>(us) / 1e6; };
+
+    table.for_each(
+      [&](MetricsRoute route, StatusClass cls, const LatencyHistogram::Snapshot& snap)
+      {
+        std::ostringstream labels;
+        labels << "route=\"" << to_string(route) << "\",class=\"" << to_string(cls) << "\"";
+        const auto l = labels.str();
+
+        for (const auto le : LE_US)
+          histogram << "wavy_request_duration_seconds_bucket{" << l << ",le=\"" << seconds(le)
+                    << "\"} " << snap.count_at_or_below(le) << "\n";
+        histogram << "wavy_request_duration_seconds_bucket{" << l << ",le=\"+Inf\"} "
+                  << snap.count << "\n";
+        histogram << "wavy_request_duration_seconds_sum{" << l << "} " << seconds(snap.sum_us)
+                  << "\n";
+        histogram << "wavy_request_duration_seconds_count{" << l << "} " << snap.count << "\n";
+
+        for (const auto& [name, q] : QUANTILES)
+          summary << "wavy_request_duration_quantile_seconds{" << l << ",quantile=\"" << name
+                  << "\"} " << seconds(snap.percentile(q)) << "\n";
+        summary << "wavy_request_duration_quantile_seconds_sum{" << l << "} "
+                << seconds(snap.sum_us) << "\n";
+        summary << "wavy_request_duration_quantile_seconds_count{" << l << "} " << snap.count
+                << "\n";
+      });
+
+    histogram << "\n";
+    summary << "\n";
+    return histogram.str() + summary.str();
+  }
+
+  // Every owner's storage counters, one series per owner
+  static auto owners_to_prometheus_format(const Metrics& m) -> std::string
+  {
+    std::vector<std::pair<StorageOwnerID, std::array<ui64, 4>>> rows;
+    {
+      std::shared_lock lock(m.owners_mutex);
+      rows.reserve(m.owners.size());
+      for (const auto& [owner, om] : m.owners)
+        rows.push_back({owner,
+                        {om.uploads.load(), om.deletes.load(), om.songs_count.load(),
+                         om.storage_bytes.load()}});
+    }
+    std::sort(rows.begin(), rows.end());
+
+    static constexpr std::array<std::array<const char*, 3>, 4> METRICS = {{
+      {"wavy_owner_uploads_total", "counter", "Total uploads from this owner"},
+      {"wavy_owner_deletes_total", "counter", "Total deletes from this owner"},
+      {"wavy_owner_songs_count", "gauge", "Current songs count for this owner"},
+      {"wavy_owner_storage_bytes", "gauge", "Total storage used by this owner"},
+    }};
+
+    std::ostringstream out;
+    for (size_t i = 0; i < METRICS.size(); ++i)
+    {
+      const auto& [name, type, help] = METRICS[i];
+      out << "# HELP " << name << " " << help << "\n";
+      out << "# TYPE " << name << " " << type << "\n";
+      for (const auto& [owner, values] : rows)
+        out << name << "{owner=\"" << escape_label(owner) << "\"} " << values[i] << "\n";
+      out << "\n";
+    }
+    return out.str();
+  }
+
+  // wavy_<prefix>_{requests,bytes,errors,cache_hits}_total for one labeled family, plus
+  // how many samples it had to fold into `_overflow`
+  template <size_t N>
+  static auto labeled_to_prometheus_format(std::string_view prefix, const LabeledFamily<N>& family)
+    -> std::string
+  {
+    struct Row
     {
+      std::string   labels;
+      LabeledSample totals;
+    };
+    std::vector<Row> rows;
+
+    family.for_each(
+      [&](const typename LabeledFamily<N>::Labels& values, const LabeledSample& totals)
+      {
+        std::string labels;
+        for (size_t i = 0; i < N; ++i)
+        {
+          if (i != 0)
+            labels += ',';
+          labels += family.names()[i];
+          labels += "=\"";
+          labels += escape_label(values[i]);
+          labels += '"';
+        }
+        rows.push_back({std::move(labels), totals});
+      });
+
+    std::ostringstream out;
+    auto counter = [&](std::string_view what, const char* help, ui64 LabeledSample::* field)
+    {
+      const auto name = "wavy_" + std::string(prefix) + "_" + std::string(what) + "_total";
       out << "# HELP " << name << " " << help << "\n";
       out << "# TYPE " << name << " counter\n";
-      out << name << "{owner=\"" << owner_id << "\"} " << value << "\n\n";
+      for (const auto& row : rows)
+        out << name << "{" << row.labels << "} " << row.totals.*field << "\n";
+      out << "\n";
     };
 
-    metric("wavy_owner_uploads_total", "Total uploads from this owner", om.uploads);
-    metric("wavy_owner_deletes_total", "Total deletes from this owner", om.deletes);
-    metric("wavy_owner_songs_count", "Current songs count for this owner", om.songs_count);
-    metric("wavy_owner_storage_bytes", "Total storage used by this owner", om.storage_bytes);
+    counter("requests", "Requests served", &LabeledSample::requests);
+    counter("bytes", "Response body bytes served", &LabeledSample::bytes);
+    counter("errors", "Requests answered with a 4xx or 5xx", &LabeledSample::errors);
+    counter("cache_hits", "Requests answered from the segment cache", &LabeledSample::cache_hits);
+
+    metric(out, "wavy_" + std::string(prefix) + "_overflow_total", "counter",
+           "Samples folded into _overflow (more than " + std::to_string(family.max_series()) +
+             " series)",
+           family.overflowed());
 
     return out.str();
   }
+
+private:
+  // One unlabelled sample with its HELP and TYPE lines
+  template <typename T>
+  static void metric(std::ostringstream& out, std::string_view name, std::string_view type,
+                     std::string_view help, const T& value)
+  {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+    out << name << " " << value << "\n\n";
+  }
+
+  static auto escape_label(std::string_view value) -> std::string
+  {
+    std::string out;
+    out.reserve(value.size());
+    for (const char c : value)
+    {
+      if (c == '\\' || c == '"')
+        out += '\\';
+      if (c == '\n')
+      {
+        out += "\\n";
+        continue;
+      }
+      out += c;
+    }
+    return out;
+  }
 };
 
 } // namespace libwavy::server
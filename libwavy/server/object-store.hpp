@@ -0,0 +1,277 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/utils/io/mmap/entry.hpp>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/*
+ * @OBJECT STORE
+ *
+ * Content addressed copies of stored files, so the same audio uploaded by several owners
+ * (compilations, re-releases, test uploads) is on disk and in the page cache once.
+ *
+ * -> Objects live in `<storage>/.objects/<sha[0:2]>/<sha>`, named by the sha256 the
+ *    track manifest already holds for every file. The name only finds the candidate: a
+ *    file is replaced by a link only after its bytes compared equal to the object's.
+ * -> Right after a track is published, each file of at least `WAVY_SERVER_DEDUPE_MIN_SIZE`
+ *    bytes becomes a hardlink of its object: the first copy is linked into the store, later
+ *    ones are replaced by a link to it (link + rename, so a reader never sees a gap).
+ * -> The link count is the reference count. Deleting a track only drops its links; an
+ *    object whose count is back to 1 is referenced by nothing but the store, and the
+ *    housekeeping sweep removes it.
+ *
+ * Stored files are never written in place (ingest writes temporaries and renames them), which
+ * is what makes sharing an inode safe. The trash worker knows not to truncate shared files.
+ *
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server
+{
+
+struct ObjectStoreStats
+{
+  std::atomic<ui64> objects{0};        // objects in the store (as of the last sweep)
+  std::atomic<ui64> physical_bytes{0}; // bytes the objects take once
+  std::atomic<ui64> logical_bytes{0};  // bytes the track files referencing them add up to
+  std::atomic<ui64> shared_files{0};   // track files replaced by a link to an existing object
+  std::atomic<ui64> shared_bytes{0};   // bytes those files no longer take
+  std::atomic<ui64> reclaimed{0};      // unreferenced objects removed
+  std::atomic<ui64> reclaimed_bytes{0};
+};
+
+struct DedupeResult
+{
+  std::size_t stored = 0; // files that became new objects
+  std::size_t shared = 0; // files now sharing an existing object
+  ui64        bytes  = 0; // bytes saved by the shared ones
+};
+
+struct ObjectSweepResult
+{
+  std::size_t removed  = 0;
+  ui64        bytes    = 0;
+  bool        finished = false;
+};
+
+class ObjectStore
+{
+public:
+  using Manifest = std::vector<std::pair<FileName, std::string>>;
+
+  explicit ObjectStore(fs::path dir      = macros::to_string(macros::SERVER_STORAGE_DIR_OBJECTS),
+                       ui64     min_size = WAVY_SERVER_DEDUPE_MIN_SIZE)
+      : m_dir(std::move(dir)), m_minSize(min_size)
+  {
+  }
+
+  ObjectStore(const ObjectStore&)                    = delete;
+  auto operator=(const ObjectStore&) -> ObjectStore& = delete;
+
+  [[nodiscard]] auto stats() const -> const ObjectStoreStats& { return m_stats; }
+
+  /// Links the files of the published track in `track_dir` to their objects. Files that
+  /// cannot be linked (other filesystem, I/O error) simply stay private copies.
+  auto link_track(const fs::path& track_dir, const Manifest& manifest) -> DedupeResult
+  {
+    DedupeResult result;
+
+    for (const auto& [name, sha] : manifest)
+    {
+      if (!is_digest(sha))
+        continue;
+
+      const fs::path file = track_dir / name;
+      struct stat    st{};
+      if (::lstat(file.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+          static_cast<ui64>(st.st_size) < m_minSize)
+        continue;
+
+      const auto size = static_cast<ui64>(st.st_size);
+      switch (link_file(file, st, object_path(sha)))
+      {
+        case Linked::Stored:
+          result.stored++;
+          m_stats.objects++;
+          m_stats.physical_bytes += size;
+          m_stats.logical_bytes += size;
+          break;
+
+        case Linked::Shared:
+          result.shared++;
+          result.bytes += size;
+          m_stats.shared_files++;
+          m_stats.shared_bytes += size;
+          m_stats.logical_bytes += size;
+          break;
+
+        case Linked::Skipped:
+          break;
+      }
+    }
+    return result;
+  }
+
+  /// Removes objects no track links to any more and recounts the gauges. Runs on the
+  /// housekeeping thread.
+  auto sweep(const std::stop_token& stop) -> ObjectSweepResult
+  {
+    ObjectSweepResult result;
+    ui64              objects = 0, physical = 0, logical = 0;
+
+    std::error_code ec;
+    for (fs::directory_iterator shards(m_dir, ec), end; !ec && shards != end; shards.increment(ec))
+    {
+      std::error_code shard_ec;
+      for (fs::directory_iterator it(shards->path(), shard_ec), e; !shard_ec && it != e;
+           it.increment(shard_ec))
+      {
+        if (stop.stop_requested())
+          return result;
+
+        struct stat st{};
+        if (::lstat(it->path().c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+          continue;
+
+        const auto size = static_cast<ui64>(st.st_size);
+        if (st.st_nlink <= 1 && remove_unreferenced(it->path()))
+        {
+          result.removed++;
+          result.bytes += size;
+          continue;
+        }
+
+        objects++;
+        physical += size;
+        logical += size * (st.st_nlink > 1 ? st.st_nlink - 1 : 1);
+      }
+    }
+
+    m_stats.objects        = objects;
+    m_stats.physical_bytes = physical;
+    m_stats.logical_bytes  = logical;
+    m_stats.reclaimed += result.removed;
+    m_stats.reclaimed_bytes += result.bytes;
+    result.finished = true;
+    return result;
+  }
+
+private:
+  enum class Linked
+  {
+    Stored,
+    Shared,
+    Skipped
+  };
+
+  fs::path         m_dir;
+  ui64             m_minSize;
+  std::mutex       m_mutex; // orders linking against the sweep's unlinks
+  ObjectStoreStats m_stats;
+
+  static auto is_digest(const std::string& sha) -> bool
+  {
+    if (sha.size() != 64)
+      return false;
+    for (const char c : sha)
+      if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+        return false;
+    return true;
+  }
+
+  [[nodiscard]] auto object_path(const std::string& sha) const -> fs::path
+  {
+    return m_dir / sha.substr(0, 2) / sha;
+  }
+
+  auto link_file(const fs::path& file, const struct stat& st, const fs::path& object) -> Linked
+  {
+    std::lock_guard lock(m_mutex);
+
+    std::error_code ec;
+    fs::create_directories(object.parent_path(), ec);
+
+    // First copy of this content: the file itself becomes the object
+    if (::link(file.c_str(), object.c_str()) == 0)
+      return Linked::Stored;
+    if (errno != EEXIST)
+      return Linked::Skipped;
+
+    struct stat existing{};
+    if (::lstat(object.c_str(), &existing) != 0 || !S_ISREG(existing.st_mode))
+      return Linked::Skipped;
+    if (existing.st_dev == st.st_dev && existing.st_ino == st.st_ino)
+      return Linked::Skipped; // already linked
+    // Same digest, different contents is a wrong manifest or a corrupt object: leave both
+    if (existing.st_size != st.st_size || !same_contents(file, object))
+      return Linked::Skipped;
+
+    fs::path tmp = file;
+    tmp += ".dedupe";
+    if (::link(object.c_str(), tmp.c_str()) != 0)
+      return Linked::Skipped;
+
+    fs::rename(tmp, file, ec);
+    if (ec)
+    {
+      fs::remove(tmp, ec);
+      return Linked::Skipped;
+    }
+    return Linked::Shared;
+  }
+
+  // Under m_mutex, so the sweep cannot unlink the object while it is being read
+  static auto same_contents(const fs::path& a, const fs::path& b) -> bool
+  {
+    utils::MappedFile lhs(a.string());
+    utils::MappedFile rhs(b.string());
+    return lhs.is_open() && rhs.is_open() && lhs.view() == rhs.view();
+  }
+
+  auto remove_unreferenced(const fs::path& object) -> bool
+  {
+    std::lock_guard lock(m_mutex);
+
+    // A track may have linked it since the directory was read
+    struct stat st{};
+    if (::lstat(object.c_str(), &st) != 0 || st.st_nlink > 1)
+      return false;
+    return ::unlink(object.c_str()) == 0;
+  }
+};
+
+} // namespace libwavy::server
@@ -6,8 +6,8 @@
 struct OwnerMetrics
 {
   std::atomic<ui64> uploads{0};
-  std::atomic<ui64> downloads{0};
   std::atomic<ui64> deletes{0};
+  std::atomic<ui64> downloads{0}; // /download and /stream requests for the owner's tracks
   std::atomic<ui64> songs_count{0};
   std::atomic<ui64> storage_bytes{0};
 };
@@ -0,0 +1,371 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <libwavy/common/content-encoding.hpp>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/parser/byterange.hpp>
+#include <libwavy/server/auth.hpp>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Packed track layout
+ *
+ * A track normally stores every segment as its own file, hundreds per track. With the
+ * packed layout every media playlist `<name>.m3u8` gets one `<name>.pack` instead: its
+ * segments concatenated in playlist order. The playlist is rewritten to address them
+ * with `#EXT-X-BYTERANGE:<length>@<offset>` (EXT-X-VERSION raised to 4), and the segment
+ * files are removed before the track is published.
+ *
+ * Nothing else changes: master playlists, init.mp4, metadata and the manifest stay
+ * separate files, and the manifest hashes the pack and the rewritten playlists. Clients
+ * fetch a segment with a `Range` request on the pack.
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server::ingest
+{
+
+enum class StorageLayout
+{
+  Files, // one file per segment
+  Packed // one .pack per media playlist, addressed with EXT-X-BYTERANGE
+};
+
+inline auto to_string(StorageLayout layout) -> const char*
+{
+  return layout == StorageLayout::Packed ? "packed" : "files";
+}
+
+inline auto default_storage_layout() -> StorageLayout
+{
+  return WAVY_SERVER_PACKED_STORAGE ? StorageLayout::Packed : StorageLayout::Files;
+}
+
+struct PackResult
+{
+  std::size_t playlists = 0; // media playlists rewritten
+  std::size_t segments  = 0; // segment files folded into packs
+  std::string error;         // first playlist that could not be packed (left as files)
+};
+
+class TrackPacker
+{
+public:
+  using Manifest = std::vector<std::pair<FileName, std::string>>;
+
+  // `manifest` is the staging manifest; it is updated to describe the packed track
+  TrackPacker(fs::path dir, Manifest& manifest) : m_dir(std::move(dir)), m_manifest(manifest) {}
+
+  // Packs each media playlist on its own: one that cannot be packed (missing segment,
+  // I/O error) keeps its files and does not stop the others.
+  auto run() -> PackResult
+  {
+    PackResult result;
+
+    std::vector<FileName> playlists;
+    for (const auto& [name, _] : m_manifest)
+      if (name.ends_with(macros::PLAYLIST_EXT))
+        playlists.push_back(name);
+    std::sort(playlists.begin(), playlists.end());
+
+    std::set<FileName> packed, still_referenced;
+    for (const auto& playlist : playlists)
+    {
+      std::vector<FileName> segments;
+      switch (packPlaylist(playlist, segments))
+      {
+        case Outcome::Packed:
+          result.playlists++;
+          packed.insert(segments.begin(), segments.end());
+          break;
+
+        case Outcome::Failed:
+          if (result.error.empty())
+            result.error = "could not pack " + playlist;
+          [[fallthrough]];
+
+        case Outcome::Skipped:
+          still_referenced.insert(segments.begin(), segments.end());
+          break;
+      }
+    }
+
+    for (const auto& segment : packed)
+    {
+      if (still_referenced.contains(segment))
+        continue;
+
+      std::error_code ec;
+      fs::remove(m_dir / segment, ec);
+      result.segments++;
+    }
+
+    rebuildManifest();
+    return result;
+  }
+
+private:
+  enum class Outcome
+  {
+    Packed,
+    Skipped, // master playlist, already ranged, or no segments
+    Failed
+  };
+
+  static constexpr std::size_t COPY_BUFFER = 128 * 1024;
+
+  fs::path                                  m_dir;
+  Manifest&                                 m_manifest;
+  std::unordered_map<FileName, std::string> m_hashes; // overrides and removals
+  std::set<FileName>                        m_added;
+
+  // Fills `segments` with the files the playlist references, packed or not
+  auto packPlaylist(const FileName& playlist, std::vector<FileName>& segments) -> Outcome
+  {
+    std::ifstream in(m_dir / playlist, std::ios::binary);
+    if (!in)
+      return Outcome::Failed;
+    const std::string content{std::istreambuf_iterator<char>(in), {}};
+
+    std::vector<std::string> lines;
+    {
+      std::istringstream ss(content);
+      std::string        line;
+      while (std::getline(ss, line))
+      {
+        if (!line.empty() && line.back() == '\r')
+          line.pop_back();
+        lines.push_back(std::move(line));
+      }
+    }
+
+    for (const auto& line : lines)
+    {
+      if (line.starts_with(hls::parser::macro::EXT_X_BYTERANGE))
+        return Outcome::Skipped;
+      if (line.empty() || line.front() == '#')
+        continue;
+      if (line.ends_with(macros::PLAYLIST_EXT))
+        return Outcome::Skipped; // master playlist
+      segments.push_back(line);
+    }
+    if (segments.empty())
+      return Outcome::Skipped;
+
+    for (const auto& segment : segments)
+    {
+      std::error_code ec;
+      if (segment.find('/') != std::string::npos || !fs::is_regular_file(m_dir / segment, ec))
+        return Outcome::Failed;
+    }
+
+    const FileName pack =
+      fs::path(playlist).stem().string() + macros::to_string(macros::PACK_FILE_EXT);
+
+    std::vector<hls::parser::MediaByteRange> ranges;
+    std::string                              pack_sha;
+    if (!writePack(pack, segments, ranges, pack_sha))
+      return Outcome::Failed;
+
+    std::string rewritten = rewritePlaylist(lines, pack, ranges);
+    if (!replaceFile(playlist, rewritten))
+    {
+      std::error_code ec;
+      fs::remove(m_dir / pack, ec);
+      return Outcome::Failed;
+    }
+
+    auth::Sha256Stream sha;
+    sha.update(rewritten.data(), rewritten.size());
+    m_hashes[playlist] = sha.final_hex().value_or("");
+    m_hashes[pack]     = std::move(pack_sha);
+    m_added.insert(pack);
+    return Outcome::Packed;
+  }
+
+  // Concatenates the segments into `pack` (one range per playlist entry, so a segment
+  // listed twice is stored twice) and hashes the result on the way
+  auto writePack(const FileName& pack, const std::vector<FileName>& segments,
+                 std::vector<hls::parser::MediaByteRange>& ranges, std::string& sha_hex) -> bool
+  {
+    const fs::path tmp = m_dir / (pack + ".tmp");
+    std::ofstream  out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out)
+      return false;
+
+    auth::Sha256Stream sha;
+    std::vector<char>  buffer(COPY_BUFFER);
+    ui64               offset = 0;
+
+    for (const auto& segment : segments)
+    {
+      std::ifstream in(m_dir / segment, std::ios::binary);
+      ui64          length = 0;
+      while (in)
+      {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        const auto n = static_cast<std::size_t>(in.gcount());
+        if (n == 0)
+          break;
+        sha.update(buffer.data(), n);
+        out.write(buffer.data(), static_cast<std::streamsize>(n));
+        length += n;
+      }
+
+      if (in.bad() || !out || length == 0)
+      {
+        out.close();
+        std::error_code ec;
+        fs::remove(tmp, ec);
+        return false;
+      }
+
+      ranges.push_back({.length = length, .offset = offset});
+      offset += length;
+    }
+
+    out.close();
+    auto            digest = sha.final_hex();
+    std::error_code ec;
+    if (!out || !digest)
+    {
+      fs::remove(tmp, ec);
+      return false;
+    }
+
+    fs::rename(tmp, m_dir / pack, ec);
+    if (ec)
+    {
+      fs::remove(tmp, ec);
+      return false;
+    }
+    sha_hex = std::move(*digest);
+    return true;
+  }
+
+  static auto rewritePlaylist(const std::vector<std::string>& lines, const FileName& pack,
+                              const std::vector<hls::parser::MediaByteRange>& ranges)
+    -> std::string
+  {
+    namespace hls_macro = hls::parser::macro;
+
+    std::string out;
+    std::size_t next          = 0;
+    bool        version_found = std::ranges::any_of(
+      lines, [](const std::string& line) { return line.starts_with(hls_macro::EXT_X_VERSION); });
+
+    for (const auto& line : lines)
+    {
+      if (line.starts_with(hls_macro::EXT_X_VERSION))
+      {
+        int version = 0;
+        std::from_chars(line.data() + hls_macro::EXT_X_VERSION.size(),
+                        line.data() + line.size(), version);
+        out += hls_macro::EXT_X_VERSION;
+        out += std::to_string(std::max(version, hls::parser::BYTERANGE_MIN_VERSION));
+        out += '\n';
+        continue;
+      }
+
+      if (!line.empty() && line.front() != '#')
+      {
+        out += hls::parser::format_byterange(ranges[next++]);
+        out += '\n';
+        out += pack;
+        out += '\n';
+        continue;
+      }
+
+      out += line;
+      out += '\n';
+
+      if (!version_found && line.starts_with(macros::PLAYLIST_GLOBAL_HEADER))
+      {
+        out += hls_macro::EXT_X_VERSION;
+        out += std::to_string(hls::parser::BYTERANGE_MIN_VERSION);
+        out += '\n';
+        version_found = true;
+      }
+    }
+    return out;
+  }
+
+  auto replaceFile(const FileName& name, const std::string& content) -> bool
+  {
+    const fs::path target = m_dir / name;
+    const fs::path tmp    = m_dir / (name + ".tmp");
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out.write(content.data(), static_cast<std::streamsize>(content.size()));
+      if (!out)
+        return false;
+    }
+
+    std::error_code ec;
+    fs::rename(tmp, target, ec);
+    if (ec)
+      return false;
+
+    // A .zst kept from the upload described the old content
+    fs::remove(m_dir / encoding::variant_name(name, encoding::Coding::Zstd), ec);
+    return true;
+  }
+
+  void rebuildManifest()
+  {
+    Manifest rebuilt;
+    rebuilt.reserve(m_manifest.size());
+    for (auto& [name, sha] : m_manifest)
+    {
+      auto it = m_hashes.find(name);
+      if (it == m_hashes.end())
+      {
+        // Removed segments are no longer on disk
+        std::error_code ec;
+        if (fs::exists(m_dir / name, ec))
+          rebuilt.emplace_back(std::move(name), std::move(sha));
+        continue;
+      }
+      rebuilt.emplace_back(name, it->second);
+    }
+    for (const auto& pack : m_added)
+      rebuilt.emplace_back(pack, m_hashes[pack]);
+    m_manifest = std::move(rebuilt);
+  }
+};
+
+} // namespace libwavy::server::ingest
@@ -0,0 +1,170 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <libwavy/common/content-encoding.hpp>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/server/auth.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Precompressed text variants
+ *
+ * Playlists, seek indexes and metadata.toml are small, highly compressible and fetched far
+ * more often than they change. At ingest every such file gets `<name>.zst` and `<name>.gz`
+ * next to it, and the manifest lists them, so each variant has its own strong ETag.
+ * /download then only picks a variant (encoding::negotiate) and never compresses per request.
+ *
+ * A text file that was uploaded as `.zst` keeps those exact bytes as its zstd variant
+ * (see ExtractPipeline) instead of being compressed again. Variants that would not be
+ * smaller than the file are not stored.
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server::ingest
+{
+
+struct PrecompressResult
+{
+  std::size_t files    = 0; // text files that got at least one variant
+  std::size_t variants = 0; // variant files stored
+  ui64        bytes_in = 0; // identity size of those files
+  ui64        zstd_out = 0; // size of their zstd variants
+};
+
+class Precompressor
+{
+public:
+  using Manifest = std::vector<std::pair<FileName, std::string>>;
+
+  // `manifest` is the staging manifest; the variants are appended to it
+  Precompressor(fs::path dir, Manifest& manifest) : m_dir(std::move(dir)), m_manifest(manifest) {}
+
+  auto run() -> PrecompressResult
+  {
+    PrecompressResult result;
+
+    Manifest added;
+    for (const auto& [name, _] : m_manifest)
+    {
+      if (!encoding::is_precompressible(name))
+        continue;
+
+      std::string content;
+      if (!readFile(m_dir / name, content) || content.size() < WAVY_SERVER_PRECOMPRESS_MIN_SIZE)
+      {
+        dropVariant(name, encoding::Coding::Zstd);
+        continue;
+      }
+
+      std::size_t stored = 0;
+      for (const auto coding : {encoding::Coding::Zstd, encoding::Coding::Gzip})
+      {
+        std::string variant;
+        if (!makeVariant(name, coding, content, variant))
+          continue;
+
+        auto digest = auth::compute_sha256_hex(variant.data(), variant.size());
+        if (!digest)
+        {
+          dropVariant(name, coding);
+          continue;
+        }
+
+        added.emplace_back(encoding::variant_name(name, coding), std::move(*digest));
+        if (coding == encoding::Coding::Zstd)
+          result.zstd_out += variant.size();
+        stored++;
+      }
+
+      if (stored > 0)
+      {
+        result.files++;
+        result.variants += stored;
+        result.bytes_in += content.size();
+      }
+    }
+
+    m_manifest.insert(m_manifest.end(), std::make_move_iterator(added.begin()),
+                      std::make_move_iterator(added.end()));
+    return result;
+  }
+
+private:
+  fs::path  m_dir;
+  Manifest& m_manifest;
+
+  // Leaves the variant of `name` on disk in `out`; false if it is not worth storing
+  auto makeVariant(const FileName& name, encoding::Coding coding, const std::string& content,
+                   std::string& out) -> bool
+  {
+    const fs::path path = m_dir / encoding::variant_name(name, coding);
+
+    std::error_code ec;
+    const bool      uploaded = coding == encoding::Coding::Zstd && fs::exists(path, ec);
+    if (uploaded && readFile(path, out) && out.size() < content.size())
+      return true;
+
+    auto compressed = encoding::compress(coding, content);
+    if (!compressed || compressed->size() >= content.size() || !writeFile(path, *compressed))
+    {
+      dropVariant(name, coding);
+      return false;
+    }
+
+    out = std::move(*compressed);
+    return true;
+  }
+
+  void dropVariant(const FileName& name, encoding::Coding coding)
+  {
+    std::error_code ec;
+    fs::remove(m_dir / encoding::variant_name(name, coding), ec);
+  }
+
+  static auto readFile(const fs::path& path, std::string& out) -> bool
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+  }
+
+  static auto writeFile(const fs::path& path, const std::string& content) -> bool
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    return static_cast<bool>(out);
+  }
+};
+
+} // namespace libwavy::server::ingest
@@ -25,7 +25,13 @@
 
 #include <libwavy/common/state.hpp>
 #include <libwavy/common/types.hpp>
+#include <libwavy/db/catalog-log.hpp>
 #include <libwavy/db/db.h>
+#include <libwavy/server/extract-pipeline.hpp>
+#include <libwavy/server/object-store.hpp>
+#include <libwavy/server/packfile.hpp>
+#include <libwavy/utils/io/async/entry.hpp>
+#include <string_view>
 #include <vector>
 
 namespace libwavy::server::helpers
@@ -36,8 +42,15 @@ auto is_valid_extension(const AbsPath& filename) -> bool;
 auto validate_m3u8_format(const PlaylistData& content) -> bool;
 auto validate_ts_file(const std::vector<ui8>& data) -> bool;
 auto validate_m4s(const AbsPath& m4s_path) -> bool;
+auto write_track_manifest(const AbsPath&                                      storage_path,
+                          const std::vector<std::pair<FileName, std::string>>& entries) -> bool;
 void populate_db_from_storage(OwnerAudioIDMap& db, const AbsPath& storage_path);
-auto extract_and_validate(const RelPath& gzip_path, const StorageAudioID& audio_id,
-                          OwnerAudioIDMap& g_owner_audio_db) -> StorageOwnerID;
+auto extract_payload(std::string_view payload, const RelPath& extract_path,
+                     utils::aio::FileIO& io, ingest::ExtractResult& out,
+                     const ingest::PayloadObserver& on_payload = {}) -> bool;
+auto extract_and_validate(std::string_view payload, const StorageAudioID& audio_id,
+                          CatalogLog& catalog, utils::aio::FileIO& io, ObjectStore* objects,
+                          ingest::StorageLayout          layout     = ingest::StorageLayout::Files,
+                          const ingest::PayloadObserver& on_payload = {}) -> StorageOwnerID;
 
 } // namespace libwavy::server::helpers
@@ -6,10 +6,14 @@ namespace libwavy::server
 {
 
 // Request timing middleware
+//
+// The latency sample is filed under the route given at construction and the status
+// class of the last mark_* call.
 class RequestTimer
 {
 public:
-  RequestTimer(Metrics& metrics) : metrics_(metrics), start_time_(std::chrono::steady_clock::now())
+  RequestTimer(Metrics& metrics, MetricsRoute route = MetricsRoute::Other)
+      : metrics_(metrics), route_(route), start_time_(std::chrono::steady_clock::now())
   {
     metrics_.total_requests++;
     metrics_.active_connections++;
@@ -17,22 +21,46 @@ public:
 
   ~RequestTimer()
   {
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - start_time_);
-    metrics_.record_response_time(duration);
+    metrics_.record_response_time(route_, class_, duration);
     metrics_.active_connections--;
   }
 
-  void mark_success() { metrics_.successful_requests++; }
-  void mark_failure() { metrics_.failed_requests++; }
-  void mark_error_400() { metrics_.error_400_count++; }
-  void mark_error_404() { metrics_.error_404_count++; }
-  void mark_error_500() { metrics_.error_500_count++; }
-  void mark_error_403() { metrics_.error_403_count++; }
+  void mark_success()
+  {
+    metrics_.successful_requests++;
+    class_ = StatusClass::Success;
+  }
+  void mark_failure()
+  {
+    metrics_.failed_requests++;
+    class_ = StatusClass::ServerError;
+  }
+  void mark_error_400() { client_error(metrics_.error_400_count); }
+  void mark_error_404() { client_error(metrics_.error_404_count); }
+  void mark_error_500()
+  {
+    metrics_.error_500_count++;
+    class_ = StatusClass::ServerError;
+  }
+  void mark_error_403() { client_error(metrics_.error_403_count); }
+  void mark_error_416() { client_error(metrics_.error_416_count); }
+  void mark_error_429() { client_error(metrics_.error_429_count); }
+
+  [[nodiscard]] auto status_class() const -> StatusClass { return class_; }
 
 private:
   Metrics&                              metrics_;
+  MetricsRoute                          route_;
+  StatusClass                           class_ = StatusClass::Unmarked;
   std::chrono::steady_clock::time_point start_time_;
+
+  void client_error(std::atomic<ui64>& counter)
+  {
+    counter++;
+    class_ = StatusClass::ClientError;
+  }
 };
 
 } // namespace libwavy::server
@@ -0,0 +1,433 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/server/track-generations.hpp>
+#include <libwavy/utils/io/mmap/entry.hpp>
+#include <libwavy/utils/math/entry.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * @SEGMENT CACHE
+ *
+ * Byte budgeted, sharded LRU of segment / playlist bodies keyed by
+ * "<owner>/<audio-id>/<filename>".
+ *
+ * -> Bodies are held as `shared_ptr<const std::string>`, so any number of concurrent
+ *    responses can reference the same bytes while the entry is being evicted.
+ * -> Misses on files that do not exist are remembered as negative entries so repeated
+ *    404s skip the filesystem too. They live in their own small LRU per shard and expire
+ *    after WAVY_SERVER_NEGATIVE_CACHE_TTL, so a scan of made-up names never evicts a
+ *    body and a not-found that raced a publish does not outlive the TTL.
+ * -> Each shard owns `budget / shard_count` bytes and its own mutex, so a hot key only
+ *    contends with keys hashing into the same shard.
+ *
+ * Uploaded content is immutable, so the only invalidation points are upload and delete.
+ * Upload only bumps the track's generation (publish_track): negative entries remember
+ * the generation they were put under and read as misses once it moves. Delete also
+ * sweeps the shards to free the track's bodies. A fill races both: read generation()
+ * before touching the disk and pass it to put(), which drops the body if the track was
+ * invalidated in between.
+ *
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server
+{
+
+using CachedBody = std::shared_ptr<const std::string>;
+
+struct SegmentCacheStats
+{
+  std::atomic<ui64> hits{0};
+  std::atomic<ui64> negative_hits{0};
+  std::atomic<ui64> misses{0};
+  std::atomic<ui64> insertions{0};
+  std::atomic<ui64> evictions{0};
+  std::atomic<ui64> invalidations{0};
+  std::atomic<ui64> stale_fills{0}; // loads dropped because their track was invalidated
+  std::atomic<ui64> bytes{0};
+  std::atomic<ui64> entries{0};
+  std::atomic<ui64> negative_entries{0};
+};
+
+class SegmentCache
+{
+public:
+  enum class Lookup
+  {
+    Miss,
+    Hit,
+    Negative
+  };
+
+  explicit SegmentCache(std::size_t byte_budget =
+                          static_cast<std::size_t>(WAVY_SERVER_SEGMENT_CACHE_SIZE) * ONE_MIB,
+                        std::size_t shard_count      = 16,
+                        std::size_t negative_entries = WAVY_SERVER_NEGATIVE_CACHE_ENTRIES,
+                        std::chrono::seconds negative_ttl =
+                          std::chrono::seconds(WAVY_SERVER_NEGATIVE_CACHE_TTL))
+      : m_shards(shard_count == 0 ? 1 : shard_count), m_negativeTTL(negative_ttl)
+  {
+    const std::size_t shard_budget    = byte_budget / m_shards.size();
+    const std::size_t shard_negatives = negative_entries / m_shards.size();
+    for (auto& shard : m_shards)
+    {
+      shard.budget            = shard_budget;
+      shard.negative_capacity = shard_negatives;
+    }
+
+    // A single lossless segment should never be able to flush a whole shard
+    m_maxObjectSize = shard_budget / 4;
+  }
+
+  static auto make_key(const StorageOwnerID& owner, const StorageAudioID& audio_id,
+                       const FileName& filename) -> std::string
+  {
+    return owner + "/" + audio_id + "/" + filename;
+  }
+
+  [[nodiscard]] auto max_object_size() const -> std::size_t { return m_maxObjectSize; }
+  [[nodiscard]] auto stats() const -> const SegmentCacheStats& { return m_stats; }
+
+  /// Read before loading anything of the track that will be put() afterwards.
+  [[nodiscard]] auto generation(const StorageOwnerID& owner, const StorageAudioID& audio_id) const
+    -> ui64
+  {
+    return m_generations.current(TrackGenerations::track_of(owner, audio_id));
+  }
+
+  auto get(const std::string& key, CachedBody& out) -> Lookup
+  {
+    auto&            shard = shard_for(key);
+    std::unique_lock lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it != shard.index.end() && lapsed(*it->second))
+    {
+      erase(shard, it->second);
+      it = shard.index.end();
+    }
+
+    if (it == shard.index.end())
+    {
+      m_stats.misses++;
+      return Lookup::Miss;
+    }
+
+    if (!it->second->body)
+    {
+      shard.negatives.splice(shard.negatives.begin(), shard.negatives, it->second);
+      m_stats.negative_hits++;
+      return Lookup::Negative;
+    }
+
+    // Move to the front of the LRU list
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+
+    out = it->second->body;
+    m_stats.hits++;
+    return Lookup::Hit;
+  }
+
+  /// Whether `key` has an entry, negative ones included. Leaves LRU order and stats alone.
+  [[nodiscard]] auto contains(const std::string& key) -> bool
+  {
+    auto&            shard = shard_for(key);
+    std::unique_lock lock(shard.mutex);
+    auto             it = shard.index.find(key);
+    return it != shard.index.end() && !lapsed(*it->second);
+  }
+
+  /// Caches `body` unless its track was invalidated since `generation` was read.
+  void put(const std::string& key, CachedBody body, ui64 generation)
+  {
+    if (!body || body->size() > m_maxObjectSize)
+      return;
+    insert(key, std::move(body), generation);
+  }
+
+  /// Remembers that `key` does not exist, for at most the negative TTL. Only worth it for
+  /// tracks that exist: anything else would let made-up names fill the negative LRU.
+  void put_negative(const std::string& key, ui64 generation)
+  {
+    auto&            shard = shard_for(key);
+    std::unique_lock lock(shard.mutex);
+
+    if (shard.negative_capacity == 0 || !fresh(key, generation))
+      return;
+
+    if (auto it = shard.index.find(key); it != shard.index.end())
+      erase(shard, it->second);
+
+    while (shard.negatives.size() >= shard.negative_capacity)
+      erase(shard, std::prev(shard.negatives.end()));
+
+    shard.negatives.push_front(
+      Entry{key, nullptr, 0, std::chrono::steady_clock::now() + m_negativeTTL, generation});
+    shard.index.emplace(key, shard.negatives.begin());
+    m_stats.negative_entries++;
+  }
+
+  void invalidate(const std::string& key)
+  {
+    auto&            shard = shard_for(key);
+    std::unique_lock lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end())
+      return;
+
+    erase(shard, it->second);
+    m_stats.invalidations++;
+  }
+
+  /// Marks a freshly published track: its negative entries (e.g. 404s from early polling)
+  /// and fills still in flight go stale. Nothing positive can be cached for a track that
+  /// did not exist yet, so unlike invalidate_track() this touches no shard.
+  void publish_track(const StorageOwnerID& owner, const StorageAudioID& audio_id)
+  {
+    m_generations.bump(TrackGenerations::track_of(owner, audio_id));
+  }
+
+  /// Drops every entry (positive or negative) that belongs to a track, and every fill of
+  /// it still in flight.
+  void invalidate_track(const StorageOwnerID& owner, const StorageAudioID& audio_id)
+  {
+    const std::string track  = TrackGenerations::track_of(owner, audio_id);
+    const std::string prefix = track + "/";
+
+    // Before the sweep: a put() that still sees the old generation under a shard lock
+    // inserts ahead of the sweep of that shard and is removed by it
+    m_generations.bump(track);
+
+    for (auto& shard : m_shards)
+    {
+      std::unique_lock lock(shard.mutex);
+      for (auto* list : {&shard.lru, &shard.negatives})
+        for (auto it = list->begin(); it != list->end();)
+        {
+          auto next = std::next(it);
+          if (it->key.starts_with(prefix))
+          {
+            erase(shard, it);
+            m_stats.invalidations++;
+          }
+          it = next;
+        }
+    }
+  }
+
+  /// Reads `path` into an immutable body. Returns nullptr if it cannot be read.
+  static auto load(const fs::path& path) -> CachedBody
+  {
+    utils::MappedFile file(path.string());
+    if (!file.is_open())
+      return nullptr;
+
+    auto view = file.view();
+    return std::make_shared<const std::string>(view.data(), view.size());
+  }
+
+  /// Loads every playlist of a track plus the first `segments_per_playlist` media
+  /// segments each playlist references, so the first plays of a fresh upload are warm.
+  auto prewarm(const StorageOwnerID& owner, const StorageAudioID& audio_id,
+               std::size_t segments_per_playlist) -> std::size_t
+  {
+    const fs::path track_dir =
+      fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / owner / audio_id;
+
+    const ui64 gen = generation(owner, audio_id);
+
+    std::error_code ec;
+    if (!fs::is_directory(track_dir, ec))
+      return 0;
+
+    std::size_t warmed   = 0;
+    auto        warm_one = [&](const FileName& filename)
+    {
+      if (auto body = load(track_dir / filename))
+      {
+        put(make_key(owner, audio_id, filename), std::move(body), gen);
+        warmed++;
+      }
+    };
+
+    for (const auto& entry : fs::directory_iterator(track_dir, ec))
+    {
+      const FileName filename = entry.path().filename().string();
+      if (!filename.ends_with(macros::PLAYLIST_EXT))
+        continue;
+
+      auto playlist = load(entry.path());
+      if (!playlist)
+        continue;
+
+      put(make_key(owner, audio_id, filename), playlist, gen);
+      warmed++;
+
+      std::istringstream iss(*playlist);
+      std::string        line;
+      std::size_t        taken = 0;
+      while (taken < segments_per_playlist && std::getline(iss, line))
+      {
+        if (!line.empty() && line.back() == '\r')
+          line.pop_back();
+        // Packs are read by range through the file handle cache, never loaded whole
+        if (line.empty() || line[0] == '#' || line.ends_with(macros::PLAYLIST_EXT) ||
+            line.ends_with(macros::PACK_FILE_EXT))
+          continue;
+        // Only plain file names of this track, never paths out of its directory
+        if (line.find('/') != std::string::npos || line == "..")
+          continue;
+
+        warm_one(line);
+        taken++;
+      }
+    }
+
+    // fMP4 variants need their init segment before anything else
+    if (fs::exists(track_dir / "init.mp4", ec))
+      warm_one("init.mp4");
+
+    return warmed;
+  }
+
+private:
+  struct Entry
+  {
+    std::string                           key;
+    CachedBody                            body; // nullptr marks a negative entry
+    std::size_t                           charge;
+    std::chrono::steady_clock::time_point expires{};   // negative entries only
+    ui64                                  generation{}; // negative entries only
+  };
+
+  struct Shard
+  {
+    std::mutex                                                   mutex;
+    std::list<Entry>                                             lru;
+    std::list<Entry>                                             negatives;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::size_t                                                  bytes             = 0;
+    std::size_t                                                  budget            = 0;
+    std::size_t                                                  negative_capacity = 0;
+  };
+
+  // Bookkeeping overhead per entry (list node, map node, key)
+  static constexpr std::size_t ENTRY_OVERHEAD = 128;
+
+  std::vector<Shard>   m_shards;
+  std::size_t          m_maxObjectSize = 0;
+  std::chrono::seconds m_negativeTTL;
+  TrackGenerations     m_generations;
+  SegmentCacheStats    m_stats;
+
+  auto shard_for(const std::string& key) -> Shard&
+  {
+    return m_shards[std::hash<std::string>{}(key) % m_shards.size()];
+  }
+
+  void insert(const std::string& key, CachedBody body, ui64 generation)
+  {
+    const std::size_t charge = key.size() + ENTRY_OVERHEAD + (body ? body->size() : 0);
+
+    auto&            shard = shard_for(key);
+    std::unique_lock lock(shard.mutex);
+
+    if (!fresh(key, generation))
+      return;
+
+    if (auto it = shard.index.find(key); it != shard.index.end())
+      erase(shard, it->second);
+
+    if (charge > shard.budget)
+      return;
+
+    while (shard.bytes + charge > shard.budget && !shard.lru.empty())
+    {
+      erase(shard, std::prev(shard.lru.end()));
+      m_stats.evictions++;
+    }
+
+    shard.lru.push_front(Entry{key, std::move(body), charge});
+    shard.index.emplace(key, shard.lru.begin());
+    shard.bytes += charge;
+
+    m_stats.insertions++;
+    m_stats.entries++;
+    m_stats.bytes += charge;
+  }
+
+  // A negative entry past its TTL or put before its track was last published
+  [[nodiscard]] auto lapsed(const Entry& entry) const -> bool
+  {
+    if (entry.body)
+      return false;
+    return entry.expires <= std::chrono::steady_clock::now() ||
+           entry.generation !=
+             m_generations.current(TrackGenerations::track_of(std::string_view(entry.key)));
+  }
+
+  // Under the shard lock: false (and counted) if the key's track was invalidated since
+  // `generation` was read
+  auto fresh(const std::string& key, ui64 generation) -> bool
+  {
+    if (generation == m_generations.current(TrackGenerations::track_of(std::string_view(key))))
+      return true;
+    m_stats.stale_fills++;
+    return false;
+  }
+
+  void erase(Shard& shard, std::list<Entry>::iterator it)
+  {
+    shard.index.erase(it->key);
+    if (!it->body)
+    {
+      m_stats.negative_entries--;
+      shard.negatives.erase(it);
+      return;
+    }
+
+    shard.bytes -= it->charge;
+    m_stats.bytes -= it->charge;
+    m_stats.entries--;
+    shard.lru.erase(it);
+  }
+};
+
+} // namespace libwavy::server
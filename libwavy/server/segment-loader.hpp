@@ -0,0 +1,223 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/server/segment-cache.hpp>
+#include <libwavy/utils/io/async/entry.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * @SEGMENT LOADER
+ *
+ * Brings segment bodies from disk into the SegmentCache through the async file backend
+ * (libwavy/utils/io/async: io_uring, or a thread pool without it).
+ *
+ * -> load() / load_many(): what a handler has to answer right now. All files of one call
+ *    are read in a single batch and the handler waits once for the lot.
+ * -> prefetch_after(): players fetch segments in order, so once `<stem><n>.<ext>` has been
+ *    served the next WAVY_SERVER_READAHEAD_SEGMENTS are read in the background. Nobody waits
+ *    on those reads; their completion puts the bodies in the cache, and the next request
+ *    is a hit instead of a blocking read on a Crow worker. Handlers only call it once the
+ *    served file was found and admitted, so unknown names never queue work.
+ * -> The open(2) and fstat(2) of each prefetched file still happen on the calling thread,
+ *    only the reads themselves are handed to the backend.
+ *
+ * Crow handlers run to completion on their worker thread, so this is how "awaiting" I/O
+ * looks here: the reads a handler will need are issued before it asks for them.
+ *
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server
+{
+
+struct ReadaheadStats
+{
+  std::atomic<ui64> issued{0};  // segment reads queued in the background
+  std::atomic<ui64> loaded{0};  // ... that ended up in the cache
+  std::atomic<ui64> missed{0};  // ... that did not (end of track, too large, I/O error)
+  std::atomic<ui64> skipped{0}; // already cached or already being read
+};
+
+class SegmentLoader
+{
+public:
+  SegmentLoader(utils::aio::FileIO& io, SegmentCache& cache,
+                std::size_t readahead = WAVY_SERVER_READAHEAD_SEGMENTS)
+      : m_io(io), m_cache(cache), m_readahead(readahead)
+  {
+  }
+
+  [[nodiscard]] auto backend() const -> std::string_view { return m_io.name(); }
+  [[nodiscard]] auto stats() const -> const ReadaheadStats& { return m_stats; }
+  [[nodiscard]] auto readahead() const -> std::size_t { return m_readahead; }
+
+  /// Reads `path` whole. nullptr if it cannot be read.
+  auto load(const fs::path& path) -> CachedBody { return std::move(load_many({path}).front()); }
+
+  /// Reads every file in one batch; entries that cannot be read come back as nullptr.
+  auto load_many(const std::vector<fs::path>& paths) -> std::vector<CachedBody>
+  {
+    std::vector<std::string> names;
+    names.reserve(paths.size());
+    for (const auto& path : paths)
+      names.push_back(path.string());
+
+    auto                    contents = utils::aio::read_files(m_io, names);
+    std::vector<CachedBody> bodies(contents.size());
+    for (std::size_t i = 0; i < contents.size(); ++i)
+      if (contents[i])
+        bodies[i] = std::make_shared<const std::string>(std::move(*contents[i]));
+    return bodies;
+  }
+
+  /// Queues background reads of the segments that follow `served`. Only opens files on the
+  /// calling thread, never waits for their contents.
+  void prefetch_after(const StorageOwnerID& owner, const StorageAudioID& audio_id,
+                      const FileName& served)
+  {
+    if (m_readahead > 0)
+      prefetch(owner, audio_id, next_segments(served, m_readahead));
+  }
+
+  /// Queues background reads of `names` of a track into the cache. Only opens files on the
+  /// calling thread, never waits for their contents.
+  void prefetch(const StorageOwnerID& owner, const StorageAudioID& audio_id,
+                const std::vector<FileName>& names)
+  {
+    const fs::path track_dir =
+      fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / owner / audio_id;
+    // Taken before anything is opened: a delete that lands before the reads complete
+    // makes their put() a no-op
+    const ui64 generation = m_cache.generation(owner, audio_id);
+
+    std::vector<std::string> keys, paths;
+    {
+      std::lock_guard lock(m_mutex);
+      for (const auto& name : names)
+      {
+        // Packs are read by range, never as a whole body
+        if (name.find('/') != std::string::npos || name.ends_with(macros::PACK_FILE_EXT))
+          continue;
+
+        std::string key = SegmentCache::make_key(owner, audio_id, name);
+        if (m_cache.contains(key) || !m_inflight.insert(key).second)
+        {
+          m_stats.skipped++;
+          continue;
+        }
+        keys.push_back(std::move(key));
+        paths.push_back((track_dir / name).string());
+      }
+    }
+    if (keys.empty())
+      return;
+
+    m_stats.issued += keys.size();
+    utils::aio::read_files_async(
+      m_io, paths, m_cache.max_object_size(),
+      [this, keys = std::move(keys), generation](utils::aio::FileContents& contents)
+      {
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+          if (!contents[i])
+          {
+            m_stats.missed++;
+            continue;
+          }
+          m_cache.put(keys[i], std::make_shared<const std::string>(std::move(*contents[i])),
+                      generation);
+          m_stats.loaded++;
+        }
+
+        std::lock_guard lock(m_mutex);
+        for (const auto& key : keys)
+          m_inflight.erase(key);
+      });
+  }
+
+  /// `hls_mp3_64_7.ts` -> `hls_mp3_64_8.ts`, `hls_mp3_64_9.ts`, ... (zero padding kept).
+  /// Empty for anything that is not a numbered media segment.
+  static auto next_segments(const FileName& served, std::size_t count) -> std::vector<FileName>
+  {
+    std::string_view ext;
+    if (served.ends_with(macros::TRANSPORT_STREAM_EXT))
+      ext = macros::TRANSPORT_STREAM_EXT;
+    else if (served.ends_with(macros::M4S_FILE_EXT))
+      ext = macros::M4S_FILE_EXT;
+    else
+      return {};
+
+    const std::string_view stem(served.data(), served.size() - ext.size());
+    std::size_t            digits = 0;
+    while (digits < stem.size() &&
+           std::isdigit(static_cast<unsigned char>(stem[stem.size() - 1 - digits])))
+      digits++;
+    if (digits == 0)
+      return {};
+
+    const std::string_view number = stem.substr(stem.size() - digits);
+    const std::string_view prefix = stem.substr(0, stem.size() - digits);
+    ui64                   index  = 0;
+    if (std::from_chars(number.data(), number.data() + number.size(), index).ec != std::errc{})
+      return {};
+
+    const bool            padded = number.size() > 1 && number.front() == '0';
+    std::vector<FileName> next;
+    next.reserve(count);
+    for (std::size_t k = 1; k <= count; ++k)
+    {
+      std::string n = std::to_string(index + k);
+      if (padded && n.size() < number.size())
+        n.insert(0, number.size() - n.size(), '0');
+
+      FileName name(prefix);
+      name += n;
+      name += ext;
+      next.push_back(std::move(name));
+    }
+    return next;
+  }
+
+private:
+  utils::aio::FileIO&             m_io;
+  SegmentCache&                   m_cache;
+  std::size_t                     m_readahead;
+  std::mutex                      m_mutex;
+  std::unordered_set<std::string> m_inflight; // cache keys being read
+  ReadaheadStats                  m_stats;
+};
+
+} // namespace libwavy::server
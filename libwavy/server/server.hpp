@@ -32,16 +32,33 @@
 
 #include <libwavy/common/api/entry.hpp>
 #include <libwavy/common/network/routes.h>
+#include <libwavy/db/catalog-log.hpp>
 #include <libwavy/db/db.h>
+#include <libwavy/server/bandwidth-shaper.hpp>
+#include <libwavy/server/file-handle-cache.hpp>
 #include <libwavy/server/health.hpp>
+#include <libwavy/server/housekeeping.hpp>
+#include <libwavy/server/live-stream.hpp>
+#include <libwavy/server/metadata-catalog.hpp>
+#include <libwavy/server/methods/catalog.hpp>
 #include <libwavy/server/methods/download.hpp>
+#include <libwavy/server/methods/live.hpp>
 #include <libwavy/server/methods/owners.hpp>
 #include <libwavy/server/metrics.hpp>
+#include <libwavy/server/object-store.hpp>
 #include <libwavy/server/request-timer.hpp>
+#include <libwavy/server/segment-cache.hpp>
+#include <libwavy/server/segment-loader.hpp>
+#include <libwavy/server/trash.hpp>
+#include <libwavy/server/upload-queue.hpp>
+#include <libwavy/server/validators.hpp>
 #include <libwavy/toml/toml_parser.hpp>
 #include <libwavy/unix/domainBind.hpp>
+#include <libwavy/utils/io/async/entry.hpp>
 #include <libwavy/utils/math/entry.hpp>
-#include <libwavy/zstd/decompression.h>
+#include <libwavy/utils/sched/entry.hpp>
+#include <libwavy/zstd/stream.hpp>
+#include <thread>
 #include <unistd.h>
 #include <utility>
 
@@ -107,19 +124,30 @@ public:
   WavyServer(short port, AbsPath serverCert, AbsPath serverKey, OwnerAudioIDMap& g_owner_audio_db)
       : m_socketPath(macros::to_string(macros::SERVER_LOCK_FILE)), m_wavySocketBind(m_socketPath),
         m_port(port), m_serverCert(std::move(serverCert)), m_serverKey(std::move(serverKey)),
-        m_shutdown_requested(false), m_metrics(std::make_unique<Metrics>()),
-        m_owner_audio_db(g_owner_audio_db), m_ownerManager(*m_metrics, m_owner_audio_db)
+        m_shutdown_requested(false),
+        m_io(utils::aio::make_file_io(WAVY_SERVER_IO_THREADS, WAVY_SERVER_IO_QUEUE_DEPTH,
+                                      WAVY_SERVER_IO_BUFFERS, ingest::ExtractPipeline::CHUNK_SIZE)),
+        m_metrics(std::make_unique<Metrics>()), m_segmentLoader(*m_io, m_segmentCache),
+        m_owner_audio_db(g_owner_audio_db),
+        m_catalog(m_owner_audio_db, macros::to_string(macros::SERVER_STORAGE_DIR_CATALOG),
+                  WAVY_SERVER_CATALOG_COMPACT_AFTER),
+        m_ownerManager(*m_metrics, m_segmentCache, m_fileHandles, m_validators, m_uploadQueue,
+                       m_trash, m_objects, m_owner_audio_db, m_catalog, m_metadata, *m_io),
+        m_catalogManager(*m_metrics, m_metadata), m_liveManager(*m_metrics, m_live, m_shaper)
   {
     m_wavySocketBind.EnsureSingleInstance();
     log::INFO<Server>("Starting Wavy Server on port {}", port);
+    log::INFO<Server>("File I/O backend: {} (registered buffers: {})", m_io->name(),
+                      m_io->registered() ? "yes" : "no");
 
     // Set up signal handlers for graceful shutdown
     std::signal(SIGINT, [](int signo) { get_instance()->request_shutdown(signo); });
     std::signal(SIGTERM, [](int signo) { get_instance()->request_shutdown(signo); });
     std::signal(SIGHUP, [](int signo) { get_instance()->request_shutdown(signo); });
 
-    helpers::populate_db_from_storage(m_owner_audio_db,
-                                      macros::to_string(macros::SERVER_STORAGE_DIR));
+    load_catalog();
+    start_housekeeping();
+    m_trash.start();
 
     // Store instance for signal handling
     s_instance = this;
@@ -132,6 +160,12 @@ public:
       request_shutdown(SIGTERM);
     }
 
+    // Workers call into m_ownerManager, which is destroyed before the queue
+    m_uploadQueue.stop();
+
+    // Waits for readahead still in flight
+    m_io.reset();
+
     m_wavySocketBind.cleanup();
   }
 
@@ -141,6 +175,9 @@ public:
     {
       m_app.get_middleware<crow::CookieParser>();
 
+      m_uploadQueue.start([this](const std::string& payload, const UploadOptions& options)
+                          { return m_ownerManager.process_upload(payload, options); });
+
       setup_routes(m_app);
       setup_health_routes(m_app);
       setup_metrics_routes(m_app);
@@ -182,9 +219,135 @@ private:
   std::condition_variable m_shutdown_cv;
   std::mutex              m_shutdown_mutex;
 
+  // Segment reads and ingest writes (io_uring or a thread pool). Reset first in the
+  // destructor: its completions write into the segment cache.
+  std::unique_ptr<utils::aio::FileIO> m_io;
+
   // Metrics
   std::unique_ptr<Metrics> m_metrics;
+  SegmentCache             m_segmentCache;
+  SegmentLoader            m_segmentLoader;
+  FileHandleCache          m_fileHandles;
+  BandwidthShaper          m_shaper;
+  ValidatorStore           m_validators;
+  UploadJobQueue           m_uploadQueue;
+  TrashReclaimer           m_trash;
+  ObjectStore              m_objects;
+  CatalogLog               m_catalog;
+  MetadataCatalog          m_metadata;
+  LiveRegistry             m_live;
   methods::OwnerManager    m_ownerManager;
+  methods::CatalogManager  m_catalogManager;
+  methods::LiveManager     m_liveManager;
+  HealthState              m_health;
+  Housekeeper              m_housekeeper;  // stopped before anything its tasks use
+  std::jthread             m_catalogCheck; // last: stopped and joined before anything it uses
+
+  // Startup reads the catalog snapshot + log instead of walking storage. Parsing every
+  // track's metadata and checking the catalog against storage both happen afterwards,
+  // on a background thread.
+  void load_catalog()
+  {
+    const auto loaded = m_catalog.load();
+    if (loaded.snapshot_loaded)
+    {
+      log::INFO<Server>("Catalog loaded: {} relations, {} log records replayed ({} bytes of "
+                        "torn tail dropped)",
+                        loaded.relations, loaded.wal_applied, loaded.wal_discarded);
+    }
+    else
+    {
+      log::WARN<Server>("No usable catalog snapshot, rebuilding it from storage...");
+      helpers::populate_db_from_storage(m_owner_audio_db,
+                                        macros::to_string(macros::SERVER_STORAGE_DIR));
+      if (!m_catalog.compact())
+        log::WARN<Server>("Could not write catalog snapshot to {}",
+                          m_catalog.snapshot_path().string());
+      log::INFO<Server>("Catalog rebuilt: {} relations", m_owner_audio_db.relation_count());
+    }
+
+    // A freshly rebuilt catalog was just walked from storage, nothing to reconcile
+    m_catalogCheck = std::jthread(
+      [this, reconcile = loaded.snapshot_loaded](const std::stop_token& stop)
+      {
+        utils::lower_thread_priority();
+        const AbsPathStr storage = macros::to_string(macros::SERVER_STORAGE_DIR);
+
+        auto synced = m_metadata.sync_with(m_owner_audio_db, storage, stop);
+        log::INFO<Server>(LogMode::Async,
+                          "Metadata catalog warm: {} tracks parsed, {} without metadata",
+                          synced.loaded, synced.failed);
+
+        if (!reconcile)
+          return;
+
+        const auto fixed = m_catalog.reconcile(storage, stop);
+        if (!fixed.finished)
+          return;
+        log::INFO<Server>(LogMode::Async, "Catalog consistency check done: {} added, {} removed",
+                          fixed.added, fixed.removed);
+
+        if (fixed.added + fixed.removed > 0)
+          m_metadata.sync_with(m_owner_audio_db, storage, stop);
+      });
+  }
+
+  void start_housekeeping()
+  {
+    using std::chrono::seconds;
+
+    // /health must be accurate before the first probe arrives
+    m_health.refresh();
+    m_housekeeper.add("health", seconds(WAVY_SERVER_HOUSEKEEPING_INTERVAL),
+                      [this](const std::stop_token&) { m_health.refresh(); });
+
+    m_housekeeper.add(
+      "temp", seconds(WAVY_SERVER_TEMP_GC_INTERVAL),
+      [this](const std::stop_token& stop)
+      {
+        const auto swept =
+          sweep_temp_dir(macros::to_string(macros::SERVER_TEMP_STORAGE_DIR),
+                         seconds(WAVY_SERVER_TEMP_MAX_AGE), stop);
+        if (swept.removed == 0)
+          return;
+
+        m_housekeeper.stats().temp_removed += swept.removed;
+        m_housekeeper.stats().temp_bytes += swept.bytes;
+        log::INFO<Server>(LogMode::Async, "Removed {} abandoned temp entries ({} bytes)",
+                          swept.removed, swept.bytes);
+      });
+
+    // Compacts a log that has not grown for a whole interval, so the snapshot write
+    // rarely lands on an upload or delete (the size threshold remains as a backstop)
+    m_housekeeper.add("catalog", seconds(WAVY_SERVER_CATALOG_COMPACT_IDLE),
+                      [this, seen = std::size_t{0}](const std::stop_token&) mutable
+                      {
+                        const auto records = m_catalog.wal_records();
+                        if (records > 0 && records == seen && m_catalog.compact())
+                        {
+                          m_housekeeper.stats().catalog_compactions++;
+                          seen = 0;
+                          return;
+                        }
+                        seen = records;
+                      });
+
+    m_housekeeper.add("live", seconds(WAVY_SERVER_HOUSEKEEPING_INTERVAL),
+                      [this](const std::stop_token&) { m_live.sweep(); });
+
+    // The first run at startup also fills the dedupe gauges of /metrics
+    m_housekeeper.add("objects", seconds(WAVY_SERVER_DEDUPE_SWEEP_INTERVAL),
+                      [this](const std::stop_token& stop)
+                      {
+                        const auto swept = m_objects.sweep(stop);
+                        if (swept.removed > 0)
+                          log::INFO<Server>(LogMode::Async,
+                                            "Removed {} unreferenced objects ({} bytes)",
+                                            swept.removed, swept.bytes);
+                      });
+
+    m_housekeeper.start();
+  }
 
   // Singleton for signal handling
   static WavyServer* s_instance;
@@ -197,34 +360,18 @@ private:
       .methods(crow::HTTPMethod::GET)(
         [this]()
         {
-          RequestTimer timer(*m_metrics);
-
-          auto health = HealthChecker::check_system_health();
+          RequestTimer timer(*m_metrics, MetricsRoute::Health);
 
-          std::ostringstream response;
-          response << "{\n";
-          response << R"(  "status": ")" << health.status_message << "\",\n";
-          response << "  \"healthy\": " << (health.is_healthy ? "true" : "false") << ",\n";
-          response << "  \"checks\": {\n";
+          // Written by the housekeeping thread: no filesystem access per probe
+          const auto health = m_health.current();
 
-          bool first = true;
-          for (const auto& check : health.checks)
-          {
-            if (!first)
-              response << ",\n";
-            response << "    \"" << check.first << "\": \"" << check.second << "\"";
-            first = false;
-          }
-
-          response << "\n  }\n}";
-
-          int status_code = health.is_healthy ? 200 : 503;
+          int status_code = health->status.is_healthy ? 200 : 503;
           if (status_code == 200)
             timer.mark_success();
           else
             timer.mark_failure();
 
-          crow::response res(status_code, response.str());
+          crow::response res(status_code, health->body);
           res.set_header("Content-Type", "application/json");
           return res;
         });
@@ -237,9 +384,32 @@ private:
       .methods(crow::HTTPMethod::GET)(
         [this]()
         {
-          RequestTimer timer(*m_metrics);
+          RequestTimer timer(*m_metrics, MetricsRoute::Metrics);
 
           auto body = libwavy::server::MetricsSerializer::to_prometheus_format(*m_metrics);
+          body += libwavy::server::MetricsSerializer::cache_to_prometheus_format(
+            m_segmentCache.stats());
+          body += libwavy::server::MetricsSerializer::file_handles_to_prometheus_format(
+            m_fileHandles.stats());
+          body += libwavy::server::MetricsSerializer::file_io_to_prometheus_format(
+            m_segmentLoader);
+          body += libwavy::server::MetricsSerializer::shaping_to_prometheus_format(m_shaper);
+          body +=
+            libwavy::server::MetricsSerializer::trash_to_prometheus_format(m_trash.stats());
+          body +=
+            libwavy::server::MetricsSerializer::dedupe_to_prometheus_format(m_objects.stats());
+          body += libwavy::server::MetricsSerializer::housekeeping_to_prometheus_format(
+            m_housekeeper, m_health.current()->status);
+          body += libwavy::server::MetricsSerializer::live_to_prometheus_format(m_live);
+          body += libwavy::server::MetricsSerializer::upload_queue_to_prometheus_format(
+            m_uploadQueue.stats());
+          body += libwavy::server::MetricsSerializer::latency_to_prometheus_format(
+            m_metrics->latency);
+          body += libwavy::server::MetricsSerializer::owners_to_prometheus_format(*m_metrics);
+          body += libwavy::server::MetricsSerializer::labeled_to_prometheus_format(
+            "owner_route", m_metrics->owner_routes);
+          body += libwavy::server::MetricsSerializer::labeled_to_prometheus_format(
+            "owner_track", m_metrics->owner_tracks);
 
           timer.mark_success();
 
@@ -255,7 +425,7 @@ private:
       .methods(crow::HTTPMethod::GET)(
         [this]()
         {
-          RequestTimer timer(*m_metrics);
+          RequestTimer timer(*m_metrics, MetricsRoute::Ping);
           log::INFO<Server>("Sending pong to client...");
           timer.mark_success();
           return crow::response(200, macros::to_string(macros::SERVER_PONG_MSG));
@@ -266,13 +436,28 @@ private:
 
     // Audio Metadata Listing (GET /audio/info)
     CROW_ROUTE(app, routes::SERVER_PATH_AUDIO_INFO)
-      .methods(crow::HTTPMethod::GET)([this]() { return m_ownerManager.list_audio_info(); });
+      .methods(crow::HTTPMethod::GET)([this](const crow::request& req)
+                                      { return m_ownerManager.list_audio_info(req); });
+
+    // Paginated JSON catalog (GET /catalog/tracks, GET /catalog/owners)
+    CROW_ROUTE(app, routes::SERVER_PATH_CATALOG_TRACKS)
+      .methods(crow::HTTPMethod::GET)([this](const crow::request& req)
+                                      { return m_catalogManager.list_tracks(req); });
+
+    CROW_ROUTE(app, routes::SERVER_PATH_CATALOG_OWNERS)
+      .methods(crow::HTTPMethod::GET)([this](const crow::request& req)
+                                      { return m_catalogManager.list_owners(req); });
 
     // File upload (POST /upload)
     CROW_ROUTE(app, routes::SERVER_PATH_TOML_UPLOAD)
       .methods(crow::HTTPMethod::POST)([this](const crow::request& req)
                                        { return m_ownerManager.handle_upload(req); });
 
+    // Upload job status (GET /upload/status/<job-id>)
+    CROW_ROUTE(app, routes::SERVER_PATH_UPLOAD_STATUS)
+      .methods(crow::HTTPMethod::GET)([this](const std::string& job_id)
+                                      { return m_ownerManager.upload_status(job_id); });
+
     // File chunked stream download ( /stream/<owner-id>/<audio-id>/<filename>)
     CROW_ROUTE(app, routes::SERVER_PATH_STREAM)
     (
@@ -282,7 +467,9 @@ private:
         log::INFO<Server>(LogMode::Async,
                           "Chunked stream request received for Audio-ID: {} by Owner: {}", audioID,
                           ownerID);
-        methods::DownloadManager dm(*m_metrics, ownerID, audioID, req);
+        methods::DownloadManager dm(*m_metrics, m_segmentCache, m_segmentLoader, m_fileHandles,
+                                    m_shaper, m_validators, m_owner_audio_db, ownerID, audioID,
+                                    req);
         dm.runStream(filename, res);
       });
 
@@ -296,12 +483,49 @@ private:
                             "Download request received for Audio-ID: {} by Owner: {}", audioID,
                             ownerID);
 
-          methods::DownloadManager dm(*m_metrics, ownerID, audioID, req);
+          methods::DownloadManager dm(*m_metrics, m_segmentCache, m_segmentLoader,
+                                      m_fileHandles, m_shaper, m_validators, m_owner_audio_db,
+                                      ownerID, audioID, req);
           auto                     response = dm.runDirect(filename);
 
           return response;
         });
 
+    // Consecutive segments of a playlist in one response
+    // (GET /bundle/<owner-id>/<audio-id>/<playlist>?start=&count=&playlist=)
+    CROW_ROUTE(app, routes::SERVER_PATH_BUNDLE)
+      .methods(crow::HTTPMethod::GET)(
+        [this](const crow::request& req, const StorageOwnerID& ownerID,
+               const StorageAudioID& audioID, const FileName& playlist)
+        {
+          methods::DownloadManager dm(*m_metrics, m_segmentCache, m_segmentLoader,
+                                      m_fileHandles, m_shaper, m_validators, m_owner_audio_db,
+                                      ownerID, audioID, req);
+          return dm.runBundle(playlist);
+        });
+
+    // Live streams: segments pushed by the owner, served from memory
+    // (POST /live/ingest/<owner>/<stream-id>, POST /live/end/<owner>/<stream-id>,
+    //  GET /live, GET /live/<owner>/<stream-id>/<index.m3u8 | n.ts>)
+    CROW_ROUTE(app, routes::SERVER_PATH_LIVE_INGEST)
+      .methods(crow::HTTPMethod::POST)(
+        [this](const crow::request& req, const StorageOwnerID& ownerID, const std::string& id)
+        { return m_liveManager.ingest(req, ownerID, id); });
+
+    CROW_ROUTE(app, routes::SERVER_PATH_LIVE_END)
+      .methods(crow::HTTPMethod::POST)(
+        [this](const crow::request& req, const StorageOwnerID& ownerID, const std::string& id)
+        { return m_liveManager.end(req, ownerID, id); });
+
+    CROW_ROUTE(app, routes::SERVER_PATH_LIVE)
+      .methods(crow::HTTPMethod::GET)([this]() { return m_liveManager.list(); });
+
+    CROW_ROUTE(app, routes::SERVER_PATH_LIVE_FILE)
+      .methods(crow::HTTPMethod::GET)(
+        [this](const crow::request& req, const StorageOwnerID& ownerID, const std::string& id,
+               const FileName& filename)
+        { return m_liveManager.serve(req, ownerID, id, filename); });
+
     CROW_ROUTE(app, routes::SERVER_PATH_DELETE)
       .methods(crow::HTTPMethod::DELETE)(
         [this](const crow::request& req, const StorageOwnerID& ownerID,
@@ -316,7 +540,7 @@ private:
       .methods(crow::HTTPMethod::GET)(
         [this](const crow::request& req, const std::string& ownerID)
         {
-          RequestTimer timer(*m_metrics);
+          RequestTimer timer(*m_metrics, MetricsRoute::OwnerMetrics);
 
           auto result = m_metrics->get_owner_metrics(ownerID);
           if (!result.has_value())
@@ -329,7 +553,7 @@ private:
           crow::json::wvalue json_res;
           json_res["owner_id"]      = ownerID;
           json_res["uploads"]       = result->get().uploads.load();
-          json_res["downloads"]     = result->get().downloads.load();
+          json_res["downloads"]     = m_metrics->get_owner_downloads(ownerID);
           json_res["deletes"]       = result->get().deletes.load();
           json_res["songs_count"]   = result->get().songs_count.load();
           json_res["storage_bytes"] = result->get().storage_bytes.load();
@@ -0,0 +1,91 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <libwavy/common/types.hpp>
+#include <string>
+#include <string_view>
+
+/*
+ * @TRACK GENERATIONS
+ *
+ * A counter per track, bumped whenever a track's stored files stop being what a cache
+ * holds (delete, re-publish). A cache fill that started before the bump must not land
+ * after the invalidation that went with it, so fills read the generation before they
+ * touch the disk and only insert if it is still the same under the cache's lock.
+ *
+ * Tracks hash into a fixed table of slots: a collision only makes an unrelated fill
+ * look stale, which costs one uncached response.
+ *
+ */
+
+namespace libwavy::server
+{
+
+class TrackGenerations
+{
+public:
+  [[nodiscard]] auto current(std::string_view track) const -> ui64
+  {
+    return slot(track).load(std::memory_order_acquire);
+  }
+
+  void bump(std::string_view track) { slot(track).fetch_add(1, std::memory_order_acq_rel); }
+
+  /// "<owner>/<audio-id>", the key prefix every cache entry of a track starts with.
+  static auto track_of(const StorageOwnerID& owner, const StorageAudioID& audio_id)
+    -> std::string
+  {
+    return owner + "/" + audio_id;
+  }
+
+  /// Track part of a "<owner>/<audio-id>/<filename>" cache key.
+  static auto track_of(std::string_view key) -> std::string_view
+  {
+    const auto owner_end = key.find('/');
+    if (owner_end == std::string_view::npos)
+      return key;
+    return key.substr(0, key.find('/', owner_end + 1));
+  }
+
+private:
+  static constexpr std::size_t SLOTS = 1024;
+
+  std::array<std::atomic<ui64>, SLOTS> m_slots{};
+
+  auto slot(std::string_view track) -> std::atomic<ui64>&
+  {
+    return m_slots[std::hash<std::string_view>{}(track) % SLOTS];
+  }
+
+  [[nodiscard]] auto slot(std::string_view track) const -> const std::atomic<ui64>&
+  {
+    return m_slots[std::hash<std::string_view>{}(track) % SLOTS];
+  }
+};
+
+} // namespace libwavy::server
@@ -0,0 +1,257 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/server/bandwidth-shaper.hpp>
+#include <libwavy/utils/math/entry.hpp>
+#include <libwavy/utils/sched/entry.hpp>
+#include <limits>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * @TRASH
+ *
+ * Deleting a track only renames its directory into `<storage>/.trash`. That is a single
+ * rename(2) on the same filesystem, so a delete takes constant time however large the
+ * track is, and the track is gone for every reader the moment it returns.
+ *
+ * A low priority worker then reclaims the space at `WAVY_SERVER_DELETE_RATE_LIMIT` MiB/s:
+ *
+ * -> files are unlinked one at a time, each charged at least `MIN_FILE_CHARGE`, so a
+ *    track of thousands of small segments is paced as well as one large pack;
+ * -> files larger than `TRUNCATE_STEP` are truncated down in steps first, so freeing
+ *    their extents is spread out instead of landing on the disk all at once;
+ * -> files with other hardlinks (deduplicated content) are only unlinked.
+ *
+ * Whatever is still in the trash at startup (crash, shutdown mid-reclaim) is queued again.
+ *
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server
+{
+
+struct TrashStats
+{
+  std::atomic<ui64> discarded{0};       // directories moved into the trash
+  std::atomic<ui64> reclaimed{0};       // trash entries fully removed
+  std::atomic<ui64> reclaimed_bytes{0}; // file bytes freed
+  std::atomic<ui64> pending{0};         // trash entries waiting for the worker
+};
+
+class TrashReclaimer
+{
+public:
+  static constexpr ui64 TRUNCATE_STEP   = 16 * ONE_MIB;
+  static constexpr ui64 MIN_FILE_CHARGE = 64 * ONE_KIB;
+
+  explicit TrashReclaimer(fs::path dir = macros::to_string(macros::SERVER_STORAGE_DIR_TRASH),
+                          ui64     bytes_per_sec =
+                            static_cast<ui64>(WAVY_SERVER_DELETE_RATE_LIMIT) * ONE_MIB)
+      : m_dir(std::move(dir)), m_bucket(bytes_per_sec, 1'000'000'000)
+  {
+  }
+
+  TrashReclaimer(const TrashReclaimer&)                    = delete;
+  auto operator=(const TrashReclaimer&) -> TrashReclaimer& = delete;
+
+  ~TrashReclaimer() { stop(); }
+
+  /// Queues what an earlier run left in the trash and starts the worker.
+  void start()
+  {
+    if (m_worker.joinable())
+      return;
+
+    std::error_code ec;
+    fs::create_directories(m_dir, ec);
+    {
+      std::lock_guard lock(m_mutex);
+      for (fs::directory_iterator it(m_dir, ec), end; !ec && it != end; it.increment(ec))
+        m_pending.push_back(it->path());
+      m_stats.pending = m_pending.size();
+    }
+
+    m_worker = std::jthread([this](const std::stop_token& stop) { loop(stop); });
+  }
+
+  /// Entries not reclaimed yet stay in the trash for the next start().
+  void stop()
+  {
+    if (!m_worker.joinable())
+      return;
+    m_worker.request_stop();
+    m_cv.notify_all();
+    m_worker.join();
+  }
+
+  /// Moves `dir` into the trash. False if it could not be renamed (it is left in place).
+  auto discard(const fs::path& dir) -> bool
+  {
+    std::error_code ec;
+    fs::create_directories(m_dir, ec);
+
+    const auto stamp = std::chrono::system_clock::now().time_since_epoch().count();
+    fs::path   entry = m_dir / (dir.filename().string() + "." + std::to_string(stamp));
+
+    fs::rename(dir, entry, ec);
+    if (ec)
+      return false;
+
+    {
+      std::lock_guard lock(m_mutex);
+      m_pending.push_back(std::move(entry));
+      m_stats.pending = m_pending.size();
+    }
+    m_stats.discarded++;
+    m_cv.notify_one();
+    return true;
+  }
+
+  [[nodiscard]] auto stats() const -> const TrashStats& { return m_stats; }
+
+private:
+  fs::path                    m_dir;
+  TokenBucket                 m_bucket;
+  std::mutex                  m_mutex;
+  std::condition_variable_any m_cv;
+  std::deque<fs::path>        m_pending;
+  TrashStats                  m_stats;
+  std::jthread                m_worker; // last: joined before the rest goes away
+
+  void loop(const std::stop_token& stop)
+  {
+    utils::lower_thread_priority();
+
+    while (true)
+    {
+      fs::path entry;
+      {
+        std::unique_lock lock(m_mutex);
+        if (!m_cv.wait(lock, stop, [this] { return !m_pending.empty(); }))
+          return;
+        entry = m_pending.front();
+      }
+
+      const bool done = reclaim(entry, stop);
+
+      std::lock_guard lock(m_mutex);
+      if (!done)
+        return; // stopping: the entry stays in the trash
+      m_pending.pop_front();
+      m_stats.pending = m_pending.size();
+      m_stats.reclaimed++;
+    }
+  }
+
+  // Sleeps until `bytes` fit the reclaim budget; false if stopped meanwhile
+  auto pace(ui64 bytes, const std::stop_token& stop) -> bool
+  {
+    const auto wait = m_bucket.reserve(bytes, shaping_now(), std::numeric_limits<i64>::max());
+    if (!wait || *wait <= 0)
+      return !stop.stop_requested();
+
+    std::mutex       mutex;
+    std::unique_lock lock(mutex);
+    m_cv.wait_for(lock, stop, std::chrono::nanoseconds(*wait), [] { return false; });
+    return !stop.stop_requested();
+  }
+
+  auto reclaim(const fs::path& entry, const std::stop_token& stop) -> bool
+  {
+    std::error_code       ec;
+    std::vector<fs::path> files;
+    if (fs::is_directory(entry, ec))
+    {
+      for (fs::recursive_directory_iterator it(entry, ec), end; !ec && it != end; it.increment(ec))
+        if (it->is_regular_file(ec))
+          files.push_back(it->path());
+    }
+    else
+    {
+      files.push_back(entry);
+    }
+
+    for (const auto& file : files)
+    {
+      struct stat st{};
+      ui64        size = ::lstat(file.c_str(), &st) == 0 ? static_cast<ui64>(st.st_size) : 0;
+
+      // A file sharing its inode with the object store or another track (object-store.hpp)
+      // must not be truncated, and unlinking it frees nothing
+      if (st.st_nlink > 1)
+      {
+        if (!pace(MIN_FILE_CHARGE, stop))
+          return false;
+        fs::remove(file, ec);
+        continue;
+      }
+
+      if (size > TRUNCATE_STEP)
+      {
+        const int fd = ::open(file.c_str(), O_WRONLY | O_CLOEXEC);
+        while (fd >= 0 && size > TRUNCATE_STEP)
+        {
+          if (!pace(TRUNCATE_STEP, stop))
+          {
+            ::close(fd);
+            return false;
+          }
+          if (::ftruncate(fd, static_cast<off_t>(size - TRUNCATE_STEP)) != 0)
+            break;
+          size -= TRUNCATE_STEP;
+          m_stats.reclaimed_bytes += TRUNCATE_STEP;
+        }
+        if (fd >= 0)
+          ::close(fd);
+      }
+
+      if (!pace(std::max(size, MIN_FILE_CHARGE), stop))
+        return false;
+      if (fs::remove(file, ec))
+        m_stats.reclaimed_bytes += size;
+    }
+
+    fs::remove_all(entry, ec);
+    return true;
+  }
+};
+
+} // namespace libwavy::server
@@ -0,0 +1,348 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/server/packfile.hpp>
+#include <libwavy/utils/math/entry.hpp>
+#include <libwavy/utils/sched/entry.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * @UPLOAD JOB QUEUE
+ *
+ * Uploads are accepted by the Crow handler, parked here and processed by a small,
+ * dedicated pool of ingest workers:
+ *
+ * -> The queue is bounded by job count (`WAVY_SERVER_UPLOAD_QUEUE_DEPTH`) and by the
+ *    bytes of the request bodies it holds, queued or running
+ *    (`WAVY_SERVER_UPLOAD_QUEUE_MEMORY`); when either is reached the handler answers
+ *    503 with a Retry-After estimated from recent job durations.
+ * -> Workers run at a lower CPU and I/O priority than the Crow request threads, so
+ *    extraction and decompression yield to /download and /stream under load.
+ * -> Finished jobs are kept (up to `WAVY_SERVER_UPLOAD_JOB_HISTORY`) so clients can
+ *    poll /upload/status/<job-id> for the outcome.
+ *
+ */
+
+namespace libwavy::server
+{
+
+enum class UploadJobState
+{
+  Queued,
+  Running,
+  Done,
+  Failed
+};
+
+inline auto to_string(UploadJobState state) -> const char*
+{
+  switch (state)
+  {
+    case UploadJobState::Queued:
+      return "queued";
+    case UploadJobState::Running:
+      return "running";
+    case UploadJobState::Done:
+      return "done";
+    case UploadJobState::Failed:
+      return "failed";
+  }
+  return "unknown";
+}
+
+/// How the upload key (returned to the owner, required for /delete) is derived
+enum class UploadKeyHash
+{
+  Sha256,    // SHA-256 of the archive, computed inline while it is extracted
+  Sha256Tree // auth::compute_tree_sha256_hex(), parallel, for large lossless uploads
+};
+
+inline auto to_string(UploadKeyHash hash) -> const char*
+{
+  return hash == UploadKeyHash::Sha256Tree ? "sha256-tree" : "sha256";
+}
+
+/// Per-upload choices taken from the /upload query string
+struct UploadOptions
+{
+  UploadKeyHash         key_hash = UploadKeyHash::Sha256;
+  ingest::StorageLayout layout   = ingest::default_storage_layout();
+};
+
+struct UploadResult
+{
+  bool                       ok = false;
+  StorageOwnerID             owner;
+  StorageAudioID             audio_id;
+  std::optional<std::string> sha256;
+  UploadKeyHash              key_hash      = UploadKeyHash::Sha256;
+  ingest::StorageLayout      layout        = ingest::StorageLayout::Files;
+  bool                       key_persisted = false;
+  std::string                error;
+};
+
+/// What /upload/status reports, copied out under the queue lock (never the payload).
+struct UploadJobStatus
+{
+  std::string    id;
+  UploadJobState state    = UploadJobState::Queued;
+  std::size_t    position = 0; // jobs ahead of this one while queued
+  UploadResult   result;
+};
+
+struct UploadQueueStats
+{
+  std::atomic<ui64> accepted{0};
+  std::atomic<ui64> rejected{0};
+  std::atomic<ui64> completed{0};
+  std::atomic<ui64> failed{0};
+  std::atomic<ui64> queued{0};
+  std::atomic<ui64> running{0};
+  std::atomic<ui64> payload_bytes{0}; // request bodies held by queued and running jobs
+};
+
+class UploadJobQueue
+{
+public:
+  using Processor = std::function<UploadResult(const std::string& payload, const UploadOptions&)>;
+
+  static constexpr ui64 BYTE_BUDGET = static_cast<ui64>(WAVY_SERVER_UPLOAD_QUEUE_MEMORY) * ONE_MIB;
+
+  explicit UploadJobQueue(std::size_t capacity    = WAVY_SERVER_UPLOAD_QUEUE_DEPTH,
+                          std::size_t workers     = WAVY_SERVER_UPLOAD_WORKERS,
+                          ui64        byte_budget = BYTE_BUDGET)
+      : m_capacity(capacity == 0 ? 1 : capacity), m_workerCount(workers == 0 ? 1 : workers),
+        m_byteBudget(byte_budget)
+  {
+  }
+
+  UploadJobQueue(const UploadJobQueue&)                    = delete;
+  auto operator=(const UploadJobQueue&) -> UploadJobQueue& = delete;
+
+  ~UploadJobQueue() { stop(); }
+
+  void start(Processor processor)
+  {
+    std::lock_guard lock(m_mutex);
+    if (!m_workers.empty())
+      return;
+
+    m_processor = std::move(processor);
+    m_stopping  = false;
+    for (std::size_t i = 0; i < m_workerCount; ++i)
+      m_workers.emplace_back([this] { worker_loop(); });
+  }
+
+  /// Jobs already running are finished, queued ones are dropped.
+  void stop()
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      m_stopping = true;
+    }
+    m_cv.notify_all();
+
+    for (auto& worker : m_workers)
+      if (worker.joinable())
+        worker.join();
+    m_workers.clear();
+  }
+
+  /// Takes ownership of the payload. Returns the job id, or std::nullopt if the queue is full
+  /// (by job count, or because the payload does not fit in the byte budget).
+  auto submit(std::string payload, UploadOptions options = {}) -> std::optional<std::string>
+  {
+    std::string id = boost::uuids::to_string(boost::uuids::random_generator()());
+
+    {
+      std::lock_guard lock(m_mutex);
+
+      // An idle queue takes any payload, so a budget below the upload limit cannot lock out
+      // large uploads for good
+      const ui64 size      = payload.size();
+      const bool over_size = m_heldBytes > 0 && m_heldBytes + size > m_byteBudget;
+      if (m_pending.size() >= m_capacity || over_size || m_stopping)
+      {
+        m_stats.rejected++;
+        return std::nullopt;
+      }
+
+      auto job     = std::make_shared<Job>();
+      job->id      = id;
+      job->payload = std::move(payload);
+      job->size    = size;
+      job->options = options;
+
+      m_jobs.emplace(id, job);
+      m_pending.push_back(job);
+      m_heldBytes += size;
+      m_stats.accepted++;
+      m_stats.queued        = m_pending.size();
+      m_stats.payload_bytes = m_heldBytes;
+    }
+
+    m_cv.notify_one();
+    return id;
+  }
+
+  auto status(const std::string& id) const -> std::optional<UploadJobStatus>
+  {
+    std::lock_guard lock(m_mutex);
+
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end())
+      return std::nullopt;
+
+    const auto&     job = *it->second;
+    UploadJobStatus out{job.id, job.state, 0, job.result};
+
+    if (job.state == UploadJobState::Queued)
+    {
+      for (const auto& pending : m_pending)
+      {
+        if (pending->id == id)
+          break;
+        out.position++;
+      }
+    }
+    return out;
+  }
+
+  /// Seconds a rejected client should wait: one average job per worker-slot ahead of it.
+  auto retry_after_seconds() const -> ui64
+  {
+    std::lock_guard lock(m_mutex);
+
+    const ui64 avg_ms = m_avgJobMs == 0 ? 1000 : m_avgJobMs;
+    const ui64 rounds = (m_pending.size() + m_workerCount) / m_workerCount;
+    const ui64 secs   = (avg_ms * rounds + 999) / 1000;
+    return std::clamp<ui64>(secs, 1, 120);
+  }
+
+  [[nodiscard]] auto stats() const -> const UploadQueueStats& { return m_stats; }
+
+private:
+  struct Job
+  {
+    std::string    id;
+    std::string    payload;
+    ui64           size = 0; // of the payload, charged against the byte budget until it ends
+    UploadOptions  options;
+    UploadJobState state = UploadJobState::Queued;
+    UploadResult   result;
+  };
+
+  std::size_t                                           m_capacity;
+  std::size_t                                           m_workerCount;
+  ui64                                                  m_byteBudget;
+  ui64                                                  m_heldBytes = 0;
+  Processor                                             m_processor;
+  mutable std::mutex                                    m_mutex;
+  std::condition_variable                               m_cv;
+  std::deque<std::shared_ptr<Job>>                      m_pending;
+  std::unordered_map<std::string, std::shared_ptr<Job>> m_jobs;
+  std::deque<std::string>                               m_finished; // oldest first
+  std::vector<std::thread>                              m_workers;
+  bool                                                  m_stopping = false;
+  ui64                                                  m_avgJobMs = 0;
+  UploadQueueStats                                      m_stats;
+
+  void worker_loop()
+  {
+    utils::lower_thread_priority();
+
+    while (true)
+    {
+      std::shared_ptr<Job> job;
+      {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+        if (m_stopping)
+          return;
+
+        job = m_pending.front();
+        m_pending.pop_front();
+        job->state     = UploadJobState::Running;
+        m_stats.queued = m_pending.size();
+        m_stats.running++;
+      }
+
+      const auto   start = std::chrono::steady_clock::now();
+      UploadResult result;
+      try
+      {
+        result = m_processor(job->payload, job->options);
+      }
+      catch (const std::exception& e)
+      {
+        result.ok    = false;
+        result.error = e.what();
+      }
+      const auto elapsed_ms = static_cast<ui64>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                              start)
+          .count());
+
+      std::lock_guard lock(m_mutex);
+
+      job->payload.clear();
+      job->payload.shrink_to_fit();
+      m_heldBytes -= job->size;
+      m_stats.payload_bytes = m_heldBytes;
+      job->result = std::move(result);
+      job->state  = job->result.ok ? UploadJobState::Done : UploadJobState::Failed;
+      (job->result.ok ? m_stats.completed : m_stats.failed)++;
+      m_stats.running--;
+
+      // EWMA (1/4 weight) of the job duration, feeds Retry-After
+      m_avgJobMs = m_avgJobMs == 0 ? elapsed_ms : (3 * m_avgJobMs + elapsed_ms) / 4;
+
+      m_finished.push_back(job->id);
+      while (m_finished.size() > WAVY_SERVER_UPLOAD_JOB_HISTORY)
+      {
+        m_jobs.erase(m_finished.front());
+        m_finished.pop_front();
+      }
+    }
+  }
+};
+
+} // namespace libwavy::server
@@ -0,0 +1,244 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <libwavy/common/macros.hpp>
+#include <libwavy/common/types.hpp>
+#include <libwavy/server/track-generations.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unordered_map>
+
+/*
+ * @CACHE VALIDATORS
+ *
+ * Every track gets a `manifest.sha256` (sha256sum format) written at ingest. From it we
+ * derive a strong ETag per file; the manifest's own mtime is the ingest time and
+ * doubles as `Last-Modified` for every file of the track.
+ *
+ * Manifests are parsed once per track and kept in an LRU of WAVY_SERVER_VALIDATOR_TRACKS
+ * tracks, so answering a conditional request with 304 touches neither the disk nor the
+ * segment cache. Missing manifests are not remembered: the URL names any track, and a
+ * track published after the miss must not stay without validators.
+ *
+ * Tracks uploaded before manifests existed simply have no validators: they are still
+ * served with Cache-Control, just never with 304.
+ *
+ */
+
+namespace fs = std::filesystem;
+
+namespace libwavy::server
+{
+
+struct TrackValidators
+{
+  std::unordered_map<FileName, std::string> etags;
+  std::time_t                               last_modified = 0;
+  std::string                               last_modified_http;
+
+  [[nodiscard]] auto etag_for(const FileName& filename) const -> const std::string*
+  {
+    auto it = etags.find(filename);
+    return it == etags.end() ? nullptr : &it->second;
+  }
+};
+
+using TrackValidatorsPtr = std::shared_ptr<const TrackValidators>;
+
+inline auto format_http_date(std::time_t t) -> std::string
+{
+  std::tm tm{};
+  gmtime_r(&t, &tm);
+  char buf[64];
+  std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return buf;
+}
+
+inline auto parse_http_date(const std::string& value) -> std::optional<std::time_t>
+{
+  std::tm tm{};
+  // Only the IMF-fixdate form, which is all any current client sends
+  const char* end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  if (!end || *end != '\0')
+    return std::nullopt;
+  return timegm(&tm);
+}
+
+/// Segments never change once stored, playlists get a short lifetime so edits
+/// (re-uploads under the same id, deletes) are picked up quickly.
+inline auto cache_control_for(const FileName& filename) -> std::string
+{
+  if (filename.ends_with(macros::PLAYLIST_EXT))
+    return "public, max-age=" + std::to_string(WAVY_SERVER_PLAYLIST_MAX_AGE);
+  return "public, max-age=" + std::to_string(WAVY_SERVER_SEGMENT_MAX_AGE) + ", immutable";
+}
+
+/// `If-None-Match` list membership (weak comparison, as RFC 9110 asks for GET).
+inline auto etag_matches(std::string_view header, std::string_view etag) -> bool
+{
+  auto strip_weak = [](std::string_view tag)
+  { return tag.starts_with("W/") ? tag.substr(2) : tag; };
+
+  etag = strip_weak(etag);
+  while (!header.empty())
+  {
+    const auto       comma = header.find(',');
+    std::string_view tag   = header.substr(0, comma);
+    header.remove_prefix(comma == std::string_view::npos ? header.size() : comma + 1);
+
+    while (!tag.empty() && tag.front() == ' ')
+      tag.remove_prefix(1);
+    while (!tag.empty() && tag.back() == ' ')
+      tag.remove_suffix(1);
+
+    if (tag == "*" || strip_weak(tag) == etag)
+      return true;
+  }
+  return false;
+}
+
+/// RFC 9110 §13.2.2: If-None-Match wins over If-Modified-Since when both are present.
+inline auto is_not_modified(const std::string& if_none_match, const std::string& if_modified_since,
+                            const std::string* etag, std::time_t last_modified) -> bool
+{
+  if (!if_none_match.empty())
+    return etag && etag_matches(if_none_match, *etag);
+
+  if (!if_modified_since.empty() && last_modified > 0)
+  {
+    const auto since = parse_http_date(if_modified_since);
+    return since && last_modified <= *since;
+  }
+  return false;
+}
+
+class ValidatorStore
+{
+public:
+  explicit ValidatorStore(std::size_t capacity = WAVY_SERVER_VALIDATOR_TRACKS)
+      : m_capacity(capacity == 0 ? 1 : capacity)
+  {
+  }
+
+  auto get(const StorageOwnerID& owner, const StorageAudioID& audio_id) -> TrackValidatorsPtr
+  {
+    const std::string key = TrackGenerations::track_of(owner, audio_id);
+
+    {
+      std::lock_guard lock(m_mutex);
+      if (auto it = m_index.find(key); it != m_index.end())
+      {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->validators;
+      }
+    }
+
+    const ui64 generation = m_generations.current(key);
+    auto       loaded     = load(fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / owner /
+                                 audio_id / macros::MANIFEST_FILE);
+    if (!loaded)
+      return nullptr;
+
+    // A manifest read just before an upload or delete invalidated the track answers
+    // this request only
+    std::lock_guard lock(m_mutex);
+    if (generation != m_generations.current(key))
+      return loaded;
+    if (auto it = m_index.find(key); it != m_index.end())
+      return it->second->validators; // loaded by another request meanwhile
+
+    while (m_lru.size() >= m_capacity)
+    {
+      m_index.erase(m_lru.back().key);
+      m_lru.pop_back();
+    }
+    m_lru.push_front(Entry{key, loaded});
+    m_index.emplace(key, m_lru.begin());
+    return loaded;
+  }
+
+  void invalidate(const StorageOwnerID& owner, const StorageAudioID& audio_id)
+  {
+    const std::string key = TrackGenerations::track_of(owner, audio_id);
+
+    std::lock_guard lock(m_mutex);
+    m_generations.bump(key);
+    if (auto it = m_index.find(key); it != m_index.end())
+    {
+      m_lru.erase(it->second);
+      m_index.erase(it);
+    }
+  }
+
+  static auto load(const fs::path& manifest_path) -> TrackValidatorsPtr
+  {
+    std::ifstream in(manifest_path);
+    if (!in)
+      return nullptr;
+
+    auto        validators = std::make_shared<TrackValidators>();
+    std::string line;
+    while (std::getline(in, line))
+    {
+      // "<sha256 hex>  <filename>"
+      const auto sep = line.find("  ");
+      if (sep == std::string::npos || sep < 32)
+        continue;
+      validators->etags.emplace(line.substr(sep + 2), "\"" + line.substr(0, 32) + "\"");
+    }
+
+    struct stat st{};
+    if (::stat(manifest_path.c_str(), &st) == 0)
+    {
+      validators->last_modified      = st.st_mtime;
+      validators->last_modified_http = format_http_date(st.st_mtime);
+    }
+
+    return validators;
+  }
+
+private:
+  struct Entry
+  {
+    std::string        key;
+    TrackValidatorsPtr validators;
+  };
+
+  std::mutex                                                   m_mutex;
+  std::list<Entry>                                             m_lru;
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+  std::size_t                                                  m_capacity;
+  TrackGenerations                                             m_generations;
+};
+
+} // namespace libwavy::server
@@ -24,6 +24,7 @@
  ********************************************************************************/
 
 #include <cstdlib>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -34,6 +35,7 @@
 #include <libwavy/common/types.hpp>
 #include <libwavy/log-macros.hpp>
 #include <libwavy/network/entry.hpp>
+#include <libwavy/parser/byterange.hpp>
 #include <libwavy/timer/timer.h>
 #include <libwavy/tsfetcher/interface.hpp>
 #include <libwavy/utils/audio/entry.hpp>
@@ -259,10 +261,11 @@ private:
     std::string        line;
     bool               has_m4s = false;
 
-    // Check if playlist contains m4s files
+    // Check if playlist contains m4s files (packed fMP4 tracks only show it by EXT-X-MAP)
     while (std::getline(stream, line))
     {
-      if (!line.empty() && line[0] != '#' && line.ends_with(macros::M4S_FILE_EXT))
+      if ((!line.empty() && line[0] != '#' && line.ends_with(macros::M4S_FILE_EXT)) ||
+          line.starts_with(hls::parser::macro::EXT_X_MAP))
       {
         has_m4s = true;
         break;
@@ -294,12 +297,25 @@ private:
     stream.clear();
     stream.seekg(0);
 
-    std::vector<std::string> segment_lines;
+    // Packed tracks list the same .pack for every segment, each with its own byte range
+    std::vector<std::string>                                segment_lines;
+    std::vector<std::optional<hls::parser::MediaByteRange>> segment_ranges;
+    std::optional<hls::parser::MediaByteRange>              pending_range;
+    ui64                                                    next_offset = 0;
     while (std::getline(stream, line))
     {
-      if (!line.empty() && line[0] != '#')
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+
+      if (line.starts_with(hls::parser::macro::EXT_X_BYTERANGE))
+      {
+        if ((pending_range = hls::parser::parse_byterange(line, next_offset)))
+          next_offset = pending_range->end();
+      }
+      else if (!line.empty() && line[0] != '#')
       {
         segment_lines.push_back(line);
+        segment_ranges.push_back(std::exchange(pending_range, std::nullopt));
       }
     }
 
@@ -326,16 +342,23 @@ private:
     size_t total_segments   = segment_lines.size();
 
     // Fetch each segment
-    for (const auto& seg_line : segment_lines)
+    for (size_t i = 0; i < segment_lines.size(); ++i)
     {
+      const auto& seg_line = segment_lines[i];
+      const auto& range    = segment_ranges[i];
+
       AudioData data;
-      NetTarget url = !use_chunked_stream
+      NetTarget url = !use_chunked_stream || range
                         ? "/download/" + nickname + "/" + audio_id + "/" + seg_line
                         : "/stream/" + nickname + "/" + audio_id + "/" + seg_line;
       ;
       log::TRACE<log::FETCH>("Fetching URL: {}", url);
       auto seg_start = std::chrono::steady_clock::now();
-      if (!use_chunked_stream)
+      if (range)
+      {
+        data = client->get_range(url, hls::parser::to_http_range(*range));
+      }
+      else if (!use_chunked_stream)
       {
         data = client->get(url);
       }
@@ -353,11 +376,11 @@ private:
 
       if (!data.empty())
       {
-        if (seg_line.ends_with(macros::M4S_FILE_EXT))
+        if (seg_line.ends_with(macros::M4S_FILE_EXT) || (range && has_m4s))
         {
           m4s_segments.push_back(std::move(data));
         }
-        else if (seg_line.ends_with(macros::TRANSPORT_STREAM_EXT))
+        else if (seg_line.ends_with(macros::TRANSPORT_STREAM_EXT) || range)
         {
           gs->appendSegment(std::move(data));
         }
@@ -31,8 +31,10 @@
 namespace libwavy::utils::audio
 {
 
+// `skip_seconds` of the decoded audio are dropped before playback (see MediaDecoder::decode)
 auto decodeAndPlay(TotalAudioData& segments, bool& flac_found,
-                   const RelPath& customAudioBackendLibPath = "") -> bool;
+                   const RelPath& customAudioBackendLibPath = "", double skip_seconds = 0.0)
+  -> bool;
 
 }
 // namespace libwavy::utils::audio
@@ -0,0 +1,872 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#ifdef WAVY_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+// Asynchronous positioned file I/O.
+//
+// A `FileIO` takes a batch of reads and writes, runs them concurrently and calls one
+// completion once every request of the batch is done. Two backends:
+//
+// -> io_uring (built when liburing is found, used when the kernel lets us set up a
+//    ring): one submission per batch, completions reaped on a single thread, and a
+//    pool of buffers registered with the ring so transfers from them skip the
+//    per-request page pinning.
+// -> a thread pool running pread(2)/pwrite(2), for kernels or sandboxes without
+//    io_uring.
+//
+// Requests always run to the end: short transfers are resubmitted for the rest, only
+// EOF or an error stop them early.
+//
+// Same contract as the other io utils: no libwavy::log, callers check the results.
+
+namespace libwavy::utils::aio
+{
+
+enum class Op
+{
+  Read,
+  Write
+};
+
+struct Request
+{
+  Op          op        = Op::Read;
+  int         fd        = -1;
+  std::size_t offset    = 0;
+  char*       buf       = nullptr;
+  std::size_t len       = 0;
+  int         buf_index = -1; // registered buffer `buf` points into (FileIO::buffer()), or -1
+  ssize_t     result    = 0;  // bytes transferred (short only at EOF), or -errno
+};
+
+using Batch = std::vector<Request>;
+
+// Runs on a backend thread: keep it short and never wait for more I/O from it
+using Completion = std::function<void(Batch&)>;
+
+class FileIO;
+
+// A buffer of the backend's registered pool, or plain heap memory once the pool is drained
+class IoBuffer
+{
+public:
+  IoBuffer() = default;
+
+  IoBuffer(const IoBuffer&)                    = delete;
+  auto operator=(const IoBuffer&) -> IoBuffer& = delete;
+
+  IoBuffer(IoBuffer&& other) noexcept
+      : m_owner(std::exchange(other.m_owner, nullptr)),
+        m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)),
+        m_index(std::exchange(other.m_index, -1)), m_heap(std::move(other.m_heap))
+  {
+  }
+
+  auto operator=(IoBuffer&& other) noexcept -> IoBuffer&
+  {
+    if (this != &other)
+    {
+      reset();
+      m_owner = std::exchange(other.m_owner, nullptr);
+      m_data  = std::exchange(other.m_data, nullptr);
+      m_size  = std::exchange(other.m_size, 0);
+      m_index = std::exchange(other.m_index, -1);
+      m_heap  = std::move(other.m_heap);
+    }
+    return *this;
+  }
+
+  ~IoBuffer() { reset(); }
+
+  [[nodiscard]] auto data() const -> char* { return m_data; }
+  [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+  [[nodiscard]] auto index() const -> int { return m_index; }
+
+  void reset();
+
+private:
+  friend class FileIO;
+
+  FileIO*                 m_owner = nullptr;
+  char*                   m_data  = nullptr;
+  std::size_t             m_size  = 0;
+  int                     m_index = -1;
+  std::unique_ptr<char[]> m_heap;
+};
+
+class FileIO
+{
+public:
+  static constexpr std::size_t BUFFER_ALIGNMENT = 4096;
+
+  FileIO(std::size_t buffer_count, std::size_t buffer_size)
+      : m_bufferSize(round_up(std::max<std::size_t>(buffer_size, 1))), m_bufferCount(buffer_count)
+  {
+    if (m_bufferCount > 0)
+      m_arena.reset(
+        static_cast<char*>(std::aligned_alloc(BUFFER_ALIGNMENT, m_bufferCount * m_bufferSize)));
+    if (!m_arena)
+      m_bufferCount = 0;
+
+    for (std::size_t i = m_bufferCount; i-- > 0;)
+      m_free.push_back(static_cast<int>(i));
+  }
+
+  FileIO(const FileIO&)                    = delete;
+  auto operator=(const FileIO&) -> FileIO& = delete;
+
+  virtual ~FileIO() = default;
+
+  [[nodiscard]] virtual auto name() const -> std::string_view = 0;
+
+  /// Whether transfers from buffer() memory use the registered (fixed) buffer path
+  [[nodiscard]] virtual auto registered() const -> bool { return false; }
+
+  /// Queues every request of `batch`; `done` gets them back with `result` filled in.
+  virtual void submit(Batch batch, Completion done) = 0;
+
+  /// Submits `batch` and waits for it.
+  auto run(Batch batch) -> Batch
+  {
+    auto finished = std::make_shared<std::promise<Batch>>();
+    auto result   = finished->get_future();
+    submit(std::move(batch), [finished](Batch& done) { finished->set_value(std::move(done)); });
+    return result.get();
+  }
+
+  [[nodiscard]] auto buffer_size() const -> std::size_t { return m_bufferSize; }
+
+  /// A `buffer_size()` buffer, out of the registered pool while one is free
+  auto buffer() -> IoBuffer
+  {
+    IoBuffer out;
+    out.m_size = m_bufferSize;
+    {
+      std::lock_guard lock(m_bufferMutex);
+      if (!m_free.empty())
+      {
+        out.m_owner = this;
+        out.m_index = m_free.back();
+        out.m_data  = buffer_at(static_cast<std::size_t>(out.m_index));
+        m_free.pop_back();
+        return out;
+      }
+    }
+
+    out.m_heap.reset(new char[m_bufferSize]);
+    out.m_data = out.m_heap.get();
+    return out;
+  }
+
+protected:
+  [[nodiscard]] auto buffer_count() const -> std::size_t { return m_bufferCount; }
+  [[nodiscard]] auto buffer_at(std::size_t i) const -> char*
+  {
+    return m_arena.get() + i * m_bufferSize;
+  }
+
+private:
+  friend class IoBuffer;
+
+  struct FreeArena
+  {
+    void operator()(char* p) const { std::free(p); }
+  };
+
+  std::size_t                      m_bufferSize;
+  std::size_t                      m_bufferCount;
+  std::unique_ptr<char, FreeArena> m_arena;
+  std::mutex                       m_bufferMutex;
+  std::vector<int>                 m_free;
+
+  static auto round_up(std::size_t n) -> std::size_t
+  {
+    return (n + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+  }
+
+  void release(int index)
+  {
+    std::lock_guard lock(m_bufferMutex);
+    m_free.push_back(index);
+  }
+};
+
+inline void IoBuffer::reset()
+{
+  if (m_owner && m_index >= 0)
+    m_owner->release(m_index);
+  m_owner = nullptr;
+  m_data  = nullptr;
+  m_size  = 0;
+  m_index = -1;
+  m_heap.reset();
+}
+
+// A batch on its way through a backend; the last request to finish runs the completion
+struct InFlight
+{
+  Batch                    batch;
+  Completion               done;
+  std::atomic<std::size_t> remaining;
+
+  InFlight(Batch b, Completion d)
+      : batch(std::move(b)), done(std::move(d)), remaining(batch.size())
+  {
+  }
+
+  void finish_one()
+  {
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      done(batch);
+  }
+};
+
+/// Runs one request to the end with pread(2)/pwrite(2)
+inline void transfer(Request& req)
+{
+  std::size_t done = 0;
+  while (done < req.len)
+  {
+    const auto    at = static_cast<off_t>(req.offset + done);
+    const ssize_t n  = req.op == Op::Read ? ::pread(req.fd, req.buf + done, req.len - done, at)
+                                          : ::pwrite(req.fd, req.buf + done, req.len - done, at);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+    {
+      req.result = -errno;
+      return;
+    }
+    if (n == 0)
+      break;
+    done += static_cast<std::size_t>(n);
+  }
+  req.result = static_cast<ssize_t>(done);
+}
+
+class ThreadPoolFileIO final : public FileIO
+{
+public:
+  ThreadPoolFileIO(std::size_t threads, std::size_t buffer_count, std::size_t buffer_size)
+      : FileIO(buffer_count, buffer_size)
+  {
+    for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i)
+      m_workers.emplace_back([this] { worker_loop(); });
+  }
+
+  // Queued requests still run before the workers exit
+  ~ThreadPoolFileIO() override
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      m_stopping = true;
+    }
+    m_cv.notify_all();
+    for (auto& worker : m_workers)
+      worker.join();
+  }
+
+  [[nodiscard]] auto name() const -> std::string_view override { return "threads"; }
+
+  void submit(Batch batch, Completion done) override
+  {
+    if (batch.empty())
+    {
+      done(batch);
+      return;
+    }
+
+    auto flight = std::make_shared<InFlight>(std::move(batch), std::move(done));
+    {
+      std::lock_guard lock(m_mutex);
+      for (std::size_t i = 0; i < flight->batch.size(); ++i)
+        m_queue.emplace_back(flight, i);
+    }
+    m_cv.notify_all();
+  }
+
+private:
+  std::mutex                                                    m_mutex;
+  std::condition_variable                                       m_cv;
+  std::deque<std::pair<std::shared_ptr<InFlight>, std::size_t>> m_queue;
+  bool                                                          m_stopping = false;
+  std::vector<std::thread>                                      m_workers;
+
+  void worker_loop()
+  {
+    while (true)
+    {
+      std::pair<std::shared_ptr<InFlight>, std::size_t> item;
+      {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_queue.empty())
+          return;
+        item = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+
+      auto& [flight, index] = item;
+      transfer(flight->batch[index]);
+      flight->finish_one();
+    }
+  }
+};
+
+#ifdef WAVY_HAVE_LIBURING
+
+class IoUringFileIO final : public FileIO
+{
+public:
+  /// nullptr when the kernel refuses a ring (too old, seccomp, io_uring_disabled)
+  static auto create(unsigned depth, std::size_t buffer_count, std::size_t buffer_size)
+    -> std::unique_ptr<IoUringFileIO>
+  {
+    std::unique_ptr<IoUringFileIO> io(new IoUringFileIO(depth, buffer_count, buffer_size));
+    if (!io->m_ready)
+      return nullptr;
+    return io;
+  }
+
+  ~IoUringFileIO() override
+  {
+    if (!m_ready)
+      return;
+
+    // Every slot back means nothing is in flight any more; the NOP then stops the reaper
+    for (unsigned i = 0; i < m_depth; ++i)
+      m_slots.acquire();
+    {
+      std::lock_guard lock(m_submitMutex);
+      io_uring_sqe*   sqe = next_sqe();
+      io_uring_prep_nop(sqe);
+      io_uring_sqe_set_data(sqe, nullptr);
+      io_uring_submit(&m_ring);
+    }
+    m_reaper.join();
+
+    if (m_fixed)
+      io_uring_unregister_buffers(&m_ring);
+    io_uring_queue_exit(&m_ring);
+  }
+
+  [[nodiscard]] auto name() const -> std::string_view override { return "io_uring"; }
+  [[nodiscard]] auto registered() const -> bool override { return m_fixed; }
+
+  // One io_uring_submit() per batch, unless the batch is larger than the free part of
+  // the ring: then it goes out in as few pieces as the ring allows.
+  void submit(Batch batch, Completion done) override
+  {
+    if (batch.empty())
+    {
+      done(batch);
+      return;
+    }
+
+    auto              flight = std::make_shared<InFlight>(std::move(batch), std::move(done));
+    const std::size_t total  = flight->batch.size();
+
+    for (std::size_t first = 0; first < total;)
+    {
+      m_slots.acquire();
+      std::size_t count = 1;
+      while (first + count < total && m_slots.try_acquire())
+        count++;
+
+      std::lock_guard lock(m_submitMutex);
+      for (std::size_t i = first; i < first + count; ++i)
+        queue(new Pending{flight, i});
+      io_uring_submit(&m_ring);
+      first += count;
+    }
+  }
+
+private:
+  struct Pending
+  {
+    std::shared_ptr<InFlight> flight;
+    std::size_t               index;
+    std::size_t               done = 0;
+  };
+
+  // Largest single transfer handed to the kernel, longer requests continue as short ones
+  static constexpr std::size_t MAX_TRANSFER = std::size_t{1} << 30;
+
+  unsigned                  m_depth;
+  std::counting_semaphore<> m_slots; // one per request in flight, keeps the CQ from overflowing
+  io_uring                  m_ring{};
+  std::mutex                m_submitMutex;
+  bool                      m_ready = false;
+  bool                      m_fixed = false;
+  std::thread               m_reaper;
+
+  IoUringFileIO(unsigned depth, std::size_t buffers, std::size_t buffer_bytes)
+      : FileIO(buffers, buffer_bytes), m_depth(std::max(depth, 1u)),
+        m_slots(static_cast<std::ptrdiff_t>(m_depth))
+  {
+    if (io_uring_queue_init(m_depth, &m_ring, 0) < 0)
+      return;
+
+    // Registration can fail on RLIMIT_MEMLOCK; the pool then works like plain memory
+    std::vector<iovec> iovecs(buffer_count());
+    for (std::size_t i = 0; i < iovecs.size(); ++i)
+      iovecs[i] = {.iov_base = buffer_at(i), .iov_len = buffer_size()};
+    m_fixed = !iovecs.empty() &&
+              io_uring_register_buffers(&m_ring, iovecs.data(),
+                                        static_cast<unsigned>(iovecs.size())) == 0;
+
+    m_ready  = true;
+    m_reaper = std::thread([this] { reap(); });
+  }
+
+  auto next_sqe() -> io_uring_sqe*
+  {
+    io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+    while (!sqe)
+    {
+      io_uring_submit(&m_ring);
+      sqe = io_uring_get_sqe(&m_ring);
+    }
+    return sqe;
+  }
+
+  // Caller holds m_submitMutex
+  void queue(Pending* p)
+  {
+    const Request& req = p->flight->batch[p->index];
+    io_uring_sqe*  sqe = next_sqe();
+
+    char*      buf   = req.buf + p->done;
+    const auto len   = static_cast<unsigned>(std::min(req.len - p->done, MAX_TRANSFER));
+    const auto at    = static_cast<__u64>(req.offset + p->done);
+    const bool fixed = m_fixed && req.buf_index >= 0 &&
+                       static_cast<std::size_t>(req.buf_index) < buffer_count();
+
+    if (req.op == Op::Read)
+    {
+      if (fixed)
+        io_uring_prep_read_fixed(sqe, req.fd, buf, len, at, req.buf_index);
+      else
+        io_uring_prep_read(sqe, req.fd, buf, len, at);
+    }
+    else
+    {
+      if (fixed)
+        io_uring_prep_write_fixed(sqe, req.fd, buf, len, at, req.buf_index);
+      else
+        io_uring_prep_write(sqe, req.fd, buf, len, at);
+    }
+    io_uring_sqe_set_data(sqe, p);
+  }
+
+  void reap()
+  {
+    while (true)
+    {
+      io_uring_cqe* cqe = nullptr;
+      const int     rc  = io_uring_wait_cqe(&m_ring, &cqe);
+      if (rc == -EINTR)
+        continue;
+      if (rc < 0)
+        return;
+
+      auto*     p   = static_cast<Pending*>(io_uring_cqe_get_data(cqe));
+      const int res = cqe->res;
+      io_uring_cqe_seen(&m_ring, cqe);
+
+      if (!p)
+        return;
+      settle(p, res);
+    }
+  }
+
+  void settle(Pending* p, int res)
+  {
+    Request& req = p->flight->batch[p->index];
+
+    const bool retry = res == -EINTR || res == -EAGAIN;
+    if (retry || (res > 0 && p->done + static_cast<std::size_t>(res) < req.len))
+    {
+      if (res > 0)
+        p->done += static_cast<std::size_t>(res);
+
+      std::lock_guard lock(m_submitMutex);
+      queue(p);
+      io_uring_submit(&m_ring);
+      return;
+    }
+
+    req.result = res < 0 ? res : static_cast<ssize_t>(p->done + static_cast<std::size_t>(res));
+
+    auto flight = std::move(p->flight);
+    delete p;
+    m_slots.release();
+    flight->finish_one();
+  }
+};
+
+#endif // WAVY_HAVE_LIBURING
+
+/// io_uring when it is compiled in and the kernel allows it, the thread pool otherwise
+inline auto make_file_io(std::size_t threads, unsigned depth, std::size_t buffer_count,
+                         std::size_t buffer_size) -> std::unique_ptr<FileIO>
+{
+#ifdef WAVY_HAVE_LIBURING
+  if (auto ring = IoUringFileIO::create(depth, buffer_count, buffer_size))
+    return ring;
+#else
+  (void)depth;
+#endif
+  return std::make_unique<ThreadPoolFileIO>(threads, buffer_count, buffer_size);
+}
+
+// nullopt: missing, not a regular file, larger than the limit or failed to read
+using FileContents = std::vector<std::optional<std::string>>;
+
+/// Reads whole files: each one is opened and sized on the calling thread, then all of
+/// them are read in a single batch and `done` runs on the backend's thread.
+inline void read_files_async(FileIO& io, const std::vector<std::string>& paths,
+                             std::size_t max_size, std::function<void(FileContents&)> done)
+{
+  struct State
+  {
+    FileContents             contents;
+    std::vector<int>         fds;
+    std::vector<std::size_t> slots; // request -> file
+  };
+
+  auto state = std::make_shared<State>();
+  state->contents.resize(paths.size());
+  state->fds.assign(paths.size(), -1);
+
+  Batch batch;
+  for (std::size_t i = 0; i < paths.size(); ++i)
+  {
+    const int fd = ::open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      continue;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        static_cast<std::size_t>(st.st_size) > max_size)
+    {
+      ::close(fd);
+      continue;
+    }
+
+    const auto size = static_cast<std::size_t>(st.st_size);
+    state->fds[i]   = fd;
+    auto& body      = state->contents[i].emplace(size, '\0');
+    if (size == 0)
+      continue;
+
+    batch.push_back({.op = Op::Read, .fd = fd, .offset = 0, .buf = body.data(), .len = size});
+    state->slots.push_back(i);
+  }
+
+  io.submit(std::move(batch),
+            [state, done = std::move(done)](Batch& finished)
+            {
+              for (std::size_t k = 0; k < finished.size(); ++k)
+              {
+                auto& body = state->contents[state->slots[k]];
+                if (finished[k].result < 0)
+                  body.reset();
+                else
+                  body->resize(static_cast<std::size_t>(finished[k].result));
+              }
+              for (const int fd : state->fds)
+                if (fd >= 0)
+                  ::close(fd);
+              done(state->contents);
+            });
+}
+
+inline auto read_files(FileIO& io, const std::vector<std::string>& paths,
+                       std::size_t max_size = std::numeric_limits<std::size_t>::max())
+  -> FileContents
+{
+  auto finished = std::make_shared<std::promise<FileContents>>();
+  auto result   = finished->get_future();
+  read_files_async(io, paths, max_size, [finished](FileContents& contents)
+                   { finished->set_value(std::move(contents)); });
+  return result.get();
+}
+
+inline auto read_file(FileIO& io, const std::string& path,
+                      std::size_t max_size = std::numeric_limits<std::size_t>::max())
+  -> std::optional<std::string>
+{
+  return std::move(read_files(io, {path}, max_size).front());
+}
+
+/// Copies `src` to `dst` (created or truncated, with `src`'s mode), reading the next
+/// chunk while the previous one is written.
+inline auto copy_file(FileIO& io, const std::filesystem::path& src,
+                      const std::filesystem::path& dst, std::error_code& ec) -> bool
+{
+  ec.clear();
+  auto fail = [&ec](int err)
+  {
+    ec.assign(err, std::generic_category());
+    return false;
+  };
+
+  const int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0)
+    return fail(errno);
+
+  struct stat st{};
+  if (::fstat(in, &st) != 0)
+  {
+    const int err = errno;
+    ::close(in);
+    return fail(err);
+  }
+
+  const int out =
+    ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+  if (out < 0)
+  {
+    const int err = errno;
+    ::close(in);
+    return fail(err);
+  }
+
+  const auto              size    = static_cast<std::size_t>(st.st_size);
+  std::array<IoBuffer, 2> chunks  = {io.buffer(), io.buffer()};
+  auto                    read_at = [&](std::size_t slot, std::size_t at) -> Request
+  {
+    return {.op        = Op::Read,
+            .fd        = in,
+            .offset    = at,
+            .buf       = chunks[slot].data(),
+            .len       = std::min(chunks[slot].size(), size - at),
+            .buf_index = chunks[slot].index()};
+  };
+
+  std::size_t offset = 0;
+  std::size_t filled = 0;
+  std::size_t cur    = 0;
+  int         err    = 0;
+
+  if (size > 0)
+  {
+    const auto first = io.run({read_at(0, 0)});
+    if (first[0].result < 0)
+      err = static_cast<int>(-first[0].result);
+    else
+      filled = static_cast<std::size_t>(first[0].result);
+  }
+
+  while (filled > 0 && err == 0)
+  {
+    Batch batch{{.op        = Op::Write,
+                 .fd        = out,
+                 .offset    = offset,
+                 .buf       = chunks[cur].data(),
+                 .len       = filled,
+                 .buf_index = chunks[cur].index()}};
+    const std::size_t next = offset + filled;
+    if (next < size)
+      batch.push_back(read_at(cur ^ 1, next));
+
+    batch = io.run(std::move(batch));
+    if (batch[0].result != static_cast<ssize_t>(filled))
+    {
+      err = batch[0].result < 0 ? static_cast<int>(-batch[0].result) : EIO;
+      break;
+    }
+
+    filled = 0;
+    if (batch.size() > 1)
+    {
+      if (batch[1].result < 0)
+        err = static_cast<int>(-batch[1].result);
+      else
+        filled = static_cast<std::size_t>(batch[1].result);
+    }
+    offset = next;
+    cur ^= 1;
+  }
+
+  ::close(in);
+  if (::close(out) != 0 && err == 0)
+    err = errno;
+  return err == 0 || fail(err);
+}
+
+/// Sequential writer: full buffers go to the backend and the next one fills while they
+/// are written, with at most `depth` of them in flight.
+class AsyncFileWriter
+{
+public:
+  explicit AsyncFileWriter(FileIO& io, std::size_t depth = 2)
+      : m_io(io), m_slots(std::max<std::size_t>(depth, 1))
+  {
+  }
+
+  AsyncFileWriter(const AsyncFileWriter&)                    = delete;
+  auto operator=(const AsyncFileWriter&) -> AsyncFileWriter& = delete;
+
+  ~AsyncFileWriter() { close(); }
+
+  auto open(const std::filesystem::path& path) -> bool
+  {
+    close();
+    m_fd      = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    m_failed  = m_fd < 0;
+    m_offset  = 0;
+    m_current = 0;
+    return !m_failed;
+  }
+
+  [[nodiscard]] auto is_open() const -> bool { return m_fd >= 0; }
+  explicit operator bool() const { return m_fd >= 0 && !m_failed; }
+
+  auto write(const char* data, std::size_t len) -> bool
+  {
+    while (len > 0 && *this)
+    {
+      Slot& slot = m_slots[m_current];
+      if (!slot.buf.data())
+        slot.buf = m_io.buffer();
+
+      const std::size_t n = std::min(len, slot.buf.size() - slot.fill);
+      std::memcpy(slot.buf.data() + slot.fill, data, n);
+      slot.fill += n;
+      data += n;
+      len -= n;
+
+      if (slot.fill == slot.buf.size())
+        flush();
+    }
+    return static_cast<bool>(*this);
+  }
+
+  /// Writes out what is buffered, waits for everything in flight and closes the file.
+  /// False if any write failed.
+  auto close() -> bool
+  {
+    if (m_fd < 0)
+      return !m_failed;
+
+    if (!m_failed)
+      flush();
+    for (auto& slot : m_slots)
+    {
+      settle(slot);
+      slot.fill = 0;
+      slot.buf.reset();
+    }
+
+    if (::close(m_fd) != 0)
+      m_failed = true;
+    m_fd = -1;
+    return !m_failed;
+  }
+
+private:
+  struct Slot
+  {
+    IoBuffer           buf;
+    std::size_t        fill = 0;
+    std::future<Batch> pending;
+  };
+
+  FileIO&           m_io;
+  std::vector<Slot> m_slots;
+  int               m_fd      = -1;
+  bool              m_failed  = false;
+  std::size_t       m_offset  = 0;
+  std::size_t       m_current = 0;
+
+  // Hands the current buffer to the backend and moves on to the next one, waiting for
+  // it first if it is still being written
+  void flush()
+  {
+    Slot& slot = m_slots[m_current];
+    if (slot.fill == 0 || slot.pending.valid())
+      return;
+
+    auto written = std::make_shared<std::promise<Batch>>();
+    slot.pending = written->get_future();
+    m_io.submit({{.op        = Op::Write,
+                  .fd        = m_fd,
+                  .offset    = m_offset,
+                  .buf       = slot.buf.data(),
+                  .len       = slot.fill,
+                  .buf_index = slot.buf.index()}},
+                [written](Batch& done) { written->set_value(std::move(done)); });
+    m_offset += slot.fill;
+
+    m_current = (m_current + 1) % m_slots.size();
+    settle(m_slots[m_current]);
+  }
+
+  void settle(Slot& slot)
+  {
+    if (!slot.pending.valid())
+      return;
+
+    const Batch done = slot.pending.get();
+    if (done.front().result != static_cast<ssize_t>(done.front().len))
+      m_failed = true;
+    slot.fill = 0;
+  }
+};
+
+} // namespace libwavy::utils::aio
@@ -25,6 +25,7 @@
 
 #include <filesystem>
 #include <fstream>
+#include <libwavy/utils/io/async/entry.hpp>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -48,9 +49,11 @@ namespace libwavy::utils
  * Rename a file like `mv`:
  * - If src and dst are on the same filesystem, uses atomic rename().
  * - If on different filesystems (EBS ↔ S3, etc.), falls back to copy + delete.
+ *   With an `io` backend the copy is pipelined through it (utils/io/async).
  * - Ensures permissions and existence checks are handled safely.
  */
-inline void rename_with_fallback(const fs::path& src, const fs::path& dst)
+inline void rename_with_fallback(const fs::path& src, const fs::path& dst,
+                                 aio::FileIO* io = nullptr)
 {
   std::error_code ec;
 
@@ -74,7 +77,10 @@ inline void rename_with_fallback(const fs::path& src, const fs::path& dst)
                                               ec);
 
     // Copy file contents
-    fs::copy_file(src, dst, fs::copy_options::overwrite_existing, ec);
+    if (io)
+      aio::copy_file(*io, src, dst, ec);
+    else
+      fs::copy_file(src, dst, fs::copy_options::overwrite_existing, ec);
     if (ec)
       throw std::filesystem::filesystem_error("Copy failed", src, dst, ec);
 
@@ -0,0 +1,142 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <algorithm>
+#include <cstddef>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+// Read-only memory mapping of a file.
+//
+// Used by the server to hand file contents to a response without first reading
+// them into an intermediate heap buffer: the bytes are copied once, straight out
+// of the page cache, into whatever the caller builds from the view.
+//
+// Like the other io utils this stays free of libwavy::log; callers check `open()`
+// and log on their side.
+
+namespace libwavy::utils
+{
+
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& path) { open(path); }
+
+  MappedFile(const MappedFile&)                    = delete;
+  auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+      : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)),
+        m_open(std::exchange(other.m_open, false))
+  {
+  }
+
+  auto operator=(MappedFile&& other) noexcept -> MappedFile&
+  {
+    if (this != &other)
+    {
+      close();
+      m_data = std::exchange(other.m_data, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+      m_open = std::exchange(other.m_open, false);
+    }
+    return *this;
+  }
+
+  ~MappedFile() { close(); }
+
+  /// Maps `path` read-only. An empty regular file opens fine with `size() == 0`.
+  auto open(const std::string& path) -> bool
+  {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+      ::close(fd);
+      return false;
+    }
+
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size > 0)
+    {
+      void* addr = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED)
+      {
+        ::close(fd);
+        m_size = 0;
+        return false;
+      }
+      // Segments are always consumed front to back
+      ::madvise(addr, m_size, MADV_SEQUENTIAL);
+      m_data = static_cast<const char*>(addr);
+    }
+
+    // The mapping keeps the pages alive, the descriptor is no longer needed
+    ::close(fd);
+    m_open = true;
+    return true;
+  }
+
+  void close()
+  {
+    if (m_data)
+      ::munmap(const_cast<char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+  }
+
+  [[nodiscard]] auto is_open() const -> bool { return m_open; }
+  [[nodiscard]] auto data() const -> const char* { return m_data; }
+  [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+
+  /// View of `[offset, offset + len)`, clamped to the end of the file.
+  [[nodiscard]] auto view(std::size_t offset = 0, std::size_t len = std::string_view::npos) const
+    -> std::string_view
+  {
+    if (offset >= m_size)
+      return {};
+    return {m_data + offset, std::min(len, m_size - offset)};
+  }
+
+private:
+  const char* m_data = nullptr;
+  std::size_t m_size = 0;
+  bool        m_open = false;
+};
+
+} // namespace libwavy::utils
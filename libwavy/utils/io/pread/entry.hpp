@@ -0,0 +1,132 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <cerrno>
+#include <cstddef>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+// Positioned reads (pread(2)) on a read-only file descriptor.
+//
+// Range responses use this instead of a mapping: only the requested
+// `[offset, offset + len)` window is ever read, and no shared file offset is
+// touched so one descriptor can serve several ranges back to back.
+//
+// Same contract as the other io utils: no libwavy::log, callers check the return.
+
+namespace libwavy::utils
+{
+
+class PositionedFile
+{
+public:
+  PositionedFile() = default;
+  explicit PositionedFile(const std::string& path) { open(path); }
+
+  PositionedFile(const PositionedFile&)                    = delete;
+  auto operator=(const PositionedFile&) -> PositionedFile& = delete;
+
+  PositionedFile(PositionedFile&& other) noexcept
+      : m_fd(std::exchange(other.m_fd, -1)), m_size(std::exchange(other.m_size, 0))
+  {
+  }
+
+  auto operator=(PositionedFile&& other) noexcept -> PositionedFile&
+  {
+    if (this != &other)
+    {
+      close();
+      m_fd   = std::exchange(other.m_fd, -1);
+      m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+  }
+
+  ~PositionedFile() { close(); }
+
+  auto open(const std::string& path) -> bool
+  {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+      ::close(fd);
+      return false;
+    }
+
+    m_fd   = fd;
+    m_size = static_cast<std::size_t>(st.st_size);
+    return true;
+  }
+
+  void close()
+  {
+    if (m_fd >= 0)
+      ::close(m_fd);
+    m_fd   = -1;
+    m_size = 0;
+  }
+
+  [[nodiscard]] auto is_open() const -> bool { return m_fd >= 0; }
+  [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+
+  /// Appends exactly `len` bytes starting at `offset` to `out`.
+  /// Returns false on I/O error or if the file is shorter than expected.
+  auto read_at(std::size_t offset, std::size_t len, std::string& out) const -> bool
+  {
+    const std::size_t base = out.size();
+    out.resize(base + len);
+
+    std::size_t done = 0;
+    while (done < len)
+    {
+      const ssize_t n = ::pread(m_fd, out.data() + base + done, len - done,
+                                static_cast<off_t>(offset + done));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+      {
+        out.resize(base);
+        return false;
+      }
+      done += static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+
+private:
+  int         m_fd   = -1;
+  std::size_t m_size = 0;
+};
+
+} // namespace libwavy::utils
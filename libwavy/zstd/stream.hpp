@@ -0,0 +1,103 @@
+#pragma once
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <cstddef>
+#include <vector>
+#include <zstd.h>
+
+/*
+ * @NOTE
+ *
+ * Streaming counterpart of ZSTD_decompress_file() (decompression.h).
+ *
+ * Input is fed in whatever pieces the caller has (archive blocks, socket reads) and
+ * decoded output is handed to a sink in `ZSTD_DStreamOutSize()` sized pieces. Memory
+ * use is that one output buffer plus the decoder window, independent of the file size,
+ * and frames without a recorded content size decode fine.
+ *
+ */
+
+namespace libwavy::zstd
+{
+
+class StreamDecoder
+{
+public:
+  StreamDecoder() : m_dstream(ZSTD_createDStream()), m_out(ZSTD_DStreamOutSize()) {}
+
+  StreamDecoder(const StreamDecoder&)                    = delete;
+  auto operator=(const StreamDecoder&) -> StreamDecoder& = delete;
+
+  ~StreamDecoder()
+  {
+    if (m_dstream)
+      ZSTD_freeDStream(m_dstream);
+  }
+
+  [[nodiscard]] auto valid() const -> bool { return m_dstream != nullptr; }
+
+  /// Starts a new (possibly multi-frame) stream, the decoder is reused across files.
+  auto reset() -> bool
+  {
+    m_lastRet = 0;
+    m_error   = nullptr;
+    return m_dstream && !ZSTD_isError(ZSTD_initDStream(m_dstream));
+  }
+
+  /// Decodes `len` bytes of compressed input. `sink(const char*, size_t) -> bool` gets
+  /// every decoded piece; returning false from it aborts the stream.
+  template <typename Sink> auto feed(const void* src, std::size_t len, Sink&& sink) -> bool
+  {
+    ZSTD_inBuffer input{src, len, 0};
+    while (input.pos < input.size)
+    {
+      ZSTD_outBuffer output{m_out.data(), m_out.size(), 0};
+
+      const std::size_t ret = ZSTD_decompressStream(m_dstream, &output, &input);
+      if (ZSTD_isError(ret))
+      {
+        m_error = ZSTD_getErrorName(ret);
+        return false;
+      }
+      m_lastRet = ret;
+
+      if (output.pos > 0 && !sink(m_out.data(), output.pos))
+        return false;
+    }
+    return true;
+  }
+
+  /// True once the last frame fed so far has been fully decoded (no truncated input).
+  [[nodiscard]] auto finished() const -> bool { return m_lastRet == 0 && !m_error; }
+  [[nodiscard]] auto error() const -> const char* { return m_error; }
+
+private:
+  ZSTD_DStream*     m_dstream;
+  std::vector<char> m_out;
+  std::size_t       m_lastRet = 0;
+  const char*       m_error   = nullptr;
+};
+
+} // namespace libwavy::zstd
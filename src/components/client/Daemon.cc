@@ -22,11 +22,112 @@
  *  See LICENSE file for full legal details.                                    *
  ********************************************************************************/
 
+#include <condition_variable>
+#include <functional>
 #include <libwavy/components/client/daemon.hpp>
+#include <libwavy/components/client/seek.hpp>
+#include <mutex>
+#include <thread>
 
 namespace libwavy::components::client
 {
 
+namespace
+{
+
+using BatchSink = std::function<void(AudioData&&)>;
+using Producer  = std::function<bool(const BatchSink&, const std::atomic<bool>&)>;
+
+// Runs `produce` on its own thread and plays what it hands over. The audio backends play a
+// decoded buffer to the end, so whatever arrived while one batch was playing becomes the next
+// batch. `prefix` goes in front of every batch (init.mp4); `first` is played before anything
+// else, with `skip` seconds dropped from its front.
+auto playInBatches(const Producer& produce, const RelPath& backend, bool flac_found,
+                   const AudioData& prefix = {}, TotalAudioData first = {}, double skip = 0.0)
+  -> bool
+{
+  std::mutex              mutex;
+  std::condition_variable cv;
+  TotalAudioData          queued;
+  bool                    done     = false;
+  bool                    produced = true;
+  std::atomic<bool>       stop{false};
+
+  std::jthread fetch(
+    [&]
+    {
+      produced = produce(
+        [&](AudioData&& data)
+        {
+          {
+            std::lock_guard lock(mutex);
+            queued.push_back(std::move(data));
+          }
+          cv.notify_one();
+        },
+        stop);
+
+      {
+        std::lock_guard lock(mutex);
+        done = true;
+      }
+      cv.notify_one();
+    });
+
+  if (!first.empty() && !utils::audio::decodeAndPlay(first, flac_found, backend, skip))
+  {
+    stop = true;
+    return false;
+  }
+
+  for (;;)
+  {
+    TotalAudioData batch;
+    if (!prefix.empty())
+      batch.push_back(prefix);
+    {
+      std::unique_lock lock(mutex);
+      cv.wait(lock, [&] { return done || !queued.empty(); });
+      if (queued.empty())
+        break;
+      std::move(queued.begin(), queued.end(), std::back_inserter(batch));
+      queued.clear();
+    }
+
+    if (!utils::audio::decodeAndPlay(batch, flac_found, backend))
+    {
+      stop = true;
+      return false;
+    }
+  }
+
+  fetch.join();
+  return produced;
+}
+
+} // namespace
+
+auto WavyClient::resolveAudioId(fetch::ISegmentFetcher& fetcher, int index)
+  -> std::optional<StorageAudioID>
+{
+  // Fetch client list and audio ID
+  const Owners owners = fetcher.fetchOwnersList(m_server, m_nickname);
+  if (owners.empty())
+  {
+    log::ERROR<log::CLIENT>("Failed to fetch clients. Exiting...");
+    return std::nullopt;
+  }
+
+  // Validate the index
+  if (index < 0 || index >= static_cast<int>(owners.size()))
+  {
+    log::ERROR<log::CLIENT>("Invalid index. Available range: 0 to {}", owners.size() - 1);
+    return std::nullopt;
+  }
+
+  return owners[index];
+}
+
 auto WavyClient::start(bool flac_found, int index, const bool& use_chunked_stream) -> int
 {
   log::DBG<log::CLIENT>("Powering up WavyClient...");
@@ -44,28 +145,74 @@ auto WavyClient::start(bool flac_found, int index, const bool& use_chunked_strea
     return WAVY_RET_FAIL;
   }
 
-  // Fetch client list and audio ID
-  const Owners owners = fetcher->fetchOwnersList(m_server, m_nickname);
-  if (owners.empty())
+  const auto audio_id = resolveAudioId(*fetcher, index);
+  if (!audio_id)
+    return WAVY_RET_FAIL;
+
+  // Fetch the transport stream
+  if (!fetcher->fetchAndPlay(m_nickname, *audio_id, m_bitrate, flac_found, m_audioBackendLibPath,
+                             use_chunked_stream))
   {
-    log::ERROR<log::CLIENT>("Failed to fetch clients. Exiting...");
+    log::ERROR<log::CLIENT>("Something went horribly wrong while fetching!!");
     return WAVY_RET_FAIL;
   }
 
-  // Validate the index
-  if (index < 0 || index >= static_cast<int>(owners.size()))
+  return WAVY_RET_SUC;
+}
+
+auto WavyClient::startAt(int index, double seconds) -> int
+{
+  log::DBG<log::CLIENT>("Powering up WavyClient to play from {:.3f}s...", seconds);
+
+  fetch::SegmentFetcherPtr fetcher;
+
+  try
   {
-    log::ERROR<log::CLIENT>("Invalid index. Available range: 0 to {}", owners.size() - 1);
+    fetcher = libwavy::fetch::plugin::FetcherFactory::create(m_pluginPath, m_server);
+  }
+  catch (const std::exception& e)
+  {
+    log::ERROR<log::PLUGIN>("Plugin error: {}", e.what());
     return WAVY_RET_FAIL;
   }
 
-  const StorageAudioID audio_id = owners[index];
+  const auto audio_id = resolveAudioId(*fetcher, index);
+  if (!audio_id)
+    return WAVY_RET_FAIL;
 
-  // Fetch the transport stream
-  if (!fetcher->fetchAndPlay(m_nickname, audio_id, m_bitrate, flac_found, m_audioBackendLibPath,
-                             use_chunked_stream))
+  SeekFetcher seek(m_server, m_nickname, *audio_id, m_bitrate);
+  auto        opening = seek.open(seconds);
+  if (!opening)
+    return WAVY_RET_FAIL;
+
+  // The opening of an fMP4 variant is plain FLAC, the segments after it need init.mp4
+  const bool flac_found = seek.fragmented();
+  const bool played     = playInBatches([&](const BatchSink& sink, const std::atomic<bool>& stop)
+                                    { return seek.run(sink, stop); },
+                                    m_audioBackendLibPath, flac_found, seek.init_segment(),
+                                    {std::move(opening->data)}, opening->skip);
+  if (!played)
   {
-    log::ERROR<log::CLIENT>("Something went horribly wrong while fetching!!");
+    log::ERROR<log::CLIENT>("Playback of {}/{} from {:.3f}s failed", m_nickname, *audio_id,
+                            seconds);
+    return WAVY_RET_FAIL;
+  }
+
+  return WAVY_RET_SUC;
+}
+
+auto WavyClient::startLive(const std::string& stream_id) -> int
+{
+  log::DBG<log::CLIENT>("Powering up WavyClient for live stream {}/{}...", m_nickname, stream_id);
+
+  LiveFollower follower(m_server, m_nickname, stream_id);
+  const bool   played = playInBatches(
+    [&](const BatchSink& sink, const std::atomic<bool>& stop)
+    { return follower.run([&](ui64, AudioData&& data) { sink(std::move(data)); }, stop); },
+    m_audioBackendLibPath, false);
+  if (!played)
+  {
+    log::ERROR<log::CLIENT>("Playback of live stream {}/{} failed", m_nickname, stream_id);
     return WAVY_RET_FAIL;
   }
 
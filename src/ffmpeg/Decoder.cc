@@ -22,6 +22,7 @@
  *  See LICENSE file for full legal details.                                    *
  ********************************************************************************/
 
+#include <cmath>
 #include <libwavy/ffmpeg/decoder/entry.hpp>
 
 using Decoder = libwavy::log::DECODER;
@@ -51,13 +52,15 @@ void MediaDecoder::print_audio_metadata(AVFormatContext* formatCtx, AVCodecParam
                                                                         : "This is a lossy codec"));
 }
 
-auto MediaDecoder::decode(TotalAudioData& ts_segments, TotalDecodedAudioData& output_audio) -> bool
+auto MediaDecoder::decode(TotalAudioData& ts_segments, TotalDecodedAudioData& output_audio,
+                          double skip_seconds) -> bool
 {
-  AVFormatContext* input_ctx        = nullptr;
-  AVCodecContext*  codec_ctx        = nullptr;
-  AudioStreamIdx   audio_stream_idx = -1;
+  AVFormatContext*  input_ctx        = nullptr;
+  AVCodecContext*   codec_ctx        = nullptr;
+  AudioStreamIdx    audio_stream_idx = -1;
+  AVIOSegmentCursor cursor{.segments = &ts_segments};
 
-  if (!init_input_context(ts_segments, input_ctx))
+  if (!init_input_context(cursor, input_ctx))
     return false;
 
   detect_format(input_ctx);
@@ -77,7 +80,13 @@ auto MediaDecoder::decode(TotalAudioData& ts_segments, TotalDecodedAudioData& ou
     return false;
   }
 
-  if (!process_packets(input_ctx, codec_ctx, audio_stream_idx, codec_params, output_audio))
+  const auto skip_samples =
+    static_cast<i64>(std::llround(std::max(0.0, skip_seconds) * codec_ctx->sample_rate));
+  if (skip_samples > 0)
+    log::DBG<Decoder>("Dropping the first {} samples ({:.3f}s)", skip_samples, skip_seconds);
+
+  if (!process_packets(input_ctx, codec_ctx, audio_stream_idx, codec_params, output_audio,
+                       skip_samples))
   {
     cleanup(input_ctx, codec_ctx);
     return false;
@@ -91,7 +100,7 @@ auto MediaDecoder::decode(TotalAudioData& ts_segments, TotalDecodedAudioData& ou
   return true;
 }
 
-auto MediaDecoder::init_input_context(TotalAudioData& ts_segments, AVFormatContext*& ctx) -> bool
+auto MediaDecoder::init_input_context(AVIOSegmentCursor& cursor, AVFormatContext*& ctx) -> bool
 {
   ctx          = avformat_alloc_context();
   auto* buffer = static_cast<DecodedAudioData*>(av_malloc(DefaultAVIOBufferSize));
@@ -99,7 +108,7 @@ auto MediaDecoder::init_input_context(TotalAudioData& ts_segments, AVFormatConte
     return false;
 
   AVIOContext* avio_ctx =
-    avio_alloc_context(buffer, DefaultAVIOBufferSize, 0, &ts_segments, &readAVIO, nullptr, nullptr);
+    avio_alloc_context(buffer, DefaultAVIOBufferSize, 0, &cursor, &readAVIO, nullptr, nullptr);
   if (!avio_ctx)
     return false;
 
@@ -166,12 +175,20 @@ auto MediaDecoder::setup_codec(AVCodecParameters* codec_params, AVCodecContext*&
 
 auto MediaDecoder::process_packets(AVFormatContext* ctx, AVCodecContext* codec_ctx,
                                    AudioStreamIdx stream_idx, AVCodecParameters* codec_params,
-                                   TotalDecodedAudioData& output) -> bool
+                                   TotalDecodedAudioData& output, i64 skip_samples) -> bool
 {
   AVPacket* packet  = av_packet_alloc();
   AVFrame*  frame   = av_frame_alloc();
   bool      is_flac = (codec_params->codec_id == AV_CODEC_ID_FLAC);
 
+  // First sample of `frame` to keep, taking it out of what is left to skip
+  auto first_kept = [&skip_samples](const AVFrame* f) -> int
+  {
+    const auto dropped = static_cast<int>(std::min<i64>(skip_samples, f->nb_samples));
+    skip_samples -= dropped;
+    return dropped;
+  };
+
   if (!packet || !frame)
   {
     av_log(nullptr, AV_LOG_ERROR, "Failed to allocate packet or frame\n");
@@ -205,13 +222,14 @@ auto MediaDecoder::process_packets(AVFormatContext* ctx, AVCodecContext* codec_c
     {
       auto fmt            = static_cast<AVSampleFormat>(frame->format);
       int  channels       = frame->ch_layout.nb_channels;
-      int  nb_samples     = frame->nb_samples;
+      int  first          = first_kept(frame);
+      int  nb_samples     = frame->nb_samples - first;
       int  bytesPerSample = av_get_bytes_per_sample(fmt);
 
       if (av_sample_fmt_is_planar(fmt))
       {
         size_t before_size = output.size();
-        for (int i = 0; i < nb_samples; ++i)
+        for (int i = first; i < frame->nb_samples; ++i)
         {
           for (int ch = 0; ch < channels; ++ch)
           {
@@ -230,11 +248,13 @@ auto MediaDecoder::process_packets(AVFormatContext* ctx, AVCodecContext* codec_c
       }
       else
       {
+        size_t skipped  = static_cast<size_t>(first) * channels * bytesPerSample;
         size_t dataSize = static_cast<size_t>(nb_samples) * channels * bytesPerSample;
-        if (frame->data[0] && dataSize > 0 && dataSize <= frame->linesize[0])
+        if (frame->data[0] && dataSize > 0 && skipped + dataSize <= frame->linesize[0])
         {
           size_t before_size = output.size();
-          output.insert(output.end(), frame->data[0], frame->data[0] + dataSize);
+          output.insert(output.end(), frame->data[0] + skipped,
+                        frame->data[0] + skipped + dataSize);
           size_t actual_added = output.size() - before_size;
           if (actual_added != dataSize)
           {
@@ -260,12 +280,13 @@ auto MediaDecoder::process_packets(AVFormatContext* ctx, AVCodecContext* codec_c
   {
     auto fmt            = static_cast<AVSampleFormat>(frame->format);
     int  channels       = frame->ch_layout.nb_channels;
-    int  nb_samples     = frame->nb_samples;
+    int  first          = first_kept(frame);
+    int  nb_samples     = frame->nb_samples - first;
     int  bytesPerSample = av_get_bytes_per_sample(fmt);
 
     if (av_sample_fmt_is_planar(fmt))
     {
-      for (int i = 0; i < nb_samples; ++i)
+      for (int i = first; i < frame->nb_samples; ++i)
       {
         for (int ch = 0; ch < channels; ++ch)
         {
@@ -276,10 +297,12 @@ auto MediaDecoder::process_packets(AVFormatContext* ctx, AVCodecContext* codec_c
     }
     else
     {
+      size_t skipped  = static_cast<size_t>(first) * channels * bytesPerSample;
       size_t dataSize = static_cast<size_t>(nb_samples) * channels * bytesPerSample;
-      if (frame->data[0] && dataSize > 0 && dataSize <= frame->linesize[0])
+      if (frame->data[0] && dataSize > 0 && skipped + dataSize <= frame->linesize[0])
       {
-        output.insert(output.end(), frame->data[0], frame->data[0] + dataSize);
+        output.insert(output.end(), frame->data[0] + skipped,
+                      frame->data[0] + skipped + dataSize);
       }
     }
   }
@@ -25,6 +25,7 @@
 #include <filesystem>
 #include <fstream>
 #include <libwavy/ffmpeg/hls/entry.hpp>
+#include <libwavy/ffmpeg/hls/seek-index.hpp>
 #include <regex>
 
 namespace fs = std::filesystem;
@@ -145,6 +146,9 @@ cleanup:
   if (input_ctx)
     avformat_close_input(&input_ctx);
 
+  if (ret >= 0)
+    writeSeekIndex(output_playlist_str);
+
   return ret >= 0;
 }
 
@@ -171,6 +175,9 @@ auto HLS_Segmenter::createSegments(CStrRelPath input_file, CStrDirectory output_
     return {};
   }
 
+  if (!use_flac)
+    writeSeekIndex(output_playlist);
+
   return found_bitrates;
 }
 
@@ -338,4 +345,13 @@ auto HLS_Segmenter::encode_variant(CStrRelPath input_file, CStrRelPath output_pl
   return true;
 }
 
+void HLS_Segmenter::writeSeekIndex(const AbsPath& playlist)
+{
+  if (SeekIndexBuilder::write(fs::path(playlist.str())))
+    log::DBG<HLS>("Wrote seek index for {}", playlist.str());
+  else
+    log::WARN<HLS>("Could not build a seek index for {}, seeking will not work on it",
+                   playlist.str());
+}
+
 } // namespace libwavy::ffmpeg::hls
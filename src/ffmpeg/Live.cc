@@ -0,0 +1,226 @@
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#include <chrono>
+#include <libwavy/ffmpeg/hls/live.hpp>
+#include <memory>
+#include <thread>
+
+using HLS = libwavy::log::HLS;
+
+namespace libwavy::ffmpeg::hls
+{
+
+LiveSegmenter::LiveSegmenter(double segment_duration, bool realtime)
+    : m_segmentDuration(segment_duration), m_realtime(realtime)
+{
+}
+
+auto LiveSegmenter::run(const std::string& input, const LiveSegmentSink& sink,
+                        const std::atomic<bool>& stop) -> bool
+{
+  const std::string url       = input == "-" ? "pipe:0" : input;
+  AVFormatContext*  input_ctx = nullptr;
+
+  int ret = avformat_open_input(&input_ctx, url.c_str(), nullptr, nullptr);
+  if (ret < 0)
+  {
+    log::ERROR<HLS>("Could not open live source: {}", input);
+    return false;
+  }
+  std::unique_ptr<AVFormatContext*, void (*)(AVFormatContext**)> input_guard(
+    &input_ctx, avformat_close_input);
+
+  if ((ret = avformat_find_stream_info(input_ctx, nullptr)) < 0)
+  {
+    log::ERROR<HLS>("Could not read stream info of live source: {}", input);
+    return false;
+  }
+
+  const int stream_idx = av_find_best_stream(input_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+  if (stream_idx < 0)
+  {
+    log::ERROR<HLS>("No audio stream in live source: {}", input);
+    return false;
+  }
+
+  const AVStream*       in_stream = input_ctx->streams[stream_idx];
+  const AVRational      time_base = in_stream->time_base;
+  const AVOutputFormat* ts_format = av_guess_format("mpegts", nullptr, nullptr);
+  if (!ts_format ||
+      avformat_query_codec(ts_format, in_stream->codecpar->codec_id, FF_COMPLIANCE_NORMAL) != 1)
+  {
+    log::ERROR<HLS>("Codec '{}' cannot be carried in MPEG-TS, transcode the source first",
+                    avcodec_get_name(in_stream->codecpar->codec_id));
+    return false;
+  }
+
+  log::INFO<HLS>("Live source {}: {} ({} Hz), {:.1f}s segments{}", input,
+                 avcodec_get_name(in_stream->codecpar->codec_id),
+                 in_stream->codecpar->sample_rate, m_segmentDuration,
+                 m_realtime ? ", paced in real time" : "");
+
+  std::vector<AVPacket*> pending;
+  auto                   drop_pending = [&]
+  {
+    for (auto* queued : pending)
+      av_packet_free(&queued);
+    pending.clear();
+  };
+
+  int64_t seg_start = AV_NOPTS_VALUE, seg_end = AV_NOPTS_VALUE, first_pts = AV_NOPTS_VALUE;
+  ui64    sequence  = 0;
+  bool    failed = false, stopped = false;
+
+  // Hands the pending packets to the sink as one segment
+  auto cut = [&]() -> bool
+  {
+    if (pending.empty())
+      return true;
+
+    std::string  data;
+    const double duration = static_cast<double>(seg_end - seg_start) * av_q2d(time_base);
+    const int    muxed    = mux_segment(in_stream->codecpar, time_base, pending, data);
+    drop_pending();
+    if (muxed < 0)
+    {
+      log::ERROR<HLS>("Muxing live segment {} failed ({})", sequence, muxed);
+      failed = true;
+      return false;
+    }
+
+    log::DBG<HLS>(LogMode::Async, "Live segment {}: {:.3f}s, {} bytes", sequence, duration,
+                  data.size());
+    if (!sink(sequence++, duration, std::move(data)))
+    {
+      stopped = true;
+      return false;
+    }
+    return true;
+  };
+
+  AVPacket* pkt = av_packet_alloc();
+  if (!pkt)
+    return false;
+
+  const auto wall_start = std::chrono::steady_clock::now();
+  while (!stop && av_read_frame(input_ctx, pkt) >= 0)
+  {
+    if (pkt->stream_index != stream_idx)
+    {
+      av_packet_unref(pkt);
+      continue;
+    }
+
+    if (pkt->pts == AV_NOPTS_VALUE)
+      pkt->pts = pkt->dts;
+    if (pkt->pts == AV_NOPTS_VALUE) // cannot be placed in a segment
+    {
+      av_packet_unref(pkt);
+      continue;
+    }
+
+    if (first_pts == AV_NOPTS_VALUE)
+      first_pts = pkt->pts;
+
+    if (m_realtime)
+      std::this_thread::sleep_until(
+        wall_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                       std::chrono::duration<double>(static_cast<double>(pkt->pts - first_pts) *
+                                                     av_q2d(time_base))));
+
+    // Audio packets are all keyframes, so any packet can start a segment
+    if (seg_start == AV_NOPTS_VALUE)
+      seg_start = pkt->pts;
+    else if (static_cast<double>(pkt->pts - seg_start) * av_q2d(time_base) >= m_segmentDuration)
+    {
+      if (!cut())
+        break;
+      seg_start = pkt->pts;
+    }
+
+    seg_end = pkt->pts + pkt->duration;
+    pending.push_back(av_packet_clone(pkt));
+    av_packet_unref(pkt);
+  }
+  av_packet_free(&pkt);
+
+  // The tail is a short segment of its own; a stopped run drops it
+  if (!failed && !stopped && !stop)
+    cut();
+
+  drop_pending();
+  return !failed;
+}
+
+auto LiveSegmenter::mux_segment(const AVCodecParameters* codecpar, AVRational time_base,
+                                std::vector<AVPacket*>& packets, std::string& out) -> int
+{
+  AVFormatContext* output_ctx = nullptr;
+  int              ret = avformat_alloc_output_context2(&output_ctx, nullptr, "mpegts", nullptr);
+  if (ret < 0 || !output_ctx)
+    return ret < 0 ? ret : AVERROR_UNKNOWN;
+
+  AVStream* out_stream = avformat_new_stream(output_ctx, nullptr);
+  if (!out_stream)
+  {
+    avformat_free_context(output_ctx);
+    return AVERROR(ENOMEM);
+  }
+
+  if ((ret = avcodec_parameters_copy(out_stream->codecpar, codecpar)) < 0 ||
+      (ret = avio_open_dyn_buf(&output_ctx->pb)) < 0)
+  {
+    avformat_free_context(output_ctx);
+    return ret;
+  }
+  out_stream->codecpar->codec_tag = 0;
+  out_stream->time_base           = time_base;
+
+  if ((ret = avformat_write_header(output_ctx, nullptr)) >= 0)
+  {
+    for (auto* packet : packets)
+    {
+      av_packet_rescale_ts(packet, time_base, out_stream->time_base);
+      packet->stream_index = 0;
+      packet->pos          = -1;
+      if ((ret = av_interleaved_write_frame(output_ctx, packet)) < 0)
+        break;
+    }
+    if (ret >= 0)
+      ret = av_write_trailer(output_ctx);
+  }
+
+  uint8_t*  buffer = nullptr;
+  const int size   = avio_close_dyn_buf(output_ctx->pb, &buffer);
+  output_ctx->pb   = nullptr;
+  if (ret >= 0 && size > 0)
+    out.assign(reinterpret_cast<const char*>(buffer), static_cast<std::size_t>(size));
+  av_free(buffer);
+  avformat_free_context(output_ctx);
+
+  return ret < 0 ? ret : (size > 0 ? 0 : AVERROR_UNKNOWN);
+}
+
+} // namespace libwavy::ffmpeg::hls
@@ -26,6 +26,9 @@
 #include <filesystem>
 #include <libwavy/common/api/entry.hpp>
 #include <libwavy/log-macros.hpp>
+#include <libwavy/server/auth.hpp>
+#include <libwavy/server/extract-pipeline.hpp>
+#include <libwavy/server/precompress.hpp>
 #include <libwavy/server/server.hpp>
 
 namespace fs   = std::filesystem;
@@ -43,7 +46,7 @@ auto is_valid_extension(const FileName& filename) -> bool
   return filename.ends_with(macros::PLAYLIST_EXT) ||
          filename.ends_with(macros::TRANSPORT_STREAM_EXT) ||
          filename.ends_with(macros::M4S_FILE_EXT) || filename.ends_with(macros::TOML_FILE_EXT) ||
-         filename.ends_with(macros::OWNER_FILE_EXT);
+         filename.ends_with(macros::OWNER_FILE_EXT) || filename.ends_with(macros::SEEK_INDEX_EXT);
 }
 
 auto validate_m3u8_format(const PlaylistData& content) -> bool
@@ -103,94 +106,47 @@ auto validate_m4s(const RelPath& m4s_path) -> bool
   return true;
 }
 
-auto extract_payload(const RelPath& payload_path, const RelPath& extract_path) -> bool
+auto extract_payload(std::string_view payload, const RelPath& extract_path,
+                     utils::aio::FileIO& io, ingest::ExtractResult& out,
+                     const ingest::PayloadObserver& on_payload) -> bool
 {
-  log::INFO<SExtract>("Extracting PAYLOAD: {}", payload_path);
+  log::INFO<SExtract>("Extracting PAYLOAD ({} bytes) into: {}", payload.size(), extract_path);
 
-  struct archive*       a   = archive_read_new();
-  struct archive*       ext = archive_write_disk_new();
-  struct archive_entry* entry;
-
-  archive_read_support_filter_gzip(a);
-  archive_read_support_format_tar(a);
-  archive_write_disk_set_options(ext, ARCHIVE_EXTRACT_PERM);
-
-  if (archive_read_open_filename(a, payload_path.c_str(), ARCHIVE_READ_BUFFER_SIZE) != ARCHIVE_OK)
+  // Decoding, validation, hashing and the write of each entry happen on the pipeline's
+  // workers as the archive is walked, nothing is read back afterwards.
+  ingest::ExtractPipeline pipeline(io);
+  if (!pipeline.run(payload, fs::path(extract_path), out, on_payload))
   {
-    log::ERROR<SExtract>("Failed to open archive: {}", archive_error_string(a));
-    archive_read_free(a);
-    archive_write_free(ext);
+    log::ERROR<SExtract>("Failed to read archive: {}", out.error);
     return false;
   }
 
-  bool valid_files_found = false;
-
-  while (archive_read_next_header(a, &entry) == ARCHIVE_OK)
-  {
-    RelPath filename    = archive_entry_pathname(entry);
-    AbsPath output_file = AbsPath(extract_path) / filename;
-
-    log::TRACE<SExtract>("Extracting file: {}",
-                         fs::relative(output_file, macros::SERVER_STORAGE_DIR).string());
-
-    archive_entry_set_pathname(entry, output_file.c_str());
+  for (const auto& file : out.files)
+    log::TRACE<SExtract>("Extracted file: {} ({} bytes)", file.name, file.size);
 
-    if (archive_write_header(ext, entry) == ARCHIVE_OK)
-    {
-      std::ofstream ofs(output_file, std::ios::binary);
-      if (!ofs)
-      {
-        log::ERROR<SExtract>("Failed to open file for writing: {}", output_file.str());
-        continue;
-      }
-
-      char    buffer[8192]; // maybe better off using std::array<>?
-      ssize_t len;
-      while ((len = archive_read_data(a, buffer, sizeof(buffer))) > 0)
-      {
-        ofs.write(buffer, len);
-      }
-      ofs.close();
-
-      valid_files_found = true;
+  return !out.files.empty();
+}
 
-      // If the extracted file is a .zst file, decompress it
-      if (output_file.substr(output_file.find_last_of(".") + 1) == macros::ZSTD_FILE_EXT)
-      {
-        log::TRACE<log::NONE>("[ZSTD] Decompressing .zst file: {}",
-                              fs::relative(output_file, macros::SERVER_TEMP_STORAGE_DIR).string());
-        if (!ZSTD_decompress_file(output_file.c_str()))
-        {
-          log::ERROR<log::NONE>("[ZSTD] Failed to decompress .zst file: {}", output_file.str());
-          continue;
-        }
+auto write_track_manifest(const AbsPath&                                      storage_path,
+                          const std::vector<std::pair<FileName, std::string>>& entries) -> bool
+{
+  const fs::path manifest_path = fs::path(storage_path.str()) / macros::MANIFEST_FILE;
 
-        RelPath decompressed_filename =
-          output_file.substr(0, output_file.find_last_of(".")); // remove .zst extension
-        log::INFO<SExtract>(
-          "Decompressed file: {}",
-          fs::relative(decompressed_filename, macros::SERVER_TEMP_STORAGE_DIR).string());
+  // Atomic write: readers either see no manifest or a complete one
+  fs::path tmp = manifest_path;
+  tmp += ".tmp";
 
-        if (std::remove(output_file.c_str()) == 0)
-        {
-          log::TRACE<log::NONE>(
-            "[ZSTD] Deleted the original .zst file: {}",
-            fs::relative(output_file, macros::SERVER_TEMP_STORAGE_DIR).string());
-        }
-        else
-        {
-          log::ERROR<log::NONE>(
-            "[ZSTD] Failed to delete .zst file: {}",
-            fs::relative(output_file, macros::SERVER_TEMP_STORAGE_DIR).string());
-        }
-      }
-    }
-  }
+  std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+  if (!ofs)
+    return false;
 
-  archive_read_free(a);
-  archive_write_free(ext);
+  for (const auto& [fname, sha] : entries)
+    ofs << sha << "  " << fname << "\n";
+  ofs.close();
 
-  return valid_files_found;
+  std::error_code ec;
+  fs::rename(tmp, manifest_path, ec);
+  return !ec;
 }
 
 void populate_db_from_storage(OwnerAudioIDMap& db, const AbsPath& storage_path)
@@ -209,6 +165,8 @@ void populate_db_from_storage(OwnerAudioIDMap& db, const AbsPath& storage_path)
           continue;
 
         const auto owner = nickname_entry.path().filename().string();
+        if (owner.front() == '.') // .keys, .catalog
+          continue;
 
         for (const fs::directory_entry& audio_entry : fs::directory_iterator(nickname_entry.path()))
         {
@@ -223,143 +181,138 @@ void populate_db_from_storage(OwnerAudioIDMap& db, const AbsPath& storage_path)
     });
 }
 
-auto extract_and_validate(const RelPath& gzip_path, const StorageAudioID& audio_id,
-                          OwnerAudioIDMap& g_owner_audio_db) -> StorageOwnerID
+auto extract_and_validate(std::string_view payload, const StorageAudioID& audio_id,
+                          CatalogLog& catalog, utils::aio::FileIO& io, ObjectStore* objects,
+                          ingest::StorageLayout          layout,
+                          const ingest::PayloadObserver& on_payload) -> StorageOwnerID
 {
-  log::INFO<SExtract>(LogMode::Async, " Validating and extracting GZIP file: {}", gzip_path);
+  log::INFO<SExtract>(LogMode::Async, " Validating and extracting payload for Audio-ID: {}",
+                      audio_id);
 
-  if (!fs::exists(gzip_path))
+  if (payload.empty())
   {
-    log::ERROR<SExtract>(LogMode::Async, " File does not exist: {}", gzip_path);
+    log::ERROR<SExtract>(LogMode::Async, " Empty payload!");
     return "";
   }
 
-  const AbsPath temp_extract_path =
-    macros::to_string(macros::SERVER_TEMP_STORAGE_DIR) + "/" + audio_id;
-  fs::create_directories(temp_extract_path);
+  const fs::path staging_path =
+    fs::path(macros::to_string(macros::SERVER_TEMP_STORAGE_DIR)) / audio_id;
+  fs::create_directories(staging_path);
+
+  auto discard_staging = [&]
+  {
+    std::error_code ec;
+    fs::remove_all(staging_path, ec);
+  };
 
-  if (!extract_payload(gzip_path, temp_extract_path))
+  ingest::ExtractResult extracted;
+  if (!extract_payload(payload, staging_path.string(), io, extracted, on_payload))
   {
     log::ERROR<SExtract>(LogMode::Async, " Extraction failed!");
+    discard_staging();
     return "";
   }
 
-  log::INFO<SExtract>(LogMode::Async, " Extraction complete. Scanning for owner file...");
+  for (const auto& rejected : extracted.rejected)
+    log::WARN<SExtract>(LogMode::Async, " Rejected {}: {}", rejected.name, rejected.reason);
 
-  StorageOwnerID ownerNickname;
-  bool           ownerFound = false;
-
-  // First pass: find the owner file
-  for (const fs::directory_entry& file : fs::directory_iterator(temp_extract_path))
-  {
-    FileName fname = file.path().filename().string();
-    if (fname.ends_with(macros::OWNER_FILE_EXT))
-    {
-      ownerNickname = fname;
-      ownerFound    = true;
-      log::INFO<SExtract>(LogMode::Async, " Found OWNER nickname file: {}", fname);
-      break;
-    }
-  }
-
-  if (!ownerFound)
+  if (extracted.owner.empty())
   {
     log::ERROR<SExtract>(LogMode::Async, " Missing OWNER file. Cannot determine destination path.");
+    discard_staging();
     return "";
   }
 
-  const AbsPath storage_path =
-    macros::to_string(macros::SERVER_STORAGE_DIR) + "/" + ownerNickname + "/" + audio_id;
-
-  fs::create_directories(storage_path);
+  const StorageOwnerID& ownerNickname = extracted.owner;
+  log::INFO<SExtract>(LogMode::Async, " Found OWNER nickname file: {}", ownerNickname);
 
-  log::INFO<SExtract>(LogMode::Async, " Validating and moving extracted files...");
-
-  int valid_file_count  = 0;
+  // Everything was validated while it streamed in; what is left is the one-metadata rule
   int metadataFileCount = 0;
 
-  // Second pass: validate and move files
-  for (const fs::directory_entry& file : fs::directory_iterator(temp_extract_path))
-  {
-    FileName fname = file.path().filename().string();
-
-    // Skip the owner file, we already handled it
-    if (fname.ends_with(macros::OWNER_FILE_EXT))
-      continue;
-
-    std::ifstream infile(file.path().string(), std::ios::binary);
-    if (!infile)
-    {
-      log::WARN<SExtract>(LogMode::Async, " Could not open file: {}", fname);
-      fs::remove(file.path());
-      continue;
-    }
-
-    AudioBuffer data((std::istreambuf_iterator<char>(infile)), {});
-
-    if (fname.ends_with(macros::PLAYLIST_EXT))
-    {
-      if (!validate_m3u8_format(std::string(data.begin(), data.end())))
-      {
-        log::WARN<SExtract>(LogMode::Async, " Invalid M3U8 file, removing: {}", fname);
-        fs::remove(file.path());
-        continue;
-      }
-    }
-    else if (fname.ends_with(macros::TRANSPORT_STREAM_EXT))
-    {
-      if (!validate_ts_file(data))
-      {
-        log::WARN<SExtract>(LogMode::Async, " Invalid TS file, removing: {}", fname);
-        fs::remove(file.path());
-        continue;
-      }
-    }
-    else if (fname.ends_with(macros::M4S_FILE_EXT))
-    {
-      if (!validate_m4s(file.path().string()))
-      {
-        log::TRACE<SExtract>(LogMode::Async, " Possibly invalid M4S segment: {}", fname);
-      }
-    }
-    else if (fname.ends_with(macros::MP4_FILE_EXT))
-    {
-      log::DBG<SExtract>(LogMode::Async, " Found MP4 file: {}", fname);
-    }
-    else if (fname.ends_with(macros::TOML_FILE_EXT))
-    {
-      if (metadataFileCount++ > 0)
-      {
-        log::WARN<SExtract>(LogMode::Async, " Extra metadata TOML file ignored: {}", fname);
-        fs::remove(file.path());
-        continue;
-      }
+  // sha256 of every stored file, written out as the track's manifest (ETag source)
+  std::vector<std::pair<FileName, std::string>> manifest_entries;
 
-      log::DBG<SExtract>(LogMode::Async, " Found metadata TOML file: {}", fname);
-    }
-    else
+  for (auto& file : extracted.files)
+  {
+    if (file.kind == ingest::EntryKind::Metadata && metadataFileCount++ > 0)
     {
-      log::WARN<SExtract>(" Unknown file, removing: {}", fname);
-      fs::remove(file.path());
+      log::WARN<SExtract>(LogMode::Async, " Extra metadata TOML file ignored: {}", file.name);
+      fs::remove(staging_path / file.name);
+      fs::remove(staging_path / encoding::variant_name(file.name, encoding::Coding::Zstd));
       continue;
     }
 
-    // Move to storage
-    //
-    // will account for EXDEV errors internally (e.g., cross-device moves)
-    utils::rename_with_fallback(file.path(), storage_path / fname);
-    log::INFO<SExtract>(LogMode::Async, " File stored: {}", fname);
-    valid_file_count++;
+    manifest_entries.emplace_back(file.name, std::move(file.sha256));
   }
 
-  if (valid_file_count == 0)
+  if (manifest_entries.empty())
   {
     log::ERROR<SExtract>(LogMode::Async,
                          " No valid files remain after validation. Extraction failed.");
+    discard_staging();
     return "";
   }
 
-  g_owner_audio_db.insert(ownerNickname, audio_id);
+  if (layout == ingest::StorageLayout::Packed)
+  {
+    ingest::TrackPacker packer(staging_path, manifest_entries);
+    const auto          packed = packer.run();
+    log::INFO<SExtract>(LogMode::Async, " Packed {} segments into {} packfiles for Audio-ID: {}",
+                        packed.segments, packed.playlists, audio_id);
+    if (!packed.error.empty())
+      log::WARN<SExtract>(LogMode::Async, " Kept loose segments ({}) for Audio-ID: {}",
+                          packed.error, audio_id);
+  }
+
+  // After packing: the variants have to match the playlists as they are served
+  {
+    ingest::Precompressor precompressor(staging_path, manifest_entries);
+    const auto            pre = precompressor.run();
+    log::INFO<SExtract>(LogMode::Async,
+                        " Stored {} precompressed variants of {} text files ({} -> {} bytes "
+                        "with zstd) for Audio-ID: {}",
+                        pre.variants, pre.files, pre.bytes_in, pre.zstd_out, audio_id);
+  }
+
+  // The manifest goes in before publishing so the track never appears without it
+  if (!write_track_manifest(staging_path.string(), manifest_entries))
+  {
+    log::WARN<SExtract>(LogMode::Async, " Failed to write manifest for Audio-ID: {}", audio_id);
+  }
+
+  const fs::path storage_path =
+    fs::path(macros::to_string(macros::SERVER_STORAGE_DIR)) / ownerNickname / audio_id;
+  fs::create_directories(storage_path.parent_path());
+
+  // Publish the whole track with one rename, falling back to per-file moves if
+  // storage lives on another filesystem (EXDEV)
+  std::error_code ec;
+  fs::rename(staging_path, storage_path, ec);
+  if (ec)
+  {
+    log::DBG<SExtract>(LogMode::Async, " Directory rename failed ({}), moving files one by one",
+                       ec.message());
+
+    fs::create_directories(storage_path);
+    for (const fs::directory_entry& file : fs::directory_iterator(staging_path))
+      utils::rename_with_fallback(file.path(), storage_path / file.path().filename(), &io);
+    discard_staging();
+  }
+
+  log::INFO<SExtract>(LogMode::Async, " Stored {} files for Audio-ID: {}",
+                      manifest_entries.size(), audio_id);
+
+  // The track is already readable: link_track hard-links each shared file to a temporary
+  // name and renames it over the stored copy, so a concurrent reader sees either file whole
+  if (objects)
+  {
+    const auto deduped = objects->link_track(storage_path, manifest_entries);
+    log::INFO<SExtract>(LogMode::Async,
+                        " Deduplicated Audio-ID {}: {} files shared ({} bytes), {} new objects",
+                        audio_id, deduped.shared, deduped.bytes, deduped.stored);
+  }
+
+  catalog.record_insert(ownerNickname, audio_id);
   log::DBG<SExtract>(LogMode::Async, " Relation stored: owner={} -> audio_id={}", ownerNickname,
                      audio_id);
 
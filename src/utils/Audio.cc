@@ -30,7 +30,7 @@ namespace libwavy::utils::audio
 {
 
 auto decodeAndPlay(TotalAudioData& segments, bool& flac_found,
-                   const RelPath& customAudioBackendLibPath) -> bool
+                   const RelPath& customAudioBackendLibPath, double skip_seconds) -> bool
 {
   try
   {
@@ -44,7 +44,7 @@ auto decodeAndPlay(TotalAudioData& segments, bool& flac_found,
 
     libwavy::ffmpeg::MediaDecoder decoder;
     TotalDecodedAudioData         decoded_audio;
-    if (!decoder.decode(segments, decoded_audio))
+    if (!decoder.decode(segments, decoded_audio, skip_seconds))
     {
       log::ERROR<Decoder>("Decoding failed!!! Check callback logs for more info.");
       return false;
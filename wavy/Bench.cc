@@ -0,0 +1,105 @@
+/********************************************************************************
+ *                                Wavy Project                                  *
+ *                         High-Fidelity Audio Streaming                        *
+ *                                                                              *
+ *  Copyright (c) 2025 Oinkognito                                               *
+ *  All rights reserved.                                                        *
+ *                                                                              *
+ *  License:                                                                    *
+ *  This software is licensed under the BSD-3-Clause License. You may use,      *
+ *  modify, and distribute this software under the conditions stated in the     *
+ *  LICENSE file provided in the project root.                                  *
+ *                                                                              *
+ *  Warranty Disclaimer:                                                        *
+ *  This software is provided "AS IS", without any warranties or guarantees,    *
+ *  either expressed or implied, including but not limited to fitness for a     *
+ *  particular purpose.                                                         *
+ *                                                                              *
+ *  Contributions:                                                              *
+ *  Contributions are welcome. By submitting code, you agree to license your    *
+ *  contributions under the same BSD-3-Clause terms.                            *
+ *                                                                              *
+ *  See LICENSE file for full legal details.                                    *
+ ********************************************************************************/
+
+#if __cplusplus < 202002L
+#error "Wavy-Bench requires C++20 or later."
+#endif
+
+#include <iostream>
+#include <libwavy/components/bench/runner.hpp>
+#include <libwavy/log-macros.hpp>
+#include <libwavy/utils/cmd-line/parser.hpp>
+
+auto main(int argc, char* argv[]) -> int
+{
+  INIT_WAVY_LOGGER_ALL();
+  namespace logger = lwlog;
+  namespace bench  = libwavy::components::bench;
+  using Bench      = libwavy::log::BENCH;
+
+  // The playlist parser logs at INFO for every playlist it reads; progress and the report
+  // go to stdout instead
+  logger::set_log_level(logger::__WARNING__);
+
+  libwavy::utils::cmdline::CmdLineParser parser(std::span<char* const>(argv, argc));
+
+  parser.register_args(
+    {{{"serverIP", "ip"}, "Wavy server IP or host (default 127.0.0.1)"},
+     {{"port"}, "Wavy server port (default " WAVY_SERVER_PORT_NO_STR ")"},
+     {{"listeners", "l"}, "Concurrent simulated listeners (default 32)"},
+     {{"uploaders", "u"}, "Concurrent upload loops, needs --uploadFile (default 0)"},
+     {{"uploadFile"}, "Archive (as made by wavy_owner) to upload repeatedly"},
+     {{"uploadLayout"}, "files | packed, passed to /upload as ?layout="},
+     {{"duration", "d"}, "Seconds to run (default 30)"},
+     {{"rampMs"}, "Listeners and uploaders start spread over this many ms (default 1000)"},
+     {{"thinkMs"}, "Pause after every segment, in ms (default 0)"},
+     {{"realtime"}, "Also wait out each segment's duration, like a real player (flag)"},
+     {{"streamRatio"}, "Share of segments fetched over /stream instead of /download (0-1)"},
+     {{"switchProb"}, "Chance of a bitrate switch before each segment (default 0.05)"},
+     {{"owner"}, "Only play this owner's tracks"},
+     {{"threads", "t"}, "io threads (default: one per core)"},
+     {{"seed"}, "Seed for track / variant choices (default: random)"}});
+
+  if (parser.has("help"))
+  {
+    parser.print_usage();
+    return WAVY_RET_SUC;
+  }
+
+  bench::BenchConfig config;
+  config.server       = parser.get_or<IPAddr>({"serverIP", "ip"}, config.server);
+  config.port         = parser.get_or<std::string>("port", config.port);
+  config.listeners    = parser.get_or<ui32>({"listeners", "l"}, config.listeners);
+  config.uploaders    = parser.get_or<ui32>({"uploaders", "u"}, config.uploaders);
+  config.upload_file  = parser.get_or<std::string>("uploadFile", "");
+  config.duration     = std::chrono::seconds(parser.get_or<ui32>({"duration", "d"}, 30));
+  config.ramp         = std::chrono::milliseconds(parser.get_or<ui32>("rampMs", 1000));
+  config.think        = std::chrono::milliseconds(parser.get_or<ui32>("thinkMs", 0));
+  config.realtime     = parser.get_bool("realtime");
+  config.stream_ratio = parser.get_or<double>("streamRatio", config.stream_ratio);
+  config.switch_prob  = parser.get_or<double>("switchProb", config.switch_prob);
+  config.owner        = parser.get_or<std::string>("owner", "");
+  config.threads      = parser.get_or<ui32>({"threads", "t"}, 0);
+  config.seed         = parser.get_or<ui64>("seed", 0);
+
+  if (const auto layout = parser.get<std::string>("uploadLayout"); layout)
+    config.upload_query = "?layout=" + *layout;
+
+  parser.warn_unknown_args();
+
+  if (config.listeners == 0 && config.uploaders == 0)
+  {
+    logger::ERROR<Bench>("Nothing to do: both --listeners and --uploaders are 0.");
+    return WAVY_RET_FAIL;
+  }
+
+  if (config.uploaders > 0 && config.upload_file.empty())
+  {
+    logger::ERROR<Bench>("--uploaders needs --uploadFile=<archive>");
+    return WAVY_RET_FAIL;
+  }
+
+  bench::BenchRunner runner(std::move(config));
+  return runner.run(std::cout);
+}
@@ -66,7 +66,9 @@ auto main(int argc, char* argv[]) -> int
      {{"fetchLib"}, "Specify the fetch mode' shared library"},
      {{"playFlac"}, "Whether to playback as FLAC stream or not. (Boolean flag)"},
      {{"useChunkedStream"},
-      "Use chunked streaming (for possibly faster streaming of transport segments.)"}
+      "Use chunked streaming (for possibly faster streaming of transport segments.)"},
+     {{"live"}, "Play the nickname's live stream of this name instead of a stored track."},
+     {{"seek"}, "Start playback this many seconds into the track (uses the seek index)."}
 
     });
 
@@ -83,7 +85,18 @@ auto main(int argc, char* argv[]) -> int
   const bool flac_found         = parser.get_bool("playFlac");
   const bool use_chunked_stream = parser.get_bool("useChunkedStream");
 
-  parser.requireMinArgs(6, argc);
+  const std::string live_stream = parser.get_or<std::string>("live", "");
+  const double      seek_to     = parser.get_or<double>("seek", -1.0);
+
+  parser.requireMinArgs(live_stream.empty() ? 6 : 5, argc);
+
+  // Live playback needs no index, bitrate or fetcher plugin
+  if (!live_stream.empty())
+  {
+    libwavy::components::client::WavyClient wavyClient(nickname, server, "", bitrate,
+                                                       audioBackendLibPath);
+    return wavyClient.startLive(live_stream);
+  }
 
   // Check if index or bitrate is valid
   if (index == -1)
@@ -140,5 +153,9 @@ auto main(int argc, char* argv[]) -> int
   libwavy::components::client::WavyClient wavyClient(nickname, server, plugin_path, bitrate,
                                                      audioBackendLibPath);
 
+  // Seeking fetches by byte range through the seek index, the fetcher plugin only lists tracks
+  if (seek_to >= 0.0)
+    return wavyClient.startAt(index, seek_to);
+
   return wavyClient.start(flac_found, index, use_chunked_stream);
 }
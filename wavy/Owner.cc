@@ -28,7 +28,12 @@
 #include <unordered_set>
 
 #include "helpers/Dispatcher.hpp"
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <libwavy/dispatch/live.hpp>
 #include <libwavy/ffmpeg/hls/entry.hpp>
+#include <libwavy/ffmpeg/hls/live.hpp>
 #include <libwavy/ffmpeg/misc/metadata.hpp>
 #include <libwavy/ffmpeg/transcoder/entry.hpp>
 #include <libwavy/log-macros.hpp>
@@ -81,6 +86,51 @@ void DBG_AVlogCheck(const bool& avdebug_mode)
   }
 }
 
+// Cuts the input into segments as it is read and pushes each one to the server, in place of
+// the encode -> archive -> upload path. Runs until the input ends or Ctrl-C.
+auto streamLive(const IPAddr& server, const StorageOwnerID& nickname, const std::string& stream_id,
+                const RelPath& input_file, double segment_secs, bool realtime) -> int
+{
+  if (stream_id.empty())
+  {
+    lwlog::ERROR<Owner>("--live needs a --streamId to publish under");
+    return WAVY_RET_FAIL;
+  }
+  if (!(segment_secs > 0))
+  {
+    lwlog::ERROR<Owner>("--segment must be a positive number of seconds");
+    return WAVY_RET_FAIL;
+  }
+
+  static std::atomic<bool> stop{false};
+  std::signal(SIGINT, [](int) { stop = true; });
+  std::signal(SIGTERM, [](int) { stop = true; });
+
+  libwavy::ffmpeg::hls::LiveSegmenter segmenter(segment_secs, realtime);
+  libwavy::dispatch::LivePublisher    publisher(server, nickname, stream_id,
+                                                static_cast<int>(std::ceil(segment_secs)));
+
+  lwlog::INFO<Owner>("Streaming '{}' live as {}/{} (Ctrl-C to end the stream)", input_file,
+                     nickname, stream_id);
+
+  const bool ok = segmenter.run(
+    input_file,
+    [&](ui64 sequence, double duration, std::string&& data)
+    {
+      publisher.push(sequence, duration, std::move(data));
+      return true;
+    },
+    stop);
+
+  const bool ended = publisher.finish();
+  const auto stats = publisher.stats();
+  lwlog::INFO<Owner>("Live stream {}/{} {}: {} segments sent, {} dropped, {} refused", nickname,
+                     stream_id, ended ? "ended" : "stopped", stats.sent, stats.dropped,
+                     stats.failed);
+
+  return ok ? WAVY_RET_SUC : WAVY_RET_FAIL;
+}
+
 auto main(int argc, char* argv[]) -> int
 {
   libwavy::utils::cmdline::CmdLineParser cmdLineParser(std::span<char* const>(argv, argc));
@@ -90,21 +140,44 @@ auto main(int argc, char* argv[]) -> int
                                {{"inputFile", "i"}, "Input audio file"},
                                {{"serverIP", "ip"}, "Wavy server IP"},
                                {{"nickname", "n"}, "Your storage nickname"},
-                               {{"outputDir", "o"}, "Output directory"}});
+                               {{"outputDir", "o"}, "Output directory"},
+                               {{"live"}, "Push the input as a live stream (input '-' is stdin)"},
+                               {{"streamId", "s"}, "Live stream name"},
+                               {{"segment"}, "Live segment duration in seconds (default 2)"},
+                               {{"realtime"}, "Pace the live input in real time (default true)"}});
 
   const bool avdebug_mode  = cmdLineParser.get_bool("avDbgLog");
   const bool send_raw_file = cmdLineParser.get_bool({"raw", "r"});
 
-  const RelPath        input_file = *cmdLineParser.get<RelPath>({"inputFile", "i"});
-  const IPAddr         server     = *cmdLineParser.get<IPAddr>({"serverIP", "ip"});
-  const StorageOwnerID nickname   = *cmdLineParser.get<StorageOwnerID>({"nickname", "n"});
-  const Directory      output_dir = *cmdLineParser.get<Directory>({"outputDir", "o"});
+  const RelPath        input_file     = *cmdLineParser.get<RelPath>({"inputFile", "i"});
+  const IPAddr         server         = *cmdLineParser.get<IPAddr>({"serverIP", "ip"});
+  const StorageOwnerID nickname       = *cmdLineParser.get<StorageOwnerID>({"nickname", "n"});
+  const auto           output_dir_arg = cmdLineParser.get<Directory>({"outputDir", "o"});
+
+  const bool        live_mode = cmdLineParser.get_bool("live");
+  const std::string stream_id = cmdLineParser.get_or<std::string>({"streamId", "s"}, "");
+  const double      segment_secs =
+    cmdLineParser.get_or<double>("segment", static_cast<double>(WAVY_LIVE_SEGMENT_DURATION));
+  const bool        realtime = cmdLineParser.get_bool("realtime", true);
 
   cmdLineParser.requireMinArgs(5, argc);
   cmdLineParser.warn_unknown_args(true);
 
   INIT_WAVY_LOGGER();
 
+  if (live_mode)
+  {
+    DBG_AVlogCheck(avdebug_mode);
+    return streamLive(server, nickname, stream_id, input_file, segment_secs, realtime);
+  }
+
+  if (!output_dir_arg)
+  {
+    lwlog::ERROR<Owner>("No output directory given (--outputDir)");
+    return WAVY_RET_FAIL;
+  }
+  const Directory output_dir = *output_dir_arg;
+
   libwavy::ffmpeg::Metadata met;
   int                       entryBitrate = met.fetchBitrate(input_file.c_str());
   std::string               audio_format = met.getAudioFormat(input_file.c_str());